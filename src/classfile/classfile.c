@@ -1,7 +1,7 @@
 #include<stdarg.h>
 
 #include "slog.h"
-#include "gc.h"
+#include "runtime/heap.h"
 
 
 #define INCLUDE_CLASSFILE_SELF 1
@@ -10,6 +10,7 @@
 #include "stream.h"
 
 #include "utils.h"
+#include "utf8.h"
 
 
 static void* parseConstantPool(Stream *stream, uint16_t size);
@@ -65,7 +66,7 @@ ClassFile *LoadClassFile(Stream *stream){
 		error("Reading ClassFile Error. Not a readable stream.");
 		return NULL;
 	}
-	ClassFile * classfile = (ClassFile*)GC_malloc(sizeof(ClassFile));
+	ClassFile * classfile = (ClassFile*)Heap_Alloc(sizeof(ClassFile));
 	if(0<=reader->ReadUint32(stream, &classfile->magic)){
 		error("Reading ClassFile Error.");
 		return NULL;
@@ -129,13 +130,14 @@ ClassFile *LoadClassFile(Stream *stream){
 		error("Reading ClassFile Error.");
 		return NULL;
 	}
-	uint16_t* interfaces = (uint16_t*)GC_malloc(sizeof(uint16_t)*classfile->interfaces_count);
+	uint16_t* interfaces = (uint16_t*)Heap_AllocAtomic(sizeof(uint16_t)*classfile->interfaces_count);
 	for(int i=0;i<classfile->interfaces_count;i++){
 		if(0<=reader->ReadUint16(stream, interfaces+i)){
 			error("Reading ClassFile Error.");
 			return NULL;
 		}
 	}
+	classfile->interfaces = interfaces;
 
 	if(0<=reader->ReadUint16(stream, &classfile->fields_count)){
 		error("Reading ClassFile Error.");
@@ -173,7 +175,7 @@ ClassFile *LoadClassFile(Stream *stream){
 
 static void* parseConstantPool(Stream *stream, uint16_t size){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	void **array = GC_malloc(sizeof(void*)*size);
+	void **array = Heap_Alloc(sizeof(void*)*size);
     // element 0 is invalid.
 	array[0]=NULL;
 	for(int i=1;i<size;i++){
@@ -293,7 +295,7 @@ static void* parseConstantPool(Stream *stream, uint16_t size){
 
 static Constant_ClassInfo* cp_parse_classInfo(Stream *stream){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Constant_ClassInfo *classinfo = (Constant_ClassInfo*)GC_malloc(sizeof(Constant_ClassInfo));
+	Constant_ClassInfo *classinfo = (Constant_ClassInfo*)Heap_AllocAtomic(sizeof(Constant_ClassInfo));
 	classinfo->tag = CONST_CONSTANTPOOLINFO_TAG_CLASS;
 	if(0<=reader->ReadUint16(stream, &classinfo->name_index)){
 		error("Reading ConstantPool Error. EOF of name_index at position %ld.", reader->Position(stream));
@@ -304,7 +306,7 @@ static Constant_ClassInfo* cp_parse_classInfo(Stream *stream){
 
 static Constant_FieldRefInfo* cp_parse_filedRefInfo(Stream* stream){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Constant_FieldRefInfo * fieldRef = (Constant_FieldRefInfo*)GC_malloc(sizeof(Constant_FieldRefInfo));
+	Constant_FieldRefInfo * fieldRef = (Constant_FieldRefInfo*)Heap_AllocAtomic(sizeof(Constant_FieldRefInfo));
 	fieldRef->tag = CONST_CONSTANTPOOLINFO_TAG_FIELD_REF;
 	if(0<=reader->ReadUint16(stream, &fieldRef->class_index)){
 		error("Reading ConstantPool Error. EOF of class_index at position %ld.", reader->Position(stream));
@@ -331,7 +333,7 @@ static Constant_InterfaceMethodRefInfo* cp_parse_interfaceMethodRefInfo(Stream*
 
 static Constant_StringInfo* cp_parse_stringInfo(Stream* stream){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Constant_StringInfo * stringinfo = (Constant_StringInfo*)GC_malloc(sizeof(Constant_StringInfo));
+	Constant_StringInfo * stringinfo = (Constant_StringInfo*)Heap_AllocAtomic(sizeof(Constant_StringInfo));
 	stringinfo->tag = CONST_CONSTANTPOOLINFO_TAG_STRING;
 	if(0<=reader->ReadUint16(stream, &stringinfo->string_index)){
 		error("Reading ConstantPool Error. EOF of string_index at position %ld.", reader->Position(stream));
@@ -342,7 +344,7 @@ static Constant_StringInfo* cp_parse_stringInfo(Stream* stream){
 
 static Constant_IntegerInfo* cp_parse_intergerInfo(Stream* stream){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Constant_IntegerInfo * integerInfo = (Constant_IntegerInfo*)GC_malloc(sizeof(Constant_IntegerInfo));
+	Constant_IntegerInfo * integerInfo = (Constant_IntegerInfo*)Heap_AllocAtomic(sizeof(Constant_IntegerInfo));
 	integerInfo->tag = CONST_CONSTANTPOOLINFO_TAG_INTEGER;
 	if(0<=reader->ReadUint32(stream, &integerInfo->value)){
 		error("Reading ConstantPool Error. EOF of bytes at position %ld.", reader->Position(stream));
@@ -353,7 +355,7 @@ static Constant_IntegerInfo* cp_parse_intergerInfo(Stream* stream){
 
 static Constant_FloatInfo* cp_parse_floatInfo(Stream* stream){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Constant_FloatInfo * floatInfo = (Constant_FloatInfo*)GC_malloc(sizeof(Constant_FloatInfo));
+	Constant_FloatInfo * floatInfo = (Constant_FloatInfo*)Heap_AllocAtomic(sizeof(Constant_FloatInfo));
 	floatInfo->tag = CONST_CONSTANTPOOLINFO_TAG_FLOAT;
 	uint32_t value;
 	if(0<=reader->ReadUint32(stream, &value)){
@@ -366,7 +368,7 @@ static Constant_FloatInfo* cp_parse_floatInfo(Stream* stream){
 
 static Constant_LongInfo* cp_parse_longInfo(Stream* stream){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Constant_LongInfo * longInfo = (Constant_LongInfo*)GC_malloc(sizeof(Constant_LongInfo));
+	Constant_LongInfo * longInfo = (Constant_LongInfo*)Heap_AllocAtomic(sizeof(Constant_LongInfo));
 	longInfo->tag = CONST_CONSTANTPOOLINFO_TAG_LONG;
 	if(0<=reader->ReadUint64(stream, &longInfo->value)){
 		error("Reading ConstantPool Error. EOF of bytes at position %ld.", reader->Position(stream));
@@ -377,7 +379,7 @@ static Constant_LongInfo* cp_parse_longInfo(Stream* stream){
 
 static Constant_DoubleInfo* cp_parse_doubleInfo(Stream* stream){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Constant_DoubleInfo * doubleInfo = (Constant_DoubleInfo*)GC_malloc(sizeof(Constant_DoubleInfo));
+	Constant_DoubleInfo * doubleInfo = (Constant_DoubleInfo*)Heap_AllocAtomic(sizeof(Constant_DoubleInfo));
 	doubleInfo->tag = CONST_CONSTANTPOOLINFO_TAG_DOUBLE;
 	uint64_t value;
 	if(0<=reader->ReadUint64(stream, &value)){
@@ -390,7 +392,7 @@ static Constant_DoubleInfo* cp_parse_doubleInfo(Stream* stream){
 
 static Constant_NameAndTypeInfo* cp_parse_nameAndTypeInfo(Stream* stream){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Constant_NameAndTypeInfo * name_type = (Constant_NameAndTypeInfo*)GC_malloc(sizeof(Constant_NameAndTypeInfo));
+	Constant_NameAndTypeInfo * name_type = (Constant_NameAndTypeInfo*)Heap_AllocAtomic(sizeof(Constant_NameAndTypeInfo));
 	name_type->tag = CONST_CONSTANTPOOLINFO_TAG_NAME_AND_TYPE;
 	if(0<=reader->ReadUint16(stream, &name_type->name_index)){
 		error("Reading ConstantPool Error. EOF of name_index at position %ld.", reader->Position(stream));
@@ -405,25 +407,31 @@ static Constant_NameAndTypeInfo* cp_parse_nameAndTypeInfo(Stream* stream){
 
 static Constant_UTF8Info* cp_parse_utf8Info(Stream* stream){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Constant_UTF8Info * utf8 = (Constant_UTF8Info*)GC_malloc(sizeof(Constant_UTF8Info));
+	Constant_UTF8Info * utf8 = (Constant_UTF8Info*)Heap_Alloc(sizeof(Constant_UTF8Info));
 	utf8->tag = CONST_CONSTANTPOOLINFO_TAG_UTF8;
 	if(0<=reader->ReadUint16(stream, &utf8->length)){
 		error("Reading ConstantPool Error. EOF of length at position %ld.", reader->Position(stream));
 		return NULL;
 	}
     // modified UTF-8
-	utf8->bytes = (uint8_t*)GC_malloc(sizeof(uint8_t)*(utf8->length+1));
+	utf8->bytes = (uint8_t*)Heap_AllocAtomic(sizeof(uint8_t)*(utf8->length+1));
 	if(0<=reader->ReadBytes(stream, utf8->length, utf8->bytes)){
 		error("Reading ConstantPool Error. EOF of bytes %ld.", reader->Position(stream));
 		return NULL;
 	}
 	utf8->bytes[utf8->length] = 0;
+	uint32_t charLength = 0;
+	if(0>UTF8_Validate(utf8->bytes, utf8->length, &charLength, &utf8->latin1)){
+		error("ClassFormatError. Malformed modified UTF-8 at position %ld.", reader->Position(stream));
+		return NULL;
+	}
+	utf8->charLength = (uint16_t)charLength;
 	return utf8;
 }
 
 static Constant_MethodHandleInfo* cp_parse_methodHandleInfo(Stream* stream){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Constant_MethodHandleInfo * methodHandleInfo = (Constant_MethodHandleInfo*)GC_malloc(sizeof(Constant_MethodHandleInfo));
+	Constant_MethodHandleInfo * methodHandleInfo = (Constant_MethodHandleInfo*)Heap_AllocAtomic(sizeof(Constant_MethodHandleInfo));
 	methodHandleInfo->tag = CONST_CONSTANTPOOLINFO_TAG_METHOD_HANDLE;
 	if(0<=reader->ReadUint8(stream, &methodHandleInfo->reference_kind)){
 		error("Reading ConstantPool Error. EOF of reference_kind at position %ld.", reader->Position(stream));
@@ -438,7 +446,7 @@ static Constant_MethodHandleInfo* cp_parse_methodHandleInfo(Stream* stream){
 
 static Constant_MethodTypeInfo* cp_parse_methodTypeInfo(Stream* stream){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Constant_MethodTypeInfo* methodTypeInfo = (Constant_MethodTypeInfo*)GC_malloc(sizeof(Constant_MethodTypeInfo));
+	Constant_MethodTypeInfo* methodTypeInfo = (Constant_MethodTypeInfo*)Heap_AllocAtomic(sizeof(Constant_MethodTypeInfo));
 	methodTypeInfo->tag = CONST_CONSTANTPOOLINFO_TAG_METHOD_TYPE;
 	if(0<=reader->ReadUint16(stream, &methodTypeInfo->descriptor_index)){
 		error("Reading ConstantPool Error. EOF of descriptor_index at position %ld.", reader->Position(stream));
@@ -449,7 +457,7 @@ static Constant_MethodTypeInfo* cp_parse_methodTypeInfo(Stream* stream){
 
 static Constant_InvokeDynamicInfo* cp_parse_invokeDynamicInfo(Stream* stream){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Constant_InvokeDynamicInfo * invokeDynamicInfo = (Constant_InvokeDynamicInfo*)GC_malloc(sizeof(Constant_InvokeDynamicInfo));
+	Constant_InvokeDynamicInfo * invokeDynamicInfo = (Constant_InvokeDynamicInfo*)Heap_AllocAtomic(sizeof(Constant_InvokeDynamicInfo));
 	invokeDynamicInfo->tag = CONST_CONSTANTPOOLINFO_TAG_INVOKE_DYNAMIC;
 	if(0<=reader->ReadUint16(stream, &invokeDynamicInfo->bootstrap_method_attr_index)){
 		error("Reading ConstantPool Error. EOF of bootstrap_method_attr_index at position %ld.", reader->Position(stream));
@@ -464,7 +472,7 @@ static Constant_InvokeDynamicInfo* cp_parse_invokeDynamicInfo(Stream* stream){
 
 static void* parseFields(Stream *stream, ClassFile *classfile, uint16_t count){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	FieldInfo *array = GC_malloc(sizeof(FieldInfo)*count);
+	FieldInfo *array = Heap_Alloc(sizeof(FieldInfo)*count);
 	for(int i=0;i<count;i++){
 		FieldInfo *fieldInfo = &array[i];
 		if(0<=reader->ReadUint16(stream, &fieldInfo->access_flags)){
@@ -493,7 +501,7 @@ static void* parseFields(Stream *stream, ClassFile *classfile, uint16_t count){
 
 static void* parseMethods(Stream *stream, ClassFile *classfile, uint16_t count){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	MethodInfo *array = GC_malloc(sizeof(MethodInfo)*count);
+	MethodInfo *array = Heap_Alloc(sizeof(MethodInfo)*count);
 	for(int i=0;i<count;i++){
 		MethodInfo *methodInfo = &array[i];
 		if(0<=reader->ReadUint16(stream, &methodInfo->access_flags)){
@@ -522,7 +530,7 @@ static void* parseMethods(Stream *stream, ClassFile *classfile, uint16_t count){
 
 static void* parseAttributes(Stream *stream, ClassFile *classfile, uint16_t count){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	void **array = GC_malloc(sizeof(void*)*count);
+	void **array = Heap_Alloc(sizeof(void*)*count);
 	for(int i=0;i<count;i++){
 		uint16_t name_index;
 		if(0<=reader->ReadUint16(stream, &name_index)){
@@ -612,12 +620,13 @@ static void* parseAttributes(Stream *stream, ClassFile *classfile, uint16_t coun
 		if(NULL==array[i]){
 			return NULL;
 		}
-	}    
+	}
+	return array;
 }
 
 static Attribute_ConstantValue* attr_parse_constantValue(Stream *stream, ClassFile *classfile, uint16_t name_index){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Attribute_ConstantValue* constant = (Attribute_ConstantValue*) GC_malloc(sizeof(Attribute_ConstantValue));
+	Attribute_ConstantValue* constant = (Attribute_ConstantValue*) Heap_AllocAtomic(sizeof(Attribute_ConstantValue));
 	constant->attribute_name_index = name_index;
 	if(0<=reader->ReadUint32(stream, &constant->attribute_length)){
 		error("ConstantValue Attribute", reader->Position(stream));
@@ -639,7 +648,7 @@ static Attribute_ConstantValue* attr_parse_constantValue(Stream *stream, ClassFi
 
 static Attribute_Code* attr_parse_code(Stream *stream, ClassFile *classfile, uint16_t name_index){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Attribute_Code* code = (Attribute_Code*) GC_malloc(sizeof(Attribute_Code));
+	Attribute_Code* code = (Attribute_Code*) Heap_Alloc(sizeof(Attribute_Code));
 	code->attribute_name_index = name_index;
 	if(0<=reader->ReadUint32(stream, &code->attribute_length)){
 		error("Code Attribute", reader->Position(stream));
@@ -658,18 +667,19 @@ static Attribute_Code* attr_parse_code(Stream *stream, ClassFile *classfile, uin
 		return NULL;
 	}
 
-	uint8_t *code_bytes = (uint8_t*)GC_malloc(sizeof(uint8_t)*code->code_length);
+	uint8_t *code_bytes = (uint8_t*)Heap_AllocAtomic(sizeof(uint8_t)*code->code_length);
 	if(0<=reader->ReadBytes(stream, code->code_length, code_bytes)){
 		error("Code Attribute", reader->Position(stream));
 		return NULL;
 	}
+	code->code = code_bytes;
 
 	if(0<=reader->ReadUint16(stream, &code->exception_table_length)){
 		error("Code Attribute", reader->Position(stream));
 		return NULL;
 	}
 	uint32_t exception_table_size = sizeof(ExceptionInfo)*code->exception_table_length;
-	code->exception_table = (ExceptionInfo*)GC_malloc(exception_table_size);
+	code->exception_table = (ExceptionInfo*)Heap_AllocAtomic(exception_table_size);
 	for(int i=0;i<code->exception_table_length;i++){
 		ExceptionInfo *ex = &code->exception_table[i];
 		if(0<=reader->ReadUint16(stream, &ex->start_pc)){
@@ -703,7 +713,7 @@ static Attribute_Code* attr_parse_code(Stream *stream, ClassFile *classfile, uin
 
 static Attribute_StackMapTable* attr_parse_stackMapTable(Stream *stream, ClassFile *classfile, uint16_t name_index){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Attribute_StackMapTable* tbl = (Attribute_StackMapTable*) GC_malloc(sizeof(Attribute_StackMapTable));
+	Attribute_StackMapTable* tbl = (Attribute_StackMapTable*) Heap_Alloc(sizeof(Attribute_StackMapTable));
 	tbl->attribute_name_index = name_index;
 	if(0<=reader->ReadUint32(stream, &tbl->attribute_length)){
 		error("StackMapTable Attribute", reader->Position(stream));
@@ -722,7 +732,7 @@ static Attribute_StackMapTable* attr_parse_stackMapTable(Stream *stream, ClassFi
 
 static Attribute_Exceptions* attr_parse_exceptions(Stream *stream, ClassFile *classfile, uint16_t name_index){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Attribute_Exceptions* exceptions = (Attribute_Exceptions*) GC_malloc(sizeof(Attribute_Exceptions));
+	Attribute_Exceptions* exceptions = (Attribute_Exceptions*) Heap_Alloc(sizeof(Attribute_Exceptions));
 	exceptions->attribute_name_index = name_index;
 	if(0<=reader->ReadUint32(stream, &exceptions->attribute_length)){
 		error("Exceptions Attribute", reader->Position(stream));
@@ -732,7 +742,7 @@ static Attribute_Exceptions* attr_parse_exceptions(Stream *stream, ClassFile *cl
 		error("Exceptions Attribute", reader->Position(stream));
 		return NULL;
 	}
-	exceptions->exception_indexes = (uint16_t*)GC_malloc(sizeof(uint16_t)*exceptions->exceptions_count);
+	exceptions->exception_indexes = (uint16_t*)Heap_AllocAtomic(sizeof(uint16_t)*exceptions->exceptions_count);
 	for(int i=0;i<exceptions->exceptions_count;i++){
 		if(0<=reader->ReadUint16(stream, &exceptions->exception_indexes[i])){
 			error("Exceptions Attribute", reader->Position(stream));
@@ -744,7 +754,7 @@ static Attribute_Exceptions* attr_parse_exceptions(Stream *stream, ClassFile *cl
 
 static Attribute_InnerClasses* attr_parse_innerClasses(Stream *stream, ClassFile *classfile, uint16_t name_index){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Attribute_InnerClasses* attr = (Attribute_InnerClasses*) GC_malloc(sizeof(Attribute_InnerClasses));
+	Attribute_InnerClasses* attr = (Attribute_InnerClasses*) Heap_Alloc(sizeof(Attribute_InnerClasses));
 	attr->attribute_name_index = name_index;
 	if(0<=reader->ReadUint32(stream, &attr->attribute_length)){
 		error("InnerClasses Attribute", reader->Position(stream));
@@ -754,7 +764,7 @@ static Attribute_InnerClasses* attr_parse_innerClasses(Stream *stream, ClassFile
 		error("InnerClasses Attribute", reader->Position(stream));
 		return NULL;
 	}
-	attr->classes = (InnerClassInfo*)GC_malloc(sizeof(InnerClassInfo)*attr->classes_count);
+	attr->classes = (InnerClassInfo*)Heap_AllocAtomic(sizeof(InnerClassInfo)*attr->classes_count);
 	for(int i=0;i<attr->classes_count;i++){
 		if(0<=reader->ReadUint16(stream, &attr->classes[i].inner_class_info_index)){
 			error("InnerClasses Attribute", reader->Position(stream));
@@ -778,7 +788,7 @@ static Attribute_InnerClasses* attr_parse_innerClasses(Stream *stream, ClassFile
 
 static Attribute_EnclosingMethod* attr_parse_enclosingMethod(Stream *stream, ClassFile *classfile, uint16_t name_index){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Attribute_EnclosingMethod* attr = (Attribute_EnclosingMethod*) GC_malloc(sizeof(Attribute_EnclosingMethod));
+	Attribute_EnclosingMethod* attr = (Attribute_EnclosingMethod*) Heap_AllocAtomic(sizeof(Attribute_EnclosingMethod));
 	attr->attribute_name_index = name_index;
 	if(0<=reader->ReadUint32(stream, &attr->attribute_length)){
 		error("EnclosingMethod Attribute", reader->Position(stream));
@@ -797,7 +807,7 @@ static Attribute_EnclosingMethod* attr_parse_enclosingMethod(Stream *stream, Cla
 
 static Attribute_Synthetic* attr_parse_synthetic(Stream *stream, ClassFile *classfile, uint16_t name_index){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Attribute_Synthetic* attr = (Attribute_Synthetic*) GC_malloc(sizeof(Attribute_Synthetic));
+	Attribute_Synthetic* attr = (Attribute_Synthetic*) Heap_AllocAtomic(sizeof(Attribute_Synthetic));
 	attr->attribute_name_index = name_index;
 	if(0<=reader->ReadUint32(stream, &attr->attribute_length)||0!=attr->attribute_length){
 		error("Synthetic Attribute", reader->Position(stream));
@@ -808,7 +818,7 @@ static Attribute_Synthetic* attr_parse_synthetic(Stream *stream, ClassFile *clas
 
 static Attribute_Signature* attr_parse_signature(Stream *stream, ClassFile *classfile, uint16_t name_index){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Attribute_Signature* attr = (Attribute_Signature*) GC_malloc(sizeof(Attribute_Signature));
+	Attribute_Signature* attr = (Attribute_Signature*) Heap_AllocAtomic(sizeof(Attribute_Signature));
 	attr->attribute_name_index = name_index;
 	if(0<=reader->ReadUint32(stream, &attr->attribute_length)||2!=attr->attribute_length){
 		error("Signature Attribute", reader->Position(stream));
@@ -823,7 +833,7 @@ static Attribute_Signature* attr_parse_signature(Stream *stream, ClassFile *clas
 
 static Attribute_SourceFile* attr_parse_sourceFile(Stream *stream, ClassFile *classfile, uint16_t name_index){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Attribute_SourceFile* attr = (Attribute_SourceFile*) GC_malloc(sizeof(Attribute_SourceFile));
+	Attribute_SourceFile* attr = (Attribute_SourceFile*) Heap_AllocAtomic(sizeof(Attribute_SourceFile));
 	attr->attribute_name_index = name_index;
 	if(0<=reader->ReadUint32(stream, &attr->attribute_length)||2!=attr->attribute_length){
 		error("SourceFile Attribute", reader->Position(stream));
@@ -838,13 +848,13 @@ static Attribute_SourceFile* attr_parse_sourceFile(Stream *stream, ClassFile *cl
 
 static Attribute_SourceDebugExtension* attr_parse_sourceDebugExtention(Stream *stream, ClassFile *classfile, uint16_t name_index){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Attribute_SourceDebugExtension* attr = (Attribute_SourceDebugExtension*) GC_malloc(sizeof(Attribute_SourceDebugExtension));
+	Attribute_SourceDebugExtension* attr = (Attribute_SourceDebugExtension*) Heap_Alloc(sizeof(Attribute_SourceDebugExtension));
 	attr->attribute_name_index = name_index;
 	if(0<=reader->ReadUint32(stream, &attr->attribute_length)||2!=attr->attribute_length){
 		error("SourceDebugExtention Attribute", reader->Position(stream));
 		return NULL;
 	}
-	attr->debug_extension = (uint8_t*)GC_malloc(sizeof(uint8_t)*attr->attribute_length);
+	attr->debug_extension = (uint8_t*)Heap_AllocAtomic(sizeof(uint8_t)*attr->attribute_length);
 	if(0<=reader->ReadBytes(stream, attr->attribute_length, attr->debug_extension)){
 		error("SourceDebugExtention Attribute", reader->Position(stream));
 		return NULL;
@@ -854,7 +864,7 @@ static Attribute_SourceDebugExtension* attr_parse_sourceDebugExtention(Stream *s
 
 static Attribute_LineNumberTable* attr_parse_lineNumberTable(Stream *stream, ClassFile *classfile, uint16_t name_index){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Attribute_LineNumberTable* attr = (Attribute_LineNumberTable*) GC_malloc(sizeof(Attribute_LineNumberTable));
+	Attribute_LineNumberTable* attr = (Attribute_LineNumberTable*) Heap_Alloc(sizeof(Attribute_LineNumberTable));
 	attr->attribute_name_index = name_index;
 	if(0<=reader->ReadUint32(stream, &attr->attribute_length)){
 		error("LineNumberTable Attribute", reader->Position(stream));
@@ -864,8 +874,8 @@ static Attribute_LineNumberTable* attr_parse_lineNumberTable(Stream *stream, Cla
 		error("LineNumberTable Attribute", reader->Position(stream));
 		return NULL;
 	}
-	attr->table = (LineNumberTableEntry*)GC_malloc(sizeof(LineNumberTableEntry)*attr->line_number_entries_count);
-	for(int i=1;i<attr->line_number_entries_count;i++){
+	attr->table = (LineNumberTableEntry*)Heap_AllocAtomic(sizeof(LineNumberTableEntry)*attr->line_number_entries_count);
+	for(int i=0;i<attr->line_number_entries_count;i++){
 		if(0<=reader->ReadUint16(stream, &attr->table[i].start_pc)){
 			error("LineNumberTable Attribute", reader->Position(stream));
 			return NULL;
@@ -881,7 +891,7 @@ static Attribute_LineNumberTable* attr_parse_lineNumberTable(Stream *stream, Cla
 
 static Attribute_LocalVariableTable* attr_parse_localVariableTable(Stream *stream, ClassFile *classfile, uint16_t name_index){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Attribute_LocalVariableTable* attr = (Attribute_LocalVariableTable*) GC_malloc(sizeof(Attribute_LocalVariableTable));
+	Attribute_LocalVariableTable* attr = (Attribute_LocalVariableTable*) Heap_Alloc(sizeof(Attribute_LocalVariableTable));
 	attr->attribute_name_index = name_index;
 	if(0<=reader->ReadUint32(stream, &attr->attribute_length)){
 		error("LocalVariableTable Attribute", reader->Position(stream));
@@ -891,8 +901,8 @@ static Attribute_LocalVariableTable* attr_parse_localVariableTable(Stream *strea
 		error("LocalVariableTable Attribute", reader->Position(stream));
 		return NULL;
 	}
-	attr->table = (LocalVariableTableEntry*)GC_malloc(sizeof(LocalVariableTableEntry)*attr->local_variable_entries_count);
-	for(int i=1;i<attr->local_variable_entries_count;i++){
+	attr->table = (LocalVariableTableEntry*)Heap_AllocAtomic(sizeof(LocalVariableTableEntry)*attr->local_variable_entries_count);
+	for(int i=0;i<attr->local_variable_entries_count;i++){
 		if(0<=reader->ReadUint16(stream, &attr->table[i].start_pc)){
 			error("LocalVariableTable Attribute", reader->Position(stream));
 			return NULL;
@@ -920,7 +930,7 @@ static Attribute_LocalVariableTable* attr_parse_localVariableTable(Stream *strea
 
 static Attribute_LocalVariableTypeTable* attr_parse_localVariableTypeTable(Stream *stream, ClassFile *classfile, uint16_t name_index){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Attribute_LocalVariableTypeTable* attr = (Attribute_LocalVariableTypeTable*) GC_malloc(sizeof(Attribute_LocalVariableTypeTable));
+	Attribute_LocalVariableTypeTable* attr = (Attribute_LocalVariableTypeTable*) Heap_Alloc(sizeof(Attribute_LocalVariableTypeTable));
 	attr->attribute_name_index = name_index;
 	if(0<=reader->ReadUint32(stream, &attr->attribute_length)){
 		error("LocalVariableTypeTable Attribute", reader->Position(stream));
@@ -930,8 +940,8 @@ static Attribute_LocalVariableTypeTable* attr_parse_localVariableTypeTable(Strea
 		error("LocalVariableTypeTable Attribute", reader->Position(stream));
 		return NULL;
 	}
-	attr->table = (LocalVariableTypeTableEntry*)GC_malloc(sizeof(LocalVariableTypeTableEntry)*attr->local_variable_type_entries_count);
-	for(int i=1;i<attr->local_variable_type_entries_count;i++){
+	attr->table = (LocalVariableTypeTableEntry*)Heap_AllocAtomic(sizeof(LocalVariableTypeTableEntry)*attr->local_variable_type_entries_count);
+	for(int i=0;i<attr->local_variable_type_entries_count;i++){
 		if(0<=reader->ReadUint16(stream, &attr->table[i].start_pc)){
 			error("LocalVariableTypeTable Attribute", reader->Position(stream));
 			return NULL;
@@ -959,7 +969,7 @@ static Attribute_LocalVariableTypeTable* attr_parse_localVariableTypeTable(Strea
 
 static Attribute_Deprecated* attr_parse_deprecated(Stream *stream, ClassFile *classfile, uint16_t name_index){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Attribute_Deprecated* attr = (Attribute_Deprecated*) GC_malloc(sizeof(Attribute_Deprecated));
+	Attribute_Deprecated* attr = (Attribute_Deprecated*) Heap_AllocAtomic(sizeof(Attribute_Deprecated));
 	attr->attribute_name_index = name_index;
 	if(0<=reader->ReadUint32(stream, &attr->attribute_length)||0!=attr->attribute_length){
 		error("Deprecated Attribute", reader->Position(stream));
@@ -1016,7 +1026,7 @@ static ElementValue* parseElementValue(Stream *stream, ClassFile *classfile, Ele
 				error("Deprecated Attribute", reader->Position(stream));
 				return NULL;
 			}
-			value->value.array_value.values = (ElementValue*)GC_malloc(sizeof(ElementValue)*value->value.array_value.values_count);
+			value->value.array_value.values = (ElementValue*)Heap_Alloc(sizeof(ElementValue)*value->value.array_value.values_count);
 			for(int i=0;i<value->value.array_value.values_count;i++){
 				if(NULL==parseElementValue(stream, classfile, &value->value.array_value.values[i])){
 					error("ElementValue", reader->Position(stream));
@@ -1041,7 +1051,7 @@ static Annotation* parseAnnotation(Stream *stream, ClassFile *classfile, Annotat
 		error("Annotation", reader->Position(stream));
 		return NULL;
 	}
-	annotation->pairs = (ElementValuePair*)GC_malloc(sizeof(ElementValuePair)*annotation->element_value_pairs_count);
+	annotation->pairs = (ElementValuePair*)Heap_Alloc(sizeof(ElementValuePair)*annotation->element_value_pairs_count);
 	for(int j=0;j<annotation->element_value_pairs_count;j++){
 		ElementValuePair *p = &(annotation->pairs[j]);
 		if(0<=reader->ReadUint16(stream, &p->element_name_index)){
@@ -1058,7 +1068,7 @@ static Annotation* parseAnnotation(Stream *stream, ClassFile *classfile, Annotat
 
 static Attribute_RuntimeVisibleAnnotations* attr_parse_runtimeVisibleAnnotations(Stream *stream, ClassFile *classfile, uint16_t name_index){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Attribute_RuntimeVisibleAnnotations* attr = (Attribute_RuntimeVisibleAnnotations*) GC_malloc(sizeof(Attribute_RuntimeVisibleAnnotations));
+	Attribute_RuntimeVisibleAnnotations* attr = (Attribute_RuntimeVisibleAnnotations*) Heap_Alloc(sizeof(Attribute_RuntimeVisibleAnnotations));
 	attr->attribute_name_index = name_index;
 	if(0<=reader->ReadUint32(stream, &attr->attribute_length)){
 		error("RuntimeVisibleAnnotations Attribute", reader->Position(stream));
@@ -1068,7 +1078,7 @@ static Attribute_RuntimeVisibleAnnotations* attr_parse_runtimeVisibleAnnotations
 		error("RuntimeVisibleAnnotations Attribute", reader->Position(stream));
 		return NULL;
 	}
-	attr->annotations = (Annotation*)GC_malloc(sizeof(Annotation)*attr->annotations_count); 
+	attr->annotations = (Annotation*)Heap_Alloc(sizeof(Annotation)*attr->annotations_count); 
 	for(int i=0;i<attr->annotations_count;i++){
 		Annotation *annotation = &attr->annotations[i];
 		if(NULL==parseAnnotation(stream, classfile, annotation)){
@@ -1081,7 +1091,7 @@ static Attribute_RuntimeVisibleAnnotations* attr_parse_runtimeVisibleAnnotations
 
 static Attribute_RuntimeInvisibleAnnotations* attr_parse_runtimeInvisibleAnnotations(Stream *stream, ClassFile *classfile, uint16_t name_index){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Attribute_RuntimeInvisibleAnnotations* attr = (Attribute_RuntimeInvisibleAnnotations*) GC_malloc(sizeof(Attribute_RuntimeInvisibleAnnotations));
+	Attribute_RuntimeInvisibleAnnotations* attr = (Attribute_RuntimeInvisibleAnnotations*) Heap_Alloc(sizeof(Attribute_RuntimeInvisibleAnnotations));
 	attr->attribute_name_index = name_index;
 	if(0<=reader->ReadUint32(stream, &attr->attribute_length)){
 		error("RuntimeInvisibleAnnotations Attribute", reader->Position(stream));
@@ -1091,7 +1101,7 @@ static Attribute_RuntimeInvisibleAnnotations* attr_parse_runtimeInvisibleAnnotat
 		error("RuntimeInvisibleAnnotations Attribute", reader->Position(stream));
 		return NULL;
 	}
-	attr->annotations = (Annotation*)GC_malloc(sizeof(Annotation)*attr->annotations_count); 
+	attr->annotations = (Annotation*)Heap_Alloc(sizeof(Annotation)*attr->annotations_count); 
 	for(int i=0;i<attr->annotations_count;i++){
 		Annotation *annotation = &attr->annotations[i];
 		if(NULL==parseAnnotation(stream, classfile, annotation)){
@@ -1104,7 +1114,7 @@ static Attribute_RuntimeInvisibleAnnotations* attr_parse_runtimeInvisibleAnnotat
 
 static Attribute_RuntimeVisibleParameterAnnotations* attr_parse_runtimeVisibleParameterAnnotations(Stream *stream, ClassFile *classfile, uint16_t name_index){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Attribute_RuntimeVisibleParameterAnnotations* attr = (Attribute_RuntimeVisibleParameterAnnotations*) GC_malloc(sizeof(Attribute_RuntimeVisibleParameterAnnotations));
+	Attribute_RuntimeVisibleParameterAnnotations* attr = (Attribute_RuntimeVisibleParameterAnnotations*) Heap_Alloc(sizeof(Attribute_RuntimeVisibleParameterAnnotations));
 	attr->attribute_name_index = name_index;
 	if(0<=reader->ReadUint32(stream, &attr->attribute_length)){
 		error("RuntimeVisibleParameterAnnotations Attribute", reader->Position(stream));
@@ -1114,14 +1124,14 @@ static Attribute_RuntimeVisibleParameterAnnotations* attr_parse_runtimeVisiblePa
 		error("RuntimeVisibleParameterAnnotations Attribute", reader->Position(stream));
 		return NULL;
 	}
-	attr->parameter_annotations = (ParameterAnnotaion*)GC_malloc(sizeof(ParameterAnnotaion)*attr->parameters_count); 
+	attr->parameter_annotations = (ParameterAnnotaion*)Heap_Alloc(sizeof(ParameterAnnotaion)*attr->parameters_count); 
 	for(int i=0;i<attr->parameters_count;i++){
 		ParameterAnnotaion *parameter_annotation = &attr->parameter_annotations[i];
 		if(0<=reader->ReadUint16(stream, &parameter_annotation->annotations_count)){
 			error("RuntimeVisibleParameterAnnotations Attribute", reader->Position(stream));
 			return NULL;
 		}
-		parameter_annotation->annotations = (Annotation*)GC_malloc(sizeof(Annotation)*parameter_annotation->annotations_count);
+		parameter_annotation->annotations = (Annotation*)Heap_Alloc(sizeof(Annotation)*parameter_annotation->annotations_count);
 		for(int j=0;j<parameter_annotation->annotations_count;j++){
 			if(NULL==parseAnnotation(stream, classfile, &parameter_annotation->annotations[j])){
 				error("RuntimeVisibleParameterAnnotations Attribute", reader->Position(stream));
@@ -1134,7 +1144,7 @@ static Attribute_RuntimeVisibleParameterAnnotations* attr_parse_runtimeVisiblePa
 
 static Attribute_RuntimeInvisibleParameterAnnotations* attr_parse_runtimeInvisibleParameterAnnotations(Stream *stream, ClassFile *classfile, uint16_t name_index){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Attribute_RuntimeInvisibleParameterAnnotations* attr = (Attribute_RuntimeInvisibleParameterAnnotations*) GC_malloc(sizeof(Attribute_RuntimeInvisibleParameterAnnotations));
+	Attribute_RuntimeInvisibleParameterAnnotations* attr = (Attribute_RuntimeInvisibleParameterAnnotations*) Heap_Alloc(sizeof(Attribute_RuntimeInvisibleParameterAnnotations));
 	attr->attribute_name_index = name_index;
 	if(0<=reader->ReadUint32(stream, &attr->attribute_length)){
 		error("RuntimeInvisibleParameterAnnotations Attribute", reader->Position(stream));
@@ -1144,14 +1154,14 @@ static Attribute_RuntimeInvisibleParameterAnnotations* attr_parse_runtimeInvisib
 		error("RuntimeInvisibleParameterAnnotations Attribute", reader->Position(stream));
 		return NULL;
 	}
-	attr->parameter_annotations = (ParameterAnnotaion*)GC_malloc(sizeof(ParameterAnnotaion)*attr->parameters_count); 
+	attr->parameter_annotations = (ParameterAnnotaion*)Heap_Alloc(sizeof(ParameterAnnotaion)*attr->parameters_count); 
 	for(int i=0;i<attr->parameters_count;i++){
 		ParameterAnnotaion *parameter_annotation = &attr->parameter_annotations[i];
 		if(0<=reader->ReadUint16(stream, &parameter_annotation->annotations_count)){
 			error("RuntimeInvisibleParameterAnnotations Attribute", reader->Position(stream));
 			return NULL;
 		}
-		parameter_annotation->annotations = (Annotation*)GC_malloc(sizeof(Annotation)*parameter_annotation->annotations_count);
+		parameter_annotation->annotations = (Annotation*)Heap_Alloc(sizeof(Annotation)*parameter_annotation->annotations_count);
 		for(int j=0;j<parameter_annotation->annotations_count;j++){
 			if(NULL==parseAnnotation(stream, classfile, &parameter_annotation->annotations[j])){
 				error("RuntimeInvisibleParameterAnnotations Attribute", reader->Position(stream));
@@ -1217,7 +1227,7 @@ static TypeAnnotation* parseTypeAnnotation(Stream *stream, ClassFile *classfile,
 				error("TypeAnnotation Attribute", reader->Position(stream));
 				return NULL;
 			}
-			annotation->target_info.localvar_target.elements = (LocalvarElement*)GC_malloc(sizeof(LocalvarElement)*annotation->target_info.localvar_target.count);
+			annotation->target_info.localvar_target.elements = (LocalvarElement*)Heap_AllocAtomic(sizeof(LocalvarElement)*annotation->target_info.localvar_target.count);
 			for(int i=0;i<annotation->target_info.localvar_target.count;i++){
 				LocalvarElement *element = &annotation->target_info.localvar_target.elements[i];
 				if(0<=reader->ReadUint16(stream, &element->start_pc)){
@@ -1272,7 +1282,7 @@ static TypeAnnotation* parseTypeAnnotation(Stream *stream, ClassFile *classfile,
 		error("TypeAnnotation Attribute", reader->Position(stream));
 		return NULL;
 	}
-	annotation->target_path.path = (_Path*)GC_malloc(sizeof(_Path)*annotation->target_path.path_count);
+	annotation->target_path.path = (_Path*)Heap_AllocAtomic(sizeof(_Path)*annotation->target_path.path_count);
 	for(int i=0; i<annotation->target_path.path_count; i++){
 		_Path *p = &annotation->target_path.path[i]; 
 		if(0<=reader->ReadUint8(stream, &p->typepath_kind)){
@@ -1294,7 +1304,7 @@ static TypeAnnotation* parseTypeAnnotation(Stream *stream, ClassFile *classfile,
 		return NULL;
 	}
 
-	annotation->pairs = (ElementValuePair*)GC_malloc(sizeof(ElementValuePair)*annotation->element_value_pairs_count);
+	annotation->pairs = (ElementValuePair*)Heap_Alloc(sizeof(ElementValuePair)*annotation->element_value_pairs_count);
 	for(int j=0;j<annotation->element_value_pairs_count;j++){
 		ElementValuePair *p = &annotation->pairs[j];
 		if(0<=reader->ReadUint16(stream, &p->element_name_index)){
@@ -1311,7 +1321,7 @@ static TypeAnnotation* parseTypeAnnotation(Stream *stream, ClassFile *classfile,
 
 static Attribute_RuntimeVisibleTypeAnnotations* attr_parse_runtimeVisibleTypeAnnotations(Stream *stream, ClassFile *classfile, uint16_t name_index){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Attribute_RuntimeVisibleTypeAnnotations* attr = (Attribute_RuntimeVisibleTypeAnnotations*) GC_malloc(sizeof(Attribute_RuntimeVisibleTypeAnnotations));
+	Attribute_RuntimeVisibleTypeAnnotations* attr = (Attribute_RuntimeVisibleTypeAnnotations*) Heap_Alloc(sizeof(Attribute_RuntimeVisibleTypeAnnotations));
 	attr->attribute_name_index = name_index;
 	if(0<=reader->ReadUint32(stream, &attr->attribute_length)){
 		error("RuntimeVisibleTypeAnnotations Attribute", reader->Position(stream));
@@ -1321,7 +1331,7 @@ static Attribute_RuntimeVisibleTypeAnnotations* attr_parse_runtimeVisibleTypeAnn
 		error("RuntimeVisibleTypeAnnotations Attribute", reader->Position(stream));
 		return NULL;
 	}
-	attr->annotations = (TypeAnnotation*)GC_malloc(sizeof(TypeAnnotation)*attr->annotations_count); 
+	attr->annotations = (TypeAnnotation*)Heap_Alloc(sizeof(TypeAnnotation)*attr->annotations_count); 
 	for(int i=0;i<attr->annotations_count;i++){
 		if(NULL==parseTypeAnnotation(stream,classfile, &attr->annotations[i])){
 			error("RuntimeVisibleParameterAnnotations Attribute", reader->Position(stream));
@@ -1333,7 +1343,7 @@ static Attribute_RuntimeVisibleTypeAnnotations* attr_parse_runtimeVisibleTypeAnn
 
 static Attribute_RuntimeInvisibleTypeAnnotations* attr_parse_runtimeInvisibleTypeAnnotations(Stream *stream, ClassFile *classfile, uint16_t name_index){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Attribute_RuntimeInvisibleTypeAnnotations* attr = (Attribute_RuntimeInvisibleTypeAnnotations*) GC_malloc(sizeof(Attribute_RuntimeInvisibleTypeAnnotations));
+	Attribute_RuntimeInvisibleTypeAnnotations* attr = (Attribute_RuntimeInvisibleTypeAnnotations*) Heap_Alloc(sizeof(Attribute_RuntimeInvisibleTypeAnnotations));
 	attr->attribute_name_index = name_index;
 	if(0<=reader->ReadUint32(stream, &attr->attribute_length)){
 		error("RuntimeInvisibleTypeAnnotations Attribute", reader->Position(stream));
@@ -1343,7 +1353,7 @@ static Attribute_RuntimeInvisibleTypeAnnotations* attr_parse_runtimeInvisibleTyp
 		error("RuntimeInvisibleTypeAnnotations Attribute", reader->Position(stream));
 		return NULL;
 	}
-	attr->annotations = (TypeAnnotation*)GC_malloc(sizeof(TypeAnnotation)*attr->annotations_count); 
+	attr->annotations = (TypeAnnotation*)Heap_Alloc(sizeof(TypeAnnotation)*attr->annotations_count); 
 	for(int i=0;i<attr->annotations_count;i++){
 		if(NULL==parseTypeAnnotation(stream, classfile, &attr->annotations[i])){
 			error("RuntimeInvisibleParameterAnnotations Attribute", reader->Position(stream));
@@ -1355,7 +1365,7 @@ static Attribute_RuntimeInvisibleTypeAnnotations* attr_parse_runtimeInvisibleTyp
 
 static Attribute_AnnotationDefault* attr_parse_annotationDefault(Stream *stream, ClassFile *classfile, uint16_t name_index){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Attribute_AnnotationDefault* attr = (Attribute_AnnotationDefault*) GC_malloc(sizeof(Attribute_AnnotationDefault));
+	Attribute_AnnotationDefault* attr = (Attribute_AnnotationDefault*) Heap_Alloc(sizeof(Attribute_AnnotationDefault));
 	attr->attribute_name_index = name_index;
 	if(0<=reader->ReadUint32(stream, &attr->attribute_length)){
 		error("AnnotationDefault Attribute", reader->Position(stream));
@@ -1370,7 +1380,7 @@ static Attribute_AnnotationDefault* attr_parse_annotationDefault(Stream *stream,
 
 static Attribute_BootstrapMethods* attr_parse_bootstrapMethods(Stream *stream, ClassFile *classfile, uint16_t name_index){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Attribute_BootstrapMethods* attr = (Attribute_BootstrapMethods*) GC_malloc(sizeof(Attribute_BootstrapMethods));
+	Attribute_BootstrapMethods* attr = (Attribute_BootstrapMethods*) Heap_Alloc(sizeof(Attribute_BootstrapMethods));
 	attr->attribute_name_index = name_index;
 	if(0<=reader->ReadUint32(stream, &attr->attribute_length)){
 		error("BootstrapMethod Attribute", reader->Position(stream));
@@ -1380,7 +1390,7 @@ static Attribute_BootstrapMethods* attr_parse_bootstrapMethods(Stream *stream, C
 		error("BootstrapMethod Attribute", reader->Position(stream));
 		return NULL;
 	}
-	attr->bootstrap_methods = (BootstrapMethod*)GC_malloc(sizeof(BootstrapMethod)*attr->bootstrap_methods_count);
+	attr->bootstrap_methods = (BootstrapMethod*)Heap_Alloc(sizeof(BootstrapMethod)*attr->bootstrap_methods_count);
 	for(int i=0;i<attr->bootstrap_methods_count;i++){
 		BootstrapMethod *m = &attr->bootstrap_methods[i];
 		if(0<=reader->ReadUint16(stream, &m->bootstrap_method_ref)){
@@ -1391,7 +1401,7 @@ static Attribute_BootstrapMethods* attr_parse_bootstrapMethods(Stream *stream, C
 			error("BootstrapMethod Attribute", reader->Position(stream));
 			return NULL;
 		}
-		m->arguments = (uint16_t*)GC_malloc(sizeof(uint16_t)*m->arguments_count);
+		m->arguments = (uint16_t*)Heap_AllocAtomic(sizeof(uint16_t)*m->arguments_count);
 		for(int j=0;j<m->arguments_count;j++){
 			if(0<=reader->ReadUint16(stream, &m->arguments[j])){
 				error("BootstrapMethod Attribute", reader->Position(stream));
@@ -1404,7 +1414,7 @@ static Attribute_BootstrapMethods* attr_parse_bootstrapMethods(Stream *stream, C
 
 static Attribute_MethodParameters* attr_parse_methodParameters(Stream *stream, ClassFile *classfile, uint16_t name_index){
 	StreamReaderOp *reader = (StreamReaderOp*)stream->reader;
-	Attribute_MethodParameters* attr = (Attribute_MethodParameters*) GC_malloc(sizeof(Attribute_MethodParameters));
+	Attribute_MethodParameters* attr = (Attribute_MethodParameters*) Heap_Alloc(sizeof(Attribute_MethodParameters));
 	attr->attribute_name_index = name_index;
 	if(0<=reader->ReadUint32(stream, &attr->attribute_length)){
 		error("MethodParameters Attribute", reader->Position(stream));
@@ -1414,7 +1424,7 @@ static Attribute_MethodParameters* attr_parse_methodParameters(Stream *stream, C
 		error("BootstrapMethod Attribute", reader->Position(stream));
 		return NULL;
 	}
-	attr->parameters= (_Parameter*)GC_malloc(sizeof(_Parameter)*attr->parameters_count);
+	attr->parameters= (_Parameter*)Heap_AllocAtomic(sizeof(_Parameter)*attr->parameters_count);
 	for(int i=0;i<attr->parameters_count;i++){
 		_Parameter *p = &attr->parameters[i];
 		if(0<=reader->ReadUint16(stream, &p->name_index)){
@@ -485,6 +485,8 @@ typedef struct{
     uint8_t tag;
     uint16_t length;
     uint8_t* bytes;
+    uint16_t charLength; // in UTF-16 chars, checked at parse time
+    uint8_t latin1; // every char fits in one byte
 } Constant_UTF8Info;
 
 typedef struct{
@@ -0,0 +1,32 @@
+#ifndef H_RUNTIME_BOUNDSCHECK
+#define H_RUNTIME_BOUNDSCHECK 1
+
+#include <stdint.h>
+#include "runtime/method.h"
+
+#ifdef INCLUDE_RUNTIME_BOUNDSCHECK_SELF
+#define RUNTIME_BOUNDSCHECK_EXTERN
+#else
+#define RUNTIME_BOUNDSCHECK_EXTERN extern
+#endif
+
+// Counted loops as javac compiles for(...; i<a.length; i++):
+//
+//         goto COND
+//   BODY: ...
+//         iinc i 1
+//   COND: iload i; aload a; arraylength; if_icmplt BODY
+//
+// When nothing else writes i or a and the loop is only entered through
+// the goto, i stays within a on every path from the test to the end of
+// the body. Accesses a[i] there are rewritten to their unchecked variant,
+// and the goto to a guarded one that checks i is not negative on entry.
+// A frame failing the guard falls back to the class file code.
+
+// the code frames of the method run, the class file code when nothing was rewritten,
+// NULL when the code is malformed
+RUNTIME_BOUNDSCHECK_EXTERN uint8_t* BoundsCheck_Eliminate(Method *method);
+// local holding the induction variable of the loop entered at pc
+RUNTIME_BOUNDSCHECK_EXTERN uint16_t BoundsCheck_GuardLocal(Method *method, uint32_t pc);
+
+#endif
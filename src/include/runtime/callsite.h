@@ -0,0 +1,52 @@
+#ifndef H_RUNTIME_CALLSITE
+#define H_RUNTIME_CALLSITE 1
+
+#include <stdint.h>
+#include "runtime/class.h"
+#include "runtime/frame.h"
+#include "runtime/object.h"
+#include "runtime/descriptor.h"
+
+#ifdef INCLUDE_RUNTIME_CALLSITE_SELF
+#define RUNTIME_CALLSITE_EXTERN
+#else
+#define RUNTIME_CALLSITE_EXTERN extern
+#endif
+
+// JVMS 4.4.8 reference kinds of a CONSTANT_MethodHandle
+#define CONST_REF_INVOKE_VIRTUAL  5
+#define CONST_REF_INVOKE_STATIC  6
+#define CONST_REF_INVOKE_SPECIAL  7
+#define CONST_REF_NEW_INVOKE_SPECIAL  8
+#define CONST_REF_INVOKE_INTERFACE  9
+
+// LambdaMetafactory.altMetafactory flags
+#define CONST_LAMBDA_FLAG_SERIALIZABLE  1
+#define CONST_LAMBDA_FLAG_MARKERS  2
+#define CONST_LAMBDA_FLAG_BRIDGES  4
+
+// A linked invokedynamic. There is no java.lang.invoke in the VM, the
+// bootstraps of LambdaMetafactory are run natively instead: they always
+// make a constant call site, whose target returns an instance of a lambda
+// class holding the captured values. That class implements the interface
+// method by calling the implementation method directly. A site is linked
+// once per constant pool entry, the sites sharing one also share the
+// bootstrap arguments, so they would link the same.
+typedef struct _CallSite CallSite;
+struct _CallSite{
+    Class *lambdaClass;
+    Object *instance; // returned by every evaluation when nothing is captured
+    Descriptor *captured; // of the invokedynamic, its arguments are the captured values
+    uint32_t *capturedOffsets; // into the lambda, indexed like captured->argTypes
+    uint8_t kind; // reference kind of the implementation method
+    Method *target;
+};
+
+// the site in the resolved entry at index, linked on first use; NULL with
+// an exception thrown into frame, a BootstrapMethodError for a site that
+// cannot be linked, or with the thread aborted (see Exception_ThrowVM)
+RUNTIME_CALLSITE_EXTERN CallSite* CallSite_Link(Frame *frame, uint16_t index);
+// a new lambda for the captured values popped from the operand stack
+RUNTIME_CALLSITE_EXTERN void CallSite_Capture(Frame *frame, CallSite *site);
+
+#endif
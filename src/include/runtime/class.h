@@ -0,0 +1,126 @@
+#ifndef H_RUNTIME_CLASS
+#define H_RUNTIME_CLASS 1
+
+#include <stdint.h>
+#include <stddef.h>
+#include "gc_typed.h"
+#include "classfile/classfile.h"
+#include "runtime/ref.h"
+#include "runtime/method.h"
+#include "runtime/memberindex.h"
+
+#ifdef INCLUDE_RUNTIME_CLASS_SELF
+#define RUNTIME_CLASS_EXTERN
+#else
+#define RUNTIME_CLASS_EXTERN extern
+#endif
+
+#define CONST_FIELD_OFFSET_NONE  0xFFFFFFFF
+
+// superclass depths found through the primary supers display
+#define CONST_CLASS_PRIMARY_SUPERS  8
+
+// initialization state word, see classinit.h
+#define CONST_CLASS_LINKED  0
+#define CONST_CLASS_INITIALIZING  1
+#define CONST_CLASS_INITIALIZED  2
+#define CONST_CLASS_ERRONEOUS  3
+
+// Low bit of a resolved static member whose class was not initialized when
+// it was stored, the entry is stored again untagged once it is.
+#define CONST_RESOLVED_UNINITIALIZED  ((uintptr_t)1)
+
+// resolved CONSTANT_Fieldref
+typedef struct{
+    uint32_t offset; // into the object, or into the static area of the declaring class
+    uint8_t type; // first char of the descriptor
+    uint8_t isStatic;
+} ResolvedField;
+
+typedef struct _Class Class;
+struct _Class{
+    ClassFile *classfile;
+    uint8_t *name;
+    Class *super;
+    // Subtype checks: classes within the display depth are found at their
+    // depth in primarySupers, interfaces and deeper classes in the
+    // secondary supers. superCheckOffset is where a subtype holds this class:
+    // its display slot, or the secondary cache.
+    uint32_t superCheckOffset;
+    uint16_t depth; // in the superclass chain, 0 for a root
+    Class *primarySupers[CONST_CLASS_PRIMARY_SUPERS]; // this class included
+    uint16_t secondarySupersCount;
+    Class **secondarySupers; // transitive superinterfaces, and this class when secondary itself
+    Class *secondarySuperCache; // last secondary super a check hit
+    // instance layout, offsets are in bytes from the start of the object
+    uint32_t instanceSize;
+    uint32_t *fieldOffsets; // indexed like classfile->fields
+    uint16_t refFieldsCount; // including the ones inherited from super
+    uint32_t *refOffsets;
+    GC_descr descr;
+    // static fields live outside of the object heap
+    uint32_t staticSize;
+    uint8_t *staticFields;
+    uint16_t staticRefFieldsCount;
+    uint32_t *staticRefOffsets;
+    uint16_t methodsCount;
+    Method *methods; // indexed like classfile->methods
+    // declared members by name and descriptor, NULL for builtin classes
+    MemberIndex *fieldIndex;
+    MemberIndex *methodIndex;
+    // runtime constant pool, indexed like classfile->constant_pool
+    void **resolved;
+    int32_t initState; // futex word, waited on while another thread initializes
+    uint32_t initThread; // id of the initializing thread
+    struct _CallSite *callSite; // the invokedynamic site a lambda class was made for, NULL otherwise
+    // Locked by the static synchronized methods in place of the class
+    // object, which is not modelled. Laid out as an object header.
+    struct{
+        Class *class;
+        uintptr_t mark;
+    } lock;
+    Class *next; // registry of loaded classes, see Class_ForEach
+};
+
+typedef struct{
+    ResolvedField field;
+    uint8_t *address;
+    Class *class; // declaring class, initialized before the first access
+} ResolvedStatic;
+
+RUNTIME_CLASS_EXTERN Class* Class_New(ClassFile *classfile, Class *super);
+RUNTIME_CLASS_EXTERN Class* Class_NewBuiltin(uint8_t *name, uint32_t instanceSize, uint16_t refFieldsCount, const uint32_t *refOffsets);
+// a class made by the VM with the given methods, see callsite.h
+RUNTIME_CLASS_EXTERN Class* Class_NewProxy(uint8_t *name, Class *super, Class **interfaces, uint16_t interfacesCount,
+    uint32_t instanceSize, uint16_t refFieldsCount, const uint32_t *refOffsets, Method *methods, uint16_t methodsCount);
+RUNTIME_CLASS_EXTERN uint32_t Class_FieldSize(uint8_t *descriptor);
+// among the loaded classes, there is no class loader behind it yet
+RUNTIME_CLASS_EXTERN Class* Class_Find(uint8_t *name);
+// CONSTANT_Class entry of the runtime constant pool, NULL until that class is loaded
+RUNTIME_CLASS_EXTERN Class* Class_ResolveClass(Class *class, uint16_t index);
+// instance field declared by class or a superclass, CONST_FIELD_OFFSET_NONE if there is none
+RUNTIME_CLASS_EXTERN uint32_t Class_FieldOffset(Class *class, uint8_t *name, uint8_t *descriptor);
+// NULL until the class of the field is loaded, or if it has no such field
+RUNTIME_CLASS_EXTERN ResolvedField* Class_ResolveField(Class *class, uint16_t index);
+RUNTIME_CLASS_EXTERN ResolvedStatic* Class_ResolveStaticField(Class *class, uint16_t index);
+// declared by class, a superclass or else a superinterface, NULL if there is none
+RUNTIME_CLASS_EXTERN Method* Class_FindMethod(Class *class, uint8_t *name, uint8_t *descriptor);
+// CONSTANT_Methodref entry of the runtime constant pool, NULL until the class is loaded
+RUNTIME_CLASS_EXTERN Method* Class_ResolveMethod(Class *class, uint16_t index);
+// slow path of Class_IsSubclassOf for interfaces and deep classes
+RUNTIME_CLASS_EXTERN int Class_IsSecondarySubclassOf(Class *class, Class *super);
+RUNTIME_CLASS_EXTERN void Class_ForEach(void (*fn)(Class *class, void *data), void *data);
+
+// class is super, a subclass of it, or implements it
+static inline int Class_IsSubclassOf(Class *class, Class *super){
+    if(super==*(Class**)((uint8_t*)class + super->superCheckOffset)){
+        return 1;
+    }
+    // a display slot holding another class is a definite miss
+    if(offsetof(Class, secondarySuperCache)!=super->superCheckOffset){
+        return 0;
+    }
+    return class==super || Class_IsSecondarySubclassOf(class, super);
+}
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef H_RUNTIME_CLASSINIT
+#define H_RUNTIME_CLASSINIT 1
+
+#include <stdint.h>
+#include "runtime/class.h"
+#include "runtime/frame.h"
+
+#ifdef INCLUDE_RUNTIME_CLASSINIT_SELF
+#define RUNTIME_CLASSINIT_EXTERN
+#else
+#define RUNTIME_CLASSINIT_EXTERN extern
+#endif
+
+// JVMS 5.5 on one atomic word per class: the thread moving it from linked
+// to initializing runs <clinit>, others wait on it as a futex until it
+// becomes initialized or erroneous. getstatic, putstatic and invokestatic
+// find their resolved entry untagged once the class is initialized, new
+// checks the state word, so the barrier is a single acquire load.
+
+static inline int ClassInit_Done(Class *class){
+    return CONST_CLASS_INITIALIZED==__atomic_load_n(&class->initState, __ATOMIC_ACQUIRE);
+}
+
+// the resolved static member at index, NULL until it is resolved and its class initialized
+static inline void* ClassInit_Resolved(Class *class, uint16_t index){
+    uintptr_t entry = (uintptr_t)__atomic_load_n(&class->resolved[index], __ATOMIC_ACQUIRE);
+    return entry & CONST_RESOLVED_UNINITIALIZED ? NULL : (void*)entry;
+}
+
+// 0 when frame may go on with class: initialized, or being initialized by
+// this thread. -1 with an exception thrown into frame otherwise, or with
+// the thread aborted when not even that is possible (see Exception_ThrowVM):
+// either way the caller returns at once.
+RUNTIME_CLASSINIT_EXTERN int ClassInit_Barrier(Frame *frame, Class *class);
+// stores the resolved entry untagged once owner is initialized
+RUNTIME_CLASSINIT_EXTERN void ClassInit_Patch(Class *class, uint16_t index, void *resolved, Class *owner);
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef H_RUNTIME_DESCRIPTOR
+#define H_RUNTIME_DESCRIPTOR 1
+
+#include <stdint.h>
+
+#ifdef INCLUDE_RUNTIME_DESCRIPTOR_SELF
+#define RUNTIME_DESCRIPTOR_EXTERN
+#else
+#define RUNTIME_DESCRIPTOR_EXTERN extern
+#endif
+
+// buckets of the process-wide cache, chains stay short for the few
+// thousand shapes a program uses
+#define CONST_DESCRIPTOR_BUCKETS  4096
+
+// A method descriptor parsed once for the whole VM. Types are the base
+// type characters of the descriptor, with 'L' for every reference type
+// (arrays included) and 'V' for a void return. Equal descriptor strings
+// share one entry, so the pointer identifies a call shape, to key
+// argument copying or native call stubs on.
+typedef struct _Descriptor Descriptor;
+struct _Descriptor{
+    uint8_t *descriptor; // the key, a constant pool string of the first class using it
+    uint32_t hash;
+    uint16_t argSlots; // without this
+    uint8_t returnType;
+    uint8_t returnSlots;
+    uint16_t argsCount;
+    uint8_t *argTypes;
+    Descriptor *next; // in its bucket
+};
+
+// NULL when the descriptor is malformed
+RUNTIME_DESCRIPTOR_EXTERN Descriptor* Descriptor_Get(uint8_t *descriptor);
+
+#endif
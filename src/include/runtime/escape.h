@@ -0,0 +1,57 @@
+#ifndef H_RUNTIME_ESCAPE
+#define H_RUNTIME_ESCAPE 1
+
+#include <stdint.h>
+#include "runtime/class.h"
+#include "runtime/method.h"
+#include "runtime/frame.h"
+#include "runtime/object.h"
+
+#ifdef INCLUDE_RUNTIME_ESCAPE_SELF
+#define RUNTIME_ESCAPE_EXTERN
+#else
+#define RUNTIME_ESCAPE_EXTERN extern
+#endif
+
+// Objects of a new that never leave the method are allocated in the frame
+// running it instead of the heap. The code is interpreted with one bit per
+// new site in each slot the object may be held in. A site escapes when its
+// object is returned, thrown, locked, stored into a field, a static or an
+// array, or passed to a call other than as the receiver of a method that
+// keeps its own receiver. It also escapes when the object may still be
+// used as the site is reached again, the next one would take its place.
+//
+// Stores into such objects skip the write barrier, their reference fields
+// are reported by Frame_ScanRoots instead.
+
+#define CONST_ESCAPE_MAX_SITES  32
+#define CONST_ESCAPE_MAX_SIZE  512 // bytes of objects per frame
+#define CONST_ESCAPE_MAX_DEPTH  8 // calls followed for a receiver
+#define CONST_ESCAPE_MAX_TRIES  8 // analyses of a method before unresolved entries are taken as final
+
+// Method.thisEscape, settled on first use
+#define CONST_ESCAPE_UNKNOWN  0
+#define CONST_ESCAPE_PENDING  1 // being analyzed, a recursive call escapes
+#define CONST_ESCAPE_NO  2
+#define CONST_ESCAPE_YES  3
+
+typedef struct{
+    uint32_t pc; // of the new
+    uint32_t offset; // into the objects of the frame
+    Class *class;
+} EscapeSite;
+
+struct _EscapeMap{
+    uint32_t size;
+    uint16_t sitesCount;
+    EscapeSite *sites; // by pc
+};
+
+// NULL when every new of the method may escape, or the code cannot be mapped.
+// Only constant pool entries already resolved are looked at, the others are
+// taken as escaping; settled is 0 when the result rests on any of them.
+RUNTIME_ESCAPE_EXTERN EscapeMap* Escape_Compute(Method *method, int *settled);
+// the object of the new at frame->pc in the frame, NULL when it goes to the heap
+RUNTIME_ESCAPE_EXTERN Object* Escape_New(Frame *frame, EscapeMap *map, Class *class);
+
+#endif
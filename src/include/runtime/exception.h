@@ -0,0 +1,81 @@
+#ifndef H_RUNTIME_EXCEPTION
+#define H_RUNTIME_EXCEPTION 1
+
+#include <stdint.h>
+#include <stdio.h>
+#include "classfile/classfile.h"
+#include "runtime/class.h"
+#include "runtime/method.h"
+#include "runtime/object.h"
+#include "runtime/frame.h"
+
+#ifdef INCLUDE_RUNTIME_EXCEPTION_SELF
+#define RUNTIME_EXCEPTION_EXTERN
+#else
+#define RUNTIME_EXCEPTION_EXTERN extern
+#endif
+
+#define CONST_EXCEPTION_NO_HANDLER  0xFFFFFFFF
+
+// thrown by the VM itself from one shared instance, without a stack trace
+#define CONST_EXCEPTION_NULL_POINTER  0
+#define CONST_EXCEPTION_ARITHMETIC  1
+#define CONST_EXCEPTION_ARRAY_INDEX  2
+#define CONST_EXCEPTION_NEGATIVE_ARRAY_SIZE  3
+#define CONST_EXCEPTION_CLASS_CAST  4
+#define CONST_EXCEPTION_ARRAY_STORE  5
+#define CONST_EXCEPTION_ILLEGAL_MONITOR_STATE  6
+#define CONST_EXCEPTION_OUT_OF_MEMORY  7
+#define CONST_EXCEPTION_STACK_OVERFLOW  8
+#define CONST_EXCEPTION_INTERRUPTED  9
+#define CONST_EXCEPTION_NO_CLASS_DEF_FOUND  10
+#define CONST_EXCEPTION_BOOTSTRAP_METHOD  11
+#define CONST_EXCEPTION_PREALLOCATED_COUNT  12
+
+typedef struct{
+    uint32_t startPc;
+    uint32_t endPc;
+    uint32_t handlerPc;
+    uint16_t catchType; // 0 catches everything (finally)
+    Class *catchClass; // cached once resolved
+} Handler;
+
+// The pc ranges of an exception table cut into disjoint intervals, each
+// listing the handlers that cover it in table order.
+struct _HandlerTable{
+    uint16_t handlersCount;
+    Handler *handlers;
+    uint32_t intervalsCount;
+    uint32_t *starts; // sorted, one more than intervals: the end of the last one
+    uint32_t *first; // by interval, into candidates, one more than intervals
+    uint16_t *candidates;
+};
+
+typedef struct{
+    uint8_t *className; // internal form, with slashes
+    uint8_t *methodName;
+    uint8_t *sourceFile; // NULL when unknown
+    int32_t line; // -1 unknown, -2 native method
+} StackTraceElement;
+
+// NULL for an empty exception table
+RUNTIME_EXCEPTION_EXTERN HandlerTable* Exception_NewHandlerTable(Attribute_Code *code);
+RUNTIME_EXCEPTION_EXTERN uint32_t Exception_FindHandler(Method *method, uint32_t pc, Class *thrown);
+// unwinds to the handler, or to the invoker of the interpreter leaving the
+// exception pending on the thread (-1)
+RUNTIME_EXCEPTION_EXTERN int Exception_Throw(Frame *frame, Object *exception);
+// NULL until the class of that exception is loaded
+RUNTIME_EXCEPTION_EXTERN Object* Exception_Preallocated(int kind);
+// -1 with the thread aborted when the class of that exception is not loaded yet
+RUNTIME_EXCEPTION_EXTERN int Exception_ThrowVM(Frame *frame, int kind);
+// the thread stops running java code, its frames down to javaBase are dropped
+RUNTIME_EXCEPTION_EXTERN void Exception_Abort(struct _Thread *thread);
+
+// Throwable.backtrace gets the raw (method, pc) pairs of the java frames,
+// names and lines are only looked up to print or inspect the trace
+RUNTIME_EXCEPTION_EXTERN int Exception_FillInStackTrace(Object *throwable, Frame *frame);
+RUNTIME_EXCEPTION_EXTERN int32_t Exception_StackTraceDepth(Object *throwable);
+RUNTIME_EXCEPTION_EXTERN int Exception_StackTraceElement(Object *throwable, int32_t index, StackTraceElement *element);
+RUNTIME_EXCEPTION_EXTERN void Exception_PrintStackTrace(Object *throwable, FILE *out);
+
+#endif
@@ -1,29 +1,96 @@
 #ifndef H_RUNTIME_FRAME
 #define H_RUNTIME_FRAME 1
 
+#include <stdint.h>
+#include "runtime/ref.h"
+#include "runtime/class.h"
+#include "runtime/method.h"
+#include "runtime/refmap.h"
+#include "utils.h"
+
 #ifdef INCLUDE_RUNTIME_FRAME_SELF
 #define RUNTIME_FRAME_EXTERN
 #else
 #define RUNTIME_FRAME_EXTERN extern
 #endif
 
+// Slots are pointer sized unless references are compressed. Wide slots hold
+// a whole long or double in the first of its two slots, the second one only
+// keeps the JVMS local and stack numbering and is never read.
+#if UINTPTR_MAX>0xFFFFFFFF && !defined(JVM_COMPRESSED_REFS)
+#define JVM_WIDE_SLOTS 1
+#endif
+
 typedef union{
     int32_t num;
-    void* ref;
+    Ref ref;
+#ifdef JVM_WIDE_SLOTS
+    int64_t lnum;
+    double dnum;
+#endif
 } ValueSlot;
 
+// category 2 values, slots points at the first of the pair
+#ifdef JVM_WIDE_SLOTS
+#define SLOT_GET_LONG(slots) ((slots)[0].lnum)
+#define SLOT_SET_LONG(slots, value) ((slots)[0].lnum = (value))
+#define SLOT_GET_DOUBLE(slots) ((slots)[0].dnum)
+#define SLOT_SET_DOUBLE(slots, value) ((slots)[0].dnum = (value))
+#else
+#define SLOT_GET_LONG(slots) ((int64_t)((uint64_t)(uint32_t)(slots)[1].num<<32 | (uint32_t)(slots)[0].num))
+#define SLOT_SET_LONG(slots, value) do{ \
+    uint64_t bits_ = (uint64_t)(value); \
+    (slots)[0].num = (int32_t)bits_; \
+    (slots)[1].num = (int32_t)(bits_>>32); \
+}while(0)
+#define SLOT_GET_DOUBLE(slots) ieee754_bin2double((uint64_t)SLOT_GET_LONG(slots))
+#define SLOT_SET_DOUBLE(slots, value) SLOT_SET_LONG(slots, (int64_t)ieee754_double2bin(value))
+#endif
+
 typedef struct{
     unsigned int maxSize;
     unsigned int size;
     ValueSlot *data; 
 } OperandStack;
 
+struct _Thread;
+
 typedef struct _Frame Frame;
 struct _Frame{
     Frame *lower;
+    struct _Thread *thread;
+    Class *class; // owner of the running method, for constant pool access
+    Method *method;
+    RefMap *refMap; // NULL when the slots have to be scanned ambiguously
+    uint8_t *code;
+    uint32_t codeLength;
+    uint32_t pc; // of the instruction being executed
+    uint32_t nextPc; // branches overwrite it
     unsigned int maxLocal;
     ValueSlot *localVars;
     OperandStack *operandStack;
+    uint8_t *objects; // NULL until the first new of the method kept in its frame
+    Ref lock; // the monitor a synchronized method holds, released as the frame is popped
 };
 
+// a reference slot of a frame, precise ones may be updated to a moved object
+typedef void (*Frame_RootFn)(Ref *slot, void *data);
+
+RUNTIME_FRAME_EXTERN Frame* Frame_New(unsigned int maxLocal, unsigned int maxOperandStack);
+RUNTIME_FRAME_EXTERN Frame* Frame_NewMethod(Method *method);
+RUNTIME_FRAME_EXTERN void Frame_ScanRoots(Frame *frame, Frame_RootFn precise, Frame_RootFn ambiguous, void *data);
+RUNTIME_FRAME_EXTERN ValueSlot* ValueSlot_New(unsigned int maxLocal);
+RUNTIME_FRAME_EXTERN OperandStack* OperandStack_New(unsigned int maxSize);
+
+RUNTIME_FRAME_EXTERN int OperandStack_PushInt(OperandStack *stack, int32_t value);
+RUNTIME_FRAME_EXTERN int32_t OperandStack_PopInt(OperandStack *stack);
+RUNTIME_FRAME_EXTERN int OperandStack_PushFloat(OperandStack *stack, float value);
+RUNTIME_FRAME_EXTERN float OperandStack_PopFloat(OperandStack *stack);
+RUNTIME_FRAME_EXTERN int OperandStack_PushLong(OperandStack *stack, int64_t value);
+RUNTIME_FRAME_EXTERN int64_t OperandStack_PopLong(OperandStack *stack);
+RUNTIME_FRAME_EXTERN int OperandStack_PushDouble(OperandStack *stack, double value);
+RUNTIME_FRAME_EXTERN double OperandStack_PopDouble(OperandStack *stack);
+RUNTIME_FRAME_EXTERN int OperandStack_PushRef(OperandStack *stack, void *value);
+RUNTIME_FRAME_EXTERN void* OperandStack_PopRef(OperandStack *stack);
+
 #endif
@@ -0,0 +1,20 @@
+#ifndef H_RUNTIME_FUTEX
+#define H_RUNTIME_FUTEX 1
+
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+// process private futexes, there is no glibc wrapper
+
+static inline long Futex_Wait(int32_t *addr, int32_t expected, const struct timespec *timeout){
+    return syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, expected, timeout, NULL, 0);
+}
+
+static inline long Futex_Wake(int32_t *addr, int32_t count){
+    return syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+#endif
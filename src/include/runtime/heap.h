@@ -0,0 +1,54 @@
+#ifndef H_RUNTIME_HEAP
+#define H_RUNTIME_HEAP 1
+
+#include <stdint.h>
+#include <stddef.h>
+#include "gc_typed.h"
+#include "runtime/ref.h"
+
+#ifdef INCLUDE_RUNTIME_HEAP_SELF
+#define RUNTIME_HEAP_EXTERN
+#else
+#define RUNTIME_HEAP_EXTERN extern
+#endif
+
+#define CONST_HEAP_BACKEND_BDWGC  0
+#define CONST_HEAP_BACKEND_GENERATIONAL  1
+
+// how the collector has to scan a java object
+#define CONST_HEAP_KIND_ATOMIC  0
+#define CONST_HEAP_KIND_CONSERVATIVE  1
+#define CONST_HEAP_KIND_TYPED  2
+
+#define DEFAULT_NURSERY_SIZE (32*1024*1024)
+
+// Java objects go through the backend, VM data structures (classes, frames,
+// streams) always come from the non-moving bdwgc heap.
+typedef struct{
+    char *name;
+    // zeroed memory, the caller fills in the object header
+    void* (*AllocObject) (uint32_t size, uint8_t kind, GC_descr descr);
+    // every store of a reference into a heap object or a static field
+    void (*WriteRef) (void *holder, Ref *slot, void *value);
+    void (*Collect) (void);
+    // references the old space collector cannot find by itself
+    void (*MarkRoots) (void (*mark)(void *ptr));
+} HeapOp;
+
+RUNTIME_HEAP_EXTERN int Heap_Init(int backend, size_t nurserySize);
+RUNTIME_HEAP_EXTERN HeapOp* Heap_Current(void);
+
+RUNTIME_HEAP_EXTERN void* Heap_Alloc(size_t size);
+RUNTIME_HEAP_EXTERN void* Heap_AllocAtomic(size_t size);
+RUNTIME_HEAP_EXTERN void* Heap_AllocPermanent(size_t size);
+RUNTIME_HEAP_EXTERN void* Heap_AllocPermanentAtomic(size_t size);
+RUNTIME_HEAP_EXTERN void Heap_Free(void *ptr);
+
+RUNTIME_HEAP_EXTERN void* Heap_AllocObject(uint32_t size, uint8_t kind, GC_descr descr);
+RUNTIME_HEAP_EXTERN void* Heap_AllocOld(uint32_t size, uint8_t kind, GC_descr descr);
+RUNTIME_HEAP_EXTERN void Heap_WriteRef(void *holder, Ref *slot, void *value);
+RUNTIME_HEAP_EXTERN void Heap_Collect(void);
+
+RUNTIME_HEAP_EXTERN HeapOp* Nursery_New(size_t size);
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include "runtime/frame.h"
+#include "runtime/safepoint.h"
 #include "stream.h"
 
 #ifdef INCLUDE_RUNTIME_INSTRUCTION_SELF
@@ -11,8 +12,51 @@
 #define RUNTIME_INSTRUCTION_EXTERN extern
 #endif
 
+// Handlers and the helpers they inline go into a text section of their
+// own, the null check trap only takes the faults of code in it.
+#define INSTRUCTION_TEXT __attribute__((section("jvm_instructions")))
+
 typedef struct{
     void* (*FetchOperands) (Stream *reader);
     void (*Execute) (Frame *frame, void *Data);
 } Instruction;
+
+// NULL for an opcode without a handler yet
+RUNTIME_INSTRUCTION_EXTERN Instruction* Instruction_Get(uint8_t opcode);
+
+// each file under runtime/instructions/ fills its share of the table
+RUNTIME_INSTRUCTION_EXTERN void Instructions_InitConstants(Instruction *table);
+RUNTIME_INSTRUCTION_EXTERN void Instructions_InitLoads(Instruction *table);
+RUNTIME_INSTRUCTION_EXTERN void Instructions_InitStores(Instruction *table);
+RUNTIME_INSTRUCTION_EXTERN void Instructions_InitMath(Instruction *table);
+RUNTIME_INSTRUCTION_EXTERN void Instructions_InitConversions(Instruction *table);
+RUNTIME_INSTRUCTION_EXTERN void Instructions_InitComparisons(Instruction *table);
+RUNTIME_INSTRUCTION_EXTERN void Instructions_InitReferences(Instruction *table);
+RUNTIME_INSTRUCTION_EXTERN void Instructions_InitControl(Instruction *table);
+
+// shared operand fetchers, a small operand is returned in the pointer itself
+RUNTIME_INSTRUCTION_EXTERN void* Instruction_FetchNone(Stream *reader);
+RUNTIME_INSTRUCTION_EXTERN void* Instruction_FetchIndex(Stream *reader);
+RUNTIME_INSTRUCTION_EXTERN void* Instruction_FetchWideIndex(Stream *reader);
+// invokeinterface and invokedynamic: a wide index and two bytes left unused
+RUNTIME_INSTRUCTION_EXTERN void* Instruction_FetchInvokeIndex(Stream *reader);
+RUNTIME_INSTRUCTION_EXTERN void* Instruction_FetchBranch(Stream *reader);
+RUNTIME_INSTRUCTION_EXTERN void* Instruction_FetchWideBranch(Stream *reader);
+// iinc: a local index and a signed byte
+RUNTIME_INSTRUCTION_EXTERN void* Instruction_FetchIncrement(Stream *reader);
+
+#define INSTRUCTION_OPERAND(data) ((uintptr_t)(data))
+#define INSTRUCTION_OFFSET(data) ((int32_t)(intptr_t)(data))
+#define INSTRUCTION_INCREMENT_INDEX(data) ((uint8_t)INSTRUCTION_OPERAND(data))
+#define INSTRUCTION_INCREMENT_CONST(data) ((int8_t)(INSTRUCTION_OPERAND(data)>>8))
+
+// backward branches poll for a safepoint, loops cannot hold it up
+static inline void Instruction_Branch(Frame *frame, void *data){
+    int32_t offset = INSTRUCTION_OFFSET(data);
+    frame->nextPc = frame->pc + offset;
+    if(0>=offset){
+        SAFEPOINT_POLL();
+    }
+}
+
 #endif
@@ -0,0 +1,15 @@
+#ifndef H_RUNTIME_INTERPRETER
+#define H_RUNTIME_INTERPRETER 1
+
+#include "runtime/thread.h"
+
+#ifdef INCLUDE_RUNTIME_INTERPRETER_SELF
+#define RUNTIME_INTERPRETER_EXTERN
+#else
+#define RUNTIME_INTERPRETER_EXTERN extern
+#endif
+
+// run the top frame of thread until it returns to its invoker
+RUNTIME_INTERPRETER_EXTERN int Interpreter_Run(Thread *thread);
+
+#endif
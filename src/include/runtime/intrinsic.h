@@ -0,0 +1,26 @@
+#ifndef H_RUNTIME_INTRINSIC
+#define H_RUNTIME_INTRINSIC 1
+
+#include <stdint.h>
+#include "runtime/frame.h"
+
+#ifdef INCLUDE_RUNTIME_INTRINSIC_SELF
+#define RUNTIME_INTRINSIC_EXTERN
+#else
+#define RUNTIME_INTRINSIC_EXTERN extern
+#endif
+
+// Hand-written C run instead of selected JDK methods. It executes in the
+// frame of the invoker like an instruction: pops the arguments, pushes the
+// result and throws through Exception_ThrowVM. The popped arguments are no
+// roots any more, so it must not allocate java objects.
+typedef void (*Intrinsic)(Frame *frame);
+
+// picks the widest kernels the cpu supports, the portable ones until then
+RUNTIME_INTRINSIC_EXTERN void Intrinsic_Init(void);
+// NULL when the method keeps its bytecode
+RUNTIME_INTRINSIC_EXTERN Intrinsic Intrinsic_Find(uint8_t *className, uint8_t *name, uint8_t *descriptor);
+// String.hashCode of the value bytes of a string, with the vectorized kernels
+RUNTIME_INTRINSIC_EXTERN int32_t Intrinsic_StringHash(const uint8_t *bytes, uint32_t size, uint8_t coder);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef H_RUNTIME_JSTRING
+#define H_RUNTIME_JSTRING 1
+
+#include <stdint.h>
+#include "runtime/object.h"
+#include "runtime/class.h"
+#include "runtime/ref.h"
+
+#ifdef INCLUDE_RUNTIME_JSTRING_SELF
+#define RUNTIME_JSTRING_EXTERN
+#else
+#define RUNTIME_JSTRING_EXTERN extern
+#endif
+
+// compact strings (JEP 254): one byte per char when every char is Latin-1
+#define CONST_STRING_CODER_LATIN1  0
+#define CONST_STRING_CODER_UTF16  1
+
+// java.lang.String as laid out by the VM, value is a byte[] of length<<coder bytes
+typedef struct{
+    ObjectHeader header;
+    Ref value;
+    int32_t hash; // 0 until computed, like String.hash
+    uint8_t coder;
+} StringObject;
+
+RUNTIME_JSTRING_EXTERN Class* String_Class(void);
+RUNTIME_JSTRING_EXTERN StringObject* String_NewUTF8(const uint8_t *bytes, uint32_t size);
+// canonical instances, held weakly by the intern table
+RUNTIME_JSTRING_EXTERN StringObject* String_Intern(StringObject *string);
+RUNTIME_JSTRING_EXTERN StringObject* String_InternUTF8(const uint8_t *bytes, uint32_t size);
+// ldc of a CONSTANT_String, resolved once per constant pool entry
+RUNTIME_JSTRING_EXTERN StringObject* String_ResolveConstant(Class *class, uint16_t index);
+RUNTIME_JSTRING_EXTERN int32_t String_HashCode(StringObject *string);
+
+static inline ArrayObject* String_Value(StringObject *string){
+    return (ArrayObject*)REF_DECODE(string->value);
+}
+
+static inline uint32_t String_Length(StringObject *string){
+    return String_Value(string)->length>>string->coder;
+}
+
+static inline uint16_t String_CharAt(StringObject *string, uint32_t index){
+    ArrayObject *value = String_Value(string);
+    if(CONST_STRING_CODER_LATIN1==string->coder){
+        return ((uint8_t*)value->data)[index];
+    }
+    return ((uint16_t*)value->data)[index];
+}
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef H_RUNTIME_LINETABLE
+#define H_RUNTIME_LINETABLE 1
+
+#include <stdint.h>
+#include "classfile/classfile.h"
+
+#ifdef INCLUDE_RUNTIME_LINETABLE_SELF
+#define RUNTIME_LINETABLE_EXTERN
+#else
+#define RUNTIME_LINETABLE_EXTERN extern
+#endif
+
+// entries decoded from a checkpoint at most
+#define CONST_LINETABLE_BLOCK  16
+
+typedef struct{
+    uint16_t pc;
+    uint16_t line;
+    uint32_t offset; // into deltas, where the rest of the block starts
+} LineCheckpoint;
+
+// LineNumberTable sorted by pc and stored as varint deltas: the pc delta
+// unsigned, the line delta zigzag encoded. Every CONST_LINETABLE_BLOCK
+// entries a checkpoint with absolute values is kept for binary search.
+typedef struct{
+    uint32_t count;
+    uint32_t checkpointsCount;
+    LineCheckpoint *checkpoints;
+    uint8_t *deltas;
+} LineTable;
+
+RUNTIME_LINETABLE_EXTERN LineTable* LineTable_New(LineNumberTableEntry *entries, uint32_t count);
+// -1 when no entry covers pc
+RUNTIME_LINETABLE_EXTERN int32_t LineTable_Lookup(LineTable *table, uint32_t pc);
+
+#endif
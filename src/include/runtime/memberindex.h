@@ -0,0 +1,39 @@
+#ifndef H_RUNTIME_MEMBERINDEX
+#define H_RUNTIME_MEMBERINDEX 1
+
+#include <stdint.h>
+
+#ifdef INCLUDE_RUNTIME_MEMBERINDEX_SELF
+#define RUNTIME_MEMBERINDEX_EXTERN
+#else
+#define RUNTIME_MEMBERINDEX_EXTERN extern
+#endif
+
+#define CONST_MEMBER_NONE  0xFFFF
+
+typedef struct{
+    uint32_t hash;
+    uint16_t member; // into the fields or the methods of the class
+    uint8_t *name;
+    uint8_t *descriptor;
+} MemberEntry;
+
+// Fields or methods declared by one class, hashed on (name, descriptor)
+// with linear probing. Slots are small indexes into the dense entries, so
+// probing a run of them touches a single cache line.
+typedef struct{
+    uint32_t mask;
+    uint16_t *slots; // into entries plus one, 0 when empty
+    uint16_t count;
+    MemberEntry *entries;
+} MemberIndex;
+
+// NULL for a class without such members
+RUNTIME_MEMBERINDEX_EXTERN MemberIndex* MemberIndex_New(uint16_t capacity);
+RUNTIME_MEMBERINDEX_EXTERN void MemberIndex_Add(MemberIndex *index, uint8_t *name, uint8_t *descriptor, uint16_t member);
+// computed once for a lookup walking up several classes
+RUNTIME_MEMBERINDEX_EXTERN uint32_t MemberIndex_Hash(uint8_t *name, uint8_t *descriptor);
+// CONST_MEMBER_NONE when the class declares no such member
+RUNTIME_MEMBERINDEX_EXTERN uint16_t MemberIndex_Find(MemberIndex *index, uint32_t hash, uint8_t *name, uint8_t *descriptor);
+
+#endif
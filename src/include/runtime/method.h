@@ -0,0 +1,71 @@
+#ifndef H_RUNTIME_METHOD
+#define H_RUNTIME_METHOD 1
+
+#include <stdint.h>
+#include "classfile/classfile.h"
+#include "runtime/linetable.h"
+#include "runtime/descriptor.h"
+
+#ifdef INCLUDE_RUNTIME_METHOD_SELF
+#define RUNTIME_METHOD_EXTERN
+#else
+#define RUNTIME_METHOD_EXTERN extern
+#endif
+
+struct _Class;
+struct _Frame;
+typedef struct _RefMap RefMap;
+typedef struct _HandlerTable HandlerTable;
+typedef struct _SwitchTable SwitchTable;
+typedef struct _EscapeMap EscapeMap;
+
+// Trivial bodies run by the invoker itself, without a frame. The getfield,
+// putfield or invokespecial of a shape is at shapeIndex of the pool.
+#define CONST_METHOD_SHAPE_NONE  0
+#define CONST_METHOD_SHAPE_EMPTY  1 // return
+#define CONST_METHOD_SHAPE_GETTER  2 // aload_0, getfield, xreturn
+#define CONST_METHOD_SHAPE_SETTER  3 // aload_0, xload_1, putfield, return
+#define CONST_METHOD_SHAPE_EMPTY_INIT  4 // aload_0, invokespecial, return: empty once the super constructor is
+
+// entry of a loop with unchecked array accesses, see boundscheck.h
+typedef struct{
+    uint32_t pc;
+    uint16_t local; // induction variable
+} LoopGuard;
+
+typedef struct{
+    struct _Class *class;
+    MethodInfo *info;
+    uint8_t *name;
+    uint8_t *descriptor;
+    Descriptor *parsedDescriptor; // shared by the methods of that shape
+    uint16_t accessFlags;
+    uint16_t argSlots; // including this
+    // zero for abstract and native methods
+    uint16_t maxStack;
+    uint16_t maxLocals;
+    uint32_t codeLength;
+    uint8_t *code; // run by the frames, may differ from the class file code
+    Attribute_Code *codeAttribute;
+    uint16_t loopGuardsCount;
+    LoopGuard *loopGuards;
+    HandlerTable *handlers; // NULL without exception handlers
+    SwitchTable *switches; // NULL without switches
+    LineTable *lines; // NULL without debug information
+    RefMap *refMap; // computed on first invocation, see Method_RefMap
+    EscapeMap *escapeMap; // computed on a new once settled, see Method_EscapeMap
+    uint8_t thisEscape; // CONST_ESCAPE_*, see escape.h
+    uint8_t escapeTries; // unsettled analyses of escapeMap
+    uint8_t shape;
+    uint16_t shapeIndex;
+    // C replacement run instead of the method, see intrinsic.h
+    void (*intrinsic)(struct _Frame *frame);
+} Method;
+
+RUNTIME_METHOD_EXTERN int Method_Init(Method *method, struct _Class *class, MethodInfo *info);
+// NULL when the code cannot be mapped, frames of the method are then scanned ambiguously
+RUNTIME_METHOD_EXTERN RefMap* Method_RefMap(Method *method);
+// NULL when every object the method allocates goes to the heap
+RUNTIME_METHOD_EXTERN EscapeMap* Method_EscapeMap(Method *method);
+
+#endif
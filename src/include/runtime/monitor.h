@@ -0,0 +1,103 @@
+#ifndef H_RUNTIME_MONITOR
+#define H_RUNTIME_MONITOR 1
+
+#include <stdint.h>
+#include "runtime/object.h"
+#include "runtime/thread.h"
+
+#ifdef INCLUDE_RUNTIME_MONITOR_SELF
+#define RUNTIME_MONITOR_EXTERN
+#else
+#define RUNTIME_MONITOR_EXTERN extern
+#endif
+
+// Lock bits of the mark word, above the header flags:
+//   thin     owner thread id << 16 | recursions << 8, all zero when unlocked
+//   inflated monitor index << 16 | CONST_HEADER_INFLATED
+// A thin lock is taken and released with one CAS. Contention, wait() or too
+// many recursions inflate it to a Monitor, which is never deflated.
+#define CONST_LOCK_RECURSION_SHIFT  8
+#define CONST_LOCK_OWNER_SHIFT  16
+#define CONST_LOCK_MAX_RECURSION  0xFF
+#define CONST_LOCK_MAX_OWNER  ((uint32_t)(UINTPTR_MAX>>CONST_LOCK_OWNER_SHIFT))
+#define CONST_LOCK_MASK  ((~(uintptr_t)0xFF)|CONST_HEADER_INFLATED)
+
+#define LOCK_OWNER(mark) ((uint32_t)((mark)>>CONST_LOCK_OWNER_SHIFT))
+#define LOCK_RECURSIONS(mark) ((uint32_t)(((mark)>>CONST_LOCK_RECURSION_SHIFT)&CONST_LOCK_MAX_RECURSION))
+#define LOCK_THIN(owner) ((uintptr_t)(owner)<<CONST_LOCK_OWNER_SHIFT)
+
+#define CONST_WAIT_WAITING  0
+#define CONST_WAIT_NOTIFIED  1 // moved to the handoff queue
+#define CONST_WAIT_WOKEN  2 // unparked by a releasing owner
+
+// a thread in Object.wait, lives on the waiter's stack
+typedef struct _WaitNode WaitNode;
+struct _WaitNode{
+    Thread *thread;
+    int32_t state;
+    WaitNode *prev;
+    WaitNode *next;
+};
+
+// FIFO of wait nodes, guarded by the monitor itself
+typedef struct{
+    WaitNode *head;
+    WaitNode *tail;
+} WaitQueue;
+
+typedef struct{
+    // 0 free, 1 locked, 2 locked with threads asleep on it
+    int32_t state;
+    uint32_t owner; // thread id
+    uint32_t recursions;
+    WaitQueue waitSet;
+    // notified waiters, unparked one per final release so that they never
+    // wake up just to block on the monitor again
+    WaitQueue handoff;
+} Monitor;
+
+RUNTIME_MONITOR_EXTERN int Monitor_EnterSlow(Object *object, uint32_t owner);
+RUNTIME_MONITOR_EXTERN int Monitor_ExitSlow(Object *object, uint32_t owner);
+// the monitor of object, inflating its lock if still thin
+RUNTIME_MONITOR_EXTERN Monitor* Monitor_Inflate(Object *object);
+RUNTIME_MONITOR_EXTERN int Monitor_HoldsLock(Object *object, uint32_t owner);
+// Object.wait, nanos 0 waits until notified; -1 if interrupted, the flag
+// is then cleared, -2 if not the owner or out of monitors
+RUNTIME_MONITOR_EXTERN int Monitor_Wait(Object *object, Thread *thread, int64_t nanos);
+RUNTIME_MONITOR_EXTERN int Monitor_Notify(Object *object, uint32_t owner);
+RUNTIME_MONITOR_EXTERN int Monitor_NotifyAll(Object *object, uint32_t owner);
+// Takes the monitor of the synchronized method of a frame just pushed: its
+// receiver, or the lock of its class. The frame holds it from then on and
+// reports it to the collections, also while the thread blocks on it.
+RUNTIME_MONITOR_EXTERN int Monitor_EnterFrame(Frame *frame);
+
+// uncontended cases inline in the interpreter, one CAS each
+static inline int Monitor_Enter(Object *object, uint32_t owner){
+    uintptr_t mark = __atomic_load_n(&object->header.mark, __ATOMIC_RELAXED);
+    if(0==(mark&CONST_LOCK_MASK)
+        && __atomic_compare_exchange_n(&object->header.mark, &mark, mark|LOCK_THIN(owner), 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)){
+        return 0;
+    }
+    return Monitor_EnterSlow(object, owner);
+}
+
+static inline int Monitor_Exit(Object *object, uint32_t owner){
+    uintptr_t mark = __atomic_load_n(&object->header.mark, __ATOMIC_RELAXED);
+    if(LOCK_THIN(owner)==(mark&CONST_LOCK_MASK)
+        && __atomic_compare_exchange_n(&object->header.mark, &mark, mark&~CONST_LOCK_MASK, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED)){
+        return 0;
+    }
+    return Monitor_ExitSlow(object, owner);
+}
+
+// releases the monitor a frame holds as it is popped, 0 when it holds none
+static inline int Monitor_ExitFrame(Frame *frame){
+    Object *object = (Object*)REF_DECODE(frame->lock);
+    if(NULL==object){
+        return 0;
+    }
+    frame->lock = REF_ENCODE(NULL);
+    return Monitor_Exit(object, frame->thread->id);
+}
+
+#endif
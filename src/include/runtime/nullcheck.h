@@ -0,0 +1,28 @@
+#ifndef H_RUNTIME_NULLCHECK
+#define H_RUNTIME_NULLCHECK 1
+
+#include <stdint.h>
+#include "runtime/thread.h"
+
+#ifdef INCLUDE_RUNTIME_NULLCHECK_SELF
+#define RUNTIME_NULLCHECK_EXTERN
+#else
+#define RUNTIME_NULLCHECK_EXTERN extern
+#endif
+
+// Instructions dereference references without testing them: a null one
+// faults in the unmapped low range, and the SIGSEGV handler throws a
+// NullPointerException at the bytecode of the top frame. Objects bigger
+// than the range still need an explicit test for their farther fields, and
+// so does a reference handed to the rest of the VM: only faults of the
+// INSTRUCTION_TEXT code are taken.
+#define CONST_NULLCHECK_GUARD_SIZE  (64*1024)
+
+#define NULLCHECK_IMPLICIT(offset) ((uintptr_t)(offset)<CONST_NULLCHECK_GUARD_SIZE)
+
+// keeps the guard range unmapped where the kernel would allow mapping it
+RUNTIME_NULLCHECK_EXTERN int NullCheck_Init(void);
+// from the SIGSEGV handler with its ucontext, does not return when the fault is a null check
+RUNTIME_NULLCHECK_EXTERN void NullCheck_Trap(Thread *thread, void *addr, void *context);
+
+#endif
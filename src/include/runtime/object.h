@@ -0,0 +1,90 @@
+#ifndef H_RUNTIME_OBJECT
+#define H_RUNTIME_OBJECT 1
+
+#include <stdint.h>
+#include "runtime/class.h"
+#include "runtime/ref.h"
+#include "runtime/heap.h"
+
+#ifdef INCLUDE_RUNTIME_OBJECT_SELF
+#define RUNTIME_OBJECT_EXTERN
+#else
+#define RUNTIME_OBJECT_EXTERN extern
+#endif
+
+// atype operand of newarray, plus one for arrays of references
+#define CONST_ARRAY_TYPE_BOOLEAN  4
+#define CONST_ARRAY_TYPE_CHAR  5
+#define CONST_ARRAY_TYPE_FLOAT  6
+#define CONST_ARRAY_TYPE_DOUBLE  7
+#define CONST_ARRAY_TYPE_BYTE  8
+#define CONST_ARRAY_TYPE_SHORT  9
+#define CONST_ARRAY_TYPE_INT  10
+#define CONST_ARRAY_TYPE_LONG  11
+#define CONST_ARRAY_TYPE_REFERENCE  12
+
+// low bits of the mark word, every object has CONST_HEADER_OBJECT set so that
+// a zeroed header marks the end of the allocated part of a nursery chunk
+#define CONST_HEADER_OBJECT  0x1
+#define CONST_HEADER_ARRAY  0x2
+#define CONST_HEADER_FORWARDED  0x4 // class holds the forwarding address
+#define CONST_HEADER_PINNED  0x8
+#define CONST_HEADER_INFLATED  0x10 // lock bits hold a monitor index, see monitor.h
+#define CONST_HEADER_FRAME  0x20 // allocated in a frame, see escape.h
+#define CONST_HEADER_GC_MASK  (CONST_HEADER_FORWARDED|CONST_HEADER_PINNED)
+
+typedef struct{
+    Class *class;
+    uintptr_t mark;
+} ObjectHeader;
+
+typedef struct{
+    ObjectHeader header;
+    uint8_t fields[];
+} Object;
+
+typedef struct{
+    ObjectHeader header;
+    Class *componentClass; // NULL for primitive arrays
+    uint32_t length;
+    uint8_t elementType;
+    uint8_t elementSize;
+    uint64_t data[]; // 8-byte aligned payload
+} ArrayObject;
+
+RUNTIME_OBJECT_EXTERN Object* Object_New(Class *class);
+RUNTIME_OBJECT_EXTERN Object* Object_NewOld(Class *class);
+RUNTIME_OBJECT_EXTERN ArrayObject* ArrayObject_New(uint8_t elementType, uint32_t length);
+RUNTIME_OBJECT_EXTERN ArrayObject* ArrayObject_NewOld(uint8_t elementType, uint32_t length);
+RUNTIME_OBJECT_EXTERN ArrayObject* ArrayObject_NewRef(Class *componentClass, uint32_t length);
+RUNTIME_OBJECT_EXTERN uint8_t ArrayObject_ElementSize(uint8_t elementType);
+RUNTIME_OBJECT_EXTERN uint32_t Object_Size(Object *object);
+RUNTIME_OBJECT_EXTERN uint8_t Object_HeapKind(Object *object);
+
+// reference fields and elements, decoding is folded into the access
+static inline void* Object_GetRef(Object *object, uint32_t offset){
+    return REF_DECODE(*(Ref*)((uint8_t*)object+offset));
+}
+
+static inline void Object_PutRef(Object *object, uint32_t offset, void *value){
+    Heap_WriteRef(object, (Ref*)((uint8_t*)object+offset), value);
+}
+
+static inline void* ArrayObject_GetRef(ArrayObject *array, uint32_t index){
+    return REF_DECODE(((Ref*)array->data)[index]);
+}
+
+static inline void ArrayObject_PutRef(ArrayObject *array, uint32_t index, void *value){
+    Heap_WriteRef(array, (Ref*)array->data+index, value);
+}
+
+// aastore type check, [FIXME] array classes are not modelled yet so an
+// array is taken as any element type
+static inline int ArrayObject_CanStore(ArrayObject *array, Object *value){
+    if(NULL==value || NULL==array->componentClass || (value->header.mark & CONST_HEADER_ARRAY)){
+        return 1;
+    }
+    return Class_IsSubclassOf(value->header.class, array->componentClass);
+}
+
+#endif
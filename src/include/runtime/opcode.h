@@ -0,0 +1,234 @@
+#ifndef H_RUNTIME_OPCODE
+#define H_RUNTIME_OPCODE 1
+
+#include <stdint.h>
+
+#ifdef INCLUDE_RUNTIME_OPCODE_SELF
+#define RUNTIME_OPCODE_EXTERN
+#else
+#define RUNTIME_OPCODE_EXTERN extern
+#endif
+
+// JVMS chapter 6
+#define CONST_OPCODE_NOP  0x00
+#define CONST_OPCODE_ACONST_NULL  0x01
+#define CONST_OPCODE_ICONST_M1  0x02
+#define CONST_OPCODE_ICONST_0  0x03
+#define CONST_OPCODE_ICONST_1  0x04
+#define CONST_OPCODE_ICONST_2  0x05
+#define CONST_OPCODE_ICONST_3  0x06
+#define CONST_OPCODE_ICONST_4  0x07
+#define CONST_OPCODE_ICONST_5  0x08
+#define CONST_OPCODE_LCONST_0  0x09
+#define CONST_OPCODE_LCONST_1  0x0A
+#define CONST_OPCODE_FCONST_0  0x0B
+#define CONST_OPCODE_FCONST_1  0x0C
+#define CONST_OPCODE_FCONST_2  0x0D
+#define CONST_OPCODE_DCONST_0  0x0E
+#define CONST_OPCODE_DCONST_1  0x0F
+#define CONST_OPCODE_BIPUSH  0x10
+#define CONST_OPCODE_SIPUSH  0x11
+#define CONST_OPCODE_LDC  0x12
+#define CONST_OPCODE_LDC_W  0x13
+#define CONST_OPCODE_LDC2_W  0x14
+#define CONST_OPCODE_ILOAD  0x15
+#define CONST_OPCODE_LLOAD  0x16
+#define CONST_OPCODE_FLOAD  0x17
+#define CONST_OPCODE_DLOAD  0x18
+#define CONST_OPCODE_ALOAD  0x19
+#define CONST_OPCODE_ILOAD_0  0x1A
+#define CONST_OPCODE_ILOAD_1  0x1B
+#define CONST_OPCODE_ILOAD_2  0x1C
+#define CONST_OPCODE_ILOAD_3  0x1D
+#define CONST_OPCODE_LLOAD_0  0x1E
+#define CONST_OPCODE_LLOAD_1  0x1F
+#define CONST_OPCODE_LLOAD_2  0x20
+#define CONST_OPCODE_LLOAD_3  0x21
+#define CONST_OPCODE_FLOAD_0  0x22
+#define CONST_OPCODE_FLOAD_1  0x23
+#define CONST_OPCODE_FLOAD_2  0x24
+#define CONST_OPCODE_FLOAD_3  0x25
+#define CONST_OPCODE_DLOAD_0  0x26
+#define CONST_OPCODE_DLOAD_1  0x27
+#define CONST_OPCODE_DLOAD_2  0x28
+#define CONST_OPCODE_DLOAD_3  0x29
+#define CONST_OPCODE_ALOAD_0  0x2A
+#define CONST_OPCODE_ALOAD_1  0x2B
+#define CONST_OPCODE_ALOAD_2  0x2C
+#define CONST_OPCODE_ALOAD_3  0x2D
+#define CONST_OPCODE_IALOAD  0x2E
+#define CONST_OPCODE_LALOAD  0x2F
+#define CONST_OPCODE_FALOAD  0x30
+#define CONST_OPCODE_DALOAD  0x31
+#define CONST_OPCODE_AALOAD  0x32
+#define CONST_OPCODE_BALOAD  0x33
+#define CONST_OPCODE_CALOAD  0x34
+#define CONST_OPCODE_SALOAD  0x35
+#define CONST_OPCODE_ISTORE  0x36
+#define CONST_OPCODE_LSTORE  0x37
+#define CONST_OPCODE_FSTORE  0x38
+#define CONST_OPCODE_DSTORE  0x39
+#define CONST_OPCODE_ASTORE  0x3A
+#define CONST_OPCODE_ISTORE_0  0x3B
+#define CONST_OPCODE_ISTORE_1  0x3C
+#define CONST_OPCODE_ISTORE_2  0x3D
+#define CONST_OPCODE_ISTORE_3  0x3E
+#define CONST_OPCODE_LSTORE_0  0x3F
+#define CONST_OPCODE_LSTORE_1  0x40
+#define CONST_OPCODE_LSTORE_2  0x41
+#define CONST_OPCODE_LSTORE_3  0x42
+#define CONST_OPCODE_FSTORE_0  0x43
+#define CONST_OPCODE_FSTORE_1  0x44
+#define CONST_OPCODE_FSTORE_2  0x45
+#define CONST_OPCODE_FSTORE_3  0x46
+#define CONST_OPCODE_DSTORE_0  0x47
+#define CONST_OPCODE_DSTORE_1  0x48
+#define CONST_OPCODE_DSTORE_2  0x49
+#define CONST_OPCODE_DSTORE_3  0x4A
+#define CONST_OPCODE_ASTORE_0  0x4B
+#define CONST_OPCODE_ASTORE_1  0x4C
+#define CONST_OPCODE_ASTORE_2  0x4D
+#define CONST_OPCODE_ASTORE_3  0x4E
+#define CONST_OPCODE_IASTORE  0x4F
+#define CONST_OPCODE_LASTORE  0x50
+#define CONST_OPCODE_FASTORE  0x51
+#define CONST_OPCODE_DASTORE  0x52
+#define CONST_OPCODE_AASTORE  0x53
+#define CONST_OPCODE_BASTORE  0x54
+#define CONST_OPCODE_CASTORE  0x55
+#define CONST_OPCODE_SASTORE  0x56
+#define CONST_OPCODE_POP  0x57
+#define CONST_OPCODE_POP2  0x58
+#define CONST_OPCODE_DUP  0x59
+#define CONST_OPCODE_DUP_X1  0x5A
+#define CONST_OPCODE_DUP_X2  0x5B
+#define CONST_OPCODE_DUP2  0x5C
+#define CONST_OPCODE_DUP2_X1  0x5D
+#define CONST_OPCODE_DUP2_X2  0x5E
+#define CONST_OPCODE_SWAP  0x5F
+#define CONST_OPCODE_IADD  0x60
+#define CONST_OPCODE_LADD  0x61
+#define CONST_OPCODE_FADD  0x62
+#define CONST_OPCODE_DADD  0x63
+#define CONST_OPCODE_ISUB  0x64
+#define CONST_OPCODE_LSUB  0x65
+#define CONST_OPCODE_FSUB  0x66
+#define CONST_OPCODE_DSUB  0x67
+#define CONST_OPCODE_IMUL  0x68
+#define CONST_OPCODE_LMUL  0x69
+#define CONST_OPCODE_FMUL  0x6A
+#define CONST_OPCODE_DMUL  0x6B
+#define CONST_OPCODE_IDIV  0x6C
+#define CONST_OPCODE_LDIV  0x6D
+#define CONST_OPCODE_FDIV  0x6E
+#define CONST_OPCODE_DDIV  0x6F
+#define CONST_OPCODE_IREM  0x70
+#define CONST_OPCODE_LREM  0x71
+#define CONST_OPCODE_FREM  0x72
+#define CONST_OPCODE_DREM  0x73
+#define CONST_OPCODE_INEG  0x74
+#define CONST_OPCODE_LNEG  0x75
+#define CONST_OPCODE_FNEG  0x76
+#define CONST_OPCODE_DNEG  0x77
+#define CONST_OPCODE_ISHL  0x78
+#define CONST_OPCODE_LSHL  0x79
+#define CONST_OPCODE_ISHR  0x7A
+#define CONST_OPCODE_LSHR  0x7B
+#define CONST_OPCODE_IUSHR  0x7C
+#define CONST_OPCODE_LUSHR  0x7D
+#define CONST_OPCODE_IAND  0x7E
+#define CONST_OPCODE_LAND  0x7F
+#define CONST_OPCODE_IOR  0x80
+#define CONST_OPCODE_LOR  0x81
+#define CONST_OPCODE_IXOR  0x82
+#define CONST_OPCODE_LXOR  0x83
+#define CONST_OPCODE_IINC  0x84
+#define CONST_OPCODE_I2L  0x85
+#define CONST_OPCODE_I2F  0x86
+#define CONST_OPCODE_I2D  0x87
+#define CONST_OPCODE_L2I  0x88
+#define CONST_OPCODE_L2F  0x89
+#define CONST_OPCODE_L2D  0x8A
+#define CONST_OPCODE_F2I  0x8B
+#define CONST_OPCODE_F2L  0x8C
+#define CONST_OPCODE_F2D  0x8D
+#define CONST_OPCODE_D2I  0x8E
+#define CONST_OPCODE_D2L  0x8F
+#define CONST_OPCODE_D2F  0x90
+#define CONST_OPCODE_I2B  0x91
+#define CONST_OPCODE_I2C  0x92
+#define CONST_OPCODE_I2S  0x93
+#define CONST_OPCODE_LCMP  0x94
+#define CONST_OPCODE_FCMPL  0x95
+#define CONST_OPCODE_FCMPG  0x96
+#define CONST_OPCODE_DCMPL  0x97
+#define CONST_OPCODE_DCMPG  0x98
+#define CONST_OPCODE_IFEQ  0x99
+#define CONST_OPCODE_IFNE  0x9A
+#define CONST_OPCODE_IFLT  0x9B
+#define CONST_OPCODE_IFGE  0x9C
+#define CONST_OPCODE_IFGT  0x9D
+#define CONST_OPCODE_IFLE  0x9E
+#define CONST_OPCODE_IF_ICMPEQ  0x9F
+#define CONST_OPCODE_IF_ICMPNE  0xA0
+#define CONST_OPCODE_IF_ICMPLT  0xA1
+#define CONST_OPCODE_IF_ICMPGE  0xA2
+#define CONST_OPCODE_IF_ICMPGT  0xA3
+#define CONST_OPCODE_IF_ICMPLE  0xA4
+#define CONST_OPCODE_IF_ACMPEQ  0xA5
+#define CONST_OPCODE_IF_ACMPNE  0xA6
+#define CONST_OPCODE_GOTO  0xA7
+#define CONST_OPCODE_JSR  0xA8
+#define CONST_OPCODE_RET  0xA9
+#define CONST_OPCODE_TABLESWITCH  0xAA
+#define CONST_OPCODE_LOOKUPSWITCH  0xAB
+#define CONST_OPCODE_IRETURN  0xAC
+#define CONST_OPCODE_LRETURN  0xAD
+#define CONST_OPCODE_FRETURN  0xAE
+#define CONST_OPCODE_DRETURN  0xAF
+#define CONST_OPCODE_ARETURN  0xB0
+#define CONST_OPCODE_RETURN  0xB1
+#define CONST_OPCODE_GETSTATIC  0xB2
+#define CONST_OPCODE_PUTSTATIC  0xB3
+#define CONST_OPCODE_GETFIELD  0xB4
+#define CONST_OPCODE_PUTFIELD  0xB5
+#define CONST_OPCODE_INVOKEVIRTUAL  0xB6
+#define CONST_OPCODE_INVOKESPECIAL  0xB7
+#define CONST_OPCODE_INVOKESTATIC  0xB8
+#define CONST_OPCODE_INVOKEINTERFACE  0xB9
+#define CONST_OPCODE_INVOKEDYNAMIC  0xBA
+#define CONST_OPCODE_NEW  0xBB
+#define CONST_OPCODE_NEWARRAY  0xBC
+#define CONST_OPCODE_ANEWARRAY  0xBD
+#define CONST_OPCODE_ARRAYLENGTH  0xBE
+#define CONST_OPCODE_ATHROW  0xBF
+#define CONST_OPCODE_CHECKCAST  0xC0
+#define CONST_OPCODE_INSTANCEOF  0xC1
+#define CONST_OPCODE_MONITORENTER  0xC2
+#define CONST_OPCODE_MONITOREXIT  0xC3
+#define CONST_OPCODE_WIDE  0xC4
+#define CONST_OPCODE_MULTIANEWARRAY  0xC5
+#define CONST_OPCODE_IFNULL  0xC6
+#define CONST_OPCODE_IFNONNULL  0xC7
+#define CONST_OPCODE_GOTO_W  0xC8
+#define CONST_OPCODE_JSR_W  0xC9
+#define CONST_OPCODE_BREAKPOINT  0xCA
+#define CONST_OPCODE_IMPDEP1  0xFE
+#define CONST_OPCODE_IMPDEP2  0xFF
+
+// Internal opcodes, in the range class files never use: the VM rewrites its
+// copy of a method's code to them, see boundscheck.h. Unchecked array
+// accesses keep the order of their JVMS counterparts.
+#define CONST_OPCODE_IALOAD_UNCHECKED  0xCB
+#define CONST_OPCODE_SALOAD_UNCHECKED  0xD2
+#define CONST_OPCODE_IASTORE_UNCHECKED  0xD3
+#define CONST_OPCODE_SASTORE_UNCHECKED  0xDA
+#define CONST_OPCODE_GOTO_GUARDED  0xDB
+
+#define OPCODE_UNCHECKED_LOAD(opcode) (CONST_OPCODE_IALOAD_UNCHECKED+((opcode)-CONST_OPCODE_IALOAD))
+#define OPCODE_UNCHECKED_STORE(opcode) (CONST_OPCODE_IASTORE_UNCHECKED+((opcode)-CONST_OPCODE_IASTORE))
+
+// bytes of the instruction at pc, -1 when it is malformed or runs past the code
+RUNTIME_OPCODE_EXTERN int64_t Opcode_Length(const uint8_t *code, uint32_t codeLength, uint32_t pc);
+
+#endif
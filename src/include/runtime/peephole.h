@@ -0,0 +1,31 @@
+#ifndef H_RUNTIME_PEEPHOLE
+#define H_RUNTIME_PEEPHOLE 1
+
+#include <stdint.h>
+#include "classfile/classfile.h"
+
+#ifdef INCLUDE_RUNTIME_PEEPHOLE_SELF
+#define RUNTIME_PEEPHOLE_EXTERN
+#else
+#define RUNTIME_PEEPHOLE_EXTERN extern
+#endif
+
+// Load-time rewrites of the class file code, run when the VM is built
+// with JVM_PEEPHOLE:
+//
+//   iconst 2; iconst 3; iadd  ->  iconst 5   (int arithmetic and narrowing)
+//   ldc 7                     ->  bipush 7   (int constants in their shortest form)
+//   dup; pop                  ->
+//   goto L; L:                ->
+//   ifeq L; ... L: goto M     ->  ifeq M
+//
+// Nothing is combined across an instruction a branch or a handler enters.
+// The code shrinks, so exception table, LineNumberTable and
+// LocalVariable(Type)Table pcs are moved along; a removed instruction
+// stands for the next one kept. StackMapTable is not read by the VM and
+// is left stale.
+
+// leaves the code as it is when it is malformed or uses jsr/ret
+RUNTIME_PEEPHOLE_EXTERN void Peephole_Optimize(ClassFile *classfile, Attribute_Code *code);
+
+#endif
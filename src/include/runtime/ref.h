@@ -0,0 +1,30 @@
+#ifndef H_RUNTIME_REF
+#define H_RUNTIME_REF 1
+
+#include <stdint.h>
+
+// A reference as stored in slots, fields and arrays.
+// With JVM_COMPRESSED_REFS it is a 32-bit offset scaled by the object
+// alignment, zero based: every java object must live below 32G, and a null
+// reference decodes to NULL without a branch.
+#ifdef JVM_COMPRESSED_REFS
+
+typedef uint32_t Ref;
+
+#define CONST_REF_SHIFT  3
+#define CONST_REF_HEAP_LIMIT  ((uintptr_t)1<<(32+CONST_REF_SHIFT))
+#define REF_ENCODE(ptr) ((Ref)((uintptr_t)(ptr)>>CONST_REF_SHIFT))
+#define REF_DECODE(ref) ((void*)((uintptr_t)(ref)<<CONST_REF_SHIFT))
+#define REF_ENCODABLE(ptr, size) ((uintptr_t)(ptr)+(size)<=CONST_REF_HEAP_LIMIT)
+
+#else
+
+typedef void* Ref;
+
+#define REF_ENCODE(ptr) ((Ref)(ptr))
+#define REF_DECODE(ref) ((void*)(ref))
+#define REF_ENCODABLE(ptr, size) 1
+
+#endif
+
+#endif
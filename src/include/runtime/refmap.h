@@ -0,0 +1,33 @@
+#ifndef H_RUNTIME_REFMAP
+#define H_RUNTIME_REFMAP 1
+
+#include <stdint.h>
+#include "runtime/method.h"
+
+#ifdef INCLUDE_RUNTIME_REFMAP_SELF
+#define RUNTIME_REFMAP_EXTERN
+#else
+#define RUNTIME_REFMAP_EXTERN extern
+#endif
+
+#define CONST_REFMAP_NONE  0xFFFFFFFF
+
+// Reference slots of a frame right before the instruction at each pc: one
+// bit per local that holds a live reference, then one per operand stack
+// slot that holds a reference. Consecutive instructions with the same
+// slots share an entry.
+struct _RefMap{
+    uint16_t maxLocals;
+    uint16_t maxStack;
+    uint16_t words; // per entry
+    uint32_t *entries; // by pc, CONST_REFMAP_NONE unless an instruction starts there
+    uint16_t *depths; // operand stack depth, by entry
+    uint32_t *bits; // by entry
+};
+
+#define REFMAP_TEST(bits, slot) ((bits)[(slot)>>5] & ((uint32_t)1<<((slot)&31)))
+
+// dataflow over the code, NULL if it uses jsr/ret or does not verify
+RUNTIME_REFMAP_EXTERN RefMap* RefMap_Compute(Method *method);
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef H_RUNTIME_SAFEPOINT
+#define H_RUNTIME_SAFEPOINT 1
+
+#include <stdint.h>
+#include <setjmp.h>
+#include "runtime/thread.h"
+
+#ifdef INCLUDE_RUNTIME_SAFEPOINT_SELF
+#define RUNTIME_SAFEPOINT_EXTERN
+#else
+#define RUNTIME_SAFEPOINT_EXTERN extern
+#endif
+
+// Bytecode polls with a single load from a page the VM makes unreadable to
+// stop the world; the fault handler parks the thread until the operation
+// ends. Threads in native code (or asleep in the VM) are already safe, they
+// check for a pending safepoint on their way back.
+
+// readable unless a safepoint is requested
+RUNTIME_SAFEPOINT_EXTERN volatile uint8_t *Safepoint_PollPage;
+RUNTIME_SAFEPOINT_EXTERN int32_t Safepoint_Active;
+// set once every other thread is stopped, until the operation ends
+RUNTIME_SAFEPOINT_EXTERN int32_t Safepoint_Reached;
+
+typedef struct{
+    uint64_t count;
+    uint64_t totalNanos; // time to safepoint, from the request until every thread is stopped
+    uint64_t maxNanos;
+    uint64_t lastNanos;
+} SafepointStats;
+
+RUNTIME_SAFEPOINT_EXTERN int Safepoint_Init(void);
+// stop every other thread, nests with nothing: one operation at a time
+RUNTIME_SAFEPOINT_EXTERN void Safepoint_Begin(void);
+RUNTIME_SAFEPOINT_EXTERN void Safepoint_End(void);
+RUNTIME_SAFEPOINT_EXTERN void Safepoint_Block(Thread *thread);
+RUNTIME_SAFEPOINT_EXTERN void Safepoint_GetStats(SafepointStats *stats);
+
+#define SAFEPOINT_POLL() ((void)*Safepoint_PollPage)
+
+// Registers and stack top of a thread that stops running java code, so that
+// a collector can treat its C stack as ambiguous roots. Has to expand in the
+// function that keeps running on that stack.
+#define SAFEPOINT_SAVE_CONTEXT(thread) do{ \
+    setjmp((thread)->registers); \
+    (thread)->stackTop = __builtin_frame_address(0); \
+}while(0)
+
+// Native sections nest: saved gets the state the thread had, for
+// Safepoint_LeaveNative to put back. A thread already native stays so.
+#define SAFEPOINT_ENTER_NATIVE(thread, saved) do{ \
+    (saved) = CONST_THREAD_STATE_NATIVE; \
+    if(NULL!=(thread)){ \
+        SAFEPOINT_SAVE_CONTEXT(thread); \
+        (saved) = __atomic_exchange_n(&(thread)->state, CONST_THREAD_STATE_NATIVE, __ATOMIC_SEQ_CST); \
+    } \
+}while(0)
+
+// pairs with the store of Safepoint_Active in Safepoint_Begin: either the
+// VM sees this thread running java code, or the thread sees the request
+static inline void Safepoint_LeaveNative(Thread *thread, int32_t saved){
+    if(NULL==thread){
+        return;
+    }
+    __atomic_store_n(&thread->state, saved, __ATOMIC_SEQ_CST);
+    if(CONST_THREAD_STATE_JAVA==saved && __atomic_load_n(&Safepoint_Active, __ATOMIC_SEQ_CST)){
+        Safepoint_Block(thread);
+    }
+}
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef H_RUNTIME_SWITCHTABLE
+#define H_RUNTIME_SWITCHTABLE 1
+
+#include <stdint.h>
+#include "runtime/method.h"
+
+#ifdef INCLUDE_RUNTIME_SWITCHTABLE_SELF
+#define RUNTIME_SWITCHTABLE_EXTERN
+#else
+#define RUNTIME_SWITCHTABLE_EXTERN extern
+#endif
+
+#define CONST_SWITCH_DENSE  0
+#define CONST_SWITCH_SORTED  1
+#define CONST_SWITCH_HASHED  2
+
+// sparse switches with more pairs look for a perfect hash
+#define CONST_SWITCH_HASH_THRESHOLD  16
+
+// A tableswitch or lookupswitch decoded from the code. Dense ones (also a
+// lookupswitch whose keys are close enough) index offsets with key-low,
+// sorted ones binary search keys. Hashed ones find the only candidate key
+// through a perfect hash, the slot hash of the key moved by the
+// displacement of its bucket. Empty hash slots hold the default offset.
+typedef struct{
+    uint32_t pc;
+    uint8_t kind;
+    uint8_t shift;
+    uint8_t bucketShift;
+    int32_t defaultOffset;
+    int32_t low;
+    uint32_t multiplier;
+    uint32_t bucketMultiplier;
+    uint32_t *displacements; // by bucket
+    uint32_t count; // of offsets
+    int32_t *keys; // NULL when dense
+    int32_t *offsets;
+} Switch;
+
+#define SWITCH_HASH_SLOT(s, key) \
+    (((((uint32_t)(key)*(s)->multiplier)>>(s)->shift) \
+        + (s)->displacements[((uint32_t)(key)*(s)->bucketMultiplier)>>(s)->bucketShift]) \
+        & ((uint32_t)0xFFFFFFFF>>(s)->shift))
+
+struct _SwitchTable{
+    uint16_t count;
+    Switch *switches; // sorted by pc
+};
+
+// decodes the switches of the code into method->switches, -1 when one is malformed
+RUNTIME_SWITCHTABLE_EXTERN int SwitchTable_Init(Method *method);
+// branch offset taken by the switch at pc for key
+RUNTIME_SWITCHTABLE_EXTERN int32_t SwitchTable_Offset(SwitchTable *table, uint32_t pc, int32_t key);
+
+#endif
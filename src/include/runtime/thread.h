@@ -7,7 +7,16 @@
 #define RUNTIME_EXTERN extern
 #endif
 
+#include <stdint.h>
+#include <setjmp.h>
 #include "runtime/frame.h"
+#include "runtime/object.h"
+
+// only threads running java code hold up a safepoint
+#define CONST_THREAD_STATE_NEW  0
+#define CONST_THREAD_STATE_JAVA  1
+#define CONST_THREAD_STATE_NATIVE  2
+#define CONST_THREAD_STATE_BLOCKED  3 // stopped at a safepoint
 
 typedef struct{
     unsigned int maxSize;
@@ -15,9 +24,42 @@ typedef struct{
     Frame *_top;
 } Stack;
 
-typedef struct{
+typedef struct _Thread Thread;
+struct _Thread{
+    uint32_t id; // never 0, owner of thin locks
+    // LockSupport permit: 1 available, 0 none, -1 parked on it (futex word)
+    int32_t parkWord;
+    int32_t interrupted;
+    int32_t state;
+    // C stack of a stopped thread, scanned for ambiguous roots
+    void *stackBase;
+    void *stackTop;
+    jmp_buf registers;
     void* pc; // wide enough to hold a returnAddress or a native pointer
     Stack *stack;
-} Thread;
+    Frame *javaBase; // invoker of the innermost Interpreter_Run, exceptions unwind no further
+    Object *exception; // pending, thrown out of the interpreter
+    int32_t aborted; // the VM could not throw, the thread runs no more java code
+    sigjmp_buf *nullTrap; // of the innermost Interpreter_Run, see nullcheck.h
+    Thread *next; // registry of live threads, see Thread_ForEach
+};
+
+RUNTIME_EXTERN Thread* Thread_New(unsigned int stackSize);
+RUNTIME_EXTERN int Thread_PushFrame(Thread *thread, Frame *frame);
+RUNTIME_EXTERN Frame* Thread_PopFrame(Thread *thread);
+RUNTIME_EXTERN Frame* Thread_CurrentFrame(Thread *thread);
+RUNTIME_EXTERN Thread* Thread_Current(void);
+RUNTIME_EXTERN void Thread_SetCurrent(Thread *thread);
+// nanos 0 parks until unparked, spurious returns are allowed as in LockSupport
+RUNTIME_EXTERN void Thread_Park(Thread *thread, int64_t nanos);
+RUNTIME_EXTERN void Thread_Unpark(Thread *thread);
+RUNTIME_EXTERN void Thread_Interrupt(Thread *thread);
+// clears the flag
+RUNTIME_EXTERN int Thread_Interrupted(Thread *thread);
+RUNTIME_EXTERN void Thread_ForEach(void (*fn)(Thread *thread, void *data), void *data);
+RUNTIME_EXTERN Stack* Stack_New(unsigned int stackSize);
+RUNTIME_EXTERN int Stack_Push(Stack *stack, Frame *frame);
+RUNTIME_EXTERN Frame* Stack_Pop(Stack *stack);
+RUNTIME_EXTERN Frame* Stack_Top(Stack *stack);
 
 #endif
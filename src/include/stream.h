@@ -27,4 +27,9 @@ typedef struct{
 
 } StreamWriterOp;
 
+extern Stream* FileReader_New(char* filepath);
+extern Stream* BytecodeReader_New(uint8_t *code, uint64_t code_len, uint64_t pc);
+// points an existing bytecode reader at other code, without allocating
+extern void BytecodeReader_Rebind(Stream *stream, uint8_t *code, uint64_t code_len, uint64_t pc);
+
 #endif
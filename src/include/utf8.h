@@ -0,0 +1,26 @@
+#ifndef INCLUDE_UTF8_H
+#define INCLUDE_UTF8_H 1
+
+#include <stdint.h>
+
+#ifdef INCLUDE_UTF8_H_SELF
+#define UTF8_EXTERN
+#else
+#define UTF8_EXTERN extern
+#endif
+
+// Modified UTF-8 (JVMS 4.4.7): no 0x00 byte, '\0' is C0 80, supplementary
+// characters are a pair of 3 byte surrogates, 4 byte forms never occur.
+// ASCII runs are scanned 16 (SSE2) or 32 (AVX2) bytes per step, the kernel
+// is picked once from the running cpu.
+
+// 0 if well formed, -1 otherwise; length is the java (UTF-16) length and
+// latin1 whether every char fits in one byte
+UTF8_EXTERN int UTF8_Validate(const uint8_t *bytes, uint32_t size, uint32_t *length, uint8_t *latin1);
+// bytes must be valid, return the number of chars written
+UTF8_EXTERN uint32_t UTF8_ToLatin1(const uint8_t *bytes, uint32_t size, uint8_t *out);
+UTF8_EXTERN uint32_t UTF8_ToUTF16(const uint8_t *bytes, uint32_t size, uint16_t *out);
+UTF8_EXTERN int UTF8_EqualsASCII(const uint8_t *bytes, uint32_t size, const char *ascii);
+UTF8_EXTERN char* UTF8_KernelName(void);
+
+#endif
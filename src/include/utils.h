@@ -12,11 +12,11 @@
 #endif
 
 UTIL_EXTERN float ieee754_bin2float(uint32_t value);
-UTIL_EXTERN uint32_t ieee754_float2bin(float value){
+UTIL_EXTERN uint32_t ieee754_float2bin(float value);
 UTIL_EXTERN double ieee754_bin2double(uint64_t value);
-UTIL_EXTERN uint64_t ieee754_double2bin(double value){
-UTIL_EXTERN uint32_t utf8ascii_equals(uint8_t utf8[], uint8_t ascii[]);
-UTIL_EXTERN uint32_t uft8_length(uint8_t utf8[]);
+UTIL_EXTERN uint64_t ieee754_double2bin(double value);
+UTIL_EXTERN uint32_t utf8ascii_equals(uint8_t utf8[], const char ascii[]);
+UTIL_EXTERN uint32_t utf8_length(uint8_t utf8[], uint32_t size);
 UTIL_EXTERN void error(char formatStr[], ...);
 
 #endif
@@ -0,0 +1,352 @@
+#include <stdint.h>
+#include <string.h>
+
+#define INCLUDE_RUNTIME_BOUNDSCHECK_SELF 1
+#include "runtime/boundscheck.h"
+#include "runtime/method.h"
+#include "runtime/class.h"
+#include "runtime/heap.h"
+#include "runtime/opcode.h"
+#include "classfile/classfile.h"
+#include "classfile/op.h"
+#include "utils.h"
+
+#define NO_LOCAL  -1
+
+typedef struct{
+    uint32_t from; // CONST_BOUNDSCHECK_OUTSIDE for exception handlers
+    uint32_t to;
+} Edge;
+
+#define CONST_BOUNDSCHECK_OUTSIDE  0xFFFFFFFF
+
+typedef struct{
+    Method *method;
+    uint8_t *code; // class file code
+    uint32_t codeLength;
+    uint8_t *starts; // by pc, 1 where an instruction starts
+    Edge *edges;
+    uint32_t edgesCount;
+    uint8_t *rewritten; // copy of the code, NULL until a rewrite
+    LoopGuard *guards;
+    uint16_t guardsCount;
+} Analysis;
+
+// slots taken and left by the instructions allowed in the value of an
+// array store, {0,0} for the others
+typedef struct{
+    int8_t pop;
+    int8_t push;
+} StackEffect;
+
+static const StackEffect effects[256] = {
+    [0x01 ... 0x08] = {0, 1}, [0x09 ... 0x0a] = {0, 2}, [0x0b ... 0x0d] = {0, 1},
+    [0x0e ... 0x0f] = {0, 2}, [0x10 ... 0x13] = {0, 1}, [0x14] = {0, 2},
+    [0x15] = {0, 1}, [0x16] = {0, 2}, [0x17] = {0, 1}, [0x18] = {0, 2}, [0x19] = {0, 1},
+    [0x1a ... 0x1d] = {0, 1}, [0x1e ... 0x21] = {0, 2}, [0x22 ... 0x25] = {0, 1},
+    [0x26 ... 0x29] = {0, 2}, [0x2a ... 0x2d] = {0, 1},
+    [0x2e] = {2, 1}, [0x2f] = {2, 2}, [0x30] = {2, 1}, [0x31] = {2, 2}, [0x32 ... 0x35] = {2, 1},
+    [0x59] = {1, 2},
+    // add, sub, mul, div, rem in the order int, long, float, double
+    [0x60] = {2, 1}, [0x61] = {4, 2}, [0x62] = {2, 1}, [0x63] = {4, 2},
+    [0x64] = {2, 1}, [0x65] = {4, 2}, [0x66] = {2, 1}, [0x67] = {4, 2},
+    [0x68] = {2, 1}, [0x69] = {4, 2}, [0x6a] = {2, 1}, [0x6b] = {4, 2},
+    [0x6c] = {2, 1}, [0x6d] = {4, 2}, [0x6e] = {2, 1}, [0x6f] = {4, 2},
+    [0x70] = {2, 1}, [0x71] = {4, 2}, [0x72] = {2, 1}, [0x73] = {4, 2},
+    [0x74] = {1, 1}, [0x75] = {2, 2}, [0x76] = {1, 1}, [0x77] = {2, 2},
+    [0x78] = {2, 1}, [0x79] = {3, 2}, [0x7a] = {2, 1}, [0x7b] = {3, 2}, [0x7c] = {2, 1}, [0x7d] = {3, 2},
+    [0x7e] = {2, 1}, [0x7f] = {4, 2}, [0x80] = {2, 1}, [0x81] = {4, 2}, [0x82] = {2, 1}, [0x83] = {4, 2},
+    [0x85] = {1, 2}, [0x86] = {1, 1}, [0x87] = {1, 2}, [0x88] = {2, 1}, [0x89] = {2, 1}, [0x8a] = {2, 2},
+    [0x8b] = {1, 1}, [0x8c] = {1, 2}, [0x8d] = {1, 2}, [0x8e] = {2, 1}, [0x8f] = {2, 2}, [0x90] = {2, 1},
+    [0x91 ... 0x93] = {1, 1}, [0x94] = {4, 1}, [0x95 ... 0x96] = {2, 1}, [0x97 ... 0x98] = {4, 1},
+    [0xbe] = {1, 1}
+};
+
+static int16_t readS16(uint8_t *p){
+    return (int16_t)(p[0]<<8 | p[1]);
+}
+
+static int32_t readS32(uint8_t *p){
+    return (int32_t)((uint32_t)p[0]<<24 | (uint32_t)p[1]<<16 | (uint32_t)p[2]<<8 | p[3]);
+}
+
+static void addEdge(Analysis *a, uint32_t from, uint32_t to, uint32_t *capacity){
+    if(a->edgesCount>=*capacity){
+        *capacity = 0==*capacity ? 16 : *capacity*2;
+        Edge *grown = (Edge*)Heap_AllocAtomic(sizeof(Edge)*(*capacity));
+        memcpy(grown, a->edges, sizeof(Edge)*a->edgesCount);
+        Heap_Free(a->edges);
+        a->edges = grown;
+    }
+    a->edges[a->edgesCount].from = from;
+    a->edges[a->edgesCount].to = to;
+    a->edgesCount++;
+}
+
+// Instruction starts and every jump of the code, -1 for malformed code, 1
+// for code this pass leaves alone (subroutines).
+static int scan(Analysis *a){
+    uint32_t capacity = 0;
+    uint32_t pc = 0;
+    int status = 0;
+    while(pc<a->codeLength){
+        int64_t length = Opcode_Length(a->code, a->codeLength, pc);
+        if(0>=length){
+            error("VerifyError. Invalid instruction 0x%02x at %u in %s.", a->code[pc], pc, a->method->name);
+            return -1;
+        }
+        a->starts[pc] = 1;
+        uint8_t *insn = a->code+pc;
+        uint32_t base = (pc+4)&~(uint32_t)3;
+        switch(insn[0]){
+            case CONST_OPCODE_JSR:
+            case CONST_OPCODE_JSR_W:
+            case CONST_OPCODE_RET:
+                status = 1;
+                break;
+            case CONST_OPCODE_IFEQ ... CONST_OPCODE_GOTO:
+            case CONST_OPCODE_IFNULL:
+            case CONST_OPCODE_IFNONNULL:
+                addEdge(a, pc, pc+readS16(insn+1), &capacity);
+                break;
+            case CONST_OPCODE_GOTO_W:
+                addEdge(a, pc, pc+readS32(insn+1), &capacity);
+                break;
+            case CONST_OPCODE_TABLESWITCH:
+                addEdge(a, pc, pc+readS32(a->code+base), &capacity);
+                for(int64_t i=0;i<=(int64_t)readS32(a->code+base+8)-readS32(a->code+base+4);i++){
+                    addEdge(a, pc, pc+readS32(a->code+base+12+4*i), &capacity);
+                }
+                break;
+            case CONST_OPCODE_LOOKUPSWITCH:
+                addEdge(a, pc, pc+readS32(a->code+base), &capacity);
+                for(int32_t i=0;i<readS32(a->code+base+4);i++){
+                    addEdge(a, pc, pc+readS32(a->code+base+12+8*i), &capacity);
+                }
+                break;
+        }
+        pc += (uint32_t)length;
+    }
+    Attribute_Code *code = a->method->codeAttribute;
+    for(int i=0;i<code->exception_table_length;i++){
+        addEdge(a, CONST_BOUNDSCHECK_OUTSIDE, code->exception_table[i].hanfler_pc, &capacity);
+    }
+    return status;
+}
+
+static int isTarget(Analysis *a, uint32_t pc){
+    for(uint32_t i=0;i<a->edgesCount;i++){
+        if(pc==a->edges[i].to){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// local read by an iload or aload (kind is the opcode of the long form)
+static int32_t loadedLocal(uint8_t *insn, uint8_t kind){
+    uint8_t shortForm = CONST_OPCODE_ILOAD==kind ? CONST_OPCODE_ILOAD_0 : CONST_OPCODE_ALOAD_0;
+    if(kind==insn[0]){
+        return insn[1];
+    }
+    if(insn[0]>=shortForm && insn[0]<shortForm+4){
+        return insn[0]-shortForm;
+    }
+    return NO_LOCAL;
+}
+
+// local an instruction writes as an int or a reference
+static int32_t storedLocal(uint8_t *insn){
+    switch(insn[0]){
+        case CONST_OPCODE_ISTORE:
+        case CONST_OPCODE_ASTORE:
+        case CONST_OPCODE_IINC:
+            return insn[1];
+        case CONST_OPCODE_ISTORE_0 ... CONST_OPCODE_ISTORE_3:
+            return insn[0]-CONST_OPCODE_ISTORE_0;
+        case CONST_OPCODE_ASTORE_0 ... CONST_OPCODE_ASTORE_3:
+            return insn[0]-CONST_OPCODE_ASTORE_0;
+        case CONST_OPCODE_WIDE:
+            if(CONST_OPCODE_ISTORE==insn[1] || CONST_OPCODE_ASTORE==insn[1] || CONST_OPCODE_IINC==insn[1]){
+                return insn[2]<<8 | insn[3];
+            }
+            return NO_LOCAL;
+        default:
+            return NO_LOCAL;
+    }
+}
+
+static uint8_t* rewrite(Analysis *a, uint32_t pc){
+    if(NULL==a->rewritten){
+        a->rewritten = (uint8_t*)Heap_AllocPermanentAtomic(a->codeLength);
+        memcpy(a->rewritten, a->code, a->codeLength);
+    }
+    return a->rewritten+pc;
+}
+
+// slots of the field a getfield or getstatic pushes
+static int fieldSlots(Analysis *a, uint16_t index){
+    void **constantPool = a->method->class->classfile->constant_pool;
+    Constant_FieldRefInfo *info = (Constant_FieldRefInfo*)constantPool[index];
+    Constant_NameAndTypeInfo *nameAndType = (Constant_NameAndTypeInfo*)constantPool[info->name_and_type_index];
+    uint8_t type = CLZFILE_cp_getUTF8(constantPool, nameAndType->descriptor_index)[0];
+    return 'J'==type || 'D'==type ? 2 : 1;
+}
+
+// Follows the straight line code computing the value stored into a[i]:
+// the pc of the store when it is found, 0 otherwise.
+static uint32_t findStore(Analysis *a, uint32_t pc, uint32_t end){
+    int depth = 0;
+    while(pc<end && !isTarget(a, pc)){
+        uint8_t *insn = a->code+pc;
+        if(insn[0]>=CONST_OPCODE_IASTORE && insn[0]<=CONST_OPCODE_SASTORE){
+            int value = CONST_OPCODE_LASTORE==insn[0] || CONST_OPCODE_DASTORE==insn[0] ? 2 : 1;
+            return value==depth ? pc : 0;
+        }
+        StackEffect effect = effects[insn[0]];
+        if(CONST_OPCODE_GETFIELD==insn[0] || CONST_OPCODE_GETSTATIC==insn[0]){
+            effect.pop = CONST_OPCODE_GETFIELD==insn[0] ? 1 : 0;
+            effect.push = fieldSlots(a, (uint16_t)(insn[1]<<8 | insn[2]));
+        }
+        if(0==effect.push || depth<effect.pop){
+            return 0;
+        }
+        depth += effect.push-effect.pop;
+        pc += (uint32_t)Opcode_Length(a->code, a->codeLength, pc);
+    }
+    return 0;
+}
+
+// a[i] accesses of the body, up to the iinc
+static void rewriteAccesses(Analysis *a, uint32_t body, uint32_t end, int32_t index, int32_t array){
+    uint32_t pc = body;
+    while(pc<end){
+        uint32_t length = (uint32_t)Opcode_Length(a->code, a->codeLength, pc);
+        uint32_t next = pc+length;
+        if(array==loadedLocal(a->code+pc, CONST_OPCODE_ALOAD) && next<end
+            && index==loadedLocal(a->code+next, CONST_OPCODE_ILOAD) && !isTarget(a, next)){
+            uint32_t access = next+(uint32_t)Opcode_Length(a->code, a->codeLength, next);
+            uint8_t opcode = a->code[access];
+            if(access<end && !isTarget(a, access) && opcode>=CONST_OPCODE_IALOAD && opcode<=CONST_OPCODE_SALOAD){
+                *rewrite(a, access) = OPCODE_UNCHECKED_LOAD(opcode);
+            }else{
+                uint32_t store = findStore(a, access, end);
+                if(0!=store){
+                    *rewrite(a, store) = OPCODE_UNCHECKED_STORE(a->code[store]);
+                }
+            }
+        }
+        pc = next;
+    }
+}
+
+static void addGuard(Analysis *a, uint32_t pc, uint16_t local){
+    LoopGuard *guards = (LoopGuard*)Heap_AllocPermanentAtomic(sizeof(LoopGuard)*(a->guardsCount+1));
+    if(NULL!=a->guards){
+        memcpy(guards, a->guards, sizeof(LoopGuard)*a->guardsCount);
+        Heap_Free(a->guards);
+    }
+    guards[a->guardsCount].pc = pc;
+    guards[a->guardsCount].local = local;
+    a->guards = guards;
+    a->guardsCount++;
+}
+
+// the load of kind right before *pc, which moves to it
+static int32_t previousLoad(Analysis *a, uint32_t *pc, uint8_t kind){
+    for(uint32_t length=1;length<=2 && length<=*pc;length++){
+        uint32_t at = *pc-length;
+        if(a->starts[at] && length==Opcode_Length(a->code, a->codeLength, at)){
+            int32_t local = loadedLocal(a->code+at, kind);
+            if(NO_LOCAL!=local){
+                *pc = at;
+            }
+            return local;
+        }
+    }
+    return NO_LOCAL;
+}
+
+// the loop test is the if_icmplt at pc, its body starts at body
+static void tryLoop(Analysis *a, uint32_t pc, uint32_t body){
+    // iload i; aload a; arraylength right before the test, iinc i 1 right before those
+    uint32_t cond = pc-1;
+    if(body<3 || body>=pc || !a->starts[cond] || CONST_OPCODE_ARRAYLENGTH!=a->code[cond]){
+        return;
+    }
+    int32_t array = previousLoad(a, &cond, CONST_OPCODE_ALOAD);
+    int32_t index = NO_LOCAL==array ? NO_LOCAL : previousLoad(a, &cond, CONST_OPCODE_ILOAD);
+    if(NO_LOCAL==index || cond<body+3){
+        return;
+    }
+    uint32_t increment = cond-3;
+    uint32_t entry = body-3;
+    if(!a->starts[increment] || CONST_OPCODE_IINC!=a->code[increment]
+        || index!=a->code[increment+1] || 1!=(int8_t)a->code[increment+2]){
+        return;
+    }
+    if(!a->starts[entry] || CONST_OPCODE_GOTO!=a->code[entry] || cond!=entry+readS16(a->code+entry+1)){
+        return;
+    }
+    uint32_t end = pc+3;
+    // entered only through the goto, never into the middle of the test
+    for(uint32_t i=0;i<a->edgesCount;i++){
+        Edge *edge = &a->edges[i];
+        if(edge->to<body || edge->to>=end){
+            continue;
+        }
+        if(edge->from==entry && edge->to==cond){
+            continue;
+        }
+        if(edge->from<body || edge->from>=end || edge->to>cond){
+            return;
+        }
+    }
+    for(uint32_t at=body;at<end;at+=(uint32_t)Opcode_Length(a->code, a->codeLength, at)){
+        int32_t local = storedLocal(a->code+at);
+        if(at!=increment && (index==local || array==local)){
+            return;
+        }
+    }
+    rewriteAccesses(a, body, increment, index, array);
+    *rewrite(a, entry) = CONST_OPCODE_GOTO_GUARDED;
+    addGuard(a, entry, (uint16_t)index);
+}
+
+uint8_t* BoundsCheck_Eliminate(Method *method){
+    Analysis a;
+    memset(&a, 0, sizeof(Analysis));
+    a.method = method;
+    a.code = method->codeAttribute->code;
+    a.codeLength = method->codeLength;
+    a.starts = (uint8_t*)Heap_AllocAtomic(a.codeLength);
+    memset(a.starts, 0, a.codeLength);
+    int status = scan(&a);
+    if(0==status){
+        for(uint32_t pc=0;pc<a.codeLength;pc+=(uint32_t)Opcode_Length(a.code, a.codeLength, pc)){
+            if(CONST_OPCODE_IF_ICMPLT==a.code[pc] && 0>readS16(a.code+pc+1)){
+                tryLoop(&a, pc, pc+readS16(a.code+pc+1));
+            }
+        }
+    }
+    Heap_Free(a.starts);
+    Heap_Free(a.edges);
+    if(0>status){
+        return NULL;
+    }
+    if(NULL==a.rewritten){
+        return a.code;
+    }
+    method->loopGuardsCount = a.guardsCount;
+    method->loopGuards = a.guards;
+    return a.rewritten;
+}
+
+uint16_t BoundsCheck_GuardLocal(Method *method, uint32_t pc){
+    for(uint16_t i=0;i<method->loopGuardsCount;i++){
+        if(pc==method->loopGuards[i].pc){
+            return method->loopGuards[i].local;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,428 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define INCLUDE_RUNTIME_CALLSITE_SELF 1
+#include "runtime/callsite.h"
+#include "runtime/class.h"
+#include "runtime/classinit.h"
+#include "runtime/frame.h"
+#include "runtime/thread.h"
+#include "runtime/object.h"
+#include "runtime/heap.h"
+#include "runtime/exception.h"
+#include "runtime/monitor.h"
+#include "runtime/descriptor.h"
+#include "runtime/opcode.h"
+#include "classfile/classfile.h"
+#include "classfile/op.h"
+#include "utils.h"
+
+// numbers the lambda classes, like the names HotSpot gives them
+static uint32_t lambdaCount = 0;
+
+static BootstrapMethod* findBootstrap(ClassFile *classfile, uint16_t index){
+    for(int i=0;i<classfile->attributes_count;i++){
+        Attribute_BootstrapMethods *attribute = (Attribute_BootstrapMethods*)classfile->attributes[i];
+        if(utf8ascii_equals(CLZFILE_cp_getUTF8(classfile->constant_pool, attribute->attribute_name_index), "BootstrapMethods")){
+            return index<attribute->bootstrap_methods_count ? &attribute->bootstrap_methods[index] : NULL;
+        }
+    }
+    return NULL;
+}
+
+static int isMetafactory(void **constantPool, BootstrapMethod *bootstrap){
+    Constant_MethodHandleInfo *handle = (Constant_MethodHandleInfo*)constantPool[bootstrap->bootstrap_method_ref];
+    if(CONST_REF_INVOKE_STATIC!=handle->reference_kind){
+        return 0;
+    }
+    Constant_MethodRefInfo *ref = (Constant_MethodRefInfo*)constantPool[handle->reference_index];
+    Constant_ClassInfo *owner = (Constant_ClassInfo*)constantPool[ref->class_index];
+    Constant_NameAndTypeInfo *nameAndType = (Constant_NameAndTypeInfo*)constantPool[ref->name_and_type_index];
+    uint8_t *name = CLZFILE_cp_getUTF8(constantPool, nameAndType->name_index);
+    return utf8ascii_equals(CLZFILE_cp_getUTF8(constantPool, owner->name_index), "java/lang/invoke/LambdaMetafactory")
+        && (utf8ascii_equals(name, "metafactory") || utf8ascii_equals(name, "altMetafactory"));
+}
+
+static Descriptor* methodType(void **constantPool, uint16_t index){
+    Constant_MethodTypeInfo *info = (Constant_MethodTypeInfo*)constantPool[index];
+    if(CONST_CONSTANTPOOLINFO_TAG_METHOD_TYPE!=info->tag){
+        return NULL;
+    }
+    return Descriptor_Get(CLZFILE_cp_getUTF8(constantPool, info->descriptor_index));
+}
+
+// the class named by the reference return type of descriptor, NULL if not loaded
+static Class* returnClass(Descriptor *descriptor){
+    uint8_t *start = (uint8_t*)strchr((char*)descriptor->descriptor, ')')+1;
+    if('L'!=*start){
+        return NULL;
+    }
+    size_t length = strlen((char*)start)-2;
+    uint8_t *name = (uint8_t*)Heap_AllocAtomic(length+1);
+    memcpy(name, start+1, length);
+    name[length] = 0;
+    Class *class = Class_Find(name);
+    Heap_Free(name);
+    return class;
+}
+
+// sub-int types share the int slot, no other conversion is adapted
+static uint8_t slotKind(uint8_t type){
+    switch(type){
+        case 'Z': case 'B': case 'C': case 'S':
+            return 'I';
+        default:
+            return type;
+    }
+}
+
+// The captured values and the interface method arguments must line up
+// with the parameters of the implementation method, this included. A void
+// interface method takes any implementation, forward drops its result.
+static int isDirect(Descriptor *captured, Descriptor *sam, uint8_t kind, Method *target){
+    int isStatic = 0!=(target->accessFlags & CONST_METHOD_ACCESS_STATIC);
+    if((CONST_REF_INVOKE_STATIC==kind)!=isStatic){
+        return 0;
+    }
+    Descriptor *impl = target->parsedDescriptor;
+    int receiver = !isStatic && CONST_REF_NEW_INVOKE_SPECIAL!=kind;
+    if(captured->argsCount+sam->argsCount!=impl->argsCount+receiver){
+        return 0;
+    }
+    for(int i=0;i<captured->argsCount+sam->argsCount;i++){
+        uint8_t type = i<captured->argsCount ? captured->argTypes[i] : sam->argTypes[i-captured->argsCount];
+        uint8_t param = receiver && 0==i ? 'L' : impl->argTypes[i-receiver];
+        if(slotKind(type)!=slotKind(param)){
+            return 0;
+        }
+    }
+    if('V'==sam->returnType){
+        return 1;
+    }
+    if(CONST_REF_NEW_INVOKE_SPECIAL==kind){
+        return 'L'==sam->returnType;
+    }
+    return slotKind(sam->returnType)==slotKind(impl->returnType);
+}
+
+static void loadCaptured(Object *lambda, CallSite *site, ValueSlot *slots){
+    Descriptor *captured = site->captured;
+    for(int i=0;i<captured->argsCount;i++){
+        uint8_t *address = (uint8_t*)lambda + site->capturedOffsets[i];
+        switch(captured->argTypes[i]){
+            case 'J':
+            case 'D':
+                SLOT_SET_LONG(slots, *(int64_t*)address);
+                slots += 2;
+                break;
+            case 'L':
+                (slots++)->ref = *(Ref*)address;
+                break;
+            default:
+                (slots++)->num = *(int32_t*)address;
+                break;
+        }
+    }
+}
+
+// The result of an implementation behind a void interface method is
+// returned into a frame running this, which hands nothing on.
+static uint8_t dropResultCode[] = {CONST_OPCODE_RETURN};
+
+static Frame* newDropResultFrame(void){
+    Frame *frame = Frame_New(0, 2);
+    frame->code = dropResultCode;
+    frame->codeLength = sizeof(dropResultCode);
+    return frame;
+}
+
+// Runs for the interface method of a lambda class in the frame of its
+// invoker. The invoking instruction names that method, its slots locate
+// the lambda below the arguments.
+static void forward(Frame *frame){
+    uint16_t index = (uint16_t)(frame->code[frame->pc+1]<<8 | frame->code[frame->pc+2]);
+    Method *invoked = Class_ResolveMethod(frame->class, index);
+    int voidResult = 'V'==invoked->parsedDescriptor->returnType;
+    OperandStack *stack = frame->operandStack;
+    ValueSlot *args = &stack->data[stack->size-invoked->argSlots];
+    Object *lambda = (Object*)REF_DECODE(args[0].ref);
+    CallSite *site = lambda->header.class->callSite;
+    Method *method = site->target;
+    uint16_t capturedSlots = site->captured->argSlots;
+    if(CONST_REF_INVOKE_VIRTUAL==site->kind || CONST_REF_INVOKE_INTERFACE==site->kind){
+        Object *receiver = (Object*)(0<capturedSlots ? Object_GetRef(lambda, site->capturedOffsets[0]) : REF_DECODE(args[1].ref));
+        if(NULL==receiver){
+            Exception_ThrowVM(frame, CONST_EXCEPTION_NULL_POINTER);
+            return;
+        }
+        Class *class = receiver->header.class;
+        if(NULL!=class && class!=method->class && !(method->accessFlags & (CONST_METHOD_ACCESS_FINAL|CONST_METHOD_ACCESS_PRIVATE))){
+            Method *selected = Class_FindMethod(class, method->name, method->descriptor);
+            if(NULL!=selected){
+                method = selected;
+            }
+        }
+    }
+    // an intrinsic runs on the invoker stack, there is room for one captured value in place of the lambda
+    if(NULL!=method->intrinsic && 1>=capturedSlots){
+        if(0==capturedSlots){
+            memmove(args, args+1, sizeof(ValueSlot)*(invoked->argSlots-1));
+        }else{
+            loadCaptured(lambda, site, args);
+        }
+        stack->size += capturedSlots-1;
+        unsigned int size = stack->size-method->argSlots+method->parsedDescriptor->returnSlots;
+        uint32_t nextPc = frame->nextPc;
+        method->intrinsic(frame);
+        // not once it threw, a handler of the frame has reset its stack
+        if(voidResult && nextPc==frame->nextPc && size==stack->size){
+            stack->size -= method->parsedDescriptor->returnSlots;
+        }
+        return;
+    }
+    if(0==method->codeLength){
+        error("[FIXME] java.lang.UnsatisfiedLinkError: %s.%s%s", method->class->name, method->name, method->descriptor);
+        return;
+    }
+    Object *created = NULL;
+    if(CONST_REF_NEW_INVOKE_SPECIAL==site->kind){
+        created = Object_New(method->class);
+        if(NULL==created){
+            Exception_ThrowVM(frame, CONST_EXCEPTION_OUT_OF_MEMORY);
+            return;
+        }
+    }
+    Frame *callee = Frame_NewMethod(method);
+    ValueSlot *locals = callee->localVars;
+    if(NULL!=created){
+        (locals++)->ref = REF_ENCODE(created);
+    }
+    loadCaptured(lambda, site, locals);
+    memcpy(locals+capturedSlots, args+1, sizeof(ValueSlot)*(invoked->argSlots-1));
+    stack->size -= invoked->argSlots;
+    // the constructor returns nothing, the new object is already the result
+    if(NULL!=created && !voidResult){
+        stack->data[stack->size++].ref = REF_ENCODE(created);
+    }
+    Frame *dropResult = NULL;
+    if(voidResult && 'V'!=method->parsedDescriptor->returnType){
+        dropResult = newDropResultFrame();
+        if(0!=Thread_PushFrame(frame->thread, dropResult)){
+            Exception_ThrowVM(frame, CONST_EXCEPTION_STACK_OVERFLOW);
+            return;
+        }
+    }
+    if(0!=Thread_PushFrame(frame->thread, callee)){
+        if(NULL!=dropResult){
+            Thread_PopFrame(frame->thread);
+        }
+        Exception_ThrowVM(frame, CONST_EXCEPTION_STACK_OVERFLOW);
+    }else if((method->accessFlags & CONST_METHOD_ACCESS_SYNCHRONIZED) && 0!=Monitor_EnterFrame(callee)){
+        Thread_PopFrame(frame->thread);
+        if(NULL!=dropResult){
+            Thread_PopFrame(frame->thread);
+        }
+        Exception_ThrowVM(frame, CONST_EXCEPTION_OUT_OF_MEMORY);
+    }
+}
+
+static void initMethod(Method *method, uint8_t *name, Descriptor *descriptor){
+    method->name = name;
+    method->descriptor = descriptor->descriptor;
+    method->parsedDescriptor = descriptor;
+    method->accessFlags = CONST_METHOD_ACCESS_PUBLIC|CONST_METHOD_ACCESS_FINAL;
+    method->argSlots = descriptor->argSlots+1;
+    method->intrinsic = forward;
+}
+
+// references first, then longs and doubles, then one int per narrower value
+static uint32_t layoutCaptured(Descriptor *captured, uint32_t start, uint32_t *offsets, uint32_t *refOffsets, uint16_t *refsCount){
+    uint32_t size = start;
+    *refsCount = 0;
+    for(int pass=0;pass<3;pass++){
+        for(int i=0;i<captured->argsCount;i++){
+            uint8_t type = captured->argTypes[i];
+            int wide = 'J'==type || 'D'==type;
+            uint32_t fieldSize = 0==pass ? sizeof(Ref) : 1==pass ? 8 : 4;
+            if((0==pass)!=('L'==type) || (1==pass)!=wide){
+                continue;
+            }
+            size = (size+fieldSize-1)&~(fieldSize-1);
+            offsets[i] = size;
+            size += fieldSize;
+            if('L'==type){
+                refOffsets[(*refsCount)++] = offsets[i];
+            }
+        }
+    }
+    return size;
+}
+
+// [FIXME] a shared instance, without the reason or a cause: those only go to the log
+static CallSite* linkFailed(Frame *frame){
+    Exception_ThrowVM(frame, CONST_EXCEPTION_BOOTSTRAP_METHOD);
+    return NULL;
+}
+
+static CallSite* linkMetafactory(Frame *frame, uint16_t index, BootstrapMethod *bootstrap){
+    Class *class = frame->class;
+    void **constantPool = class->classfile->constant_pool;
+    Constant_InvokeDynamicInfo *info = (Constant_InvokeDynamicInfo*)constantPool[index];
+    Constant_NameAndTypeInfo *nameAndType = (Constant_NameAndTypeInfo*)constantPool[info->name_and_type_index];
+    uint8_t *name = CLZFILE_cp_getUTF8(constantPool, nameAndType->name_index);
+    Descriptor *captured = Descriptor_Get(CLZFILE_cp_getUTF8(constantPool, nameAndType->descriptor_index));
+    uint16_t *arguments = bootstrap->arguments;
+    if(NULL==captured || 3>bootstrap->arguments_count){
+        error("[FIXME] java.lang.BootstrapMethodError: malformed lambda call site in %s.", class->name);
+        return linkFailed(frame);
+    }
+    Class *interface = returnClass(captured);
+    Descriptor *sam = methodType(constantPool, arguments[0]);
+    Constant_MethodHandleInfo *handle = (Constant_MethodHandleInfo*)constantPool[arguments[1]];
+    if(NULL==interface || NULL==sam || CONST_CONSTANTPOOLINFO_TAG_METHOD_HANDLE!=handle->tag){
+        error("[FIXME] java.lang.BootstrapMethodError: lambda call site %s%s in %s.", name, captured->descriptor, class->name);
+        return linkFailed(frame);
+    }
+    uint8_t kind = handle->reference_kind;
+    Method *target = Class_ResolveMethod(class, handle->reference_index);
+    if(NULL==target){
+        error("[FIXME] java.lang.NoSuchMethodError");
+        return linkFailed(frame);
+    }
+    if(kind<CONST_REF_INVOKE_VIRTUAL || kind>CONST_REF_INVOKE_INTERFACE || !isDirect(captured, sam, kind, target)){
+        error("[FIXME] java.lang.invoke.LambdaConversionException: %s.%s%s as %s%s, boxing and widening are not adapted.",
+            target->class->name, target->name, target->descriptor, name, sam->descriptor);
+        return linkFailed(frame);
+    }
+    if((CONST_REF_INVOKE_STATIC==kind || CONST_REF_NEW_INVOKE_SPECIAL==kind) && 0!=ClassInit_Barrier(frame, target->class)){
+        return NULL;
+    }
+
+    // altMetafactory: flags, then the counted marker interfaces and bridges
+    uint16_t count = bootstrap->arguments_count;
+    Class **interfaces = (Class**)Heap_AllocAtomic(sizeof(Class*)*count);
+    Descriptor **bridges = (Descriptor**)Heap_AllocAtomic(sizeof(Descriptor*)*count);
+    uint16_t interfacesCount = 0;
+    uint16_t bridgesCount = 0;
+    interfaces[interfacesCount++] = interface;
+    if(3<count){
+        uint32_t flags = ((Constant_IntegerInfo*)constantPool[arguments[3]])->value;
+        uint16_t next = 4;
+        if((flags & CONST_LAMBDA_FLAG_MARKERS) && next<count){
+            uint32_t markers = ((Constant_IntegerInfo*)constantPool[arguments[next++]])->value;
+            for(uint32_t i=0;i<markers && next<count;i++){
+                Class *marker = Class_ResolveClass(class, arguments[next++]);
+                if(NULL!=marker){
+                    interfaces[interfacesCount++] = marker;
+                }
+            }
+        }
+        if((flags & CONST_LAMBDA_FLAG_BRIDGES) && next<count){
+            uint32_t bridgeTypes = ((Constant_IntegerInfo*)constantPool[arguments[next++]])->value;
+            for(uint32_t i=0;i<bridgeTypes && next<count;i++){
+                Descriptor *bridge = methodType(constantPool, arguments[next++]);
+                // erased shapes of the same method, they only differ in reference types
+                if(NULL!=bridge && sam!=bridge && sam->argSlots==bridge->argSlots){
+                    bridges[bridgesCount++] = bridge;
+                }
+            }
+        }
+    }
+
+    CallSite *site = (CallSite*)Heap_AllocPermanent(sizeof(CallSite));
+    site->captured = captured;
+    site->kind = kind;
+    site->target = target;
+    site->capturedOffsets = (uint32_t*)Heap_AllocPermanentAtomic(sizeof(uint32_t)*(0==captured->argsCount ? 1 : captured->argsCount));
+    uint32_t *refOffsets = (uint32_t*)Heap_AllocAtomic(sizeof(uint32_t)*(captured->argsCount+1));
+    uint16_t refsCount;
+    Class *super = Class_Find((uint8_t*)"java/lang/Object");
+    uint32_t instanceSize = layoutCaptured(captured, NULL==super ? sizeof(ObjectHeader) : super->instanceSize,
+        site->capturedOffsets, refOffsets, &refsCount);
+    Method *methods = (Method*)Heap_AllocPermanent(sizeof(Method)*(1+bridgesCount));
+    initMethod(&methods[0], name, sam);
+    for(int i=0;i<bridgesCount;i++){
+        initMethod(&methods[1+i], name, bridges[i]);
+    }
+    size_t nameSize = strlen((char*)class->name)+20;
+    uint8_t *lambdaName = (uint8_t*)Heap_AllocPermanentAtomic(nameSize);
+    snprintf((char*)lambdaName, nameSize, "%s$$Lambda$%u", class->name, __atomic_add_fetch(&lambdaCount, 1, __ATOMIC_RELAXED));
+    site->lambdaClass = Class_NewProxy(lambdaName, super, interfaces, interfacesCount,
+        instanceSize, refsCount, refOffsets, methods, (uint16_t)(1+bridgesCount));
+    site->lambdaClass->callSite = site;
+    Heap_Free(refOffsets);
+    Heap_Free(bridges);
+    Heap_Free(interfaces);
+    if(0==captured->argsCount){
+        // never moved, so it is held by the permanent site
+        site->instance = Object_NewOld(site->lambdaClass);
+        if(NULL==site->instance){
+            Exception_ThrowVM(frame, CONST_EXCEPTION_OUT_OF_MEMORY);
+            return NULL;
+        }
+    }
+    return site;
+}
+
+// racing threads may both link it, the first site stored wins
+CallSite* CallSite_Link(Frame *frame, uint16_t index){
+    Class *class = frame->class;
+    CallSite *site = (CallSite*)__atomic_load_n(&class->resolved[index], __ATOMIC_ACQUIRE);
+    if(NULL!=site){
+        return site;
+    }
+    ClassFile *classfile = class->classfile;
+    Constant_InvokeDynamicInfo *info = (Constant_InvokeDynamicInfo*)classfile->constant_pool[index];
+    BootstrapMethod *bootstrap = findBootstrap(classfile, info->bootstrap_method_attr_index);
+    if(NULL==bootstrap){
+        error("ClassFormatError. No bootstrap method %u in %s.", info->bootstrap_method_attr_index, class->name);
+        return linkFailed(frame);
+    }
+    // [FIXME] other bootstraps need java.lang.invoke, StringConcatFactory among them
+    if(!isMetafactory(classfile->constant_pool, bootstrap)){
+        error("[FIXME] java.lang.BootstrapMethodError: only LambdaMetafactory call sites are linked, in %s.", class->name);
+        return linkFailed(frame);
+    }
+    site = linkMetafactory(frame, index, bootstrap);
+    if(NULL==site){
+        return NULL;
+    }
+    void *expected = NULL;
+    if(!__atomic_compare_exchange_n(&class->resolved[index], &expected, site, 0, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)){
+        site = (CallSite*)expected;
+    }
+    return site;
+}
+
+void CallSite_Capture(Frame *frame, CallSite *site){
+    // allocated while the captured values are still roots on the operand stack
+    Object *lambda = Object_New(site->lambdaClass);
+    if(NULL==lambda){
+        Exception_ThrowVM(frame, CONST_EXCEPTION_OUT_OF_MEMORY);
+        return;
+    }
+    Descriptor *captured = site->captured;
+    OperandStack *stack = frame->operandStack;
+    stack->size -= captured->argSlots;
+    ValueSlot *values = &stack->data[stack->size];
+    for(int i=0;i<captured->argsCount;i++){
+        uint8_t *address = (uint8_t*)lambda + site->capturedOffsets[i];
+        switch(captured->argTypes[i]){
+            case 'J':
+            case 'D':
+                *(int64_t*)address = SLOT_GET_LONG(values);
+                values += 2;
+                break;
+            case 'L':
+                Object_PutRef(lambda, site->capturedOffsets[i], REF_DECODE(values->ref));
+                values++;
+                break;
+            default:
+                *(int32_t*)address = values->num;
+                values++;
+                break;
+        }
+    }
+    stack->data[stack->size++].ref = REF_ENCODE(lambda);
+}
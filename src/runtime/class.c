@@ -0,0 +1,515 @@
+#include <stdint.h>
+#include <string.h>
+#include "gc_typed.h"
+
+#define INCLUDE_RUNTIME_CLASS_SELF 1
+#include "runtime/class.h"
+#include "runtime/object.h"
+#include "runtime/heap.h"
+#include "runtime/memberindex.h"
+#include "classfile/classfile.h"
+#include "classfile/op.h"
+#include "utils.h"
+
+// field sizes in layout order, 0 stands for references
+static const uint32_t layoutPasses[] = {0, 8, 4, 2, 1};
+
+// push-only and lock-free, collectors walk it while the world is stopped
+static Class *classes = NULL;
+
+static uint32_t alignUp(uint32_t offset, uint32_t align){
+    return (offset+align-1)&~(align-1);
+}
+
+static int isRefDescriptor(uint8_t *descriptor){
+    return descriptor[0]=='L' || descriptor[0]=='[';
+}
+
+uint32_t Class_FieldSize(uint8_t *descriptor){
+    switch(descriptor[0]){
+        case 'L':
+        case '[':
+            return sizeof(Ref);
+        case 'J':
+        case 'D':
+            return 8;
+        case 'I':
+        case 'F':
+            return 4;
+        case 'S':
+        case 'C':
+            return 2;
+        case 'B':
+        case 'Z':
+            return 1;
+        default:
+            error("Invalid field descriptor: %s.", descriptor);
+            return 0;
+    }
+}
+
+static int layoutFields(Class *class){
+    ClassFile *classfile = class->classfile;
+    uint32_t size = sizeof(ObjectHeader);
+    uint32_t staticSize = 0;
+    uint16_t refs = 0;
+    uint16_t staticRefs = 0;
+    if(NULL!=class->super){
+        size = class->super->instanceSize;
+        refs = class->super->refFieldsCount;
+    }
+    class->fieldOffsets = (uint32_t*)Heap_AllocAtomic(sizeof(uint32_t)*classfile->fields_count);
+
+    // references first so that they stay word aligned, then primitives by decreasing size
+    for(size_t p=0;p<sizeof(layoutPasses)/sizeof(layoutPasses[0]);p++){
+        for(int i=0;i<classfile->fields_count;i++){
+            FieldInfo *field = &classfile->fields[i];
+            uint8_t *descriptor = CLZFILE_cp_getUTF8(classfile->constant_pool, field->descriptor_index);
+            uint32_t fieldSize = Class_FieldSize(descriptor);
+            int isRef = isRefDescriptor(descriptor);
+            if(0==fieldSize){
+                return -1;
+            }
+            if((0==layoutPasses[p])!=isRef || (!isRef && fieldSize!=layoutPasses[p])){
+                continue;
+            }
+            if(field->access_flags & CONST_FIELD_ACCESS_STATIC){
+                staticSize = alignUp(staticSize, fieldSize);
+                class->fieldOffsets[i] = staticSize;
+                staticSize += fieldSize;
+                staticRefs += isRef;
+            }else{
+                size = alignUp(size, fieldSize);
+                class->fieldOffsets[i] = size;
+                size += fieldSize;
+                refs += isRef;
+            }
+        }
+    }
+    class->instanceSize = alignUp(size, sizeof(GC_word));
+    class->refFieldsCount = refs;
+
+    class->refOffsets = (uint32_t*)Heap_AllocAtomic(sizeof(uint32_t)*refs);
+    int n = 0;
+    if(NULL!=class->super){
+        memcpy(class->refOffsets, class->super->refOffsets, sizeof(uint32_t)*class->super->refFieldsCount);
+        n = class->super->refFieldsCount;
+    }
+    class->staticRefFieldsCount = staticRefs;
+    class->staticRefOffsets = (uint32_t*)Heap_AllocAtomic(sizeof(uint32_t)*staticRefs);
+    int m = 0;
+    for(int i=0;i<classfile->fields_count;i++){
+        FieldInfo *field = &classfile->fields[i];
+        uint8_t *descriptor = CLZFILE_cp_getUTF8(classfile->constant_pool, field->descriptor_index);
+        if(!isRefDescriptor(descriptor)){
+            continue;
+        }
+        if(field->access_flags & CONST_FIELD_ACCESS_STATIC){
+            class->staticRefOffsets[m++] = class->fieldOffsets[i];
+        }else{
+            class->refOffsets[n++] = class->fieldOffsets[i];
+        }
+    }
+
+    // static references are found by scanning the (uncollectable) static area conservatively,
+    // or pushed one by one when references are compressed
+    class->staticSize = alignUp(staticSize, sizeof(GC_word));
+    if(0<staticRefs){
+        class->staticFields = (uint8_t*)Heap_AllocPermanent(class->staticSize);
+    }else{
+        class->staticFields = (uint8_t*)Heap_AllocPermanentAtomic(class->staticSize);
+    }
+    return 0;
+}
+
+#ifndef JVM_COMPRESSED_REFS
+// Bitmap with one bit per word of the instance, set for reference slots only.
+// The header is left out since classes are never collected.
+static GC_descr makeDescriptor(Class *class){
+    uint32_t words = class->instanceSize/sizeof(GC_word);
+    uint32_t bitmapSize = sizeof(GC_word)*((words+GC_WORDSZ-1)/GC_WORDSZ);
+    GC_word *bitmap = (GC_word*)Heap_AllocAtomic(bitmapSize);
+    memset(bitmap, 0, bitmapSize);
+    for(int i=0;i<class->refFieldsCount;i++){
+        GC_set_bit(bitmap, class->refOffsets[i]/sizeof(GC_word));
+    }
+    return GC_make_descriptor(bitmap, words);
+}
+#endif
+
+static void indexMembers(Class *class){
+    ClassFile *classfile = class->classfile;
+    void **constantPool = classfile->constant_pool;
+    class->fieldIndex = MemberIndex_New(classfile->fields_count);
+    for(int i=0;i<classfile->fields_count;i++){
+        FieldInfo *field = &classfile->fields[i];
+        MemberIndex_Add(class->fieldIndex, CLZFILE_cp_getUTF8(constantPool, field->name_index),
+            CLZFILE_cp_getUTF8(constantPool, field->descriptor_index), (uint16_t)i);
+    }
+    class->methodIndex = MemberIndex_New(class->methodsCount);
+    for(int i=0;i<class->methodsCount;i++){
+        MemberIndex_Add(class->methodIndex, class->methods[i].name, class->methods[i].descriptor, (uint16_t)i);
+    }
+}
+
+static void* untag(void *entry){
+    return (void*)((uintptr_t)entry & ~CONST_RESOLVED_UNINITIALIZED);
+}
+
+// tagged until the class passes the initialization barrier, see classinit.h
+static void storeStatic(Class *class, uint16_t index, void *resolved, Class *owner){
+    if(CONST_CLASS_INITIALIZED!=__atomic_load_n(&owner->initState, __ATOMIC_ACQUIRE)){
+        resolved = (void*)((uintptr_t)resolved | CONST_RESOLVED_UNINITIALIZED);
+    }
+    __atomic_store_n(&class->resolved[index], resolved, __ATOMIC_RELEASE);
+}
+
+static int addSecondary(Class **supers, int count, Class *class){
+    for(int i=0;i<count;i++){
+        if(supers[i]==class){
+            return count;
+        }
+    }
+    supers[count] = class;
+    return count+1;
+}
+
+// interfaces are the direct superinterfaces, NULL for the ones not loaded
+static void linkSupers(Class *class, Class **interfaces, uint16_t interfacesCount){
+    Class *super = class->super;
+    int isInterface = NULL!=class->classfile && (class->classfile->access_flags & CONST_CLASSFILE_ACCESS_INTERFACE);
+    if(NULL!=super){
+        memcpy(class->primarySupers, super->primarySupers, sizeof(class->primarySupers));
+    }
+    class->depth = NULL==super ? 0 : super->depth+1;
+    int secondary = isInterface || class->depth>=CONST_CLASS_PRIMARY_SUPERS;
+    if(secondary){
+        class->superCheckOffset = offsetof(Class, secondarySuperCache);
+    }else{
+        class->primarySupers[class->depth] = class;
+        class->superCheckOffset = offsetof(Class, primarySupers)+sizeof(Class*)*class->depth;
+    }
+
+    int capacity = 1 + (NULL==super ? 0 : super->secondarySupersCount);
+    for(int i=0;i<interfacesCount;i++){
+        capacity += NULL==interfaces[i] ? 0 : interfaces[i]->secondarySupersCount;
+    }
+    Class **supers = (Class**)Heap_AllocAtomic(sizeof(Class*)*capacity);
+    int count = 0;
+    if(secondary){
+        supers[count++] = class;
+    }
+    for(int i=0;NULL!=super && i<super->secondarySupersCount;i++){
+        count = addSecondary(supers, count, super->secondarySupers[i]);
+    }
+    // an interface is its own first secondary super
+    for(int i=0;i<interfacesCount;i++){
+        for(int j=0;NULL!=interfaces[i] && j<interfaces[i]->secondarySupersCount;j++){
+            count = addSecondary(supers, count, interfaces[i]->secondarySupers[j]);
+        }
+    }
+    class->secondarySupersCount = (uint16_t)count;
+    class->secondarySupers = (Class**)Heap_AllocPermanentAtomic(sizeof(Class*)*(0==count ? 1 : count));
+    memcpy(class->secondarySupers, supers, sizeof(Class*)*count);
+    class->secondarySuperCache = NULL;
+    Heap_Free(supers);
+}
+
+// [FIXME] superinterfaces not loaded before the class are left out, there is no class loader yet
+static void linkClassFileSupers(Class *class){
+    uint16_t interfacesCount = class->classfile->interfaces_count;
+    Class **interfaces = (Class**)Heap_AllocAtomic(sizeof(Class*)*(interfacesCount+1));
+    for(int i=0;i<interfacesCount;i++){
+        interfaces[i] = Class_ResolveClass(class, class->classfile->interfaces[i]);
+    }
+    linkSupers(class, interfaces, interfacesCount);
+    Heap_Free(interfaces);
+}
+
+static void registerClass(Class *class){
+    class->next = __atomic_load_n(&classes, __ATOMIC_ACQUIRE);
+    while(!__atomic_compare_exchange_n(&classes, &class->next, class, 1, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE));
+}
+
+Class* Class_New(ClassFile *classfile, Class *super){
+    // classes are not unloaded, so they are not traced through object headers
+    Class *class = (Class*)Heap_AllocPermanent(sizeof(Class));
+    class->classfile = classfile;
+    class->super = super;
+    Constant_ClassInfo *classInfo = (Constant_ClassInfo*)classfile->constant_pool[classfile->this_class];
+    class->name = CLZFILE_cp_getUTF8(classfile->constant_pool, classInfo->name_index);
+    if(0!=layoutFields(class)){
+        error("Linking Class Error. Invalid fields in %s.", class->name);
+        return NULL;
+    }
+#ifndef JVM_COMPRESSED_REFS
+    // the collector cannot read compressed references through a bitmap, see heap.c
+    if(0<class->refFieldsCount){
+        class->descr = makeDescriptor(class);
+    }
+#endif
+    class->methodsCount = classfile->methods_count;
+    class->methods = (Method*)Heap_AllocPermanent(sizeof(Method)*classfile->methods_count);
+    for(int i=0;i<classfile->methods_count;i++){
+        if(0!=Method_Init(&class->methods[i], class, &classfile->methods[i])){
+            error("Linking Class Error. Invalid method in %s.", class->name);
+            return NULL;
+        }
+    }
+    indexMembers(class);
+    class->initState = CONST_CLASS_LINKED;
+    class->initThread = 0;
+    // resolved entries are traced through this uncollectable array
+    class->resolved = (void**)Heap_AllocPermanent(sizeof(void*)*classfile->constant_pool_count);
+    linkClassFileSupers(class);
+    registerClass(class);
+    return class;
+}
+
+// a class whose layout is fixed by the VM rather than read from a class file
+Class* Class_NewBuiltin(uint8_t *name, uint32_t instanceSize, uint16_t refFieldsCount, const uint32_t *refOffsets){
+    Class *class = (Class*)Heap_AllocPermanent(sizeof(Class));
+    class->name = name;
+    class->instanceSize = alignUp(instanceSize, sizeof(GC_word));
+    class->refFieldsCount = refFieldsCount;
+    class->refOffsets = (uint32_t*)Heap_AllocPermanentAtomic(sizeof(uint32_t)*refFieldsCount);
+    memcpy(class->refOffsets, refOffsets, sizeof(uint32_t)*refFieldsCount);
+    // nothing to run, its instances are made by the VM
+    class->initState = CONST_CLASS_INITIALIZED;
+    linkSupers(class, NULL, 0);
+#ifndef JVM_COMPRESSED_REFS
+    if(0<class->refFieldsCount){
+        class->descr = makeDescriptor(class);
+    }
+#endif
+    registerClass(class);
+    return class;
+}
+
+Class* Class_NewProxy(uint8_t *name, Class *super, Class **interfaces, uint16_t interfacesCount,
+    uint32_t instanceSize, uint16_t refFieldsCount, const uint32_t *refOffsets, Method *methods, uint16_t methodsCount){
+    Class *class = (Class*)Heap_AllocPermanent(sizeof(Class));
+    class->name = name;
+    class->super = super;
+    class->instanceSize = alignUp(instanceSize, sizeof(GC_word));
+    class->refFieldsCount = refFieldsCount;
+    class->refOffsets = (uint32_t*)Heap_AllocPermanentAtomic(sizeof(uint32_t)*refFieldsCount);
+    memcpy(class->refOffsets, refOffsets, sizeof(uint32_t)*refFieldsCount);
+    class->methodsCount = methodsCount;
+    class->methods = methods;
+    class->methodIndex = MemberIndex_New(methodsCount);
+    for(int i=0;i<methodsCount;i++){
+        methods[i].class = class;
+        MemberIndex_Add(class->methodIndex, methods[i].name, methods[i].descriptor, (uint16_t)i);
+    }
+    class->initState = CONST_CLASS_INITIALIZED;
+    linkSupers(class, interfaces, interfacesCount);
+#ifndef JVM_COMPRESSED_REFS
+    if(0<class->refFieldsCount){
+        class->descr = makeDescriptor(class);
+    }
+#endif
+    registerClass(class);
+    return class;
+}
+
+void Class_ForEach(void (*fn)(Class *class, void *data), void *data){
+    for(Class *class=__atomic_load_n(&classes, __ATOMIC_ACQUIRE);NULL!=class;class=class->next){
+        fn(class, data);
+    }
+}
+
+Class* Class_Find(uint8_t *name){
+    for(Class *class=__atomic_load_n(&classes, __ATOMIC_ACQUIRE);NULL!=class;class=class->next){
+        if(0==strcmp((char*)class->name, (char*)name)){
+            return class;
+        }
+    }
+    return NULL;
+}
+
+Class* Class_ResolveClass(Class *class, uint16_t index){
+    Class *resolved = (Class*)__atomic_load_n(&class->resolved[index], __ATOMIC_ACQUIRE);
+    if(NULL!=resolved){
+        return resolved;
+    }
+    void **constantPool = class->classfile->constant_pool;
+    Constant_ClassInfo *info = (Constant_ClassInfo*)constantPool[index];
+    resolved = Class_Find(CLZFILE_cp_getUTF8(constantPool, info->name_index));
+    if(NULL!=resolved){
+        __atomic_store_n(&class->resolved[index], resolved, __ATOMIC_RELEASE);
+    }
+    return resolved;
+}
+
+int Class_IsSecondarySubclassOf(Class *class, Class *super){
+    for(int i=0;i<class->secondarySupersCount;i++){
+        if(super==class->secondarySupers[i]){
+            // racing threads may overwrite each other's hit, any of them is right
+            __atomic_store_n(&class->secondarySuperCache, super, __ATOMIC_RELAXED);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// interfaces only declare static fields, instance fields come from superclasses
+uint32_t Class_FieldOffset(Class *class, uint8_t *name, uint8_t *descriptor){
+    uint32_t hash = MemberIndex_Hash(name, descriptor);
+    for(;NULL!=class;class=class->super){
+        uint16_t i = MemberIndex_Find(class->fieldIndex, hash, name, descriptor);
+        if(CONST_MEMBER_NONE!=i && !(class->classfile->fields[i].access_flags & CONST_FIELD_ACCESS_STATIC)){
+            return class->fieldOffsets[i];
+        }
+    }
+    return CONST_FIELD_OFFSET_NONE;
+}
+
+ResolvedField* Class_ResolveField(Class *class, uint16_t index){
+    ResolvedField *field = (ResolvedField*)untag(__atomic_load_n(&class->resolved[index], __ATOMIC_ACQUIRE));
+    if(NULL!=field){
+        // [FIXME] java.lang.IncompatibleClassChangeError
+        return field->isStatic ? NULL : field;
+    }
+    void **constantPool = class->classfile->constant_pool;
+    Constant_FieldRefInfo *info = (Constant_FieldRefInfo*)constantPool[index];
+    Class *owner = Class_ResolveClass(class, info->class_index);
+    if(NULL==owner){
+        return NULL;
+    }
+    Constant_NameAndTypeInfo *nameAndType = (Constant_NameAndTypeInfo*)constantPool[info->name_and_type_index];
+    uint8_t *descriptor = CLZFILE_cp_getUTF8(constantPool, nameAndType->descriptor_index);
+    uint32_t offset = Class_FieldOffset(owner, CLZFILE_cp_getUTF8(constantPool, nameAndType->name_index), descriptor);
+    if(CONST_FIELD_OFFSET_NONE==offset){
+        return NULL;
+    }
+    field = (ResolvedField*)Heap_AllocPermanentAtomic(sizeof(ResolvedField));
+    field->offset = offset;
+    field->type = descriptor[0];
+    field->isStatic = 0;
+    __atomic_store_n(&class->resolved[index], field, __ATOMIC_RELEASE);
+    return field;
+}
+
+// JVMS 5.4.3.2: declared by class, else by a superinterface, else by a superclass
+static Class* findStaticField(Class *class, uint32_t hash, uint8_t *name, uint8_t *descriptor, uint16_t *found){
+    for(;NULL!=class;class=class->super){
+        uint16_t i = MemberIndex_Find(class->fieldIndex, hash, name, descriptor);
+        if(CONST_MEMBER_NONE!=i){
+            *found = i;
+            return class->classfile->fields[i].access_flags & CONST_FIELD_ACCESS_STATIC ? class : NULL;
+        }
+        if(NULL==class->classfile){
+            continue;
+        }
+        for(int j=0;j<class->classfile->interfaces_count;j++){
+            Class *interface = Class_ResolveClass(class, class->classfile->interfaces[j]);
+            Class *owner = NULL==interface ? NULL : findStaticField(interface, hash, name, descriptor, found);
+            if(NULL!=owner){
+                return owner;
+            }
+        }
+    }
+    return NULL;
+}
+
+ResolvedStatic* Class_ResolveStaticField(Class *class, uint16_t index){
+    ResolvedStatic *resolved = (ResolvedStatic*)untag(__atomic_load_n(&class->resolved[index], __ATOMIC_ACQUIRE));
+    if(NULL!=resolved){
+        return resolved->field.isStatic ? resolved : NULL;
+    }
+    void **constantPool = class->classfile->constant_pool;
+    Constant_FieldRefInfo *info = (Constant_FieldRefInfo*)constantPool[index];
+    Class *owner = Class_ResolveClass(class, info->class_index);
+    if(NULL==owner){
+        return NULL;
+    }
+    Constant_NameAndTypeInfo *nameAndType = (Constant_NameAndTypeInfo*)constantPool[info->name_and_type_index];
+    uint8_t *name = CLZFILE_cp_getUTF8(constantPool, nameAndType->name_index);
+    uint8_t *descriptor = CLZFILE_cp_getUTF8(constantPool, nameAndType->descriptor_index);
+    uint16_t field;
+    owner = findStaticField(owner, MemberIndex_Hash(name, descriptor), name, descriptor, &field);
+    if(NULL==owner){
+        return NULL;
+    }
+    resolved = (ResolvedStatic*)Heap_AllocPermanent(sizeof(ResolvedStatic));
+    resolved->field.offset = owner->fieldOffsets[field];
+    resolved->field.type = descriptor[0];
+    resolved->field.isStatic = 1;
+    resolved->address = owner->staticFields + owner->fieldOffsets[field];
+    resolved->class = owner;
+    storeStatic(class, index, resolved, owner);
+    return resolved;
+}
+
+// Depth first through the superinterfaces of class, skipping the ones not
+// loaded yet. Static and private interface methods are not inherited.
+static Method* findInterfaceMethod(Class *class, uint32_t hash, uint8_t *name, uint8_t *descriptor){
+    ClassFile *classfile = class->classfile;
+    for(int i=0;i<classfile->interfaces_count;i++){
+        Class *interface = Class_ResolveClass(class, classfile->interfaces[i]);
+        if(NULL==interface){
+            continue;
+        }
+        uint16_t index = MemberIndex_Find(interface->methodIndex, hash, name, descriptor);
+        if(CONST_MEMBER_NONE!=index
+            && !(interface->methods[index].accessFlags & (CONST_METHOD_ACCESS_STATIC|CONST_METHOD_ACCESS_PRIVATE))){
+            return &interface->methods[index];
+        }
+        Method *method = findInterfaceMethod(interface, hash, name, descriptor);
+        if(NULL!=method){
+            return method;
+        }
+    }
+    return NULL;
+}
+
+Method* Class_FindMethod(Class *class, uint8_t *name, uint8_t *descriptor){
+    uint32_t hash = MemberIndex_Hash(name, descriptor);
+    for(Class *cur=class;NULL!=cur;cur=cur->super){
+        uint16_t index = MemberIndex_Find(cur->methodIndex, hash, name, descriptor);
+        if(CONST_MEMBER_NONE!=index){
+            return &cur->methods[index];
+        }
+    }
+    for(Class *cur=class;NULL!=cur;cur=cur->super){
+        if(NULL==cur->classfile){
+            // made by the VM, its secondary supers are all of its superinterfaces
+            for(int i=0;i<cur->secondarySupersCount;i++){
+                Class *interface = cur->secondarySupers[i];
+                uint16_t index = MemberIndex_Find(interface->methodIndex, hash, name, descriptor);
+                if(CONST_MEMBER_NONE!=index
+                    && !(interface->methods[index].accessFlags & (CONST_METHOD_ACCESS_STATIC|CONST_METHOD_ACCESS_PRIVATE))){
+                    return &interface->methods[index];
+                }
+            }
+            continue;
+        }
+        Method *method = findInterfaceMethod(cur, hash, name, descriptor);
+        if(NULL!=method){
+            return method;
+        }
+    }
+    return NULL;
+}
+
+Method* Class_ResolveMethod(Class *class, uint16_t index){
+    Method *method = (Method*)untag(__atomic_load_n(&class->resolved[index], __ATOMIC_ACQUIRE));
+    if(NULL!=method){
+        return method;
+    }
+    void **constantPool = class->classfile->constant_pool;
+    Constant_MethodRefInfo *info = (Constant_MethodRefInfo*)constantPool[index];
+    Class *owner = Class_ResolveClass(class, info->class_index);
+    if(NULL==owner){
+        return NULL;
+    }
+    Constant_NameAndTypeInfo *nameAndType = (Constant_NameAndTypeInfo*)constantPool[info->name_and_type_index];
+    method = Class_FindMethod(owner, CLZFILE_cp_getUTF8(constantPool, nameAndType->name_index), CLZFILE_cp_getUTF8(constantPool, nameAndType->descriptor_index));
+    if(NULL!=method && (method->accessFlags & CONST_METHOD_ACCESS_STATIC)){
+        storeStatic(class, index, method, method->class);
+    }else if(NULL!=method){
+        __atomic_store_n(&class->resolved[index], method, __ATOMIC_RELEASE);
+    }
+    return method;
+}
@@ -0,0 +1,98 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#define INCLUDE_RUNTIME_CLASSINIT_SELF 1
+#include "runtime/classinit.h"
+#include "runtime/class.h"
+#include "runtime/frame.h"
+#include "runtime/thread.h"
+#include "runtime/interpreter.h"
+#include "runtime/exception.h"
+#include "runtime/memberindex.h"
+#include "runtime/safepoint.h"
+#include "runtime/futex.h"
+#include "classfile/classfile.h"
+#include "utils.h"
+
+// <clinit> runs on the thread stack above frame, in a nested interpreter
+static int runInitializer(Frame *frame, Class *class){
+    uint8_t *name = (uint8_t*)"<clinit>";
+    uint8_t *descriptor = (uint8_t*)"()V";
+    uint16_t index = MemberIndex_Find(class->methodIndex, MemberIndex_Hash(name, descriptor), name, descriptor);
+    if(CONST_MEMBER_NONE==index){
+        return 0;
+    }
+    Thread *thread = frame->thread;
+    Frame *callee = Frame_NewMethod(&class->methods[index]);
+    if(0!=Thread_PushFrame(thread, callee)){
+        Exception_ThrowVM(frame, CONST_EXCEPTION_STACK_OVERFLOW);
+        return -1;
+    }
+    int status = Interpreter_Run(thread);
+    if(0==status){
+        return 0;
+    }
+    Object *exception = thread->exception;
+    thread->exception = NULL;
+    if(NULL!=exception){
+        // [FIXME] java.lang.ExceptionInInitializerError wrapping it
+        Exception_Throw(frame, exception);
+    }else if(!thread->aborted){
+        // the run failed without an exception, nor can frame go on
+        Exception_Abort(thread);
+    }
+    return -1;
+}
+
+static int initialize(Frame *frame, Class *class){
+    int status = 0;
+    // superinterfaces are only initialized when used themselves
+    int isInterface = NULL!=class->classfile && (class->classfile->access_flags & CONST_CLASSFILE_ACCESS_INTERFACE);
+    if(!isInterface && NULL!=class->super && !ClassInit_Done(class->super)){
+        status = ClassInit_Barrier(frame, class->super);
+    }
+    if(0==status){
+        status = runInitializer(frame, class);
+    }
+    __atomic_store_n(&class->initState, 0==status ? CONST_CLASS_INITIALIZED : CONST_CLASS_ERRONEOUS, __ATOMIC_RELEASE);
+    Futex_Wake(&class->initState, INT32_MAX);
+    return status;
+}
+
+int ClassInit_Barrier(Frame *frame, Class *class){
+    Thread *thread = frame->thread;
+    for(;;){
+        int32_t state = __atomic_load_n(&class->initState, __ATOMIC_ACQUIRE);
+        switch(state){
+            case CONST_CLASS_INITIALIZED:
+                return 0;
+            case CONST_CLASS_ERRONEOUS:
+                // [FIXME] shared instance, without the "Could not initialize class" message
+                Exception_ThrowVM(frame, CONST_EXCEPTION_NO_CLASS_DEF_FOUND);
+                return -1;
+            case CONST_CLASS_INITIALIZING:
+                // a recursive request from <clinit> itself goes on
+                if(thread->id==__atomic_load_n(&class->initThread, __ATOMIC_RELAXED)){
+                    return 0;
+                }
+                // the operands of frame are still on its stack, where a collection finds them
+                int32_t threadState;
+                SAFEPOINT_ENTER_NATIVE(thread, threadState);
+                Futex_Wait(&class->initState, CONST_CLASS_INITIALIZING, NULL);
+                Safepoint_LeaveNative(thread, threadState);
+                break;
+            default:
+                if(__atomic_compare_exchange_n(&class->initState, &state, CONST_CLASS_INITIALIZING, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+                    __atomic_store_n(&class->initThread, thread->id, __ATOMIC_RELAXED);
+                    return initialize(frame, class);
+                }
+                break;
+        }
+    }
+}
+
+void ClassInit_Patch(Class *class, uint16_t index, void *resolved, Class *owner){
+    if(ClassInit_Done(owner)){
+        __atomic_store_n(&class->resolved[index], resolved, __ATOMIC_RELEASE);
+    }
+}
@@ -0,0 +1,127 @@
+#include <stdint.h>
+#include <string.h>
+
+#define INCLUDE_RUNTIME_DESCRIPTOR_SELF 1
+#include "runtime/descriptor.h"
+#include "runtime/heap.h"
+#include "utils.h"
+
+// push-only and lock-free like the class registry, entries are never freed
+static Descriptor *buckets[CONST_DESCRIPTOR_BUCKETS];
+
+static uint32_t hashDescriptor(uint8_t *descriptor){
+    uint32_t hash = 2166136261u;
+    for(uint8_t *cur=descriptor;0!=*cur;cur++){
+        hash = (hash^*cur)*16777619u;
+    }
+    return hash;
+}
+
+// the type code of the field type at *cur, which moves past it; 0 if malformed
+static uint8_t parseType(uint8_t **cur, int allowVoid){
+    uint8_t *p = *cur;
+    uint8_t type = *p;
+    switch(type){
+        case 'B': case 'C': case 'D': case 'F': case 'I': case 'J': case 'S': case 'Z':
+            *cur = p+1;
+            return type;
+        case 'V':
+            if(!allowVoid){
+                return 0;
+            }
+            *cur = p+1;
+            return type;
+        case '[':
+            while('['==*p){
+                p++;
+            }
+            *cur = p;
+            if(0==parseType(cur, 0)){
+                return 0;
+            }
+            return 'L';
+        case 'L':
+            p = (uint8_t*)strchr((char*)p, ';');
+            if(NULL==p || p==*cur+1){
+                return 0;
+            }
+            *cur = p+1;
+            return 'L';
+        default:
+            return 0;
+    }
+}
+
+static Descriptor* parse(uint8_t *descriptor, uint32_t hash){
+    if('('!=descriptor[0]){
+        return NULL;
+    }
+    // at most one type per character
+    uint8_t *types = (uint8_t*)Heap_AllocAtomic(strlen((char*)descriptor));
+    uint16_t count = 0;
+    uint32_t slots = 0;
+    uint8_t *cur = descriptor+1;
+    while(')'!=*cur){
+        uint8_t type = parseType(&cur, 0);
+        if(0==type){
+            Heap_Free(types);
+            return NULL;
+        }
+        types[count++] = type;
+        slots += 'J'==type || 'D'==type ? 2 : 1;
+    }
+    cur++;
+    uint8_t returnType = parseType(&cur, 1);
+    // the JVMS limit on parameter slots
+    if(0==returnType || 0!=*cur || slots>255){
+        Heap_Free(types);
+        return NULL;
+    }
+    Descriptor *parsed = (Descriptor*)Heap_AllocPermanent(sizeof(Descriptor));
+    parsed->descriptor = descriptor;
+    parsed->hash = hash;
+    parsed->argSlots = (uint16_t)slots;
+    parsed->returnType = returnType;
+    parsed->returnSlots = 'V'==returnType ? 0 : 'J'==returnType || 'D'==returnType ? 2 : 1;
+    parsed->argsCount = count;
+    parsed->argTypes = (uint8_t*)Heap_AllocPermanentAtomic(0==count ? 1 : count);
+    memcpy(parsed->argTypes, types, count);
+    Heap_Free(types);
+    return parsed;
+}
+
+static Descriptor* find(Descriptor *chain, uint8_t *descriptor, uint32_t hash){
+    for(;NULL!=chain;chain=chain->next){
+        if(hash==chain->hash && 0==strcmp((char*)chain->descriptor, (char*)descriptor)){
+            return chain;
+        }
+    }
+    return NULL;
+}
+
+// racing threads may both parse it, the first one pushed wins and the
+// others free their copy
+Descriptor* Descriptor_Get(uint8_t *descriptor){
+    uint32_t hash = hashDescriptor(descriptor);
+    Descriptor **bucket = &buckets[hash%CONST_DESCRIPTOR_BUCKETS];
+    Descriptor *head = __atomic_load_n(bucket, __ATOMIC_ACQUIRE);
+    Descriptor *found = find(head, descriptor, hash);
+    if(NULL!=found){
+        return found;
+    }
+    Descriptor *parsed = parse(descriptor, hash);
+    if(NULL==parsed){
+        return NULL;
+    }
+    parsed->next = head;
+    while(!__atomic_compare_exchange_n(bucket, &parsed->next, parsed, 1, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)){
+        // another thread may have pushed the same descriptor meanwhile
+        found = find(parsed->next, descriptor, hash);
+        if(NULL!=found){
+            Heap_Free(parsed->argTypes);
+            Heap_Free(parsed);
+            return found;
+        }
+    }
+    return parsed;
+}
@@ -0,0 +1,922 @@
+#include <stdint.h>
+#include <string.h>
+
+#define INCLUDE_RUNTIME_ESCAPE_SELF 1
+#include "runtime/escape.h"
+#include "runtime/method.h"
+#include "runtime/class.h"
+#include "runtime/frame.h"
+#include "runtime/object.h"
+#include "runtime/refmap.h"
+#include "runtime/heap.h"
+#include "runtime/opcode.h"
+#include "runtime/descriptor.h"
+#include "classfile/classfile.h"
+#include "classfile/op.h"
+#include "utils.h"
+
+// Malformed code fails quietly here, the reference map reports it.
+
+// the receiver of a method, when following one
+#define THIS_BIT  1
+
+typedef struct{
+    Method *method;
+    void **constantPool;
+    uint16_t constantPoolCount;
+    uint8_t *code;
+    uint32_t codeLength;
+    uint16_t maxLocals;
+    uint16_t maxStack;
+    uint16_t slotsCount;
+    uint16_t localWords;
+    uint32_t *index; // by pc: instruction number, CONST_REFMAP_NONE elsewhere
+    uint32_t *pcs; // by instruction number
+    uint32_t count;
+    uint32_t *states; // slotsCount site masks per instruction, locals then stack
+    int32_t *depths; // -1 until reached
+    uint32_t *worklist;
+    uint32_t worklistSize;
+    uint8_t *queued;
+    // the new sites, NULL when following a receiver
+    uint32_t *sites;
+    Class **classes; // exact class of each site, NULL when unresolved
+    uint32_t sitesCount;
+    int depth;
+    uint32_t escaped;
+    int unresolved; // an entry taken as escaping may be resolved later
+} Analysis;
+
+typedef struct{
+    uint32_t *slots;
+    int32_t sp;
+} State;
+
+static int keepsThis(Analysis *caller, Method *method);
+
+static uint16_t readU16(uint8_t *p){
+    return (uint16_t)(p[0]<<8 | p[1]);
+}
+
+static int32_t readS32(uint8_t *p){
+    return (int32_t)((uint32_t)p[0]<<24 | (uint32_t)p[1]<<16 | (uint32_t)p[2]<<8 | p[3]);
+}
+
+static uint32_t switchBase(uint32_t pc){
+    return (pc+4)&~(uint32_t)3;
+}
+
+// Only entries the running code has already resolved are looked at, the
+// analysis must not resolve, or fail on, what the program never touches.
+// Anything unresolved is taken to escape.
+static void* resolvedEntry(Class *class, uint16_t index){
+    uintptr_t entry = (uintptr_t)__atomic_load_n(&class->resolved[index], __ATOMIC_ACQUIRE);
+    return (void*)(entry & ~CONST_RESOLVED_UNINITIALIZED);
+}
+
+static void enqueue(Analysis *a, uint32_t insn){
+    if(!a->queued[insn]){
+        a->queued[insn] = 1;
+        a->worklist[a->worklistSize++] = insn;
+    }
+}
+
+static int merge(Analysis *a, uint32_t target, State *state){
+    if(target>=a->codeLength || CONST_REFMAP_NONE==a->index[target]){
+        return -1;
+    }
+    uint32_t insn = a->index[target];
+    uint32_t *slots = a->states + (size_t)insn*a->slotsCount;
+    if(-1==a->depths[insn]){
+        memcpy(slots, state->slots, sizeof(uint32_t)*a->slotsCount);
+        a->depths[insn] = state->sp;
+        enqueue(a, insn);
+        return 0;
+    }
+    if(a->depths[insn]!=state->sp){
+        return -1;
+    }
+    int changed = 0;
+    for(int i=0;i<a->maxLocals+state->sp;i++){
+        if((slots[i]|state->slots[i])!=slots[i]){
+            slots[i] |= state->slots[i];
+            changed = 1;
+        }
+    }
+    if(changed){
+        enqueue(a, insn);
+    }
+    return 0;
+}
+
+static int forEachSuccessor(Analysis *a, uint32_t pc, State *state){
+    uint8_t *code = a->code;
+    uint32_t next = pc+(uint32_t)Opcode_Length(code, a->codeLength, pc);
+    uint32_t base;
+    switch(code[pc]){
+        case CONST_OPCODE_IFEQ ... CONST_OPCODE_IF_ACMPNE:
+        case CONST_OPCODE_IFNULL:
+        case CONST_OPCODE_IFNONNULL:
+            if(0!=merge(a, pc+(int16_t)readU16(code+pc+1), state)){
+                return -1;
+            }
+            return merge(a, next, state);
+        case CONST_OPCODE_GOTO:
+            return merge(a, pc+(int16_t)readU16(code+pc+1), state);
+        case CONST_OPCODE_GOTO_W:
+            return merge(a, pc+readS32(code+pc+1), state);
+        case CONST_OPCODE_TABLESWITCH:
+            base = switchBase(pc);
+            if(0!=merge(a, pc+readS32(code+base), state)){
+                return -1;
+            }
+            for(int64_t i=0;i<=(int64_t)readS32(code+base+8)-readS32(code+base+4);i++){
+                if(0!=merge(a, pc+readS32(code+base+12+4*i), state)){
+                    return -1;
+                }
+            }
+            return 0;
+        case CONST_OPCODE_LOOKUPSWITCH:
+            base = switchBase(pc);
+            if(0!=merge(a, pc+readS32(code+base), state)){
+                return -1;
+            }
+            for(int32_t i=0;i<readS32(code+base+4);i++){
+                if(0!=merge(a, pc+readS32(code+base+12+8*i), state)){
+                    return -1;
+                }
+            }
+            return 0;
+        case CONST_OPCODE_IRETURN ... CONST_OPCODE_RETURN:
+        case CONST_OPCODE_ATHROW:
+            return 0;
+        default:
+            return merge(a, next, state);
+    }
+}
+
+static uint8_t* constantDescriptor(Analysis *a, uint16_t index){
+    if(0==index || index>=a->constantPoolCount || NULL==a->constantPool[index]){
+        return NULL;
+    }
+    uint16_t nameAndType;
+    switch(*(uint8_t*)a->constantPool[index]){
+        case CONST_CONSTANTPOOLINFO_TAG_FIELD_REF:
+        case CONST_CONSTANTPOOLINFO_TAG_METHOD_REF:
+        case CONST_CONSTANTPOOLINFO_TAG_INTERFACE_METHOD_REF:
+            nameAndType = ((Constant_FieldRefInfo*)a->constantPool[index])->name_and_type_index;
+            break;
+        case CONST_CONSTANTPOOLINFO_TAG_INVOKE_DYNAMIC:
+            nameAndType = ((Constant_InvokeDynamicInfo*)a->constantPool[index])->name_and_type_index;
+            break;
+        default:
+            return NULL;
+    }
+    Constant_NameAndTypeInfo *info = (Constant_NameAndTypeInfo*)a->constantPool[nameAndType];
+    return CLZFILE_cp_getUTF8(a->constantPool, info->descriptor_index);
+}
+
+// the sites that may be in the slot count down from the top of the stack
+static uint32_t peek(Analysis *a, State *state, int depth){
+    return state->sp>depth ? state->slots[a->maxLocals+state->sp-1-depth] : 0;
+}
+
+static int pop(State *state, int count){
+    if(state->sp<count){
+        return -1;
+    }
+    state->sp -= count;
+    return 0;
+}
+
+static int push(Analysis *a, State *state, uint32_t sites, int count){
+    if(state->sp+count>a->maxStack){
+        return -1;
+    }
+    for(int i=0;i<count;i++){
+        state->slots[a->maxLocals+state->sp++] = 0==i ? sites : 0;
+    }
+    return 0;
+}
+
+static int typeSlots(uint8_t type){
+    return 'J'==type || 'D'==type ? 2 : 1;
+}
+
+static int pushType(Analysis *a, State *state, uint8_t type){
+    return 'V'==type ? 0 : push(a, state, 0, typeSlots(type));
+}
+
+static int checkLocal(Analysis *a, uint32_t local, int count){
+    return local+count>a->maxLocals ? -1 : 0;
+}
+
+static int load(Analysis *a, State *state, uint32_t local, int count, int isRef){
+    if(0!=checkLocal(a, local, count)){
+        return -1;
+    }
+    return push(a, state, isRef ? state->slots[local] : 0, count);
+}
+
+static int store(Analysis *a, State *state, uint32_t local, int count, int isRef){
+    if(0!=checkLocal(a, local, count) || 0!=pop(state, count)){
+        return -1;
+    }
+    for(int i=0;i<count;i++){
+        state->slots[local+i] = isRef ? state->slots[a->maxLocals+state->sp] : 0;
+    }
+    return 0;
+}
+
+// dup family, patterns list the popped slots to push again, 0 being the top
+static int shuffle(Analysis *a, State *state, int pops, const int8_t *pattern, int count){
+    uint32_t popped[4];
+    if(0!=pop(state, pops)){
+        return -1;
+    }
+    for(int i=0;i<pops;i++){
+        popped[i] = state->slots[a->maxLocals+state->sp+pops-1-i];
+    }
+    for(int i=0;i<count;i++){
+        if(0!=push(a, state, popped[pattern[i]], 1)){
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// The receivers among sites whose call keeps them. The class of a new is
+// exact, its virtual calls select their method; a followed receiver may be
+// of any subclass, only calls that cannot be overridden are followed.
+static uint32_t keptReceivers(Analysis *a, uint8_t opcode, uint16_t index, uint32_t sites){
+    if(a->depth>=CONST_ESCAPE_MAX_DEPTH){
+        return 0;
+    }
+    Method *resolved = (Method*)resolvedEntry(a->method->class, index);
+    if(NULL==resolved){
+        a->unresolved = 1;
+        return 0;
+    }
+    int bound = CONST_OPCODE_INVOKESPECIAL==opcode || (resolved->accessFlags & (CONST_METHOD_ACCESS_FINAL|CONST_METHOD_ACCESS_PRIVATE))
+        || (NULL!=resolved->class->classfile && (resolved->class->classfile->access_flags & CONST_CLASSFILE_ACCESS_FINAL));
+    uint32_t kept = 0;
+    for(uint32_t i=0;i<32;i++){
+        if(!(sites & ((uint32_t)1<<i))){
+            continue;
+        }
+        Method *target = resolved;
+        if(!bound){
+            if(NULL==a->sites || NULL==a->classes[i]){
+                continue;
+            }
+            target = Class_FindMethod(a->classes[i], resolved->name, resolved->descriptor);
+        }
+        if(NULL!=target && keepsThis(a, target)){
+            kept |= (uint32_t)1<<i;
+        }
+    }
+    return kept;
+}
+
+static int invoke(Analysis *a, uint32_t pc, State *state){
+    uint8_t opcode = a->code[pc];
+    uint16_t index = readU16(a->code+pc+1);
+    uint8_t *descriptor = constantDescriptor(a, index);
+    Descriptor *parsed = NULL==descriptor ? NULL : Descriptor_Get(descriptor);
+    if(NULL==parsed){
+        return -1;
+    }
+    for(int i=0;i<parsed->argSlots;i++){
+        a->escaped |= peek(a, state, i);
+    }
+    if(CONST_OPCODE_INVOKESTATIC!=opcode && CONST_OPCODE_INVOKEDYNAMIC!=opcode){
+        uint32_t receivers = peek(a, state, parsed->argSlots);
+        if(0!=(receivers & ~a->escaped)){
+            receivers &= ~keptReceivers(a, opcode, index, receivers & ~a->escaped);
+        }
+        a->escaped |= receivers;
+        if(0!=pop(state, 1)){
+            return -1;
+        }
+    }
+    if(0!=pop(state, parsed->argSlots)){
+        return -1;
+    }
+    // what a kept receiver holds has escaped, it is none of the sites
+    return pushType(a, state, parsed->returnType);
+}
+
+static int newSite(Analysis *a, uint32_t pc, State *state){
+    uint32_t bit = 0;
+    for(uint32_t i=0;NULL!=a->sites && i<a->sitesCount;i++){
+        if(pc==a->sites[i]){
+            bit = (uint32_t)1<<i;
+            break;
+        }
+    }
+    return push(a, state, bit, 1);
+}
+
+static int interpret(Analysis *a, uint32_t pc, State *state){
+    uint8_t *code = a->code;
+    uint8_t opcode = code[pc];
+    uint8_t *descriptor;
+    uint16_t index;
+    switch(opcode){
+        case CONST_OPCODE_NOP:
+            return 0;
+        case CONST_OPCODE_ACONST_NULL:
+        case CONST_OPCODE_ICONST_M1 ... CONST_OPCODE_ICONST_5:
+        case CONST_OPCODE_FCONST_0 ... CONST_OPCODE_FCONST_2:
+        case CONST_OPCODE_BIPUSH:
+        case CONST_OPCODE_SIPUSH:
+        case CONST_OPCODE_LDC:
+        case CONST_OPCODE_LDC_W:
+            return push(a, state, 0, 1);
+        case CONST_OPCODE_LCONST_0 ... CONST_OPCODE_LCONST_1:
+        case CONST_OPCODE_DCONST_0 ... CONST_OPCODE_DCONST_1:
+        case CONST_OPCODE_LDC2_W:
+            return push(a, state, 0, 2);
+        case CONST_OPCODE_ILOAD:
+        case CONST_OPCODE_FLOAD:
+            return load(a, state, code[pc+1], 1, 0);
+        case CONST_OPCODE_LLOAD:
+        case CONST_OPCODE_DLOAD:
+            return load(a, state, code[pc+1], 2, 0);
+        case CONST_OPCODE_ALOAD:
+            return load(a, state, code[pc+1], 1, 1);
+        case CONST_OPCODE_ILOAD_0 ... CONST_OPCODE_ILOAD_3:
+            return load(a, state, opcode-CONST_OPCODE_ILOAD_0, 1, 0);
+        case CONST_OPCODE_LLOAD_0 ... CONST_OPCODE_LLOAD_3:
+            return load(a, state, opcode-CONST_OPCODE_LLOAD_0, 2, 0);
+        case CONST_OPCODE_FLOAD_0 ... CONST_OPCODE_FLOAD_3:
+            return load(a, state, opcode-CONST_OPCODE_FLOAD_0, 1, 0);
+        case CONST_OPCODE_DLOAD_0 ... CONST_OPCODE_DLOAD_3:
+            return load(a, state, opcode-CONST_OPCODE_DLOAD_0, 2, 0);
+        case CONST_OPCODE_ALOAD_0 ... CONST_OPCODE_ALOAD_3:
+            return load(a, state, opcode-CONST_OPCODE_ALOAD_0, 1, 1);
+        case CONST_OPCODE_IALOAD ... CONST_OPCODE_SALOAD:
+            if(0!=pop(state, 2)){
+                return -1;
+            }
+            return push(a, state, 0, CONST_OPCODE_LALOAD==opcode || CONST_OPCODE_DALOAD==opcode ? 2 : 1);
+        case CONST_OPCODE_ISTORE:
+        case CONST_OPCODE_FSTORE:
+            return store(a, state, code[pc+1], 1, 0);
+        case CONST_OPCODE_LSTORE:
+        case CONST_OPCODE_DSTORE:
+            return store(a, state, code[pc+1], 2, 0);
+        case CONST_OPCODE_ASTORE:
+            return store(a, state, code[pc+1], 1, 1);
+        case CONST_OPCODE_ISTORE_0 ... CONST_OPCODE_ISTORE_3:
+            return store(a, state, opcode-CONST_OPCODE_ISTORE_0, 1, 0);
+        case CONST_OPCODE_LSTORE_0 ... CONST_OPCODE_LSTORE_3:
+            return store(a, state, opcode-CONST_OPCODE_LSTORE_0, 2, 0);
+        case CONST_OPCODE_FSTORE_0 ... CONST_OPCODE_FSTORE_3:
+            return store(a, state, opcode-CONST_OPCODE_FSTORE_0, 1, 0);
+        case CONST_OPCODE_DSTORE_0 ... CONST_OPCODE_DSTORE_3:
+            return store(a, state, opcode-CONST_OPCODE_DSTORE_0, 2, 0);
+        case CONST_OPCODE_ASTORE_0 ... CONST_OPCODE_ASTORE_3:
+            return store(a, state, opcode-CONST_OPCODE_ASTORE_0, 1, 1);
+        case CONST_OPCODE_AASTORE:
+            a->escaped |= peek(a, state, 0);
+            return pop(state, 3);
+        case CONST_OPCODE_IASTORE ... CONST_OPCODE_FASTORE:
+        case CONST_OPCODE_BASTORE ... CONST_OPCODE_SASTORE:
+            return pop(state, CONST_OPCODE_LASTORE==opcode ? 4 : 3);
+        case CONST_OPCODE_DASTORE:
+            return pop(state, 4);
+        case CONST_OPCODE_POP:
+            return pop(state, 1);
+        case CONST_OPCODE_POP2:
+            return pop(state, 2);
+        case CONST_OPCODE_DUP:
+            return shuffle(a, state, 1, (const int8_t[]){0, 0}, 2);
+        case CONST_OPCODE_DUP_X1:
+            return shuffle(a, state, 2, (const int8_t[]){0, 1, 0}, 3);
+        case CONST_OPCODE_DUP_X2:
+            return shuffle(a, state, 3, (const int8_t[]){0, 2, 1, 0}, 4);
+        case CONST_OPCODE_DUP2:
+            return shuffle(a, state, 2, (const int8_t[]){1, 0, 1, 0}, 4);
+        case CONST_OPCODE_DUP2_X1:
+            return shuffle(a, state, 3, (const int8_t[]){1, 0, 2, 1, 0}, 5);
+        case CONST_OPCODE_DUP2_X2:
+            return shuffle(a, state, 4, (const int8_t[]){1, 0, 3, 2, 1, 0}, 6);
+        case CONST_OPCODE_SWAP:
+            return shuffle(a, state, 2, (const int8_t[]){0, 1}, 2);
+        // arithmetic, odd opcodes work on longs and doubles up to lxor
+        case CONST_OPCODE_IADD ... CONST_OPCODE_DREM:
+        case CONST_OPCODE_IAND ... CONST_OPCODE_LXOR:
+            if(0!=pop(state, (opcode&1) ? 4 : 2)){
+                return -1;
+            }
+            return push(a, state, 0, (opcode&1) ? 2 : 1);
+        case CONST_OPCODE_INEG ... CONST_OPCODE_DNEG:
+            return 0;
+        case CONST_OPCODE_ISHL ... CONST_OPCODE_LUSHR:
+            if(0!=pop(state, (opcode&1) ? 3 : 2)){
+                return -1;
+            }
+            return push(a, state, 0, (opcode&1) ? 2 : 1);
+        case CONST_OPCODE_IINC:
+            return checkLocal(a, code[pc+1], 1);
+        case CONST_OPCODE_I2L:
+        case CONST_OPCODE_I2D:
+        case CONST_OPCODE_F2L:
+        case CONST_OPCODE_F2D:
+            return push(a, state, 0, 1);
+        case CONST_OPCODE_L2I:
+        case CONST_OPCODE_L2F:
+        case CONST_OPCODE_D2I:
+        case CONST_OPCODE_D2F:
+            return pop(state, 1);
+        case CONST_OPCODE_I2F:
+        case CONST_OPCODE_L2D:
+        case CONST_OPCODE_F2I:
+        case CONST_OPCODE_D2L:
+        case CONST_OPCODE_I2B ... CONST_OPCODE_I2S:
+            return 0;
+        case CONST_OPCODE_LCMP:
+        case CONST_OPCODE_DCMPL:
+        case CONST_OPCODE_DCMPG:
+            if(0!=pop(state, 4)){
+                return -1;
+            }
+            return push(a, state, 0, 1);
+        case CONST_OPCODE_FCMPL:
+        case CONST_OPCODE_FCMPG:
+            if(0!=pop(state, 2)){
+                return -1;
+            }
+            return push(a, state, 0, 1);
+        case CONST_OPCODE_IFEQ ... CONST_OPCODE_IFLE:
+        case CONST_OPCODE_IFNULL:
+        case CONST_OPCODE_IFNONNULL:
+        case CONST_OPCODE_TABLESWITCH:
+        case CONST_OPCODE_LOOKUPSWITCH:
+            return pop(state, 1);
+        case CONST_OPCODE_IF_ICMPEQ ... CONST_OPCODE_IF_ACMPNE:
+            return pop(state, 2);
+        case CONST_OPCODE_GOTO:
+        case CONST_OPCODE_GOTO_W:
+        case CONST_OPCODE_IRETURN ... CONST_OPCODE_DRETURN:
+        case CONST_OPCODE_RETURN:
+            return 0;
+        case CONST_OPCODE_ARETURN:
+        case CONST_OPCODE_ATHROW:
+        case CONST_OPCODE_MONITORENTER:
+        case CONST_OPCODE_MONITOREXIT:
+            a->escaped |= peek(a, state, 0);
+            return CONST_OPCODE_MONITORENTER==opcode || CONST_OPCODE_MONITOREXIT==opcode ? pop(state, 1) : 0;
+        case CONST_OPCODE_GETSTATIC:
+        case CONST_OPCODE_PUTSTATIC:
+        case CONST_OPCODE_GETFIELD:
+        case CONST_OPCODE_PUTFIELD:
+            descriptor = constantDescriptor(a, readU16(code+pc+1));
+            if(NULL==descriptor){
+                return -1;
+            }
+            if(CONST_OPCODE_GETSTATIC==opcode){
+                return pushType(a, state, descriptor[0]);
+            }
+            if(CONST_OPCODE_GETFIELD==opcode){
+                return 0!=pop(state, 1) ? -1 : pushType(a, state, descriptor[0]);
+            }
+            // the holder of a putfield keeps, the value stored escapes
+            if('L'==descriptor[0] || '['==descriptor[0]){
+                a->escaped |= peek(a, state, 0);
+            }
+            return pop(state, typeSlots(descriptor[0])+(CONST_OPCODE_PUTFIELD==opcode));
+        case CONST_OPCODE_INVOKEVIRTUAL ... CONST_OPCODE_INVOKEDYNAMIC:
+            return invoke(a, pc, state);
+        case CONST_OPCODE_NEW:
+            return newSite(a, pc, state);
+        case CONST_OPCODE_NEWARRAY:
+        case CONST_OPCODE_ANEWARRAY:
+        case CONST_OPCODE_ARRAYLENGTH:
+        case CONST_OPCODE_INSTANCEOF:
+            if(0!=pop(state, 1)){
+                return -1;
+            }
+            return push(a, state, 0, 1);
+        case CONST_OPCODE_CHECKCAST:
+            return state->sp<1 ? -1 : 0;
+        case CONST_OPCODE_MULTIANEWARRAY:
+            if(0!=pop(state, code[pc+3])){
+                return -1;
+            }
+            return push(a, state, 0, 1);
+        case CONST_OPCODE_WIDE:
+            index = readU16(code+pc+2);
+            switch(code[pc+1]){
+                case CONST_OPCODE_ILOAD:
+                case CONST_OPCODE_FLOAD:
+                    return load(a, state, index, 1, 0);
+                case CONST_OPCODE_LLOAD:
+                case CONST_OPCODE_DLOAD:
+                    return load(a, state, index, 2, 0);
+                case CONST_OPCODE_ALOAD:
+                    return load(a, state, index, 1, 1);
+                case CONST_OPCODE_ISTORE:
+                case CONST_OPCODE_FSTORE:
+                    return store(a, state, index, 1, 0);
+                case CONST_OPCODE_LSTORE:
+                case CONST_OPCODE_DSTORE:
+                    return store(a, state, index, 2, 0);
+                case CONST_OPCODE_ASTORE:
+                    return store(a, state, index, 1, 1);
+                case CONST_OPCODE_IINC:
+                    return checkLocal(a, index, 1);
+                default:
+                    break;
+            }
+            // fall through, wide ret
+        default:
+            // jsr and ret, whatever the subroutine holds is given up on
+            return -1;
+    }
+}
+
+// a handler starts with the thrown exception alone on the stack
+static int mergeHandlers(Analysis *a, uint32_t pc, State *state, uint32_t *scratch){
+    Attribute_Code *attribute = a->method->codeAttribute;
+    for(int i=0;i<attribute->exception_table_length;i++){
+        ExceptionInfo *handler = &attribute->exception_table[i];
+        if(pc<handler->start_pc || pc>=handler->end_pc){
+            continue;
+        }
+        if(0==a->maxStack){
+            return -1;
+        }
+        State thrown = {scratch, 1};
+        memcpy(scratch, state->slots, sizeof(uint32_t)*a->maxLocals);
+        scratch[a->maxLocals] = 0;
+        if(0!=merge(a, handler->hanfler_pc, &thrown)){
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int forward(Analysis *a){
+    State state;
+    uint32_t *scratch = (uint32_t*)Heap_AllocAtomic(sizeof(uint32_t)*a->slotsCount+1);
+    int status = -1;
+    state.slots = (uint32_t*)Heap_AllocAtomic(sizeof(uint32_t)*a->slotsCount+1);
+    memset(scratch, 0, sizeof(uint32_t)*a->slotsCount);
+    memset(state.slots, 0, sizeof(uint32_t)*a->slotsCount);
+    state.sp = 0;
+    if(NULL==a->sites){
+        state.slots[0] = THIS_BIT;
+    }
+    if(0!=merge(a, 0, &state)){
+        goto done;
+    }
+    while(0<a->worklistSize){
+        uint32_t insn = a->worklist[--a->worklistSize];
+        uint32_t pc = a->pcs[insn];
+        a->queued[insn] = 0;
+        memcpy(state.slots, a->states + (size_t)insn*a->slotsCount, sizeof(uint32_t)*a->slotsCount);
+        state.sp = a->depths[insn];
+        // a handler may see the locals from before or after the instruction
+        if(0!=mergeHandlers(a, pc, &state, scratch) || 0!=interpret(a, pc, &state)
+            || 0!=mergeHandlers(a, pc, &state, scratch) || 0!=forEachSuccessor(a, pc, &state)){
+            goto done;
+        }
+    }
+    status = 0;
+done:
+    Heap_Free(scratch);
+    Heap_Free(state.slots);
+    return status;
+}
+
+// the local an instruction reads a reference from, and the ones it overwrites
+static void localsEffect(uint8_t *code, uint32_t pc, int32_t *use, int32_t *def, int *defCount){
+    uint8_t opcode = code[pc];
+    *use = -1;
+    *def = -1;
+    *defCount = 1;
+    switch(opcode){
+        case CONST_OPCODE_ALOAD:
+            *use = code[pc+1];
+            return;
+        case CONST_OPCODE_ALOAD_0 ... CONST_OPCODE_ALOAD_3:
+            *use = opcode-CONST_OPCODE_ALOAD_0;
+            return;
+        case CONST_OPCODE_ISTORE ... CONST_OPCODE_ASTORE:
+            *def = code[pc+1];
+            *defCount = CONST_OPCODE_LSTORE==opcode || CONST_OPCODE_DSTORE==opcode ? 2 : 1;
+            return;
+        case CONST_OPCODE_ISTORE_0 ... CONST_OPCODE_ASTORE_3:
+            *def = (opcode-CONST_OPCODE_ISTORE_0)&3;
+            *defCount = opcode>=CONST_OPCODE_LSTORE_0 && opcode<=CONST_OPCODE_LSTORE_3 ? 2 : opcode>=CONST_OPCODE_DSTORE_0 && opcode<=CONST_OPCODE_DSTORE_3 ? 2 : 1;
+            return;
+        case CONST_OPCODE_WIDE:
+            opcode = code[pc+1];
+            if(CONST_OPCODE_ALOAD==opcode){
+                *use = readU16(code+pc+2);
+            }else if(opcode>=CONST_OPCODE_ISTORE && opcode<=CONST_OPCODE_ASTORE){
+                *def = readU16(code+pc+2);
+                *defCount = CONST_OPCODE_LSTORE==opcode || CONST_OPCODE_DSTORE==opcode ? 2 : 1;
+            }
+            return;
+        default:
+            return;
+    }
+}
+
+static void orLiveIn(Analysis *a, uint32_t *live, uint32_t *in, uint32_t target){
+    if(target<a->codeLength && CONST_REFMAP_NONE!=a->index[target]){
+        uint32_t *from = in + (size_t)a->index[target]*a->localWords;
+        for(int i=0;i<a->localWords;i++){
+            live[i] |= from[i];
+        }
+    }
+}
+
+// successors of an instruction for the liveness pass, the code was
+// followed by then so the targets are known to be instructions
+static void orSuccessors(Analysis *a, uint32_t *live, uint32_t *in, uint32_t pc){
+    uint8_t *code = a->code;
+    uint32_t next = pc+(uint32_t)Opcode_Length(code, a->codeLength, pc);
+    uint32_t base;
+    switch(code[pc]){
+        case CONST_OPCODE_IFEQ ... CONST_OPCODE_IF_ACMPNE:
+        case CONST_OPCODE_IFNULL:
+        case CONST_OPCODE_IFNONNULL:
+            orLiveIn(a, live, in, pc+(int16_t)readU16(code+pc+1));
+            orLiveIn(a, live, in, next);
+            break;
+        case CONST_OPCODE_GOTO:
+            orLiveIn(a, live, in, pc+(int16_t)readU16(code+pc+1));
+            break;
+        case CONST_OPCODE_GOTO_W:
+            orLiveIn(a, live, in, pc+readS32(code+pc+1));
+            break;
+        case CONST_OPCODE_TABLESWITCH:
+            base = switchBase(pc);
+            orLiveIn(a, live, in, pc+readS32(code+base));
+            for(int64_t i=0;i<=(int64_t)readS32(code+base+8)-readS32(code+base+4);i++){
+                orLiveIn(a, live, in, pc+readS32(code+base+12+4*i));
+            }
+            break;
+        case CONST_OPCODE_LOOKUPSWITCH:
+            base = switchBase(pc);
+            orLiveIn(a, live, in, pc+readS32(code+base));
+            for(int32_t i=0;i<readS32(code+base+4);i++){
+                orLiveIn(a, live, in, pc+readS32(code+base+12+8*i));
+            }
+            break;
+        case CONST_OPCODE_IRETURN ... CONST_OPCODE_RETURN:
+        case CONST_OPCODE_ATHROW:
+            break;
+        default:
+            orLiveIn(a, live, in, next);
+            break;
+    }
+    Attribute_Code *attribute = a->method->codeAttribute;
+    for(int i=0;i<attribute->exception_table_length;i++){
+        ExceptionInfo *handler = &attribute->exception_table[i];
+        if(pc>=handler->start_pc && pc<handler->end_pc){
+            orLiveIn(a, live, in, handler->hanfler_pc);
+        }
+    }
+}
+
+// A new reached again takes the place of its previous object, which must
+// be dead by then: on no stack slot and in no local read again.
+static void checkReuse(Analysis *a){
+    uint32_t *in = (uint32_t*)Heap_AllocAtomic(sizeof(uint32_t)*a->localWords*a->count);
+    uint32_t *live = (uint32_t*)Heap_AllocAtomic(sizeof(uint32_t)*a->localWords);
+    memset(in, 0, sizeof(uint32_t)*a->localWords*a->count);
+    int changed = 1;
+    while(changed){
+        changed = 0;
+        for(int64_t insn=(int64_t)a->count-1;insn>=0;insn--){
+            if(-1==a->depths[insn]){
+                continue;
+            }
+            uint32_t pc = a->pcs[insn];
+            int32_t use, def;
+            int defCount;
+            memset(live, 0, sizeof(uint32_t)*a->localWords);
+            orSuccessors(a, live, in, pc);
+            localsEffect(a->code, pc, &use, &def, &defCount);
+            for(int i=0;-1!=def && i<defCount;i++){
+                live[(def+i)>>5] &= ~((uint32_t)1<<((def+i)&31));
+            }
+            if(-1!=use){
+                live[use>>5] |= (uint32_t)1<<(use&31);
+            }
+            uint32_t *cur = in + (size_t)insn*a->localWords;
+            if(0!=memcmp(cur, live, sizeof(uint32_t)*a->localWords)){
+                memcpy(cur, live, sizeof(uint32_t)*a->localWords);
+                changed = 1;
+            }
+        }
+    }
+    for(uint32_t i=0;i<a->sitesCount;i++){
+        uint32_t insn = a->index[a->sites[i]];
+        uint32_t bit = (uint32_t)1<<i;
+        if(-1==a->depths[insn]){
+            continue;
+        }
+        uint32_t *slots = a->states + (size_t)insn*a->slotsCount;
+        uint32_t *liveIn = in + (size_t)insn*a->localWords;
+        for(int j=0;j<a->maxLocals+a->depths[insn];j++){
+            if((slots[j] & bit) && (j>=a->maxLocals || REFMAP_TEST(liveIn, j))){
+                a->escaped |= bit;
+            }
+        }
+    }
+    Heap_Free(in);
+    Heap_Free(live);
+}
+
+// the sites escaped, all of them when the code could not be followed
+static uint32_t analyze(Analysis *a){
+    uint32_t escaped = UINT32_MAX;
+    Method *method = a->method;
+    uint32_t pc = 0;
+    a->constantPool = method->class->classfile->constant_pool;
+    a->constantPoolCount = method->class->classfile->constant_pool_count;
+    // the class file code, the VM may execute a rewritten copy of it
+    a->code = method->codeAttribute->code;
+    a->codeLength = method->codeLength;
+    a->maxLocals = method->maxLocals;
+    a->maxStack = method->maxStack;
+    a->slotsCount = method->maxLocals+method->maxStack;
+    a->localWords = 0==method->maxLocals ? 1 : (method->maxLocals+31)/32;
+    a->escaped = 0;
+    a->unresolved = 0;
+    a->count = 0;
+    a->worklistSize = 0;
+    if(NULL==a->sites && 0==a->maxLocals){
+        return escaped;
+    }
+    a->index = (uint32_t*)Heap_AllocAtomic(sizeof(uint32_t)*a->codeLength);
+    a->pcs = (uint32_t*)Heap_AllocAtomic(sizeof(uint32_t)*a->codeLength);
+    for(uint32_t i=0;i<a->codeLength;i++){
+        a->index[i] = CONST_REFMAP_NONE;
+    }
+    while(pc<a->codeLength){
+        int64_t length = Opcode_Length(a->code, a->codeLength, pc);
+        if(0>=length || pc+length>a->codeLength){
+            goto done;
+        }
+        a->index[pc] = a->count;
+        a->pcs[a->count++] = pc;
+        pc += (uint32_t)length;
+    }
+    a->states = (uint32_t*)Heap_AllocAtomic(sizeof(uint32_t)*((size_t)a->count*a->slotsCount+1));
+    a->depths = (int32_t*)Heap_AllocAtomic(sizeof(int32_t)*a->count);
+    a->worklist = (uint32_t*)Heap_AllocAtomic(sizeof(uint32_t)*a->count);
+    a->queued = (uint8_t*)Heap_AllocAtomic(a->count);
+    memset(a->queued, 0, a->count);
+    for(uint32_t i=0;i<a->count;i++){
+        a->depths[i] = -1;
+    }
+    if(0==forward(a)){
+        if(NULL!=a->sites){
+            checkReuse(a);
+        }
+        escaped = a->escaped;
+    }
+    Heap_Free(a->states);
+    Heap_Free(a->depths);
+    Heap_Free(a->worklist);
+    Heap_Free(a->queued);
+done:
+    Heap_Free(a->index);
+    Heap_Free(a->pcs);
+    return escaped;
+}
+
+// Whether the method leaves its receiver where its invoker put it. Racing
+// threads may both analyze it, and one of them may see the other's mark
+// and take the receiver as escaping; both are safe. An escape seen through
+// unresolved entries is left unsettled and passed on to the caller.
+static int keepsThis(Analysis *caller, Method *method){
+    uint8_t state = __atomic_load_n(&method->thisEscape, __ATOMIC_RELAXED);
+    if(CONST_ESCAPE_UNKNOWN!=state){
+        return CONST_ESCAPE_NO==state;
+    }
+    int kept = 0;
+    if(!(method->accessFlags & (CONST_METHOD_ACCESS_STATIC|CONST_METHOD_ACCESS_SYNCHRONIZED))
+        && NULL==method->intrinsic && 0!=method->codeLength){
+        Analysis a;
+        a.method = method;
+        a.sites = NULL;
+        a.classes = NULL;
+        a.sitesCount = 0;
+        a.depth = caller->depth+1;
+        __atomic_store_n(&method->thisEscape, CONST_ESCAPE_PENDING, __ATOMIC_RELAXED);
+        kept = 0==(analyze(&a) & THIS_BIT);
+        if(!kept && a.unresolved){
+            caller->unresolved = 1;
+            __atomic_store_n(&method->thisEscape, CONST_ESCAPE_UNKNOWN, __ATOMIC_RELAXED);
+            return 0;
+        }
+    }
+    __atomic_store_n(&method->thisEscape, kept ? CONST_ESCAPE_NO : CONST_ESCAPE_YES, __ATOMIC_RELAXED);
+    return kept;
+}
+
+static int instantiable(Class *class){
+    return NULL!=class && (NULL==class->classfile
+        || !(class->classfile->access_flags & (CONST_CLASSFILE_ACCESS_INTERFACE|CONST_CLASSFILE_ACCESS_ABSTRACT)));
+}
+
+EscapeMap* Escape_Compute(Method *method, int *settled){
+    *settled = 1;
+    if(NULL==method->code || 0==method->codeLength){
+        return NULL;
+    }
+    uint8_t *code = method->codeAttribute->code;
+    uint32_t sites[CONST_ESCAPE_MAX_SITES];
+    Class *classes[CONST_ESCAPE_MAX_SITES];
+    Analysis a;
+    a.method = method;
+    a.sites = sites;
+    a.classes = classes;
+    a.sitesCount = 0;
+    a.depth = 0;
+    int unresolved = 0;
+    for(uint32_t pc=0;pc<method->codeLength && a.sitesCount<CONST_ESCAPE_MAX_SITES;){
+        int64_t length = Opcode_Length(code, method->codeLength, pc);
+        if(0>=length){
+            return NULL;
+        }
+        if(CONST_OPCODE_NEW==code[pc] && pc+2<method->codeLength){
+            Class *class = (Class*)resolvedEntry(method->class, readU16(code+pc+1));
+            unresolved |= NULL==class;
+            sites[a.sitesCount] = pc;
+            classes[a.sitesCount++] = instantiable(class) ? class : NULL;
+        }
+        pc += (uint32_t)length;
+    }
+    if(0==a.sitesCount){
+        return NULL;
+    }
+    uint32_t escaped = analyze(&a);
+    *settled = !unresolved && !a.unresolved;
+    EscapeSite kept[CONST_ESCAPE_MAX_SITES];
+    uint16_t keptCount = 0;
+    uint32_t size = 0;
+    for(uint32_t i=0;i<a.sitesCount;i++){
+        Class *class = classes[i];
+        if((escaped & ((uint32_t)1<<i)) || NULL==class){
+            continue;
+        }
+        // objects are 8-byte aligned, compressed references rely on it
+        uint32_t objectSize = (class->instanceSize+7)&~(uint32_t)7;
+        if(size+objectSize>CONST_ESCAPE_MAX_SIZE){
+            continue;
+        }
+        kept[keptCount++] = (EscapeSite){sites[i], size, class};
+        size += objectSize;
+    }
+    if(0==keptCount){
+        return NULL;
+    }
+    EscapeMap *map = (EscapeMap*)Heap_AllocPermanent(sizeof(EscapeMap));
+    map->size = size;
+    map->sitesCount = keptCount;
+    map->sites = (EscapeSite*)Heap_AllocPermanent(sizeof(EscapeSite)*keptCount);
+    memcpy(map->sites, kept, sizeof(EscapeSite)*keptCount);
+    return map;
+}
+
+// The objects of a frame are allocated with its first new kept there, and
+// zeroed again whenever their site is reached. They are never scanned as
+// memory, see Frame_ScanRoots.
+Object* Escape_New(Frame *frame, EscapeMap *map, Class *class){
+    EscapeSite *site = NULL;
+    for(int i=0;i<map->sitesCount && map->sites[i].pc<=frame->pc;i++){
+        if(frame->pc==map->sites[i].pc){
+            site = &map->sites[i];
+            break;
+        }
+    }
+    if(NULL==site || class!=site->class){
+        return NULL;
+    }
+    if(NULL==frame->objects){
+        uint8_t *objects = (uint8_t*)Heap_AllocAtomic(map->size);
+        if(NULL==objects){
+            return NULL;
+        }
+        if(!REF_ENCODABLE(objects, map->size)){
+            Heap_Free(objects);
+            return NULL;
+        }
+        memset(objects, 0, map->size);
+        frame->objects = objects;
+    }
+    Object *object = (Object*)(frame->objects + site->offset);
+    memset(object, 0, class->instanceSize);
+    object->header.class = class;
+    object->header.mark = CONST_HEADER_OBJECT|CONST_HEADER_FRAME;
+    return object;
+}
@@ -0,0 +1,336 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INCLUDE_RUNTIME_EXCEPTION_SELF 1
+#include "runtime/exception.h"
+#include "runtime/class.h"
+#include "runtime/method.h"
+#include "runtime/object.h"
+#include "runtime/frame.h"
+#include "runtime/thread.h"
+#include "runtime/monitor.h"
+#include "runtime/heap.h"
+#include "runtime/linetable.h"
+#include "classfile/classfile.h"
+#include "classfile/op.h"
+#include "utils.h"
+
+static const char *preallocatedNames[CONST_EXCEPTION_PREALLOCATED_COUNT] = {
+    "java/lang/NullPointerException",
+    "java/lang/ArithmeticException",
+    "java/lang/ArrayIndexOutOfBoundsException",
+    "java/lang/NegativeArraySizeException",
+    "java/lang/ClassCastException",
+    "java/lang/ArrayStoreException",
+    "java/lang/IllegalMonitorStateException",
+    "java/lang/OutOfMemoryError",
+    "java/lang/StackOverflowError",
+    "java/lang/InterruptedException",
+    "java/lang/NoClassDefFoundError",
+    "java/lang/BootstrapMethodError"
+};
+
+// old objects, kept alive by this (scanned) static array
+static Object *preallocated[CONST_EXCEPTION_PREALLOCATED_COUNT];
+
+static int comparePc(const void *a, const void *b){
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return x<y ? -1 : x>y;
+}
+
+HandlerTable* Exception_NewHandlerTable(Attribute_Code *code){
+    uint16_t count = code->exception_table_length;
+    if(0==count){
+        return NULL;
+    }
+    HandlerTable *table = (HandlerTable*)Heap_AllocPermanent(sizeof(HandlerTable));
+    table->handlersCount = count;
+    table->handlers = (Handler*)Heap_AllocPermanent(sizeof(Handler)*count);
+    for(int i=0;i<count;i++){
+        ExceptionInfo *info = &code->exception_table[i];
+        table->handlers[i].startPc = info->start_pc;
+        table->handlers[i].endPc = info->end_pc;
+        table->handlers[i].handlerPc = info->hanfler_pc;
+        table->handlers[i].catchType = info->catch_type;
+        table->handlers[i].catchClass = NULL;
+    }
+
+    // every start and end is an interval boundary
+    uint32_t *points = (uint32_t*)Heap_AllocAtomic(sizeof(uint32_t)*count*2);
+    uint32_t pointsCount = 0;
+    for(int i=0;i<count;i++){
+        points[pointsCount++] = table->handlers[i].startPc;
+        points[pointsCount++] = table->handlers[i].endPc;
+    }
+    qsort(points, pointsCount, sizeof(uint32_t), comparePc);
+    uint32_t unique = 1;
+    for(uint32_t i=1;i<pointsCount;i++){
+        if(points[i]!=points[unique-1]){
+            points[unique++] = points[i];
+        }
+    }
+    table->intervalsCount = unique-1;
+    table->starts = (uint32_t*)Heap_AllocPermanentAtomic(sizeof(uint32_t)*unique);
+    memcpy(table->starts, points, sizeof(uint32_t)*unique);
+    Heap_Free(points);
+
+    table->first = (uint32_t*)Heap_AllocPermanentAtomic(sizeof(uint32_t)*unique);
+    uint32_t candidates = 0;
+    for(uint32_t i=0;i<table->intervalsCount;i++){
+        for(int j=0;j<count;j++){
+            candidates += table->handlers[j].startPc<=table->starts[i] && table->starts[i]<table->handlers[j].endPc;
+        }
+    }
+    table->candidates = (uint16_t*)Heap_AllocPermanentAtomic(sizeof(uint16_t)*(candidates+1));
+    candidates = 0;
+    for(uint32_t i=0;i<table->intervalsCount;i++){
+        table->first[i] = candidates;
+        for(int j=0;j<count;j++){
+            if(table->handlers[j].startPc<=table->starts[i] && table->starts[i]<table->handlers[j].endPc){
+                table->candidates[candidates++] = (uint16_t)j;
+            }
+        }
+    }
+    table->first[table->intervalsCount] = candidates;
+    return table;
+}
+
+// a catch class that is not loaded yet cannot be a superclass of the thrown one
+static Class* catchClass(Class *class, Handler *handler){
+    Class *catchClass = __atomic_load_n(&handler->catchClass, __ATOMIC_ACQUIRE);
+    if(NULL==catchClass){
+        catchClass = Class_ResolveClass(class, handler->catchType);
+        if(NULL!=catchClass){
+            __atomic_store_n(&handler->catchClass, catchClass, __ATOMIC_RELEASE);
+        }
+    }
+    return catchClass;
+}
+
+uint32_t Exception_FindHandler(Method *method, uint32_t pc, Class *thrown){
+    HandlerTable *table = method->handlers;
+    if(NULL==table || pc<table->starts[0] || pc>=table->starts[table->intervalsCount]){
+        return CONST_EXCEPTION_NO_HANDLER;
+    }
+    // starts[low] <= pc < starts[high]
+    uint32_t low = 0;
+    uint32_t high = table->intervalsCount;
+    while(high-low>1){
+        uint32_t mid = (low+high)/2;
+        if(table->starts[mid]<=pc){
+            low = mid;
+        }else{
+            high = mid;
+        }
+    }
+    for(uint32_t i=table->first[low];i<table->first[low+1];i++){
+        Handler *handler = &table->handlers[table->candidates[i]];
+        if(0==handler->catchType){
+            return handler->handlerPc;
+        }
+        Class *class = catchClass(method->class, handler);
+        if(NULL!=class && Class_IsSubclassOf(thrown, class)){
+            return handler->handlerPc;
+        }
+    }
+    return CONST_EXCEPTION_NO_HANDLER;
+}
+
+// The synchronized methods of the frames popped release their monitor,
+// unbalanced ones are not reported, the exception in flight wins.
+// Frames below the innermost interpreter entry belong to the java code
+// that called into native code, they see the exception once it returns.
+int Exception_Throw(Frame *frame, Object *exception){
+    Thread *thread = frame->thread;
+    Class *thrown = exception->header.class;
+    for(Frame *cur=frame;NULL!=cur && cur!=thread->javaBase;cur=cur->lower){
+        if(NULL==cur->method){
+            continue;
+        }
+        uint32_t handlerPc = Exception_FindHandler(cur->method, cur->pc, thrown);
+        if(CONST_EXCEPTION_NO_HANDLER==handlerPc){
+            continue;
+        }
+        // nothing to pop when it is caught in the method that threw it
+        while(thread->stack->_top!=cur){
+            Monitor_ExitFrame(Thread_PopFrame(thread));
+        }
+        cur->operandStack->size = 1;
+        cur->operandStack->data[0].ref = REF_ENCODE(exception);
+        cur->nextPc = handlerPc;
+        return 0;
+    }
+    while(thread->stack->_top!=thread->javaBase){
+        Monitor_ExitFrame(Thread_PopFrame(thread));
+    }
+    thread->exception = exception;
+    return -1;
+}
+
+Object* Exception_Preallocated(int kind){
+    Object *exception = __atomic_load_n(&preallocated[kind], __ATOMIC_ACQUIRE);
+    if(NULL!=exception){
+        return exception;
+    }
+    Class *class = Class_Find((uint8_t*)preallocatedNames[kind]);
+    if(NULL==class){
+        return NULL;
+    }
+    exception = Object_NewOld(class);
+    if(NULL==exception){
+        return NULL;
+    }
+    Object *expected = NULL;
+    if(!__atomic_compare_exchange_n(&preallocated[kind], &expected, exception, 0, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)){
+        return expected;
+    }
+    return exception;
+}
+
+// The instruction has already taken its operands, it cannot go on without
+// the exception: the frames of the interpreter run are dropped, and every
+// enclosing run drops its own as it gets back control.
+int Exception_ThrowVM(Frame *frame, int kind){
+    Object *exception = Exception_Preallocated(kind);
+    if(NULL==exception){
+        Thread *thread = frame->thread;
+        error("[FIXME] %s thrown before its class is loaded, thread %u aborted.", preallocatedNames[kind], thread->id);
+        Exception_Abort(thread);
+        return -1;
+    }
+    return Exception_Throw(frame, exception);
+}
+
+void Exception_Abort(Thread *thread){
+    thread->aborted = 1;
+    while(thread->stack->_top!=thread->javaBase){
+        Monitor_ExitFrame(Thread_PopFrame(thread));
+    }
+}
+
+static uint32_t backtraceOffset = CONST_FIELD_OFFSET_NONE;
+
+// resolved once, every throwable inherits the field from java/lang/Throwable
+static Ref* backtraceSlot(Object *throwable){
+    uint32_t offset = __atomic_load_n(&backtraceOffset, __ATOMIC_ACQUIRE);
+    if(CONST_FIELD_OFFSET_NONE==offset){
+        Class *class = Class_Find((uint8_t*)"java/lang/Throwable");
+        if(NULL==class){
+            return NULL;
+        }
+        offset = Class_FieldOffset(class, (uint8_t*)"backtrace", (uint8_t*)"Ljava/lang/Object;");
+        if(CONST_FIELD_OFFSET_NONE==offset){
+            return NULL;
+        }
+        __atomic_store_n(&backtraceOffset, offset, __ATOMIC_RELEASE);
+    }
+    return (Ref*)((uint8_t*)throwable + offset);
+}
+
+// the throwable's own constructors and fillInStackTrace are left out
+static int isFillingFrame(Frame *frame, Object *throwable){
+    Method *method = frame->method;
+    return (utf8ascii_equals(method->name, "fillInStackTrace") || utf8ascii_equals(method->name, "<init>"))
+        && Class_IsSubclassOf(throwable->header.class, method->class);
+}
+
+int Exception_FillInStackTrace(Object *throwable, Frame *frame){
+    Ref *slot = backtraceSlot(throwable);
+    if(NULL==slot){
+        return -1;
+    }
+    while(NULL!=frame && (NULL==frame->method || isFillingFrame(frame, throwable))){
+        frame = frame->lower;
+    }
+    uint32_t depth = 0;
+    for(Frame *cur=frame;NULL!=cur;cur=cur->lower){
+        depth += NULL!=cur->method;
+    }
+    // a long[] of pairs: methods are permanent, so no reference to trace
+    ArrayObject *backtrace = ArrayObject_New(CONST_ARRAY_TYPE_LONG, depth*2);
+    if(NULL==backtrace){
+        return -1;
+    }
+    int64_t *pairs = (int64_t*)backtrace->data;
+    for(Frame *cur=frame;NULL!=cur;cur=cur->lower){
+        if(NULL!=cur->method){
+            *pairs++ = (int64_t)(intptr_t)cur->method;
+            *pairs++ = cur->pc;
+        }
+    }
+    Heap_WriteRef(throwable, slot, backtrace);
+    return 0;
+}
+
+static ArrayObject* backtraceOf(Object *throwable){
+    Ref *slot = backtraceSlot(throwable);
+    return NULL==slot ? NULL : (ArrayObject*)REF_DECODE(*slot);
+}
+
+int32_t Exception_StackTraceDepth(Object *throwable){
+    ArrayObject *backtrace = backtraceOf(throwable);
+    return NULL==backtrace ? 0 : (int32_t)(backtrace->length/2);
+}
+
+static uint8_t* sourceFile(Class *class){
+    ClassFile *classfile = class->classfile;
+    if(NULL==classfile){
+        return NULL;
+    }
+    for(int i=0;i<classfile->attributes_count;i++){
+        Attribute_SourceFile *attribute = (Attribute_SourceFile*)classfile->attributes[i];
+        if(utf8ascii_equals(CLZFILE_cp_getUTF8(classfile->constant_pool, attribute->attribute_name_index), "SourceFile")){
+            return CLZFILE_cp_getUTF8(classfile->constant_pool, attribute->sourcefile_index);
+        }
+    }
+    return NULL;
+}
+
+int Exception_StackTraceElement(Object *throwable, int32_t index, StackTraceElement *element){
+    ArrayObject *backtrace = backtraceOf(throwable);
+    if(NULL==backtrace || 0>index || (uint32_t)index>=backtrace->length/2){
+        return -1;
+    }
+    int64_t *pair = (int64_t*)backtrace->data + 2*index;
+    Method *method = (Method*)(intptr_t)pair[0];
+    element->className = method->class->name;
+    element->methodName = method->name;
+    element->sourceFile = sourceFile(method->class);
+    if(method->accessFlags & CONST_METHOD_ACCESS_NATIVE){
+        element->line = -2;
+    }else{
+        element->line = LineTable_Lookup(method->lines, (uint32_t)pair[1]);
+    }
+    return 0;
+}
+
+static void printClassName(uint8_t *name, FILE *out){
+    for(;0!=*name;name++){
+        fputc('/'==*name ? '.' : *name, out);
+    }
+}
+
+void Exception_PrintStackTrace(Object *throwable, FILE *out){
+    StackTraceElement element;
+    printClassName(throwable->header.class->name, out);
+    fputc('\n', out);
+    int32_t depth = Exception_StackTraceDepth(throwable);
+    for(int32_t i=0;i<depth;i++){
+        Exception_StackTraceElement(throwable, i, &element);
+        fputs("\tat ", out);
+        printClassName(element.className, out);
+        fprintf(out, ".%s(", element.methodName);
+        if(-2==element.line){
+            fputs("Native Method", out);
+        }else if(NULL==element.sourceFile){
+            fputs("Unknown Source", out);
+        }else if(0<=element.line){
+            fprintf(out, "%s:%d", element.sourceFile, element.line);
+        }else{
+            fputs((char*)element.sourceFile, out);
+        }
+        fputs(")\n", out);
+    }
+}
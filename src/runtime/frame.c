@@ -1,24 +1,117 @@
 #include <stdint.h>
+#include <string.h>
 
 #define INCLUDE_RUNTIME_FRAME_SELF 1
 #include "runtime/frame.h"
+#include "runtime/heap.h"
+#include "runtime/refmap.h"
+#include "runtime/escape.h"
+#include "runtime/object.h"
+#include "runtime/safepoint.h"
 #include "utils.h"
 
 Frame* Frame_New(unsigned int maxLocal, unsigned int maxOperandStack){
-    Frame *frame = (Frame*)GC_malloc(sizeof(Frame));
+    Frame *frame = (Frame*)Heap_Alloc(sizeof(Frame));
     frame->maxLocal = maxLocal;
     frame->localVars = ValueSlot_New(maxLocal);
     frame->operandStack = OperandStack_New(maxOperandStack);
     frame->lower = NULL;
+    frame->class = NULL;
+    frame->method = NULL;
+    frame->refMap = NULL;
+    frame->thread = NULL;
+    frame->code = NULL;
+    frame->codeLength = 0;
+    frame->pc = 0;
+    frame->nextPc = 0;
+    frame->objects = NULL;
+    frame->lock = REF_ENCODE(NULL);
     return frame;
 }
 
+Frame* Frame_NewMethod(Method *method){
+    Frame *frame = Frame_New(method->maxLocals, method->maxStack);
+    frame->class = method->class;
+    frame->method = method;
+    frame->code = method->code;
+    frame->codeLength = method->codeLength;
+    frame->refMap = Method_RefMap(method);
+    return frame;
+}
+
+static void scanAmbiguously(Frame *frame, Frame_RootFn ambiguous, void *data){
+    for(unsigned int i=0;i<frame->maxLocal;i++){
+        ambiguous(&frame->localVars[i].ref, data);
+    }
+    for(unsigned int i=0;i<frame->operandStack->size;i++){
+        ambiguous(&frame->operandStack->data[i].ref, data);
+    }
+}
+
+// The objects allocated in the frame always hold references in their
+// reference fields, mapped or not. A site not reached yet has no header.
+static void scanObjects(Frame *frame, Frame_RootFn precise, void *data){
+    EscapeMap *map = frame->method->escapeMap;
+    for(uint16_t i=0;i<map->sitesCount;i++){
+        Object *object = (Object*)(frame->objects + map->sites[i].offset);
+        Class *class = map->sites[i].class;
+        if(0==object->header.mark){
+            continue;
+        }
+        for(uint16_t j=0;j<class->refFieldsCount;j++){
+            precise((Ref*)((uint8_t*)object + class->refOffsets[j]), data);
+        }
+    }
+}
+
+// Maps describe the slots between two instructions, which only holds for
+// a thread stopped at a safepoint: the instructions that poll or allocate
+// have popped their operands by then and pushed nothing yet. Slots above
+// the mapped stack depth belong to an instruction half way through.
+void Frame_ScanRoots(Frame *frame, Frame_RootFn precise, Frame_RootFn ambiguous, void *data){
+    RefMap *map = frame->refMap;
+    uint32_t entry = CONST_REFMAP_NONE;
+    if(NULL!=frame->objects){
+        scanObjects(frame, precise, data);
+    }
+    if(NULL!=REF_DECODE(frame->lock)){
+        precise(&frame->lock, data);
+    }
+    if(NULL!=map && frame->pc<frame->codeLength && __atomic_load_n(&Safepoint_Reached, __ATOMIC_ACQUIRE)){
+        entry = map->entries[frame->pc];
+    }
+    if(CONST_REFMAP_NONE==entry){
+        scanAmbiguously(frame, ambiguous, data);
+        return;
+    }
+    uint32_t *bits = map->bits + (size_t)entry*map->words;
+    uint16_t depth = map->depths[entry];
+    for(uint16_t i=0;i<map->maxLocals;i++){
+        if(REFMAP_TEST(bits, i)){
+            precise(&frame->localVars[i].ref, data);
+        }
+    }
+    OperandStack *stack = frame->operandStack;
+    for(unsigned int i=0;i<stack->size;i++){
+        if(i>=depth){
+            ambiguous(&stack->data[i].ref, data);
+        }else if(REFMAP_TEST(bits, map->maxLocals+i)){
+            precise(&stack->data[i].ref, data);
+        }
+    }
+}
+
+// slots are reported to the collectors by Frame_ScanRoots, never scanned as memory
 ValueSlot* ValueSlot_New(unsigned int maxLocal){
-   return (ValueSlot*)GC_malloc(sizeof(ValueSlot)*maxLocal);
+    ValueSlot *slots = (ValueSlot*)Heap_AllocAtomic(sizeof(ValueSlot)*maxLocal);
+    if(NULL!=slots){
+        memset(slots, 0, sizeof(ValueSlot)*maxLocal);
+    }
+    return slots;
 }
 
 OperandStack* OperandStack_New(unsigned int maxSize){
-    OperandStack *stack = (OperandStack*)GC_malloc(sizeof(OperandStack));
+    OperandStack *stack = (OperandStack*)Heap_Alloc(sizeof(OperandStack));
     stack->maxSize = maxSize;
     stack->size = 0;
     stack->data = ValueSlot_New(maxSize);
@@ -64,8 +157,8 @@ int OperandStack_PushLong(OperandStack *stack, int64_t value){
         error("[FIXME] jvm operand stack overflow.");
         return -1;
     }
-    stack->data[stack->size++].num = int32_t(value);
-    stack->data[stack->size++].num = int32_t(value >> 32);
+    SLOT_SET_LONG(&stack->data[stack->size], value);
+    stack->size += 2;
     return 0;
 }
 
@@ -74,19 +167,27 @@ int64_t  OperandStack_PopLong(OperandStack *stack){
         error("[FIXME] jvm operand stack overflow.");
         return -1;
     }
-    uint32_t high = stack->data[--stack->size].num;
-    uint32_t low = stack->data[--stack->size].num;
-    return int64_t(high)<<32 | int64_t(low);
+    stack->size -= 2;
+    return SLOT_GET_LONG(&stack->data[stack->size]);
 }
 
 int OperandStack_PushDouble(OperandStack *stack, double value){
-    int64_t bits = ieee754_double2bin(value);
-    return OperandStack_PushLong(stack, bits);
+    if(stack->size+1>=stack->maxSize){
+        error("[FIXME] jvm operand stack overflow.");
+        return -1;
+    }
+    SLOT_SET_DOUBLE(&stack->data[stack->size], value);
+    stack->size += 2;
+    return 0;
 }
 
-double  OperandStack_PopLong(OperandStack *stack){
-    int64_t value = OperandStack_PopLong(stack);
-    return ieee754_bin2double(value);
+double  OperandStack_PopDouble(OperandStack *stack){
+    if(1>=stack->size){
+        error("[FIXME] jvm operand stack overflow.");
+        return -1;
+    }
+    stack->size -= 2;
+    return SLOT_GET_DOUBLE(&stack->data[stack->size]);
 }
 
 int OperandStack_PushRef(OperandStack *stack, void *value){
@@ -94,17 +195,17 @@ int OperandStack_PushRef(OperandStack *stack, void *value){
         error("[FIXME] jvm operand stack overflow.");
         return -1;
     }
-    stack->data[stack->size++].ref = value;
+    stack->data[stack->size++].ref = REF_ENCODE(value);
     return 0;
 }
 
-int32_t  OperandStack_PopRef(OperandStack *stack){
+void*  OperandStack_PopRef(OperandStack *stack){
     if(0>=stack->size){
         error("[FIXME] jvm operand stack overflow.");
-        return -1;
+        return NULL;
     }
-    void *value = stack->data[--stack->size].ref;
-    stack->data[stack->size].ref = NULL;
+    void *value = REF_DECODE(stack->data[--stack->size].ref);
+    stack->data[stack->size].ref = 0;
     return value;
 }
 
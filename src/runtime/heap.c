@@ -0,0 +1,247 @@
+#include <stdint.h>
+#include <string.h>
+#include "gc.h"
+#include "gc_typed.h"
+
+#define INCLUDE_RUNTIME_HEAP_SELF 1
+#include "runtime/heap.h"
+#include "runtime/ref.h"
+#include "utils.h"
+
+#include "gc_mark.h"
+#include "runtime/object.h"
+#include "runtime/class.h"
+#include "runtime/thread.h"
+#include "runtime/frame.h"
+
+static void* bdwgc_allocObject(uint32_t size, uint8_t kind, GC_descr descr){
+    return Heap_AllocOld(size, kind, descr);
+}
+
+static void bdwgc_writeRef(void *holder, Ref *slot, void *value){
+    *slot = REF_ENCODE(value);
+}
+
+static void bdwgc_collect(void){
+    GC_gcollect();
+}
+
+static HeapOp bdwgcHeapOp = {
+    "bdwgc",
+    bdwgc_allocObject,
+    bdwgc_writeRef,
+    bdwgc_collect,
+    NULL
+};
+
+static HeapOp *heap = &bdwgcHeapOp;
+
+#define HEAP_ROOTS_INITIAL_SIZE 1024
+
+static GC_push_other_roots_proc nextPushRoots;
+static void **roots;
+static size_t rootsSize;
+static size_t rootsCapacity;
+
+#ifdef JVM_COMPRESSED_REFS
+static int refsKind;
+
+// bdwgc cannot recognize a compressed reference, objects holding some are
+// allocated in their own kind and traced through their class layout
+static struct GC_ms_entry* markObject(GC_word *addr, struct GC_ms_entry *msp, struct GC_ms_entry *lim, GC_word env){
+    Object *object = (Object*)addr;
+    Ref *slot;
+    if(0==object->header.mark){
+        // allocated, header not written yet
+        return msp;
+    }
+    if(object->header.mark & CONST_HEADER_ARRAY){
+        ArrayObject *array = (ArrayObject*)object;
+        for(uint32_t i=0;i<array->length;i++){
+            slot = (Ref*)array->data + i;
+            if(0!=*slot){
+                msp = GC_MARK_AND_PUSH(REF_DECODE(*slot), msp, lim, (void**)addr);
+            }
+        }
+        return msp;
+    }
+    Class *class = object->header.class;
+    for(int i=0;i<class->refFieldsCount;i++){
+        slot = (Ref*)((uint8_t*)object + class->refOffsets[i]);
+        if(0!=*slot){
+            msp = GC_MARK_AND_PUSH(REF_DECODE(*slot), msp, lim, (void**)addr);
+        }
+    }
+    return msp;
+}
+#endif
+
+static void addRoot(void *ptr){
+    if(NULL==ptr){
+        return;
+    }
+    if(rootsSize>=rootsCapacity){
+        size_t capacity = 0==rootsCapacity ? HEAP_ROOTS_INITIAL_SIZE : rootsCapacity*2;
+        void **grown = (void**)GC_malloc_atomic_uncollectable(sizeof(void*)*capacity);
+        if(NULL==grown){
+            error("[FIXME] unable to grow the root buffer.");
+            return;
+        }
+        memcpy(grown, roots, sizeof(void*)*rootsSize);
+        GC_free(roots);
+        roots = grown;
+        rootsCapacity = capacity;
+    }
+    roots[rootsSize++] = ptr;
+}
+
+static void addSlotRoot(Ref *slot, void *data){
+    addRoot(REF_DECODE(*slot));
+}
+
+// only live references when the world is stopped at a safepoint, every slot otherwise
+static void addFrameRoots(Thread *thread, void *data){
+    for(Frame *frame=thread->stack->_top;NULL!=frame;frame=frame->lower){
+        Frame_ScanRoots(frame, addSlotRoot, addSlotRoot, NULL);
+    }
+}
+
+#ifdef JVM_COMPRESSED_REFS
+static void addStaticRoots(Class *class, void *data){
+    for(int i=0;i<class->staticRefFieldsCount;i++){
+        addRoot(REF_DECODE(*(Ref*)(class->staticFields + class->staticRefOffsets[i])));
+    }
+}
+#endif
+
+// frame slots are atomic memory, their references (decoded when compressed)
+// are collected into a buffer scanned like any other root range
+static void pushOtherRoots(void){
+    rootsSize = 0;
+    Thread_ForEach(addFrameRoots, NULL);
+#ifdef JVM_COMPRESSED_REFS
+    Class_ForEach(addStaticRoots, NULL);
+    if(NULL!=heap->MarkRoots){
+        heap->MarkRoots(addRoot);
+    }
+#endif
+    if(0<rootsSize){
+        GC_push_all(roots, roots+rootsSize);
+    }
+    if(NULL!=nextPushRoots){
+        nextPushRoots();
+    }
+}
+
+#ifdef JVM_COMPRESSED_REFS
+// The Makefile configures bdwgc for sbrk only and fails the build
+// otherwise, with a non-PIE binary the heap then grows from just above the
+// data segment. bdwgc still falls back to mmap once sbrk fails, so every
+// allocation that is to be referenced compressed is checked as well.
+static void initCompressedRefs(void){
+    refsKind = GC_new_kind(GC_new_free_list(), GC_MAKE_PROC(GC_new_proc(markObject), 0), 0, 1);
+    GC_set_max_heap_size(CONST_REF_HEAP_LIMIT);
+}
+#endif
+
+int Heap_Init(int backend, size_t nurserySize){
+    GC_init();
+    nextPushRoots = GC_get_push_other_roots();
+    GC_set_push_other_roots(pushOtherRoots);
+#ifdef JVM_COMPRESSED_REFS
+    initCompressedRefs();
+#endif
+    switch(backend){
+        case CONST_HEAP_BACKEND_BDWGC:
+            heap = &bdwgcHeapOp;
+            return 0;
+        case CONST_HEAP_BACKEND_GENERATIONAL:
+            heap = Nursery_New(0==nurserySize ? DEFAULT_NURSERY_SIZE : nurserySize);
+            if(NULL==heap){
+                error("Unable to reserve the nursery, falling back to bdwgc.");
+                heap = &bdwgcHeapOp;
+                return -1;
+            }
+            return 0;
+        default:
+            error("Unknown heap backend: %d.", backend);
+            return -1;
+    }
+}
+
+HeapOp* Heap_Current(void){
+    return heap;
+}
+
+void* Heap_Alloc(size_t size){
+    return GC_malloc(size);
+}
+
+void* Heap_AllocAtomic(size_t size){
+    return GC_malloc_atomic(size);
+}
+
+// classes are permanent, their lock header is referenced like an object
+void* Heap_AllocPermanent(size_t size){
+    void *ptr = GC_malloc_uncollectable(size);
+    if(NULL!=ptr && !REF_ENCODABLE(ptr, size)){
+        error("OutOfMemoryError. Permanent block at %p is out of the compressed reference range.", ptr);
+        GC_free(ptr);
+        return NULL;
+    }
+    return ptr;
+}
+
+void* Heap_AllocPermanentAtomic(size_t size){
+    void *ptr = GC_malloc_atomic_uncollectable(size);
+    if(NULL!=ptr){
+        memset(ptr, 0, size);
+    }
+    return ptr;
+}
+
+void Heap_Free(void *ptr){
+    GC_free(ptr);
+}
+
+void* Heap_AllocObject(uint32_t size, uint8_t kind, GC_descr descr){
+    return heap->AllocObject(size, kind, descr);
+}
+
+// the bdwgc-managed space, also where the nursery promotes survivors to
+void* Heap_AllocOld(uint32_t size, uint8_t kind, GC_descr descr){
+    void *ptr;
+    switch(kind){
+        case CONST_HEAP_KIND_ATOMIC:
+            ptr = GC_malloc_atomic(size);
+            if(NULL!=ptr){
+                memset(ptr, 0, size);
+            }
+            break;
+#ifdef JVM_COMPRESSED_REFS
+        default:
+            ptr = GC_generic_malloc(size, refsKind);
+            break;
+#else
+        case CONST_HEAP_KIND_TYPED:
+            ptr = GC_malloc_explicitly_typed(size, descr);
+            break;
+        default:
+            ptr = GC_malloc(size);
+            break;
+#endif
+    }
+    if(NULL!=ptr && !REF_ENCODABLE(ptr, size)){
+        error("OutOfMemoryError. Object at %p is out of the compressed reference range.", ptr);
+        return NULL;
+    }
+    return ptr;
+}
+
+void Heap_WriteRef(void *holder, Ref *slot, void *value){
+    heap->WriteRef(holder, slot, value);
+}
+
+void Heap_Collect(void){
+    heap->Collect();
+}
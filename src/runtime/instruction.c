@@ -1,6 +1,73 @@
+#include <stdint.h>
+#include <stddef.h>
 
 #define INCLUDE_RUNTIME_INSTRUCTION_SELF 1
-#include "classfile/instruction.h"
+#include "runtime/instruction.h"
 
+static Instruction instructions[256];
+static int initialized = 0;
 
+static void initInstructions(void){
+    Instructions_InitConstants(instructions);
+    Instructions_InitLoads(instructions);
+    Instructions_InitStores(instructions);
+    Instructions_InitMath(instructions);
+    Instructions_InitConversions(instructions);
+    Instructions_InitComparisons(instructions);
+    Instructions_InitReferences(instructions);
+    Instructions_InitControl(instructions);
+    initialized = 1;
+}
 
+Instruction* Instruction_Get(uint8_t opcode){
+    if(!initialized){
+        initInstructions();
+    }
+    if(NULL==instructions[opcode].Execute){
+        return NULL;
+    }
+    return &instructions[opcode];
+}
+
+void* Instruction_FetchNone(Stream *reader){
+    return NULL;
+}
+
+void* Instruction_FetchIndex(Stream *reader){
+    uint8_t index = 0;
+    ((StreamReaderOp*)reader->reader)->ReadUint8(reader, &index);
+    return (void*)(uintptr_t)index;
+}
+
+void* Instruction_FetchWideIndex(Stream *reader){
+    uint16_t index = 0;
+    ((StreamReaderOp*)reader->reader)->ReadUint16(reader, &index);
+    return (void*)(uintptr_t)index;
+}
+
+void* Instruction_FetchInvokeIndex(Stream *reader){
+    uint16_t index = 0;
+    ((StreamReaderOp*)reader->reader)->ReadUint16(reader, &index);
+    ((StreamReaderOp*)reader->reader)->Skip(reader, 2);
+    return (void*)(uintptr_t)index;
+}
+
+void* Instruction_FetchBranch(Stream *reader){
+    uint16_t offset = 0;
+    ((StreamReaderOp*)reader->reader)->ReadUint16(reader, &offset);
+    return (void*)(intptr_t)(int16_t)offset;
+}
+
+void* Instruction_FetchWideBranch(Stream *reader){
+    uint32_t offset = 0;
+    ((StreamReaderOp*)reader->reader)->ReadUint32(reader, &offset);
+    return (void*)(intptr_t)(int32_t)offset;
+}
+
+void* Instruction_FetchIncrement(Stream *reader){
+    uint8_t index = 0;
+    uint8_t value = 0;
+    ((StreamReaderOp*)reader->reader)->ReadUint8(reader, &index);
+    ((StreamReaderOp*)reader->reader)->ReadUint8(reader, &value);
+    return (void*)(uintptr_t)(index | (uintptr_t)value<<8);
+}
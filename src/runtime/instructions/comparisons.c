@@ -0,0 +1,118 @@
+#include <stdint.h>
+
+#include "runtime/instruction.h"
+#include "runtime/opcode.h"
+#include "runtime/frame.h"
+
+INSTRUCTION_TEXT static void lcmp(Frame *frame, void *data){
+    OperandStack *stack = frame->operandStack;
+    ValueSlot *slot1 = &stack->data[stack->size-4];
+    int64_t value1 = SLOT_GET_LONG(slot1);
+    int64_t value2 = SLOT_GET_LONG(&stack->data[stack->size-2]);
+    slot1->num = value1>value2 ? 1 : (value1<value2 ? -1 : 0);
+    stack->size -= 3;
+}
+
+// dcmpg and dcmpl only differ on NaN
+INSTRUCTION_TEXT static inline void dcmp(Frame *frame, int32_t nan){
+    OperandStack *stack = frame->operandStack;
+    ValueSlot *slot1 = &stack->data[stack->size-4];
+    double value1 = SLOT_GET_DOUBLE(slot1);
+    double value2 = SLOT_GET_DOUBLE(&stack->data[stack->size-2]);
+    if(value1>value2){
+        slot1->num = 1;
+    }else if(value1<value2){
+        slot1->num = -1;
+    }else if(value1==value2){
+        slot1->num = 0;
+    }else{
+        slot1->num = nan;
+    }
+    stack->size -= 3;
+}
+
+INSTRUCTION_TEXT static void dcmpl(Frame *frame, void *data){
+    dcmp(frame, -1);
+}
+
+INSTRUCTION_TEXT static void dcmpg(Frame *frame, void *data){
+    dcmp(frame, 1);
+}
+
+#define IF_INT(name, cond) \
+INSTRUCTION_TEXT static void name(Frame *frame, void *data){ \
+    OperandStack *stack = frame->operandStack; \
+    int32_t value = stack->data[--stack->size].num; \
+    if(cond){ \
+        Instruction_Branch(frame, data); \
+    } \
+}
+
+#define IF_ICMP(name, cond) \
+INSTRUCTION_TEXT static void name(Frame *frame, void *data){ \
+    OperandStack *stack = frame->operandStack; \
+    int32_t value2 = stack->data[--stack->size].num; \
+    int32_t value1 = stack->data[--stack->size].num; \
+    if(cond){ \
+        Instruction_Branch(frame, data); \
+    } \
+}
+
+// encoded references compare like the pointers they stand for
+#define IF_REF(name, cond) \
+INSTRUCTION_TEXT static void name(Frame *frame, void *data){ \
+    OperandStack *stack = frame->operandStack; \
+    Ref value = stack->data[--stack->size].ref; \
+    if(cond){ \
+        Instruction_Branch(frame, data); \
+    } \
+}
+
+#define IF_ACMP(name, cond) \
+INSTRUCTION_TEXT static void name(Frame *frame, void *data){ \
+    OperandStack *stack = frame->operandStack; \
+    Ref value2 = stack->data[--stack->size].ref; \
+    Ref value1 = stack->data[--stack->size].ref; \
+    if(cond){ \
+        Instruction_Branch(frame, data); \
+    } \
+}
+
+IF_INT(ifeq, 0==value)
+IF_INT(ifne, 0!=value)
+IF_INT(iflt, 0>value)
+IF_INT(ifge, 0<=value)
+IF_INT(ifgt, 0<value)
+IF_INT(ifle, 0>=value)
+IF_ICMP(if_icmpeq, value1==value2)
+IF_ICMP(if_icmpne, value1!=value2)
+IF_ICMP(if_icmplt, value1<value2)
+IF_ICMP(if_icmpge, value1>=value2)
+IF_ICMP(if_icmpgt, value1>value2)
+IF_ICMP(if_icmple, value1<=value2)
+IF_ACMP(if_acmpeq, value1==value2)
+IF_ACMP(if_acmpne, value1!=value2)
+IF_REF(ifnull, 0==value)
+IF_REF(ifnonnull, 0!=value)
+
+void Instructions_InitComparisons(Instruction *table){
+    table[CONST_OPCODE_IFEQ] = (Instruction){Instruction_FetchBranch, ifeq};
+    table[CONST_OPCODE_IFNE] = (Instruction){Instruction_FetchBranch, ifne};
+    table[CONST_OPCODE_IFLT] = (Instruction){Instruction_FetchBranch, iflt};
+    table[CONST_OPCODE_IFGE] = (Instruction){Instruction_FetchBranch, ifge};
+    table[CONST_OPCODE_IFGT] = (Instruction){Instruction_FetchBranch, ifgt};
+    table[CONST_OPCODE_IFLE] = (Instruction){Instruction_FetchBranch, ifle};
+    table[CONST_OPCODE_IF_ICMPEQ] = (Instruction){Instruction_FetchBranch, if_icmpeq};
+    table[CONST_OPCODE_IF_ICMPNE] = (Instruction){Instruction_FetchBranch, if_icmpne};
+    table[CONST_OPCODE_IF_ICMPLT] = (Instruction){Instruction_FetchBranch, if_icmplt};
+    table[CONST_OPCODE_IF_ICMPGE] = (Instruction){Instruction_FetchBranch, if_icmpge};
+    table[CONST_OPCODE_IF_ICMPGT] = (Instruction){Instruction_FetchBranch, if_icmpgt};
+    table[CONST_OPCODE_IF_ICMPLE] = (Instruction){Instruction_FetchBranch, if_icmple};
+    table[CONST_OPCODE_IF_ACMPEQ] = (Instruction){Instruction_FetchBranch, if_acmpeq};
+    table[CONST_OPCODE_IF_ACMPNE] = (Instruction){Instruction_FetchBranch, if_acmpne};
+    table[CONST_OPCODE_IFNULL] = (Instruction){Instruction_FetchBranch, ifnull};
+    table[CONST_OPCODE_IFNONNULL] = (Instruction){Instruction_FetchBranch, ifnonnull};
+    table[CONST_OPCODE_LCMP] = (Instruction){Instruction_FetchNone, lcmp};
+    table[CONST_OPCODE_DCMPL] = (Instruction){Instruction_FetchNone, dcmpl};
+    table[CONST_OPCODE_DCMPG] = (Instruction){Instruction_FetchNone, dcmpg};
+}
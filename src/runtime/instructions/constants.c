@@ -0,0 +1,133 @@
+#include <stdint.h>
+
+#include "runtime/instruction.h"
+#include "runtime/opcode.h"
+#include "runtime/frame.h"
+#include "runtime/jstring.h"
+#include "classfile/classfile.h"
+#include "utils.h"
+
+INSTRUCTION_TEXT static inline void pushInt(Frame *frame, int32_t value){
+    frame->operandStack->data[frame->operandStack->size++].num = value;
+}
+
+INSTRUCTION_TEXT static void aconst_null(Frame *frame, void *data){
+    frame->operandStack->data[frame->operandStack->size++].ref = 0;
+}
+
+INSTRUCTION_TEXT static void iconst_m1(Frame *frame, void *data){
+    pushInt(frame, -1);
+}
+
+INSTRUCTION_TEXT static void iconst_0(Frame *frame, void *data){
+    pushInt(frame, 0);
+}
+
+INSTRUCTION_TEXT static void iconst_1(Frame *frame, void *data){
+    pushInt(frame, 1);
+}
+
+INSTRUCTION_TEXT static void iconst_2(Frame *frame, void *data){
+    pushInt(frame, 2);
+}
+
+INSTRUCTION_TEXT static void iconst_3(Frame *frame, void *data){
+    pushInt(frame, 3);
+}
+
+INSTRUCTION_TEXT static void iconst_4(Frame *frame, void *data){
+    pushInt(frame, 4);
+}
+
+INSTRUCTION_TEXT static void iconst_5(Frame *frame, void *data){
+    pushInt(frame, 5);
+}
+
+INSTRUCTION_TEXT static void bipush(Frame *frame, void *data){
+    pushInt(frame, (int8_t)INSTRUCTION_OPERAND(data));
+}
+
+INSTRUCTION_TEXT static void sipush(Frame *frame, void *data){
+    pushInt(frame, (int16_t)INSTRUCTION_OPERAND(data));
+}
+
+INSTRUCTION_TEXT static void lconst_0(Frame *frame, void *data){
+    OperandStack *stack = frame->operandStack;
+    SLOT_SET_LONG(&stack->data[stack->size], 0);
+    stack->size += 2;
+}
+
+INSTRUCTION_TEXT static void lconst_1(Frame *frame, void *data){
+    OperandStack *stack = frame->operandStack;
+    SLOT_SET_LONG(&stack->data[stack->size], 1);
+    stack->size += 2;
+}
+
+INSTRUCTION_TEXT static void dconst_0(Frame *frame, void *data){
+    OperandStack *stack = frame->operandStack;
+    SLOT_SET_DOUBLE(&stack->data[stack->size], 0.0);
+    stack->size += 2;
+}
+
+INSTRUCTION_TEXT static void dconst_1(Frame *frame, void *data){
+    OperandStack *stack = frame->operandStack;
+    SLOT_SET_DOUBLE(&stack->data[stack->size], 1.0);
+    stack->size += 2;
+}
+
+INSTRUCTION_TEXT static void ldc(Frame *frame, void *data){
+    uint16_t index = (uint16_t)INSTRUCTION_OPERAND(data);
+    OperandStack *stack = frame->operandStack;
+    void *constant = frame->class->classfile->constant_pool[index];
+    switch(*(uint8_t*)constant){
+        case CONST_CONSTANTPOOLINFO_TAG_INTEGER:
+            stack->data[stack->size++].num = (int32_t)((Constant_IntegerInfo*)constant)->value;
+            break;
+        case CONST_CONSTANTPOOLINFO_TAG_FLOAT:
+            stack->data[stack->size++].num = (int32_t)ieee754_float2bin(((Constant_FloatInfo*)constant)->value);
+            break;
+        case CONST_CONSTANTPOOLINFO_TAG_STRING:{
+            StringObject *string = String_ResolveConstant(frame->class, index);
+            if(NULL==string){
+                return;
+            }
+            stack->data[stack->size++].ref = REF_ENCODE(string);
+            break;
+        }
+        default:
+            error("[FIXME] ldc of constant pool tag %d.", *(uint8_t*)constant);
+            break;
+    }
+}
+
+INSTRUCTION_TEXT static void ldc2_w(Frame *frame, void *data){
+    uint16_t index = (uint16_t)INSTRUCTION_OPERAND(data);
+    OperandStack *stack = frame->operandStack;
+    void *constant = frame->class->classfile->constant_pool[index];
+    if(CONST_CONSTANTPOOLINFO_TAG_LONG==*(uint8_t*)constant){
+        SLOT_SET_LONG(&stack->data[stack->size], (int64_t)((Constant_LongInfo*)constant)->value);
+    }else{
+        SLOT_SET_DOUBLE(&stack->data[stack->size], ((Constant_DoubleInfo*)constant)->value);
+    }
+    stack->size += 2;
+}
+
+void Instructions_InitConstants(Instruction *table){
+    table[CONST_OPCODE_ACONST_NULL] = (Instruction){Instruction_FetchNone, aconst_null};
+    table[CONST_OPCODE_ICONST_M1] = (Instruction){Instruction_FetchNone, iconst_m1};
+    table[CONST_OPCODE_ICONST_0] = (Instruction){Instruction_FetchNone, iconst_0};
+    table[CONST_OPCODE_ICONST_1] = (Instruction){Instruction_FetchNone, iconst_1};
+    table[CONST_OPCODE_ICONST_2] = (Instruction){Instruction_FetchNone, iconst_2};
+    table[CONST_OPCODE_ICONST_3] = (Instruction){Instruction_FetchNone, iconst_3};
+    table[CONST_OPCODE_ICONST_4] = (Instruction){Instruction_FetchNone, iconst_4};
+    table[CONST_OPCODE_ICONST_5] = (Instruction){Instruction_FetchNone, iconst_5};
+    table[CONST_OPCODE_BIPUSH] = (Instruction){Instruction_FetchIndex, bipush};
+    table[CONST_OPCODE_SIPUSH] = (Instruction){Instruction_FetchWideIndex, sipush};
+    table[CONST_OPCODE_LDC] = (Instruction){Instruction_FetchIndex, ldc};
+    table[CONST_OPCODE_LDC_W] = (Instruction){Instruction_FetchWideIndex, ldc};
+    table[CONST_OPCODE_LDC2_W] = (Instruction){Instruction_FetchWideIndex, ldc2_w};
+    table[CONST_OPCODE_LCONST_0] = (Instruction){Instruction_FetchNone, lconst_0};
+    table[CONST_OPCODE_LCONST_1] = (Instruction){Instruction_FetchNone, lconst_1};
+    table[CONST_OPCODE_DCONST_0] = (Instruction){Instruction_FetchNone, dconst_0};
+    table[CONST_OPCODE_DCONST_1] = (Instruction){Instruction_FetchNone, dconst_1};
+}
@@ -0,0 +1,78 @@
+#include <stdint.h>
+
+#include "runtime/instruction.h"
+#include "runtime/opcode.h"
+#include "runtime/frame.h"
+#include "runtime/thread.h"
+#include "runtime/safepoint.h"
+#include "runtime/monitor.h"
+#include "runtime/exception.h"
+#include "runtime/boundscheck.h"
+#include "runtime/switchtable.h"
+
+INSTRUCTION_TEXT static void goto_(Frame *frame, void *data){
+    Instruction_Branch(frame, data);
+}
+
+// entry of a loop whose array accesses are unchecked, a frame entering it
+// with a negative induction variable goes on with the checked code
+INSTRUCTION_TEXT static void goto_guarded(Frame *frame, void *data){
+    Method *method = frame->method;
+    if(0>frame->localVars[BoundsCheck_GuardLocal(method, frame->pc)].num){
+        frame->code = method->codeAttribute->code;
+    }
+    Instruction_Branch(frame, data);
+}
+
+// both switch forms, decoded when the method was linked
+INSTRUCTION_TEXT static void switch_(Frame *frame, void *data){
+    OperandStack *stack = frame->operandStack;
+    int32_t key = stack->data[--stack->size].num;
+    int32_t offset = SwitchTable_Offset(frame->method->switches, frame->pc, key);
+    Instruction_Branch(frame, (void*)(intptr_t)offset);
+}
+
+// the top count slots become the result on the invoker's operand stack
+INSTRUCTION_TEXT static inline void returnSlots(Frame *frame, unsigned int count){
+    SAFEPOINT_POLL();
+    if(0!=Monitor_ExitFrame(frame)){
+        Exception_ThrowVM(frame, CONST_EXCEPTION_ILLEGAL_MONITOR_STATE);
+        return;
+    }
+    Thread_PopFrame(frame->thread);
+    Frame *invoker = frame->lower;
+    if(NULL==invoker){
+        return;
+    }
+    OperandStack *from = frame->operandStack;
+    OperandStack *to = invoker->operandStack;
+    for(unsigned int i=0;i<count;i++){
+        to->data[to->size++] = from->data[from->size-count+i];
+    }
+}
+
+INSTRUCTION_TEXT static void ireturn(Frame *frame, void *data){
+    returnSlots(frame, 1);
+}
+
+INSTRUCTION_TEXT static void lreturn(Frame *frame, void *data){
+    returnSlots(frame, 2);
+}
+
+INSTRUCTION_TEXT static void return_(Frame *frame, void *data){
+    returnSlots(frame, 0);
+}
+
+void Instructions_InitControl(Instruction *table){
+    table[CONST_OPCODE_GOTO] = (Instruction){Instruction_FetchBranch, goto_};
+    table[CONST_OPCODE_GOTO_W] = (Instruction){Instruction_FetchWideBranch, goto_};
+    table[CONST_OPCODE_GOTO_GUARDED] = (Instruction){Instruction_FetchBranch, goto_guarded};
+    table[CONST_OPCODE_TABLESWITCH] = (Instruction){Instruction_FetchNone, switch_};
+    table[CONST_OPCODE_LOOKUPSWITCH] = (Instruction){Instruction_FetchNone, switch_};
+    table[CONST_OPCODE_IRETURN] = (Instruction){Instruction_FetchNone, ireturn};
+    table[CONST_OPCODE_FRETURN] = (Instruction){Instruction_FetchNone, ireturn};
+    table[CONST_OPCODE_ARETURN] = (Instruction){Instruction_FetchNone, ireturn};
+    table[CONST_OPCODE_LRETURN] = (Instruction){Instruction_FetchNone, lreturn};
+    table[CONST_OPCODE_DRETURN] = (Instruction){Instruction_FetchNone, lreturn};
+    table[CONST_OPCODE_RETURN] = (Instruction){Instruction_FetchNone, return_};
+}
@@ -0,0 +1,113 @@
+#include <stdint.h>
+#include <math.h>
+
+#include "runtime/instruction.h"
+#include "runtime/opcode.h"
+#include "runtime/frame.h"
+#include "utils.h"
+
+// JVMS d2l/f2l: NaN is 0, out of range values saturate
+INSTRUCTION_TEXT static int64_t toLong(double value){
+    if(isnan(value)){
+        return 0;
+    }
+    if(value>=9223372036854775807.0){
+        return INT64_MAX;
+    }
+    if(value<=-9223372036854775808.0){
+        return INT64_MIN;
+    }
+    return (int64_t)value;
+}
+
+INSTRUCTION_TEXT static int32_t toInt(double value){
+    if(isnan(value)){
+        return 0;
+    }
+    if(value>=2147483647.0){
+        return INT32_MAX;
+    }
+    if(value<=-2147483648.0){
+        return INT32_MIN;
+    }
+    return (int32_t)value;
+}
+
+INSTRUCTION_TEXT static void i2l(Frame *frame, void *data){
+    OperandStack *stack = frame->operandStack;
+    ValueSlot *slot = &stack->data[stack->size-1];
+    SLOT_SET_LONG(slot, (int64_t)slot->num);
+    stack->size += 1;
+}
+
+INSTRUCTION_TEXT static void i2d(Frame *frame, void *data){
+    OperandStack *stack = frame->operandStack;
+    ValueSlot *slot = &stack->data[stack->size-1];
+    SLOT_SET_DOUBLE(slot, (double)slot->num);
+    stack->size += 1;
+}
+
+INSTRUCTION_TEXT static void f2l(Frame *frame, void *data){
+    OperandStack *stack = frame->operandStack;
+    ValueSlot *slot = &stack->data[stack->size-1];
+    SLOT_SET_LONG(slot, toLong(ieee754_bin2float(slot->num)));
+    stack->size += 1;
+}
+
+INSTRUCTION_TEXT static void f2d(Frame *frame, void *data){
+    OperandStack *stack = frame->operandStack;
+    ValueSlot *slot = &stack->data[stack->size-1];
+    SLOT_SET_DOUBLE(slot, (double)ieee754_bin2float(slot->num));
+    stack->size += 1;
+}
+
+INSTRUCTION_TEXT static void l2i(Frame *frame, void *data){
+    OperandStack *stack = frame->operandStack;
+    ValueSlot *slot = &stack->data[stack->size-2];
+    slot->num = (int32_t)SLOT_GET_LONG(slot);
+    stack->size -= 1;
+}
+
+INSTRUCTION_TEXT static void l2f(Frame *frame, void *data){
+    OperandStack *stack = frame->operandStack;
+    ValueSlot *slot = &stack->data[stack->size-2];
+    slot->num = (int32_t)ieee754_float2bin((float)SLOT_GET_LONG(slot));
+    stack->size -= 1;
+}
+
+INSTRUCTION_TEXT static void l2d(Frame *frame, void *data){
+    ValueSlot *slot = &frame->operandStack->data[frame->operandStack->size-2];
+    SLOT_SET_DOUBLE(slot, (double)SLOT_GET_LONG(slot));
+}
+
+INSTRUCTION_TEXT static void d2i(Frame *frame, void *data){
+    OperandStack *stack = frame->operandStack;
+    ValueSlot *slot = &stack->data[stack->size-2];
+    slot->num = toInt(SLOT_GET_DOUBLE(slot));
+    stack->size -= 1;
+}
+
+INSTRUCTION_TEXT static void d2l(Frame *frame, void *data){
+    ValueSlot *slot = &frame->operandStack->data[frame->operandStack->size-2];
+    SLOT_SET_LONG(slot, toLong(SLOT_GET_DOUBLE(slot)));
+}
+
+INSTRUCTION_TEXT static void d2f(Frame *frame, void *data){
+    OperandStack *stack = frame->operandStack;
+    ValueSlot *slot = &stack->data[stack->size-2];
+    slot->num = (int32_t)ieee754_float2bin((float)SLOT_GET_DOUBLE(slot));
+    stack->size -= 1;
+}
+
+void Instructions_InitConversions(Instruction *table){
+    table[CONST_OPCODE_I2L] = (Instruction){Instruction_FetchNone, i2l};
+    table[CONST_OPCODE_I2D] = (Instruction){Instruction_FetchNone, i2d};
+    table[CONST_OPCODE_F2L] = (Instruction){Instruction_FetchNone, f2l};
+    table[CONST_OPCODE_F2D] = (Instruction){Instruction_FetchNone, f2d};
+    table[CONST_OPCODE_L2I] = (Instruction){Instruction_FetchNone, l2i};
+    table[CONST_OPCODE_L2F] = (Instruction){Instruction_FetchNone, l2f};
+    table[CONST_OPCODE_L2D] = (Instruction){Instruction_FetchNone, l2d};
+    table[CONST_OPCODE_D2I] = (Instruction){Instruction_FetchNone, d2i};
+    table[CONST_OPCODE_D2L] = (Instruction){Instruction_FetchNone, d2l};
+    table[CONST_OPCODE_D2F] = (Instruction){Instruction_FetchNone, d2f};
+}
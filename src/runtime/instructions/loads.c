@@ -0,0 +1,144 @@
+#include <stdint.h>
+
+#include "runtime/instruction.h"
+#include "runtime/opcode.h"
+#include "runtime/frame.h"
+#include "runtime/object.h"
+#include "runtime/exception.h"
+
+// category 2 locals are moved as raw 64 bits, doubles included
+INSTRUCTION_TEXT static inline void loadWide(Frame *frame, uintptr_t index){
+    OperandStack *stack = frame->operandStack;
+    SLOT_SET_LONG(&stack->data[stack->size], SLOT_GET_LONG(&frame->localVars[index]));
+    stack->size += 2;
+}
+
+INSTRUCTION_TEXT static void lload(Frame *frame, void *data){
+    loadWide(frame, INSTRUCTION_OPERAND(data));
+}
+
+INSTRUCTION_TEXT static void lload_0(Frame *frame, void *data){
+    loadWide(frame, 0);
+}
+
+INSTRUCTION_TEXT static void lload_1(Frame *frame, void *data){
+    loadWide(frame, 1);
+}
+
+INSTRUCTION_TEXT static void lload_2(Frame *frame, void *data){
+    loadWide(frame, 2);
+}
+
+INSTRUCTION_TEXT static void lload_3(Frame *frame, void *data){
+    loadWide(frame, 3);
+}
+
+// int, float and reference locals are one slot copied as is
+INSTRUCTION_TEXT static inline void load(Frame *frame, uintptr_t index){
+    OperandStack *stack = frame->operandStack;
+    stack->data[stack->size++] = frame->localVars[index];
+}
+
+INSTRUCTION_TEXT static void iload(Frame *frame, void *data){
+    load(frame, INSTRUCTION_OPERAND(data));
+}
+
+INSTRUCTION_TEXT static void iload_0(Frame *frame, void *data){
+    load(frame, 0);
+}
+
+INSTRUCTION_TEXT static void iload_1(Frame *frame, void *data){
+    load(frame, 1);
+}
+
+INSTRUCTION_TEXT static void iload_2(Frame *frame, void *data){
+    load(frame, 2);
+}
+
+INSTRUCTION_TEXT static void iload_3(Frame *frame, void *data){
+    load(frame, 3);
+}
+
+// The index is checked unless the code was rewritten for a loop keeping it
+// in bounds. A null array faults on its length, or on the element once unchecked.
+#define ARRAY_LOAD(name, type, checked, FIELD) \
+INSTRUCTION_TEXT static void name(Frame *frame, void *data){ \
+    OperandStack *stack = frame->operandStack; \
+    int32_t index = stack->data[stack->size-1].num; \
+    ArrayObject *array = (ArrayObject*)REF_DECODE(stack->data[stack->size-2].ref); \
+    if(checked && (uint32_t)index>=array->length){ \
+        Exception_ThrowVM(frame, CONST_EXCEPTION_ARRAY_INDEX); \
+        return; \
+    } \
+    stack->data[stack->size-2].FIELD = ((type*)array->data)[index]; \
+    stack->size--; \
+}
+
+#define ARRAY_LOAD_WIDE(name, checked) \
+INSTRUCTION_TEXT static void name(Frame *frame, void *data){ \
+    OperandStack *stack = frame->operandStack; \
+    int32_t index = stack->data[stack->size-1].num; \
+    ArrayObject *array = (ArrayObject*)REF_DECODE(stack->data[stack->size-2].ref); \
+    if(checked && (uint32_t)index>=array->length){ \
+        Exception_ThrowVM(frame, CONST_EXCEPTION_ARRAY_INDEX); \
+        return; \
+    } \
+    SLOT_SET_LONG(&stack->data[stack->size-2], ((int64_t*)array->data)[index]); \
+}
+
+ARRAY_LOAD(iaload, int32_t, 1, num)
+ARRAY_LOAD_WIDE(laload, 1)
+ARRAY_LOAD(aaload, Ref, 1, ref)
+ARRAY_LOAD(baload, int8_t, 1, num)
+ARRAY_LOAD(caload, uint16_t, 1, num)
+ARRAY_LOAD(saload, int16_t, 1, num)
+ARRAY_LOAD(iaload_unchecked, int32_t, 0, num)
+ARRAY_LOAD_WIDE(laload_unchecked, 0)
+ARRAY_LOAD(aaload_unchecked, Ref, 0, ref)
+ARRAY_LOAD(baload_unchecked, int8_t, 0, num)
+ARRAY_LOAD(caload_unchecked, uint16_t, 0, num)
+ARRAY_LOAD(saload_unchecked, int16_t, 0, num)
+
+void Instructions_InitLoads(Instruction *table){
+    table[CONST_OPCODE_ILOAD] = (Instruction){Instruction_FetchIndex, iload};
+    table[CONST_OPCODE_ILOAD_0] = (Instruction){Instruction_FetchNone, iload_0};
+    table[CONST_OPCODE_ILOAD_1] = (Instruction){Instruction_FetchNone, iload_1};
+    table[CONST_OPCODE_ILOAD_2] = (Instruction){Instruction_FetchNone, iload_2};
+    table[CONST_OPCODE_ILOAD_3] = (Instruction){Instruction_FetchNone, iload_3};
+    table[CONST_OPCODE_FLOAD] = (Instruction){Instruction_FetchIndex, iload};
+    table[CONST_OPCODE_FLOAD_0] = (Instruction){Instruction_FetchNone, iload_0};
+    table[CONST_OPCODE_FLOAD_1] = (Instruction){Instruction_FetchNone, iload_1};
+    table[CONST_OPCODE_FLOAD_2] = (Instruction){Instruction_FetchNone, iload_2};
+    table[CONST_OPCODE_FLOAD_3] = (Instruction){Instruction_FetchNone, iload_3};
+    table[CONST_OPCODE_ALOAD] = (Instruction){Instruction_FetchIndex, iload};
+    table[CONST_OPCODE_ALOAD_0] = (Instruction){Instruction_FetchNone, iload_0};
+    table[CONST_OPCODE_ALOAD_1] = (Instruction){Instruction_FetchNone, iload_1};
+    table[CONST_OPCODE_ALOAD_2] = (Instruction){Instruction_FetchNone, iload_2};
+    table[CONST_OPCODE_ALOAD_3] = (Instruction){Instruction_FetchNone, iload_3};
+    table[CONST_OPCODE_LLOAD] = (Instruction){Instruction_FetchIndex, lload};
+    table[CONST_OPCODE_LLOAD_0] = (Instruction){Instruction_FetchNone, lload_0};
+    table[CONST_OPCODE_LLOAD_1] = (Instruction){Instruction_FetchNone, lload_1};
+    table[CONST_OPCODE_LLOAD_2] = (Instruction){Instruction_FetchNone, lload_2};
+    table[CONST_OPCODE_LLOAD_3] = (Instruction){Instruction_FetchNone, lload_3};
+    table[CONST_OPCODE_DLOAD] = (Instruction){Instruction_FetchIndex, lload};
+    table[CONST_OPCODE_DLOAD_0] = (Instruction){Instruction_FetchNone, lload_0};
+    table[CONST_OPCODE_DLOAD_1] = (Instruction){Instruction_FetchNone, lload_1};
+    table[CONST_OPCODE_DLOAD_2] = (Instruction){Instruction_FetchNone, lload_2};
+    table[CONST_OPCODE_DLOAD_3] = (Instruction){Instruction_FetchNone, lload_3};
+    table[CONST_OPCODE_IALOAD] = (Instruction){Instruction_FetchNone, iaload};
+    table[CONST_OPCODE_LALOAD] = (Instruction){Instruction_FetchNone, laload};
+    table[CONST_OPCODE_FALOAD] = (Instruction){Instruction_FetchNone, iaload};
+    table[CONST_OPCODE_DALOAD] = (Instruction){Instruction_FetchNone, laload};
+    table[CONST_OPCODE_AALOAD] = (Instruction){Instruction_FetchNone, aaload};
+    table[CONST_OPCODE_BALOAD] = (Instruction){Instruction_FetchNone, baload};
+    table[CONST_OPCODE_CALOAD] = (Instruction){Instruction_FetchNone, caload};
+    table[CONST_OPCODE_SALOAD] = (Instruction){Instruction_FetchNone, saload};
+    table[OPCODE_UNCHECKED_LOAD(CONST_OPCODE_IALOAD)] = (Instruction){Instruction_FetchNone, iaload_unchecked};
+    table[OPCODE_UNCHECKED_LOAD(CONST_OPCODE_LALOAD)] = (Instruction){Instruction_FetchNone, laload_unchecked};
+    table[OPCODE_UNCHECKED_LOAD(CONST_OPCODE_FALOAD)] = (Instruction){Instruction_FetchNone, iaload_unchecked};
+    table[OPCODE_UNCHECKED_LOAD(CONST_OPCODE_DALOAD)] = (Instruction){Instruction_FetchNone, laload_unchecked};
+    table[OPCODE_UNCHECKED_LOAD(CONST_OPCODE_AALOAD)] = (Instruction){Instruction_FetchNone, aaload_unchecked};
+    table[OPCODE_UNCHECKED_LOAD(CONST_OPCODE_BALOAD)] = (Instruction){Instruction_FetchNone, baload_unchecked};
+    table[OPCODE_UNCHECKED_LOAD(CONST_OPCODE_CALOAD)] = (Instruction){Instruction_FetchNone, caload_unchecked};
+    table[OPCODE_UNCHECKED_LOAD(CONST_OPCODE_SALOAD)] = (Instruction){Instruction_FetchNone, saload_unchecked};
+}
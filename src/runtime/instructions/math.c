@@ -0,0 +1,123 @@
+#include <stdint.h>
+#include <math.h>
+
+#include "runtime/instruction.h"
+#include "runtime/opcode.h"
+#include "runtime/frame.h"
+#include "runtime/exception.h"
+#include "utils.h"
+
+// value2 is on top, the result takes the place of value1
+#define LONG_BINARY(name, expr) \
+INSTRUCTION_TEXT static void name(Frame *frame, void *data){ \
+    OperandStack *stack = frame->operandStack; \
+    ValueSlot *slot1 = &stack->data[stack->size-4]; \
+    int64_t value1 = SLOT_GET_LONG(slot1); \
+    int64_t value2 = SLOT_GET_LONG(&stack->data[stack->size-2]); \
+    SLOT_SET_LONG(slot1, expr); \
+    stack->size -= 2; \
+}
+
+#define DOUBLE_BINARY(name, expr) \
+INSTRUCTION_TEXT static void name(Frame *frame, void *data){ \
+    OperandStack *stack = frame->operandStack; \
+    ValueSlot *slot1 = &stack->data[stack->size-4]; \
+    double value1 = SLOT_GET_DOUBLE(slot1); \
+    double value2 = SLOT_GET_DOUBLE(&stack->data[stack->size-2]); \
+    SLOT_SET_DOUBLE(slot1, expr); \
+    stack->size -= 2; \
+}
+
+// the shift distance is an int, only its low 6 bits count
+#define LONG_SHIFT(name, expr) \
+INSTRUCTION_TEXT static void name(Frame *frame, void *data){ \
+    OperandStack *stack = frame->operandStack; \
+    ValueSlot *slot1 = &stack->data[stack->size-3]; \
+    int64_t value1 = SLOT_GET_LONG(slot1); \
+    int32_t shift = stack->data[stack->size-1].num & 0x3F; \
+    SLOT_SET_LONG(slot1, expr); \
+    stack->size -= 1; \
+}
+
+// java arithmetic wraps around, do it unsigned
+LONG_BINARY(ladd, (int64_t)((uint64_t)value1+(uint64_t)value2))
+LONG_BINARY(lsub, (int64_t)((uint64_t)value1-(uint64_t)value2))
+LONG_BINARY(lmul, (int64_t)((uint64_t)value1*(uint64_t)value2))
+LONG_BINARY(land, value1&value2)
+LONG_BINARY(lor, value1|value2)
+LONG_BINARY(lxor, value1^value2)
+
+LONG_SHIFT(lshl, (int64_t)((uint64_t)value1<<shift))
+LONG_SHIFT(lshr, value1>>shift)
+LONG_SHIFT(lushr, (int64_t)((uint64_t)value1>>shift))
+
+DOUBLE_BINARY(dadd, value1+value2)
+DOUBLE_BINARY(dsub, value1-value2)
+DOUBLE_BINARY(dmul, value1*value2)
+DOUBLE_BINARY(ddiv, value1/value2)
+DOUBLE_BINARY(drem_, fmod(value1, value2))
+
+// ldiv and drem are taken by libc
+INSTRUCTION_TEXT static void ldiv_(Frame *frame, void *data){
+    OperandStack *stack = frame->operandStack;
+    ValueSlot *slot1 = &stack->data[stack->size-4];
+    int64_t value1 = SLOT_GET_LONG(slot1);
+    int64_t value2 = SLOT_GET_LONG(&stack->data[stack->size-2]);
+    stack->size -= 2;
+    if(0==value2){
+        Exception_ThrowVM(frame, CONST_EXCEPTION_ARITHMETIC);
+        return;
+    }
+    // Long.MIN_VALUE / -1 overflows back to Long.MIN_VALUE
+    SLOT_SET_LONG(slot1, -1==value2 ? (int64_t)(0-(uint64_t)value1) : value1/value2);
+}
+
+INSTRUCTION_TEXT static void lrem(Frame *frame, void *data){
+    OperandStack *stack = frame->operandStack;
+    ValueSlot *slot1 = &stack->data[stack->size-4];
+    int64_t value1 = SLOT_GET_LONG(slot1);
+    int64_t value2 = SLOT_GET_LONG(&stack->data[stack->size-2]);
+    stack->size -= 2;
+    if(0==value2){
+        Exception_ThrowVM(frame, CONST_EXCEPTION_ARITHMETIC);
+        return;
+    }
+    SLOT_SET_LONG(slot1, -1==value2 ? 0 : value1%value2);
+}
+
+INSTRUCTION_TEXT static void lneg(Frame *frame, void *data){
+    ValueSlot *slot = &frame->operandStack->data[frame->operandStack->size-2];
+    SLOT_SET_LONG(slot, (int64_t)(0-(uint64_t)SLOT_GET_LONG(slot)));
+}
+
+INSTRUCTION_TEXT static void dneg(Frame *frame, void *data){
+    ValueSlot *slot = &frame->operandStack->data[frame->operandStack->size-2];
+    SLOT_SET_DOUBLE(slot, -SLOT_GET_DOUBLE(slot));
+}
+
+INSTRUCTION_TEXT static void iinc(Frame *frame, void *data){
+    ValueSlot *slot = &frame->localVars[INSTRUCTION_INCREMENT_INDEX(data)];
+    slot->num = (int32_t)((uint32_t)slot->num + (uint32_t)INSTRUCTION_INCREMENT_CONST(data));
+}
+
+void Instructions_InitMath(Instruction *table){
+    table[CONST_OPCODE_IINC] = (Instruction){Instruction_FetchIncrement, iinc};
+    table[CONST_OPCODE_LADD] = (Instruction){Instruction_FetchNone, ladd};
+    table[CONST_OPCODE_LSUB] = (Instruction){Instruction_FetchNone, lsub};
+    table[CONST_OPCODE_LMUL] = (Instruction){Instruction_FetchNone, lmul};
+    table[CONST_OPCODE_LDIV] = (Instruction){Instruction_FetchNone, ldiv_};
+    table[CONST_OPCODE_LREM] = (Instruction){Instruction_FetchNone, lrem};
+    table[CONST_OPCODE_LNEG] = (Instruction){Instruction_FetchNone, lneg};
+    table[CONST_OPCODE_LAND] = (Instruction){Instruction_FetchNone, land};
+    table[CONST_OPCODE_LOR] = (Instruction){Instruction_FetchNone, lor};
+    table[CONST_OPCODE_LXOR] = (Instruction){Instruction_FetchNone, lxor};
+    table[CONST_OPCODE_LSHL] = (Instruction){Instruction_FetchNone, lshl};
+    table[CONST_OPCODE_LSHR] = (Instruction){Instruction_FetchNone, lshr};
+    table[CONST_OPCODE_LUSHR] = (Instruction){Instruction_FetchNone, lushr};
+    table[CONST_OPCODE_DADD] = (Instruction){Instruction_FetchNone, dadd};
+    table[CONST_OPCODE_DSUB] = (Instruction){Instruction_FetchNone, dsub};
+    table[CONST_OPCODE_DMUL] = (Instruction){Instruction_FetchNone, dmul};
+    table[CONST_OPCODE_DDIV] = (Instruction){Instruction_FetchNone, ddiv};
+    table[CONST_OPCODE_DREM] = (Instruction){Instruction_FetchNone, drem_};
+    table[CONST_OPCODE_DNEG] = (Instruction){Instruction_FetchNone, dneg};
+}
@@ -0,0 +1,459 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "runtime/instruction.h"
+#include "runtime/opcode.h"
+#include "runtime/frame.h"
+#include "runtime/thread.h"
+#include "runtime/object.h"
+#include "runtime/heap.h"
+#include "runtime/monitor.h"
+#include "runtime/exception.h"
+#include "runtime/nullcheck.h"
+#include "runtime/classinit.h"
+#include "runtime/callsite.h"
+#include "runtime/escape.h"
+#include "utils.h"
+
+// Null references are not tested here, the first access to the object
+// faults and the interpreter throws the NullPointerException.
+
+INSTRUCTION_TEXT static ResolvedField* resolveField(Frame *frame, void *data){
+    ResolvedField *field = Class_ResolveField(frame->class, (uint16_t)INSTRUCTION_OPERAND(data));
+    if(NULL==field){
+        error("[FIXME] java.lang.NoSuchFieldError");
+    }
+    return field;
+}
+
+// the value at address pushed into slot, the number of slots it takes
+INSTRUCTION_TEXT static int readField(ValueSlot *slot, uint8_t *address, uint8_t type){
+    switch(type){
+        case 'Z':
+            slot->num = *(uint8_t*)address;
+            return 1;
+        case 'B':
+            slot->num = *(int8_t*)address;
+            return 1;
+        case 'C':
+            slot->num = *(uint16_t*)address;
+            return 1;
+        case 'S':
+            slot->num = *(int16_t*)address;
+            return 1;
+        case 'I':
+        case 'F':
+            slot->num = *(int32_t*)address;
+            return 1;
+        case 'J':
+        case 'D':
+            SLOT_SET_LONG(slot, *(int64_t*)address);
+            return 2;
+        default:
+            slot->ref = *(Ref*)address;
+            return 1;
+    }
+}
+
+INSTRUCTION_TEXT static void writeField(void *holder, uint8_t *address, ValueSlot *value, uint8_t type){
+    switch(type){
+        case 'Z':
+            *(uint8_t*)address = (uint8_t)(value->num&1);
+            break;
+        case 'B':
+            *(int8_t*)address = (int8_t)value->num;
+            break;
+        case 'C':
+        case 'S':
+            *(int16_t*)address = (int16_t)value->num;
+            break;
+        case 'I':
+        case 'F':
+            *(int32_t*)address = value->num;
+            break;
+        case 'J':
+        case 'D':
+            *(int64_t*)address = SLOT_GET_LONG(value);
+            break;
+        default:
+            // the barrier stores before it looks at the holder, so null still faults first
+            Heap_WriteRef(holder, (Ref*)address, REF_DECODE(value->ref));
+            break;
+    }
+}
+
+// objects allocated in a frame are never remembered, Frame_ScanRoots reports their fields
+INSTRUCTION_TEXT static void writeObjectField(Object *object, uint8_t *address, ValueSlot *value, uint8_t type){
+    if(('L'==type || '['==type) && (object->header.mark & CONST_HEADER_FRAME)){
+        *(Ref*)address = value->ref;
+        return;
+    }
+    writeField(object, address, value, type);
+}
+
+INSTRUCTION_TEXT static void getfield(Frame *frame, void *data){
+    ResolvedField *field = resolveField(frame, data);
+    if(NULL==field){
+        return;
+    }
+    OperandStack *stack = frame->operandStack;
+    Object *object = (Object*)REF_DECODE(stack->data[stack->size-1].ref);
+    if(!NULLCHECK_IMPLICIT(field->offset) && NULL==object){
+        Exception_ThrowVM(frame, CONST_EXCEPTION_NULL_POINTER);
+        return;
+    }
+    stack->size += readField(&stack->data[stack->size-1], (uint8_t*)object + field->offset, field->type) - 1;
+}
+
+INSTRUCTION_TEXT static void putfield(Frame *frame, void *data){
+    ResolvedField *field = resolveField(frame, data);
+    if(NULL==field){
+        return;
+    }
+    OperandStack *stack = frame->operandStack;
+    int wide = 'J'==field->type || 'D'==field->type;
+    stack->size -= wide ? 3 : 2;
+    ValueSlot *value = &stack->data[stack->size+1];
+    Object *object = (Object*)REF_DECODE(stack->data[stack->size].ref);
+    if(!NULLCHECK_IMPLICIT(field->offset) && NULL==object){
+        Exception_ThrowVM(frame, CONST_EXCEPTION_NULL_POINTER);
+        return;
+    }
+    writeObjectField(object, (uint8_t*)object + field->offset, value, field->type);
+}
+
+// The initialization barrier runs before any operand is popped, the
+// frame is consistent if <clinit> runs or the thread waits for it.
+INSTRUCTION_TEXT static ResolvedStatic* resolveStatic(Frame *frame, void *data){
+    uint16_t index = (uint16_t)INSTRUCTION_OPERAND(data);
+    ResolvedStatic *field = (ResolvedStatic*)ClassInit_Resolved(frame->class, index);
+    if(NULL!=field){
+        return field;
+    }
+    field = Class_ResolveStaticField(frame->class, index);
+    if(NULL==field){
+        error("[FIXME] java.lang.NoSuchFieldError");
+        return NULL;
+    }
+    if(0!=ClassInit_Barrier(frame, field->class)){
+        return NULL;
+    }
+    ClassInit_Patch(frame->class, index, field, field->class);
+    return field;
+}
+
+INSTRUCTION_TEXT static void getstatic(Frame *frame, void *data){
+    ResolvedStatic *field = resolveStatic(frame, data);
+    if(NULL==field){
+        return;
+    }
+    OperandStack *stack = frame->operandStack;
+    stack->size += readField(&stack->data[stack->size], field->address, field->field.type);
+}
+
+INSTRUCTION_TEXT static void putstatic(Frame *frame, void *data){
+    ResolvedStatic *field = resolveStatic(frame, data);
+    if(NULL==field){
+        return;
+    }
+    OperandStack *stack = frame->operandStack;
+    stack->size -= 'J'==field->field.type || 'D'==field->field.type ? 2 : 1;
+    writeField(field->class->staticFields, field->address, &stack->data[stack->size], field->field.type);
+}
+
+INSTRUCTION_TEXT static void new_(Frame *frame, void *data){
+    Class *class = Class_ResolveClass(frame->class, (uint16_t)INSTRUCTION_OPERAND(data));
+    if(NULL==class){
+        error("[FIXME] java.lang.NoClassDefFoundError");
+        return;
+    }
+    if(!ClassInit_Done(class) && 0!=ClassInit_Barrier(frame, class)){
+        return;
+    }
+    if(NULL!=class->classfile && (class->classfile->access_flags & (CONST_CLASSFILE_ACCESS_INTERFACE|CONST_CLASSFILE_ACCESS_ABSTRACT))){
+        error("[FIXME] java.lang.InstantiationError: %s", class->name);
+        return;
+    }
+    EscapeMap *map = Method_EscapeMap(frame->method);
+    Object *object = NULL==map ? NULL : Escape_New(frame, map, class);
+    if(NULL==object){
+        object = Object_New(class);
+    }
+    if(NULL==object){
+        Exception_ThrowVM(frame, CONST_EXCEPTION_OUT_OF_MEMORY);
+        return;
+    }
+    OperandStack *stack = frame->operandStack;
+    stack->data[stack->size++].ref = REF_ENCODE(object);
+}
+
+INSTRUCTION_TEXT static Method* resolveMethod(Frame *frame, void *data){
+    Method *method = Class_ResolveMethod(frame->class, (uint16_t)INSTRUCTION_OPERAND(data));
+    if(NULL==method){
+        error("[FIXME] java.lang.NoSuchMethodError");
+    }
+    return method;
+}
+
+// the super constructor chain of an empty-looking constructor, settled on its first call
+INSTRUCTION_TEXT static int isEmpty(Method *method){
+    uint8_t shape = __atomic_load_n(&method->shape, __ATOMIC_RELAXED);
+    if(CONST_METHOD_SHAPE_EMPTY_INIT!=shape){
+        return CONST_METHOD_SHAPE_EMPTY==shape;
+    }
+    Method *super = Class_ResolveMethod(method->class, method->shapeIndex);
+    int empty = NULL!=super && 1==super->argSlots && isEmpty(super);
+    __atomic_store_n(&method->shape, empty ? CONST_METHOD_SHAPE_EMPTY : CONST_METHOD_SHAPE_NONE, __ATOMIC_RELAXED);
+    return empty;
+}
+
+// Runs a trivial method on the operand stack of its invoker, the method
+// has no frame of its own, nor a line in stack traces. 0 when it is to be
+// invoked after all, its code then reports what did not resolve.
+INSTRUCTION_TEXT static int runShape(Frame *frame, Method *method){
+    OperandStack *stack = frame->operandStack;
+    ValueSlot *args = &stack->data[stack->size-method->argSlots];
+    ResolvedField *field = NULL;
+    if(CONST_METHOD_SHAPE_GETTER==method->shape || CONST_METHOD_SHAPE_SETTER==method->shape){
+        field = Class_ResolveField(method->class, method->shapeIndex);
+        if(NULL==field){
+            return 0;
+        }
+    }else if(!isEmpty(method)){
+        return 0;
+    }
+    Object *object = NULL;
+    if(!(method->accessFlags & CONST_METHOD_ACCESS_STATIC)){
+        object = (Object*)REF_DECODE(args[0].ref);
+        if(NULL==object){
+            Exception_ThrowVM(frame, CONST_EXCEPTION_NULL_POINTER);
+            return 1;
+        }
+    }
+    switch(method->shape){
+        case CONST_METHOD_SHAPE_GETTER:
+            stack->size += readField(&args[0], (uint8_t*)object + field->offset, field->type) - 1;
+            break;
+        case CONST_METHOD_SHAPE_SETTER:
+            writeObjectField(object, (uint8_t*)object + field->offset, &args[1], field->type);
+            stack->size -= method->argSlots;
+            break;
+        default:
+            stack->size -= method->argSlots;
+            break;
+    }
+    return 1;
+}
+
+// The callee frame is allocated while the arguments are still on the
+// operand stack, where a collection finds them.
+INSTRUCTION_TEXT static void invoke(Frame *frame, Method *method){
+    if(CONST_METHOD_SHAPE_NONE!=method->shape && runShape(frame, method)){
+        return;
+    }
+    if(NULL!=method->intrinsic){
+        method->intrinsic(frame);
+        return;
+    }
+    if(0==method->codeLength){
+        error("[FIXME] java.lang.UnsatisfiedLinkError: %s.%s%s", method->class->name, method->name, method->descriptor);
+        return;
+    }
+    OperandStack *stack = frame->operandStack;
+    int synchronized = 0!=(method->accessFlags & CONST_METHOD_ACCESS_SYNCHRONIZED);
+    if(synchronized && !(method->accessFlags & CONST_METHOD_ACCESS_STATIC)
+        && NULL==REF_DECODE(stack->data[stack->size-method->argSlots].ref)){
+        Exception_ThrowVM(frame, CONST_EXCEPTION_NULL_POINTER);
+        return;
+    }
+    Frame *callee = Frame_NewMethod(method);
+    stack->size -= method->argSlots;
+    memcpy(callee->localVars, &stack->data[stack->size], sizeof(ValueSlot)*method->argSlots);
+    if(0!=Thread_PushFrame(frame->thread, callee)){
+        Exception_ThrowVM(frame, CONST_EXCEPTION_STACK_OVERFLOW);
+    }else if(synchronized && 0!=Monitor_EnterFrame(callee)){
+        Thread_PopFrame(frame->thread);
+        // out of monitors to inflate the lock into
+        Exception_ThrowVM(frame, CONST_EXCEPTION_OUT_OF_MEMORY);
+    }
+}
+
+INSTRUCTION_TEXT static void invokestatic(Frame *frame, void *data){
+    uint16_t index = (uint16_t)INSTRUCTION_OPERAND(data);
+    Method *method = (Method*)ClassInit_Resolved(frame->class, index);
+    if(NULL==method){
+        method = resolveMethod(frame, data);
+        if(NULL==method){
+            return;
+        }
+        if((method->accessFlags & CONST_METHOD_ACCESS_STATIC) && 0!=ClassInit_Barrier(frame, method->class)){
+            return;
+        }
+        ClassInit_Patch(frame->class, index, method, method->class);
+    }
+    if(!(method->accessFlags & CONST_METHOD_ACCESS_STATIC)){
+        error("[FIXME] java.lang.IncompatibleClassChangeError: %s.%s%s", method->class->name, method->name, method->descriptor);
+        return;
+    }
+    invoke(frame, method);
+}
+
+INSTRUCTION_TEXT static void invokespecial(Frame *frame, void *data){
+    Method *method = resolveMethod(frame, data);
+    if(NULL!=method){
+        invoke(frame, method);
+    }
+}
+
+// [FIXME] selection walks the receiver's class chain, there is no vtable yet
+INSTRUCTION_TEXT static void invokevirtual(Frame *frame, void *data){
+    Method *method = resolveMethod(frame, data);
+    if(NULL==method){
+        return;
+    }
+    OperandStack *stack = frame->operandStack;
+    Object *receiver = (Object*)REF_DECODE(stack->data[stack->size-method->argSlots].ref);
+    Class *class = receiver->header.class;
+    if(NULL!=class && class!=method->class && !(method->accessFlags & (CONST_METHOD_ACCESS_FINAL|CONST_METHOD_ACCESS_PRIVATE))){
+        Method *selected = Class_FindMethod(class, method->name, method->descriptor);
+        if(NULL!=selected){
+            method = selected;
+        }
+    }
+    invoke(frame, method);
+}
+
+// [FIXME] selection walks the receiver's class and superinterfaces, there is no itable yet
+INSTRUCTION_TEXT static void invokeinterface(Frame *frame, void *data){
+    Method *method = resolveMethod(frame, data);
+    if(NULL==method){
+        return;
+    }
+    OperandStack *stack = frame->operandStack;
+    Object *receiver = (Object*)REF_DECODE(stack->data[stack->size-method->argSlots].ref);
+    Class *class = receiver->header.class;
+    if(NULL!=class && !(method->accessFlags & CONST_METHOD_ACCESS_PRIVATE)){
+        Method *selected = Class_FindMethod(class, method->name, method->descriptor);
+        if(NULL==selected || (selected->accessFlags & CONST_METHOD_ACCESS_ABSTRACT)){
+            error("[FIXME] java.lang.AbstractMethodError: %s.%s%s", class->name, method->name, method->descriptor);
+            return;
+        }
+        method = selected;
+    }
+    invoke(frame, method);
+}
+
+// a linked lambda site without captured values hands out one instance
+INSTRUCTION_TEXT static void invokedynamic(Frame *frame, void *data){
+    CallSite *site = CallSite_Link(frame, (uint16_t)INSTRUCTION_OPERAND(data));
+    if(NULL==site){
+        return;
+    }
+    if(NULL!=site->instance){
+        OperandStack *stack = frame->operandStack;
+        stack->data[stack->size++].ref = REF_ENCODE(site->instance);
+        return;
+    }
+    CallSite_Capture(frame, site);
+}
+
+// [FIXME] array classes are not modelled yet, an array is only taken as an Object
+INSTRUCTION_TEXT static int isInstance(Object *object, Class *class){
+    if(object->header.mark & CONST_HEADER_ARRAY){
+        return NULL==class->super && NULL!=class->classfile
+            && !(class->classfile->access_flags & CONST_CLASSFILE_ACCESS_INTERFACE);
+    }
+    return Class_IsSubclassOf(object->header.class, class);
+}
+
+INSTRUCTION_TEXT static Class* resolveType(Frame *frame, void *data){
+    Class *class = Class_ResolveClass(frame->class, (uint16_t)INSTRUCTION_OPERAND(data));
+    if(NULL==class){
+        error("[FIXME] java.lang.NoClassDefFoundError");
+    }
+    return class;
+}
+
+INSTRUCTION_TEXT static void checkcast(Frame *frame, void *data){
+    OperandStack *stack = frame->operandStack;
+    Object *object = (Object*)REF_DECODE(stack->data[stack->size-1].ref);
+    if(NULL==object){
+        return;
+    }
+    Class *class = resolveType(frame, data);
+    if(NULL!=class && !isInstance(object, class)){
+        Exception_ThrowVM(frame, CONST_EXCEPTION_CLASS_CAST);
+    }
+}
+
+INSTRUCTION_TEXT static void instanceof(Frame *frame, void *data){
+    OperandStack *stack = frame->operandStack;
+    ValueSlot *slot = &stack->data[stack->size-1];
+    Object *object = (Object*)REF_DECODE(slot->ref);
+    if(NULL==object){
+        slot->num = 0;
+        return;
+    }
+    Class *class = resolveType(frame, data);
+    slot->num = NULL!=class && isInstance(object, class);
+}
+
+INSTRUCTION_TEXT static void arraylength(Frame *frame, void *data){
+    ValueSlot *slot = &frame->operandStack->data[frame->operandStack->size-1];
+    ArrayObject *array = (ArrayObject*)REF_DECODE(slot->ref);
+    slot->num = (int32_t)array->length;
+}
+
+INSTRUCTION_TEXT static void athrow(Frame *frame, void *data){
+    OperandStack *stack = frame->operandStack;
+    Object *exception = (Object*)REF_DECODE(stack->data[--stack->size].ref);
+    if(NULL==exception){
+        Exception_ThrowVM(frame, CONST_EXCEPTION_NULL_POINTER);
+        return;
+    }
+    Exception_Throw(frame, exception);
+}
+
+INSTRUCTION_TEXT static void monitorenter(Frame *frame, void *data){
+    OperandStack *stack = frame->operandStack;
+    Object *object = (Object*)REF_DECODE(stack->data[--stack->size].ref);
+    if(NULL==object){
+        Exception_ThrowVM(frame, CONST_EXCEPTION_NULL_POINTER);
+        return;
+    }
+    if(0!=Monitor_Enter(object, frame->thread->id)){
+        // out of monitors to inflate the lock into
+        Exception_ThrowVM(frame, CONST_EXCEPTION_OUT_OF_MEMORY);
+    }
+}
+
+INSTRUCTION_TEXT static void monitorexit(Frame *frame, void *data){
+    OperandStack *stack = frame->operandStack;
+    Object *object = (Object*)REF_DECODE(stack->data[--stack->size].ref);
+    if(NULL==object){
+        Exception_ThrowVM(frame, CONST_EXCEPTION_NULL_POINTER);
+        return;
+    }
+    if(0!=Monitor_Exit(object, frame->thread->id)){
+        Exception_ThrowVM(frame, CONST_EXCEPTION_ILLEGAL_MONITOR_STATE);
+    }
+}
+
+void Instructions_InitReferences(Instruction *table){
+    table[CONST_OPCODE_GETSTATIC] = (Instruction){Instruction_FetchWideIndex, getstatic};
+    table[CONST_OPCODE_PUTSTATIC] = (Instruction){Instruction_FetchWideIndex, putstatic};
+    table[CONST_OPCODE_GETFIELD] = (Instruction){Instruction_FetchWideIndex, getfield};
+    table[CONST_OPCODE_PUTFIELD] = (Instruction){Instruction_FetchWideIndex, putfield};
+    table[CONST_OPCODE_INVOKEVIRTUAL] = (Instruction){Instruction_FetchWideIndex, invokevirtual};
+    table[CONST_OPCODE_INVOKESPECIAL] = (Instruction){Instruction_FetchWideIndex, invokespecial};
+    table[CONST_OPCODE_INVOKESTATIC] = (Instruction){Instruction_FetchWideIndex, invokestatic};
+    table[CONST_OPCODE_INVOKEINTERFACE] = (Instruction){Instruction_FetchInvokeIndex, invokeinterface};
+    table[CONST_OPCODE_INVOKEDYNAMIC] = (Instruction){Instruction_FetchInvokeIndex, invokedynamic};
+    table[CONST_OPCODE_NEW] = (Instruction){Instruction_FetchWideIndex, new_};
+    table[CONST_OPCODE_ARRAYLENGTH] = (Instruction){Instruction_FetchNone, arraylength};
+    table[CONST_OPCODE_ATHROW] = (Instruction){Instruction_FetchNone, athrow};
+    table[CONST_OPCODE_CHECKCAST] = (Instruction){Instruction_FetchWideIndex, checkcast};
+    table[CONST_OPCODE_INSTANCEOF] = (Instruction){Instruction_FetchWideIndex, instanceof};
+    table[CONST_OPCODE_MONITORENTER] = (Instruction){Instruction_FetchNone, monitorenter};
+    table[CONST_OPCODE_MONITOREXIT] = (Instruction){Instruction_FetchNone, monitorexit};
+}
@@ -0,0 +1,158 @@
+#include <stdint.h>
+
+#include "runtime/instruction.h"
+#include "runtime/opcode.h"
+#include "runtime/frame.h"
+#include "runtime/object.h"
+#include "runtime/exception.h"
+
+// category 2 locals are moved as raw 64 bits, doubles included
+INSTRUCTION_TEXT static inline void storeWide(Frame *frame, uintptr_t index){
+    OperandStack *stack = frame->operandStack;
+    stack->size -= 2;
+    SLOT_SET_LONG(&frame->localVars[index], SLOT_GET_LONG(&stack->data[stack->size]));
+}
+
+INSTRUCTION_TEXT static void lstore(Frame *frame, void *data){
+    storeWide(frame, INSTRUCTION_OPERAND(data));
+}
+
+INSTRUCTION_TEXT static void lstore_0(Frame *frame, void *data){
+    storeWide(frame, 0);
+}
+
+INSTRUCTION_TEXT static void lstore_1(Frame *frame, void *data){
+    storeWide(frame, 1);
+}
+
+INSTRUCTION_TEXT static void lstore_2(Frame *frame, void *data){
+    storeWide(frame, 2);
+}
+
+INSTRUCTION_TEXT static void lstore_3(Frame *frame, void *data){
+    storeWide(frame, 3);
+}
+
+INSTRUCTION_TEXT static inline void store(Frame *frame, uintptr_t index){
+    OperandStack *stack = frame->operandStack;
+    frame->localVars[index] = stack->data[--stack->size];
+}
+
+INSTRUCTION_TEXT static void istore(Frame *frame, void *data){
+    store(frame, INSTRUCTION_OPERAND(data));
+}
+
+INSTRUCTION_TEXT static void istore_0(Frame *frame, void *data){
+    store(frame, 0);
+}
+
+INSTRUCTION_TEXT static void istore_1(Frame *frame, void *data){
+    store(frame, 1);
+}
+
+INSTRUCTION_TEXT static void istore_2(Frame *frame, void *data){
+    store(frame, 2);
+}
+
+INSTRUCTION_TEXT static void istore_3(Frame *frame, void *data){
+    store(frame, 3);
+}
+
+// operands are popped before the checks, see Frame_ScanRoots
+#define ARRAY_STORE(name, type, checked, slots, VALUE) \
+INSTRUCTION_TEXT static void name(Frame *frame, void *data){ \
+    OperandStack *stack = frame->operandStack; \
+    stack->size -= 2+slots; \
+    ValueSlot *operands = &stack->data[stack->size]; \
+    ArrayObject *array = (ArrayObject*)REF_DECODE(operands[0].ref); \
+    int32_t index = operands[1].num; \
+    if(checked && (uint32_t)index>=array->length){ \
+        Exception_ThrowVM(frame, CONST_EXCEPTION_ARRAY_INDEX); \
+        return; \
+    } \
+    ((type*)array->data)[index] = VALUE(&operands[2], array); \
+}
+
+#define INT_VALUE(slot, array) ((slot)->num)
+#define LONG_VALUE(slot, array) SLOT_GET_LONG(slot)
+// boolean arrays share bastore, they only keep the low bit
+#define BYTE_VALUE(slot, array) ((int8_t)(CONST_ARRAY_TYPE_BOOLEAN==(array)->elementType ? (slot)->num&1 : (slot)->num))
+
+#define ARRAY_STORE_REF(name, checked) \
+INSTRUCTION_TEXT static void name(Frame *frame, void *data){ \
+    OperandStack *stack = frame->operandStack; \
+    stack->size -= 3; \
+    ValueSlot *operands = &stack->data[stack->size]; \
+    ArrayObject *array = (ArrayObject*)REF_DECODE(operands[0].ref); \
+    int32_t index = operands[1].num; \
+    Object *value = (Object*)REF_DECODE(operands[2].ref); \
+    if(checked && (uint32_t)index>=array->length){ \
+        Exception_ThrowVM(frame, CONST_EXCEPTION_ARRAY_INDEX); \
+        return; \
+    } \
+    /* a null array would only fault in the write barrier */ \
+    if(!checked && NULL==array){ \
+        Exception_ThrowVM(frame, CONST_EXCEPTION_NULL_POINTER); \
+        return; \
+    } \
+    if(!ArrayObject_CanStore(array, value)){ \
+        Exception_ThrowVM(frame, CONST_EXCEPTION_ARRAY_STORE); \
+        return; \
+    } \
+    ArrayObject_PutRef(array, (uint32_t)index, value); \
+}
+
+ARRAY_STORE(iastore, int32_t, 1, 1, INT_VALUE)
+ARRAY_STORE(lastore, int64_t, 1, 2, LONG_VALUE)
+ARRAY_STORE_REF(aastore, 1)
+ARRAY_STORE(bastore, int8_t, 1, 1, BYTE_VALUE)
+ARRAY_STORE(castore, int16_t, 1, 1, INT_VALUE)
+ARRAY_STORE(iastore_unchecked, int32_t, 0, 1, INT_VALUE)
+ARRAY_STORE(lastore_unchecked, int64_t, 0, 2, LONG_VALUE)
+ARRAY_STORE_REF(aastore_unchecked, 0)
+ARRAY_STORE(bastore_unchecked, int8_t, 0, 1, BYTE_VALUE)
+ARRAY_STORE(castore_unchecked, int16_t, 0, 1, INT_VALUE)
+
+void Instructions_InitStores(Instruction *table){
+    table[CONST_OPCODE_ISTORE] = (Instruction){Instruction_FetchIndex, istore};
+    table[CONST_OPCODE_ISTORE_0] = (Instruction){Instruction_FetchNone, istore_0};
+    table[CONST_OPCODE_ISTORE_1] = (Instruction){Instruction_FetchNone, istore_1};
+    table[CONST_OPCODE_ISTORE_2] = (Instruction){Instruction_FetchNone, istore_2};
+    table[CONST_OPCODE_ISTORE_3] = (Instruction){Instruction_FetchNone, istore_3};
+    table[CONST_OPCODE_FSTORE] = (Instruction){Instruction_FetchIndex, istore};
+    table[CONST_OPCODE_FSTORE_0] = (Instruction){Instruction_FetchNone, istore_0};
+    table[CONST_OPCODE_FSTORE_1] = (Instruction){Instruction_FetchNone, istore_1};
+    table[CONST_OPCODE_FSTORE_2] = (Instruction){Instruction_FetchNone, istore_2};
+    table[CONST_OPCODE_FSTORE_3] = (Instruction){Instruction_FetchNone, istore_3};
+    table[CONST_OPCODE_ASTORE] = (Instruction){Instruction_FetchIndex, istore};
+    table[CONST_OPCODE_ASTORE_0] = (Instruction){Instruction_FetchNone, istore_0};
+    table[CONST_OPCODE_ASTORE_1] = (Instruction){Instruction_FetchNone, istore_1};
+    table[CONST_OPCODE_ASTORE_2] = (Instruction){Instruction_FetchNone, istore_2};
+    table[CONST_OPCODE_ASTORE_3] = (Instruction){Instruction_FetchNone, istore_3};
+    table[CONST_OPCODE_LSTORE] = (Instruction){Instruction_FetchIndex, lstore};
+    table[CONST_OPCODE_LSTORE_0] = (Instruction){Instruction_FetchNone, lstore_0};
+    table[CONST_OPCODE_LSTORE_1] = (Instruction){Instruction_FetchNone, lstore_1};
+    table[CONST_OPCODE_LSTORE_2] = (Instruction){Instruction_FetchNone, lstore_2};
+    table[CONST_OPCODE_LSTORE_3] = (Instruction){Instruction_FetchNone, lstore_3};
+    table[CONST_OPCODE_DSTORE] = (Instruction){Instruction_FetchIndex, lstore};
+    table[CONST_OPCODE_DSTORE_0] = (Instruction){Instruction_FetchNone, lstore_0};
+    table[CONST_OPCODE_DSTORE_1] = (Instruction){Instruction_FetchNone, lstore_1};
+    table[CONST_OPCODE_DSTORE_2] = (Instruction){Instruction_FetchNone, lstore_2};
+    table[CONST_OPCODE_DSTORE_3] = (Instruction){Instruction_FetchNone, lstore_3};
+    table[CONST_OPCODE_IASTORE] = (Instruction){Instruction_FetchNone, iastore};
+    table[CONST_OPCODE_LASTORE] = (Instruction){Instruction_FetchNone, lastore};
+    table[CONST_OPCODE_FASTORE] = (Instruction){Instruction_FetchNone, iastore};
+    table[CONST_OPCODE_DASTORE] = (Instruction){Instruction_FetchNone, lastore};
+    table[CONST_OPCODE_AASTORE] = (Instruction){Instruction_FetchNone, aastore};
+    table[CONST_OPCODE_BASTORE] = (Instruction){Instruction_FetchNone, bastore};
+    table[CONST_OPCODE_CASTORE] = (Instruction){Instruction_FetchNone, castore};
+    table[CONST_OPCODE_SASTORE] = (Instruction){Instruction_FetchNone, castore};
+    table[OPCODE_UNCHECKED_STORE(CONST_OPCODE_IASTORE)] = (Instruction){Instruction_FetchNone, iastore_unchecked};
+    table[OPCODE_UNCHECKED_STORE(CONST_OPCODE_LASTORE)] = (Instruction){Instruction_FetchNone, lastore_unchecked};
+    table[OPCODE_UNCHECKED_STORE(CONST_OPCODE_FASTORE)] = (Instruction){Instruction_FetchNone, iastore_unchecked};
+    table[OPCODE_UNCHECKED_STORE(CONST_OPCODE_DASTORE)] = (Instruction){Instruction_FetchNone, lastore_unchecked};
+    table[OPCODE_UNCHECKED_STORE(CONST_OPCODE_AASTORE)] = (Instruction){Instruction_FetchNone, aastore_unchecked};
+    table[OPCODE_UNCHECKED_STORE(CONST_OPCODE_BASTORE)] = (Instruction){Instruction_FetchNone, bastore_unchecked};
+    table[OPCODE_UNCHECKED_STORE(CONST_OPCODE_CASTORE)] = (Instruction){Instruction_FetchNone, castore_unchecked};
+    table[OPCODE_UNCHECKED_STORE(CONST_OPCODE_SASTORE)] = (Instruction){Instruction_FetchNone, castore_unchecked};
+}
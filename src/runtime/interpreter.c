@@ -0,0 +1,92 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <setjmp.h>
+
+#define INCLUDE_RUNTIME_INTERPRETER_SELF 1
+#include "runtime/interpreter.h"
+#include "runtime/instruction.h"
+#include "runtime/thread.h"
+#include "runtime/frame.h"
+#include "runtime/safepoint.h"
+#include "runtime/exception.h"
+#include "stream.h"
+#include "utils.h"
+
+int Interpreter_Run(Thread *thread){
+    Frame *entry = thread->stack->_top;
+    if(NULL==entry){
+        error("[FIXME] jvm stack is empty.");
+        return -1;
+    }
+    if(thread->aborted){
+        return -1;
+    }
+    Frame *invoker = entry->lower;
+    Frame *javaBase = thread->javaBase;
+    Frame *current = NULL;
+    uint8_t *code = NULL;
+    Stream *stream = NULL;
+    StreamReaderOp *reader = NULL;
+    int status = 0;
+    sigjmp_buf nullTrap;
+    sigjmp_buf *outerTrap = thread->nullTrap;
+    thread->javaBase = invoker;
+    // native when called from C, java when <clinit> runs nested in an instruction
+    int32_t outerState;
+    SAFEPOINT_ENTER_NATIVE(thread, outerState);
+    Safepoint_LeaveNative(thread, CONST_THREAD_STATE_JAVA);
+    // an instruction dereferenced null, the top frame is still the one running it
+    if(0!=sigsetjmp(nullTrap, 1)){
+        current = NULL;
+        Exception_ThrowVM(thread->stack->_top, CONST_EXCEPTION_NULL_POINTER);
+    }
+    thread->nullTrap = &nullTrap;
+    while(invoker!=thread->stack->_top){
+        Frame *frame = thread->stack->_top;
+        frame->pc = frame->nextPc;
+        // a guarded loop may have sent the frame back to the class file code
+        if(frame!=current || frame->code!=code){
+            if(NULL==stream){
+                stream = BytecodeReader_New(frame->code, frame->codeLength, frame->pc);
+                reader = (StreamReaderOp*)stream->reader;
+            }else{
+                BytecodeReader_Rebind(stream, frame->code, frame->codeLength, frame->pc);
+            }
+            current = frame;
+            code = frame->code;
+        }else{
+            // the reader already sits on nextPc unless the instruction branched
+            long int delta = (long int)frame->pc - reader->Position(stream);
+            if(0!=delta){
+                reader->Skip(stream, delta);
+            }
+        }
+        uint8_t opcode;
+        if(0>=reader->ReadUint8(stream, &opcode)){
+            error("[FIXME] fell off the end of the code at pc %u.", frame->pc);
+            status = -1;
+            break;
+        }
+        Instruction *instruction = Instruction_Get(opcode);
+        if(NULL==instruction){
+            error("[FIXME] unsupported opcode 0x%02x at pc %u.", opcode, frame->pc);
+            status = -1;
+            break;
+        }
+        void *data = instruction->FetchOperands(stream);
+        frame->nextPc = (uint32_t)reader->Position(stream);
+        instruction->Execute(frame, data);
+    }
+    SAFEPOINT_SAVE_CONTEXT(thread);
+    Safepoint_LeaveNative(thread, outerState);
+    thread->nullTrap = outerTrap;
+    thread->javaBase = javaBase;
+    if(thread->aborted){
+        // nested in an instruction of an enclosing run, which stops right after it
+        if(NULL!=outerTrap){
+            Exception_Abort(thread);
+        }
+        return -1;
+    }
+    return NULL==thread->exception ? status : -1;
+}
@@ -0,0 +1,995 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define INTRINSIC_AVX2 1
+#define INTRINSIC_SSE42 1
+#endif
+
+#define INCLUDE_RUNTIME_INTRINSIC_SELF 1
+#include "runtime/intrinsic.h"
+#include "runtime/frame.h"
+#include "runtime/object.h"
+#include "runtime/class.h"
+#include "runtime/heap.h"
+#include "runtime/exception.h"
+#include "runtime/jstring.h"
+#include "runtime/monitor.h"
+#include "runtime/thread.h"
+#include "utils.h"
+
+// 31^8 (mod 2^32), the weight of a block of 8 elements in a java hash code
+#define HASH_BLOCK_WEIGHT  2487512833u
+
+// Bulk loops over array payloads, in one flavour per instruction set.
+typedef struct{
+    // bytes is a multiple of the element size, the pattern repeats the element
+    void (*fill)(uint8_t *dst, uint64_t pattern, size_t bytes);
+    // offset of the first differing byte, bytes when there is none
+    size_t (*mismatch)(const uint8_t *a, const uint8_t *b, size_t bytes);
+    // hash = 31*hash + element over the whole range
+    uint32_t (*hashByte)(uint32_t hash, const int8_t *data, size_t count);
+    uint32_t (*hashChar)(uint32_t hash, const uint16_t *data, size_t count);
+    uint32_t (*hashShort)(uint32_t hash, const int16_t *data, size_t count);
+    uint32_t (*hashInt)(uint32_t hash, const int32_t *data, size_t count);
+    uint32_t (*hashLatin1)(uint32_t hash, const uint8_t *data, size_t count);
+    // index of the first element equal to c, count when there is none
+    size_t (*findByte)(const uint8_t *data, size_t count, uint8_t c);
+    size_t (*findChar)(const uint16_t *data, size_t count, uint16_t c);
+    // start of the first occurrence of a non-empty needle, count when there is none
+    size_t (*searchBytes)(const uint8_t *data, size_t count, const uint8_t *needle, size_t needleCount);
+    size_t (*searchChars)(const uint16_t *data, size_t count, const uint16_t *needle, size_t needleCount);
+    void (*inflate)(const uint8_t *src, uint16_t *dst, size_t count);
+    // chars stored before the first one above Latin-1
+    size_t (*compress)(const uint16_t *src, uint8_t *dst, size_t count);
+} Kernels;
+
+static Kernels kernels;
+
+static void portable_fill(uint8_t *dst, uint64_t pattern, size_t bytes){
+    size_t i = 0;
+    for(;i+8<=bytes;i+=8){
+        memcpy(dst+i, &pattern, 8);
+    }
+    memcpy(dst+i, &pattern, bytes-i);
+}
+
+static size_t portable_mismatch(const uint8_t *a, const uint8_t *b, size_t bytes){
+    for(size_t i=0;i<bytes;i++){
+        if(a[i]!=b[i]){
+            return i;
+        }
+    }
+    return bytes;
+}
+
+#define PORTABLE_HASH(name, type) \
+static uint32_t name(uint32_t hash, const type *data, size_t count){ \
+    for(size_t i=0;i<count;i++){ \
+        hash = 31*hash + (uint32_t)(int32_t)data[i]; \
+    } \
+    return hash; \
+}
+
+PORTABLE_HASH(portable_hashByte, int8_t)
+PORTABLE_HASH(portable_hashChar, uint16_t)
+PORTABLE_HASH(portable_hashShort, int16_t)
+PORTABLE_HASH(portable_hashInt, int32_t)
+PORTABLE_HASH(portable_hashLatin1, uint8_t)
+
+#define PORTABLE_FIND(name, type) \
+static size_t name(const type *data, size_t count, type c){ \
+    for(size_t i=0;i<count;i++){ \
+        if(c==data[i]){ \
+            return i; \
+        } \
+    } \
+    return count; \
+}
+
+PORTABLE_FIND(portable_findByte, uint8_t)
+PORTABLE_FIND(portable_findChar, uint16_t)
+
+// candidates are the matches of the first element
+#define PORTABLE_SEARCH(name, type, FIND) \
+static size_t name(const type *data, size_t count, const type *needle, size_t needleCount){ \
+    if(needleCount>count){ \
+        return count; \
+    } \
+    size_t last = count-needleCount; \
+    for(size_t i=0;i<=last;i++){ \
+        i += FIND(data+i, last-i+1, needle[0]); \
+        if(i>last){ \
+            break; \
+        } \
+        if(0==memcmp(data+i, needle, needleCount*sizeof(type))){ \
+            return i; \
+        } \
+    } \
+    return count; \
+}
+
+PORTABLE_SEARCH(portable_searchBytes, uint8_t, kernels.findByte)
+PORTABLE_SEARCH(portable_searchChars, uint16_t, kernels.findChar)
+
+static void portable_inflate(const uint8_t *src, uint16_t *dst, size_t count){
+    for(size_t i=0;i<count;i++){
+        dst[i] = src[i];
+    }
+}
+
+static size_t portable_compress(const uint16_t *src, uint8_t *dst, size_t count){
+    for(size_t i=0;i<count;i++){
+        if(0xFF<src[i]){
+            return i;
+        }
+        dst[i] = (uint8_t)src[i];
+    }
+    return count;
+}
+
+#if defined(__SSE2__)
+static void sse2_fill(uint8_t *dst, uint64_t pattern, size_t bytes){
+    __m128i value = _mm_set1_epi64x((int64_t)pattern);
+    size_t i = 0;
+    for(;i+16<=bytes;i+=16){
+        _mm_storeu_si128((__m128i*)(dst+i), value);
+    }
+    portable_fill(dst+i, pattern, bytes-i);
+}
+
+static size_t sse2_mismatch(const uint8_t *a, const uint8_t *b, size_t bytes){
+    size_t i = 0;
+    for(;i+16<=bytes;i+=16){
+        __m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a+i)), _mm_loadu_si128((const __m128i*)(b+i)));
+        uint32_t diff = ~(uint32_t)_mm_movemask_epi8(equal) & 0xFFFF;
+        if(0!=diff){
+            return i + __builtin_ctz(diff);
+        }
+    }
+    return i + portable_mismatch(a+i, b+i, bytes-i);
+}
+
+static size_t sse2_findByte(const uint8_t *data, size_t count, uint8_t c){
+    __m128i value = _mm_set1_epi8((char)c);
+    size_t i = 0;
+    for(;i+16<=count;i+=16){
+        uint32_t hits = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(data+i)), value));
+        if(0!=hits){
+            return i + __builtin_ctz(hits);
+        }
+    }
+    return i + portable_findByte(data+i, count-i, c);
+}
+
+static size_t sse2_findChar(const uint16_t *data, size_t count, uint16_t c){
+    __m128i value = _mm_set1_epi16((short)c);
+    size_t i = 0;
+    for(;i+8<=count;i+=8){
+        uint32_t hits = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)(data+i)), value));
+        if(0!=hits){
+            return i + __builtin_ctz(hits)/2;
+        }
+    }
+    return i + portable_findChar(data+i, count-i, c);
+}
+
+static void sse2_inflate(const uint8_t *src, uint16_t *dst, size_t count){
+    __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for(;i+16<=count;i+=16){
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(src+i));
+        _mm_storeu_si128((__m128i*)(dst+i), _mm_unpacklo_epi8(bytes, zero));
+        _mm_storeu_si128((__m128i*)(dst+i+8), _mm_unpackhi_epi8(bytes, zero));
+    }
+    portable_inflate(src+i, dst+i, count-i);
+}
+
+static size_t sse2_compress(const uint16_t *src, uint8_t *dst, size_t count){
+    __m128i high = _mm_set1_epi16((short)0xFF00);
+    size_t i = 0;
+    for(;i+16<=count;i+=16){
+        __m128i low = _mm_loadu_si128((const __m128i*)(src+i));
+        __m128i upper = _mm_loadu_si128((const __m128i*)(src+i+8));
+        __m128i wide = _mm_and_si128(_mm_or_si128(low, upper), high);
+        if(0xFFFF!=_mm_movemask_epi8(_mm_cmpeq_epi16(wide, _mm_setzero_si128()))){
+            break;
+        }
+        _mm_storeu_si128((__m128i*)(dst+i), _mm_packus_epi16(low, upper));
+    }
+    return i + portable_compress(src+i, dst+i, count-i);
+}
+#endif
+
+static Kernels kernels = {
+#if defined(__SSE2__)
+    .fill = sse2_fill,
+    .mismatch = sse2_mismatch,
+    .findByte = sse2_findByte,
+    .findChar = sse2_findChar,
+    .inflate = sse2_inflate,
+    .compress = sse2_compress,
+#else
+    .fill = portable_fill,
+    .mismatch = portable_mismatch,
+    .findByte = portable_findByte,
+    .findChar = portable_findChar,
+    .inflate = portable_inflate,
+    .compress = portable_compress,
+#endif
+    .hashByte = portable_hashByte,
+    .hashChar = portable_hashChar,
+    .hashShort = portable_hashShort,
+    .hashInt = portable_hashInt,
+    .hashLatin1 = portable_hashLatin1,
+    .searchBytes = portable_searchBytes,
+    .searchChars = portable_searchChars
+};
+
+#ifdef INTRINSIC_SSE42
+// pcmpestri finds where the first 16 bytes of the needle start in a block,
+// also when they run past its end, so blocks without a candidate are skipped
+// whole and candidates are verified against the full needle. Blocks at the
+// end of the data are copied out, loads must not run past the payload.
+#define SSE42_SEARCH(name, type, MODE) \
+__attribute__((target("sse4.2"))) \
+static size_t name(const type *data, size_t count, const type *needle, size_t needleCount){ \
+    const size_t lanes = 16/sizeof(type); \
+    if(needleCount>count){ \
+        return count; \
+    } \
+    type head[16/sizeof(type)] = {0}; \
+    int headCount = needleCount<lanes ? (int)needleCount : (int)lanes; \
+    memcpy(head, needle, headCount*sizeof(type)); \
+    __m128i pattern = _mm_loadu_si128((const __m128i*)head); \
+    size_t last = count-needleCount; \
+    size_t i = 0; \
+    while(i<=last){ \
+        type block[16/sizeof(type)]; \
+        const type *cur = data+i; \
+        int blockCount = count-i<lanes ? (int)(count-i) : (int)lanes; \
+        if(blockCount<(int)lanes){ \
+            memcpy(block, cur, blockCount*sizeof(type)); \
+            cur = block; \
+        } \
+        int at = _mm_cmpestri(pattern, headCount, _mm_loadu_si128((const __m128i*)cur), blockCount, MODE|_SIDD_CMP_EQUAL_ORDERED); \
+        if((int)lanes==at){ \
+            i += lanes; \
+            continue; \
+        } \
+        i += at; \
+        if(i>last){ \
+            break; \
+        } \
+        if(0==memcmp(data+i, needle, needleCount*sizeof(type))){ \
+            return i; \
+        } \
+        i++; \
+    } \
+    return count; \
+}
+
+SSE42_SEARCH(sse42_searchBytes, uint8_t, _SIDD_UBYTE_OPS)
+SSE42_SEARCH(sse42_searchChars, uint16_t, _SIDD_UWORD_OPS)
+#endif
+
+#ifdef INTRINSIC_AVX2
+static uint32_t pow31(size_t n){
+    uint32_t result = 1;
+    uint32_t base = 31;
+    for(;0!=n;n>>=1){
+        if(n&1){
+            result *= base;
+        }
+        base *= base;
+    }
+    return result;
+}
+
+__attribute__((target("avx2")))
+static void avx2_fill(uint8_t *dst, uint64_t pattern, size_t bytes){
+    __m256i value = _mm256_set1_epi64x((int64_t)pattern);
+    size_t i = 0;
+    for(;i+32<=bytes;i+=32){
+        _mm256_storeu_si256((__m256i*)(dst+i), value);
+    }
+    portable_fill(dst+i, pattern, bytes-i);
+}
+
+__attribute__((target("avx2")))
+static size_t avx2_mismatch(const uint8_t *a, const uint8_t *b, size_t bytes){
+    size_t i = 0;
+    for(;i+32<=bytes;i+=32){
+        __m256i equal = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(a+i)), _mm256_loadu_si256((const __m256i*)(b+i)));
+        uint32_t diff = ~(uint32_t)_mm256_movemask_epi8(equal);
+        if(0!=diff){
+            return i + __builtin_ctz(diff);
+        }
+    }
+    return i + portable_mismatch(a+i, b+i, bytes-i);
+}
+
+// Lane k sums the elements 8b+k weighted by 31^(8*(blocks-1-b)), folding
+// the lanes with 31^(7-k) gives the hash of the blocks.
+#define AVX2_HASH(name, type, LOAD) \
+__attribute__((target("avx2"))) \
+static uint32_t name(uint32_t hash, const type *data, size_t count){ \
+    static const uint32_t weights[8] = {1742810335u, 887503681u, 28629151u, 923521u, 29791u, 961u, 31u, 1u}; \
+    __m256i acc = _mm256_setzero_si256(); \
+    __m256i step = _mm256_set1_epi32((int32_t)HASH_BLOCK_WEIGHT); \
+    size_t i = 0; \
+    for(;i+8<=count;i+=8){ \
+        acc = _mm256_add_epi32(_mm256_mullo_epi32(acc, step), LOAD(data+i)); \
+    } \
+    if(0<i){ \
+        uint32_t lanes[8]; \
+        _mm256_storeu_si256((__m256i*)lanes, acc); \
+        hash *= pow31(i); \
+        for(int k=0;k<8;k++){ \
+            hash += lanes[k]*weights[k]; \
+        } \
+    } \
+    for(;i<count;i++){ \
+        hash = 31*hash + (uint32_t)(int32_t)data[i]; \
+    } \
+    return hash; \
+}
+
+#define LOAD_BYTES(p) _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)(p)))
+#define LOAD_CHARS(p) _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(p)))
+#define LOAD_SHORTS(p) _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(p)))
+#define LOAD_INTS(p) _mm256_loadu_si256((const __m256i*)(p))
+
+AVX2_HASH(avx2_hashByte, int8_t, LOAD_BYTES)
+AVX2_HASH(avx2_hashChar, uint16_t, LOAD_CHARS)
+AVX2_HASH(avx2_hashShort, int16_t, LOAD_SHORTS)
+AVX2_HASH(avx2_hashInt, int32_t, LOAD_INTS)
+
+#define LOAD_LATIN1(p) _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(p)))
+
+AVX2_HASH(avx2_hashLatin1, uint8_t, LOAD_LATIN1)
+
+__attribute__((target("avx2")))
+static size_t avx2_findByte(const uint8_t *data, size_t count, uint8_t c){
+    __m256i value = _mm256_set1_epi8((char)c);
+    size_t i = 0;
+    for(;i+32<=count;i+=32){
+        uint32_t hits = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(data+i)), value));
+        if(0!=hits){
+            return i + __builtin_ctz(hits);
+        }
+    }
+    return i + portable_findByte(data+i, count-i, c);
+}
+
+__attribute__((target("avx2")))
+static size_t avx2_findChar(const uint16_t *data, size_t count, uint16_t c){
+    __m256i value = _mm256_set1_epi16((short)c);
+    size_t i = 0;
+    for(;i+16<=count;i+=16){
+        uint32_t hits = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i*)(data+i)), value));
+        if(0!=hits){
+            return i + __builtin_ctz(hits)/2;
+        }
+    }
+    return i + portable_findChar(data+i, count-i, c);
+}
+
+__attribute__((target("avx2")))
+static void avx2_inflate(const uint8_t *src, uint16_t *dst, size_t count){
+    size_t i = 0;
+    for(;i+16<=count;i+=16){
+        _mm256_storeu_si256((__m256i*)(dst+i), _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(src+i))));
+    }
+    portable_inflate(src+i, dst+i, count-i);
+}
+
+// packus works within 128-bit lanes, the permute puts the quarters back in order
+__attribute__((target("avx2")))
+static size_t avx2_compress(const uint16_t *src, uint8_t *dst, size_t count){
+    __m256i high = _mm256_set1_epi16((short)0xFF00);
+    size_t i = 0;
+    for(;i+32<=count;i+=32){
+        __m256i low = _mm256_loadu_si256((const __m256i*)(src+i));
+        __m256i upper = _mm256_loadu_si256((const __m256i*)(src+i+16));
+        if(!_mm256_testz_si256(_mm256_or_si256(low, upper), high)){
+            break;
+        }
+        _mm256_storeu_si256((__m256i*)(dst+i), _mm256_permute4x64_epi64(_mm256_packus_epi16(low, upper), 0xD8));
+    }
+    return i + portable_compress(src+i, dst+i, count-i);
+}
+#endif
+
+void Intrinsic_Init(void){
+#if defined(INTRINSIC_SSE42) || defined(INTRINSIC_AVX2)
+    __builtin_cpu_init();
+#endif
+#ifdef INTRINSIC_SSE42
+    if(__builtin_cpu_supports("sse4.2")){
+        kernels.searchBytes = sse42_searchBytes;
+        kernels.searchChars = sse42_searchChars;
+    }
+#endif
+#ifdef INTRINSIC_AVX2
+    if(__builtin_cpu_supports("avx2")){
+        kernels.fill = avx2_fill;
+        kernels.mismatch = avx2_mismatch;
+        kernels.hashByte = avx2_hashByte;
+        kernels.hashChar = avx2_hashChar;
+        kernels.hashShort = avx2_hashShort;
+        kernels.hashInt = avx2_hashInt;
+        kernels.hashLatin1 = avx2_hashLatin1;
+        kernels.findByte = avx2_findByte;
+        kernels.findChar = avx2_findChar;
+        kernels.inflate = avx2_inflate;
+        kernels.compress = avx2_compress;
+    }
+#endif
+}
+
+// floatToIntBits and doubleToLongBits fold every NaN into one value
+static uint32_t floatBits(uint32_t bits){
+    return (bits&0x7FFFFFFF)>0x7F800000 ? 0x7FC00000 : bits;
+}
+
+static uint64_t doubleBits(uint64_t bits){
+    return (bits&0x7FFFFFFFFFFFFFFF)>0x7FF0000000000000 ? 0x7FF8000000000000 : bits;
+}
+
+static inline ValueSlot* popArgs(Frame *frame, unsigned int slots){
+    OperandStack *stack = frame->operandStack;
+    stack->size -= slots;
+    return &stack->data[stack->size];
+}
+
+static inline uint8_t* elementAt(ArrayObject *array, int32_t index){
+    return (uint8_t*)array->data + (size_t)index*array->elementSize;
+}
+
+// copies until an element cannot be stored, its index is returned (length when all made it)
+static int32_t copyRefs(ArrayObject *src, int32_t srcPos, ArrayObject *dest, int32_t destPos, int32_t length){
+    int checked = src!=dest && src->componentClass!=dest->componentClass
+        && !Class_IsSubclassOf(src->componentClass, dest->componentClass);
+    if(src==dest && srcPos<destPos){
+        for(int32_t i=length-1;i>=0;i--){
+            ArrayObject_PutRef(dest, destPos+i, ArrayObject_GetRef(src, srcPos+i));
+        }
+        return length;
+    }
+    for(int32_t i=0;i<length;i++){
+        Object *value = (Object*)ArrayObject_GetRef(src, srcPos+i);
+        if(checked && !ArrayObject_CanStore(dest, value)){
+            return i;
+        }
+        ArrayObject_PutRef(dest, destPos+i, value);
+    }
+    return length;
+}
+
+// System.arraycopy(Object src, int srcPos, Object dest, int destPos, int length)
+static void arraycopy(Frame *frame){
+    ValueSlot *args = popArgs(frame, 5);
+    ArrayObject *src = (ArrayObject*)REF_DECODE(args[0].ref);
+    int32_t srcPos = args[1].num;
+    ArrayObject *dest = (ArrayObject*)REF_DECODE(args[2].ref);
+    int32_t destPos = args[3].num;
+    int32_t length = args[4].num;
+    if(NULL==src || NULL==dest){
+        Exception_ThrowVM(frame, CONST_EXCEPTION_NULL_POINTER);
+        return;
+    }
+    if(!(src->header.mark & CONST_HEADER_ARRAY) || !(dest->header.mark & CONST_HEADER_ARRAY)
+        || src->elementType!=dest->elementType){
+        Exception_ThrowVM(frame, CONST_EXCEPTION_ARRAY_STORE);
+        return;
+    }
+    if(0>srcPos || 0>destPos || 0>length
+        || (int64_t)srcPos+length>src->length || (int64_t)destPos+length>dest->length){
+        Exception_ThrowVM(frame, CONST_EXCEPTION_ARRAY_INDEX);
+        return;
+    }
+    if(CONST_ARRAY_TYPE_REFERENCE!=src->elementType){
+        memmove(elementAt(dest, destPos), elementAt(src, srcPos), (size_t)length*src->elementSize);
+        return;
+    }
+    if(length!=copyRefs(src, srcPos, dest, destPos, length)){
+        Exception_ThrowVM(frame, CONST_EXCEPTION_ARRAY_STORE);
+    }
+}
+
+// Arrays.fill(a, val) and Arrays.fill(a, fromIndex, toIndex, val)
+static void fillArray(Frame *frame, unsigned int valueSlots, int ranged){
+    ValueSlot *args = popArgs(frame, 1 + (ranged ? 2 : 0) + valueSlots);
+    ArrayObject *array = (ArrayObject*)REF_DECODE(args[0].ref);
+    ValueSlot *value = &args[ranged ? 3 : 1];
+    if(NULL==array){
+        Exception_ThrowVM(frame, CONST_EXCEPTION_NULL_POINTER);
+        return;
+    }
+    int32_t from = 0;
+    int32_t to = (int32_t)array->length;
+    if(ranged){
+        from = args[1].num;
+        to = args[2].num;
+        if(from>to){
+            error("[FIXME] java.lang.IllegalArgumentException: fromIndex(%d) > toIndex(%d)", from, to);
+            return;
+        }
+        if(0>from || to>(int32_t)array->length){
+            Exception_ThrowVM(frame, CONST_EXCEPTION_ARRAY_INDEX);
+            return;
+        }
+    }
+    if(CONST_ARRAY_TYPE_REFERENCE==array->elementType){
+        Object *element = (Object*)REF_DECODE(value->ref);
+        if(from<to && !ArrayObject_CanStore(array, element)){
+            Exception_ThrowVM(frame, CONST_EXCEPTION_ARRAY_STORE);
+            return;
+        }
+        for(int32_t i=from;i<to;i++){
+            ArrayObject_PutRef(array, i, element);
+        }
+        return;
+    }
+    uint64_t bits = 2==valueSlots ? (uint64_t)SLOT_GET_LONG(value) : (uint32_t)value->num;
+    uint64_t pattern;
+    switch(array->elementSize){
+        case 1:
+            pattern = (uint64_t)(uint8_t)bits * 0x0101010101010101u;
+            break;
+        case 2:
+            pattern = (uint64_t)(uint16_t)bits * 0x0001000100010001u;
+            break;
+        case 4:
+            pattern = (uint64_t)(uint32_t)bits * 0x0000000100000001u;
+            break;
+        default:
+            pattern = bits;
+            break;
+    }
+    kernels.fill(elementAt(array, from), pattern, (size_t)(to-from)*array->elementSize);
+}
+
+static void fill(Frame *frame){
+    fillArray(frame, 1, 0);
+}
+
+static void fillWide(Frame *frame){
+    fillArray(frame, 2, 0);
+}
+
+static void fillRange(Frame *frame){
+    fillArray(frame, 1, 1);
+}
+
+static void fillRangeWide(Frame *frame){
+    fillArray(frame, 2, 1);
+}
+
+static int arraysEqual(ArrayObject *a, ArrayObject *b){
+    if(a==b){
+        return 1;
+    }
+    if(NULL==a || NULL==b || a->length!=b->length){
+        return 0;
+    }
+    const uint8_t *left = (const uint8_t*)a->data;
+    const uint8_t *right = (const uint8_t*)b->data;
+    size_t bytes = (size_t)a->length*a->elementSize;
+    size_t at = kernels.mismatch(left, right, bytes);
+    // differing bits are still equal floating point values when both are NaN
+    while(at<bytes){
+        size_t start = at - at%a->elementSize;
+        if(CONST_ARRAY_TYPE_FLOAT==a->elementType){
+            uint32_t x, y;
+            memcpy(&x, left+start, 4);
+            memcpy(&y, right+start, 4);
+            if(floatBits(x)!=floatBits(y)){
+                return 0;
+            }
+        }else if(CONST_ARRAY_TYPE_DOUBLE==a->elementType){
+            uint64_t x, y;
+            memcpy(&x, left+start, 8);
+            memcpy(&y, right+start, 8);
+            if(doubleBits(x)!=doubleBits(y)){
+                return 0;
+            }
+        }else{
+            return 0;
+        }
+        start += a->elementSize;
+        at = start + kernels.mismatch(left+start, right+start, bytes-start);
+    }
+    return 1;
+}
+
+// Arrays.equals of two primitive arrays
+static void equals(Frame *frame){
+    ValueSlot *args = popArgs(frame, 2);
+    int32_t result = arraysEqual((ArrayObject*)REF_DECODE(args[0].ref), (ArrayObject*)REF_DECODE(args[1].ref));
+    frame->operandStack->data[frame->operandStack->size++].num = result;
+}
+
+static uint32_t longHash(uint32_t hash, uint64_t value){
+    return 31*hash + (uint32_t)(value^(value>>32));
+}
+
+static uint32_t arrayHash(ArrayObject *array){
+    uint32_t hash = 1;
+    size_t count = array->length;
+    switch(array->elementType){
+        case CONST_ARRAY_TYPE_BYTE:
+            return kernels.hashByte(hash, (const int8_t*)array->data, count);
+        case CONST_ARRAY_TYPE_CHAR:
+            return kernels.hashChar(hash, (const uint16_t*)array->data, count);
+        case CONST_ARRAY_TYPE_SHORT:
+            return kernels.hashShort(hash, (const int16_t*)array->data, count);
+        case CONST_ARRAY_TYPE_INT:
+            return kernels.hashInt(hash, (const int32_t*)array->data, count);
+        case CONST_ARRAY_TYPE_BOOLEAN:
+            for(size_t i=0;i<count;i++){
+                hash = 31*hash + (((uint8_t*)array->data)[i] ? 1231 : 1237);
+            }
+            return hash;
+        case CONST_ARRAY_TYPE_FLOAT:
+            for(size_t i=0;i<count;i++){
+                hash = 31*hash + floatBits(((uint32_t*)array->data)[i]);
+            }
+            return hash;
+        case CONST_ARRAY_TYPE_LONG:
+            for(size_t i=0;i<count;i++){
+                hash = longHash(hash, ((uint64_t*)array->data)[i]);
+            }
+            return hash;
+        case CONST_ARRAY_TYPE_DOUBLE:
+            for(size_t i=0;i<count;i++){
+                hash = longHash(hash, doubleBits(((uint64_t*)array->data)[i]));
+            }
+            return hash;
+        default:
+            return hash;
+    }
+}
+
+// Arrays.hashCode of a primitive array
+static void hashCode(Frame *frame){
+    ValueSlot *args = popArgs(frame, 1);
+    ArrayObject *array = (ArrayObject*)REF_DECODE(args[0].ref);
+    int32_t result = NULL==array ? 0 : (int32_t)arrayHash(array);
+    frame->operandStack->data[frame->operandStack->size++].num = result;
+}
+
+int32_t Intrinsic_StringHash(const uint8_t *bytes, uint32_t size, uint8_t coder){
+    if(CONST_STRING_CODER_LATIN1==coder){
+        return (int32_t)kernels.hashLatin1(0, bytes, size);
+    }
+    return (int32_t)kernels.hashChar(0, (const uint16_t*)bytes, size/2);
+}
+
+static inline void pushInt(Frame *frame, int32_t value){
+    frame->operandStack->data[frame->operandStack->size++].num = value;
+}
+
+static inline uint8_t* stringBytes(StringObject *string){
+    return (uint8_t*)String_Value(string)->data;
+}
+
+// String.equals(Object)
+static void stringEquals(Frame *frame){
+    ValueSlot *args = popArgs(frame, 2);
+    StringObject *string = (StringObject*)REF_DECODE(args[0].ref);
+    StringObject *other = (StringObject*)REF_DECODE(args[1].ref);
+    int32_t result = string==other;
+    // String is final, an instance of it has exactly its class
+    if(!result && NULL!=other && other->header.class==string->header.class && other->coder==string->coder){
+        uint32_t bytes = String_Value(string)->length;
+        result = bytes==String_Value(other)->length
+            && bytes==kernels.mismatch(stringBytes(string), stringBytes(other), bytes);
+    }
+    pushInt(frame, result);
+}
+
+// String.hashCode()
+static void stringHashCode(Frame *frame){
+    ValueSlot *args = popArgs(frame, 1);
+    pushInt(frame, String_HashCode((StringObject*)REF_DECODE(args[0].ref)));
+}
+
+// String.indexOf(int), code points above the BMP are searched as surrogate pairs
+static int32_t indexOfCodePoint(StringObject *string, int32_t ch){
+    uint32_t length = String_Length(string);
+    if(CONST_STRING_CODER_LATIN1==string->coder){
+        if(0>ch || 0xFF<ch){
+            return -1;
+        }
+        size_t at = kernels.findByte(stringBytes(string), length, (uint8_t)ch);
+        return at<length ? (int32_t)at : -1;
+    }
+    const uint16_t *chars = (const uint16_t*)stringBytes(string);
+    if(0<=ch && 0xFFFF>=ch){
+        size_t at = kernels.findChar(chars, length, (uint16_t)ch);
+        return at<length ? (int32_t)at : -1;
+    }
+    if(0>ch || 0x10FFFF<ch){
+        return -1;
+    }
+    uint16_t pair[2] = {(uint16_t)(0xD7C0 + (ch>>10)), (uint16_t)(0xDC00 + (ch&0x3FF))};
+    size_t at = kernels.searchChars(chars, length, pair, 2);
+    return at<length ? (int32_t)at : -1;
+}
+
+static void stringIndexOfChar(Frame *frame){
+    ValueSlot *args = popArgs(frame, 2);
+    pushInt(frame, indexOfCodePoint((StringObject*)REF_DECODE(args[0].ref), args[1].num));
+}
+
+// Compact strings only use UTF-16 when a char needs it: a Latin-1 string
+// never contains a UTF-16 one, the other way round the needle is inflated.
+static int32_t indexOfString(StringObject *string, StringObject *needle){
+    uint32_t length = String_Length(string);
+    uint32_t needleLength = String_Length(needle);
+    if(0==needleLength){
+        return 0;
+    }
+    if(needleLength>length){
+        return -1;
+    }
+    size_t at;
+    if(CONST_STRING_CODER_LATIN1==string->coder){
+        if(CONST_STRING_CODER_LATIN1!=needle->coder){
+            return -1;
+        }
+        at = kernels.searchBytes(stringBytes(string), length, stringBytes(needle), needleLength);
+    }else if(CONST_STRING_CODER_UTF16==needle->coder){
+        at = kernels.searchChars((const uint16_t*)stringBytes(string), length, (const uint16_t*)stringBytes(needle), needleLength);
+    }else{
+        uint16_t *inflated = (uint16_t*)Heap_AllocAtomic(sizeof(uint16_t)*needleLength);
+        if(NULL==inflated){
+            error("OutOfMemoryError");
+            return -1;
+        }
+        kernels.inflate(stringBytes(needle), inflated, needleLength);
+        at = kernels.searchChars((const uint16_t*)stringBytes(string), length, inflated, needleLength);
+        Heap_Free(inflated);
+    }
+    return at<length ? (int32_t)at : -1;
+}
+
+// String.indexOf(String)
+static void stringIndexOf(Frame *frame){
+    ValueSlot *args = popArgs(frame, 2);
+    StringObject *needle = (StringObject*)REF_DECODE(args[1].ref);
+    if(NULL==needle){
+        Exception_ThrowVM(frame, CONST_EXCEPTION_NULL_POINTER);
+        return;
+    }
+    pushInt(frame, indexOfString((StringObject*)REF_DECODE(args[0].ref), needle));
+}
+
+static int32_t compareStrings(StringObject *string, StringObject *other){
+    uint32_t length = String_Length(string);
+    uint32_t otherLength = String_Length(other);
+    uint32_t count = length<otherLength ? length : otherLength;
+    if(string->coder==other->coder){
+        size_t bytes = (size_t)count<<string->coder;
+        size_t at = kernels.mismatch(stringBytes(string), stringBytes(other), bytes);
+        if(at<bytes){
+            uint32_t index = (uint32_t)(at>>string->coder);
+            return (int32_t)String_CharAt(string, index) - (int32_t)String_CharAt(other, index);
+        }
+    }else{
+        for(uint32_t i=0;i<count;i++){
+            uint16_t c = String_CharAt(string, i);
+            uint16_t d = String_CharAt(other, i);
+            if(c!=d){
+                return (int32_t)c - (int32_t)d;
+            }
+        }
+    }
+    return (int32_t)length - (int32_t)otherLength;
+}
+
+// String.compareTo(String)
+static void stringCompareTo(Frame *frame){
+    ValueSlot *args = popArgs(frame, 2);
+    StringObject *other = (StringObject*)REF_DECODE(args[1].ref);
+    if(NULL==other){
+        Exception_ThrowVM(frame, CONST_EXCEPTION_NULL_POINTER);
+        return;
+    }
+    pushInt(frame, compareStrings((StringObject*)REF_DECODE(args[0].ref), other));
+}
+
+// The (array, offset, array, offset, length) arguments of the coder helpers,
+// byte[] holding UTF-16 are indexed in chars. Zero when an exception is thrown.
+static int transcodeArgs(Frame *frame, ValueSlot *args, int srcChars, int destChars,
+    uint8_t **src, uint8_t **dest, int32_t *length){
+    ArrayObject *from = (ArrayObject*)REF_DECODE(args[0].ref);
+    int32_t srcOff = args[1].num;
+    ArrayObject *to = (ArrayObject*)REF_DECODE(args[2].ref);
+    int32_t destOff = args[3].num;
+    *length = args[4].num;
+    if(NULL==from || NULL==to){
+        Exception_ThrowVM(frame, CONST_EXCEPTION_NULL_POINTER);
+        return 0;
+    }
+    uint32_t srcLength = srcChars && 1==from->elementSize ? from->length/2 : from->length;
+    uint32_t destLength = destChars && 1==to->elementSize ? to->length/2 : to->length;
+    if(0>srcOff || 0>destOff || 0>*length
+        || (int64_t)srcOff+*length>srcLength || (int64_t)destOff+*length>destLength){
+        Exception_ThrowVM(frame, CONST_EXCEPTION_ARRAY_INDEX);
+        return 0;
+    }
+    *src = (uint8_t*)from->data + (size_t)srcOff*(srcChars ? 2 : 1);
+    *dest = (uint8_t*)to->data + (size_t)destOff*(destChars ? 2 : 1);
+    return 1;
+}
+
+// StringLatin1.inflate into a char[] or a UTF-16 byte[]
+static void inflate(Frame *frame){
+    ValueSlot *args = popArgs(frame, 5);
+    uint8_t *src;
+    uint8_t *dest;
+    int32_t length;
+    if(transcodeArgs(frame, args, 0, 1, &src, &dest, &length)){
+        kernels.inflate(src, (uint16_t*)dest, (size_t)length);
+    }
+}
+
+// StringUTF16.compress from a char[] or a UTF-16 byte[], all or nothing:
+// length when every char fits in Latin-1, 0 otherwise
+static void compress(Frame *frame){
+    ValueSlot *args = popArgs(frame, 5);
+    uint8_t *src;
+    uint8_t *dest;
+    int32_t length;
+    if(transcodeArgs(frame, args, 1, 0, &src, &dest, &length)){
+        size_t count = kernels.compress((const uint16_t*)src, dest, (size_t)length);
+        pushInt(frame, count==(size_t)length ? length : 0);
+    }
+}
+
+// Object.wait(long timeout), timeout in milliseconds, 0 until notified
+static void objectWait(Frame *frame){
+    ValueSlot *args = popArgs(frame, 3);
+    Object *object = (Object*)REF_DECODE(args[0].ref);
+    int64_t millis = SLOT_GET_LONG(&args[1]);
+    if(0>millis){
+        error("[FIXME] java.lang.IllegalArgumentException: timeout value is negative");
+        return;
+    }
+    if(!Monitor_HoldsLock(object, frame->thread->id)){
+        Exception_ThrowVM(frame, CONST_EXCEPTION_ILLEGAL_MONITOR_STATE);
+        return;
+    }
+    int64_t nanos = millis>INT64_MAX/1000000 ? INT64_MAX : millis*1000000;
+    int status = Monitor_Wait(object, frame->thread, nanos);
+    if(0==status){
+        return;
+    }
+    if(-2==status){
+        // out of monitors to inflate the lock into
+        Exception_ThrowVM(frame, CONST_EXCEPTION_OUT_OF_MEMORY);
+        return;
+    }
+    // interrupted, the wait has cleared the flag
+    Object *exception = Exception_Preallocated(CONST_EXCEPTION_INTERRUPTED);
+    if(NULL==exception){
+        error("[FIXME] java.lang.InterruptedException thrown before its class is loaded.");
+        Thread_Interrupt(frame->thread);
+        return;
+    }
+    Exception_Throw(frame, exception);
+}
+
+static void objectNotify(Frame *frame){
+    Object *object = (Object*)REF_DECODE(popArgs(frame, 1)[0].ref);
+    if(0!=Monitor_Notify(object, frame->thread->id)){
+        Exception_ThrowVM(frame, CONST_EXCEPTION_ILLEGAL_MONITOR_STATE);
+    }
+}
+
+static void objectNotifyAll(Frame *frame){
+    Object *object = (Object*)REF_DECODE(popArgs(frame, 1)[0].ref);
+    if(0!=Monitor_NotifyAll(object, frame->thread->id)){
+        Exception_ThrowVM(frame, CONST_EXCEPTION_ILLEGAL_MONITOR_STATE);
+    }
+}
+
+// Unsafe.park(boolean isAbsolute, long time), behind LockSupport.park:
+// an absolute time is a deadline in epoch milliseconds, a relative one is
+// in nanoseconds, 0 parking until unparked
+static void park(Frame *frame){
+    ValueSlot *args = popArgs(frame, 4);
+    int absolute = args[1].num;
+    int64_t time = SLOT_GET_LONG(&args[2]);
+    if(0>time || (absolute && 0==time) || __atomic_load_n(&frame->thread->interrupted, __ATOMIC_ACQUIRE)){
+        return;
+    }
+    if(absolute){
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        time = (time - ((int64_t)now.tv_sec*1000+now.tv_nsec/1000000))*1000000;
+        if(0>=time){
+            return;
+        }
+    }
+    Thread_Park(frame->thread, time);
+}
+
+typedef struct{
+    const char *className;
+    const char *name;
+    const char *descriptor;
+    Intrinsic fn;
+} IntrinsicEntry;
+
+static const IntrinsicEntry intrinsics[] = {
+    {"java/lang/System", "arraycopy", "(Ljava/lang/Object;ILjava/lang/Object;II)V", arraycopy},
+    {"java/util/Arrays", "fill", "([ZZ)V", fill},
+    {"java/util/Arrays", "fill", "([BB)V", fill},
+    {"java/util/Arrays", "fill", "([CC)V", fill},
+    {"java/util/Arrays", "fill", "([SS)V", fill},
+    {"java/util/Arrays", "fill", "([II)V", fill},
+    {"java/util/Arrays", "fill", "([FF)V", fill},
+    {"java/util/Arrays", "fill", "([JJ)V", fillWide},
+    {"java/util/Arrays", "fill", "([DD)V", fillWide},
+    {"java/util/Arrays", "fill", "([Ljava/lang/Object;Ljava/lang/Object;)V", fill},
+    {"java/util/Arrays", "fill", "([ZIIZ)V", fillRange},
+    {"java/util/Arrays", "fill", "([BIIB)V", fillRange},
+    {"java/util/Arrays", "fill", "([CIIC)V", fillRange},
+    {"java/util/Arrays", "fill", "([SIIS)V", fillRange},
+    {"java/util/Arrays", "fill", "([IIII)V", fillRange},
+    {"java/util/Arrays", "fill", "([FIIF)V", fillRange},
+    {"java/util/Arrays", "fill", "([JIIJ)V", fillRangeWide},
+    {"java/util/Arrays", "fill", "([DIID)V", fillRangeWide},
+    {"java/util/Arrays", "fill", "([Ljava/lang/Object;IILjava/lang/Object;)V", fillRange},
+    {"java/util/Arrays", "equals", "([Z[Z)Z", equals},
+    {"java/util/Arrays", "equals", "([B[B)Z", equals},
+    {"java/util/Arrays", "equals", "([C[C)Z", equals},
+    {"java/util/Arrays", "equals", "([S[S)Z", equals},
+    {"java/util/Arrays", "equals", "([I[I)Z", equals},
+    {"java/util/Arrays", "equals", "([J[J)Z", equals},
+    {"java/util/Arrays", "equals", "([F[F)Z", equals},
+    {"java/util/Arrays", "equals", "([D[D)Z", equals},
+    {"java/util/Arrays", "hashCode", "([Z)I", hashCode},
+    {"java/util/Arrays", "hashCode", "([B)I", hashCode},
+    {"java/util/Arrays", "hashCode", "([C)I", hashCode},
+    {"java/util/Arrays", "hashCode", "([S)I", hashCode},
+    {"java/util/Arrays", "hashCode", "([I)I", hashCode},
+    {"java/util/Arrays", "hashCode", "([J)I", hashCode},
+    {"java/util/Arrays", "hashCode", "([F)I", hashCode},
+    {"java/util/Arrays", "hashCode", "([D)I", hashCode},
+    {"java/lang/String", "equals", "(Ljava/lang/Object;)Z", stringEquals},
+    {"java/lang/String", "hashCode", "()I", stringHashCode},
+    {"java/lang/String", "indexOf", "(I)I", stringIndexOfChar},
+    {"java/lang/String", "indexOf", "(Ljava/lang/String;)I", stringIndexOf},
+    {"java/lang/String", "compareTo", "(Ljava/lang/String;)I", stringCompareTo},
+    {"java/lang/StringLatin1", "inflate", "([BI[CII)V", inflate},
+    {"java/lang/StringLatin1", "inflate", "([BI[BII)V", inflate},
+    {"java/lang/StringUTF16", "compress", "([CI[BII)I", compress},
+    {"java/lang/StringUTF16", "compress", "([BI[BII)I", compress},
+    {"java/lang/Object", "wait", "(J)V", objectWait},
+    {"java/lang/Object", "wait0", "(J)V", objectWait},
+    {"java/lang/Object", "notify", "()V", objectNotify},
+    {"java/lang/Object", "notifyAll", "()V", objectNotifyAll},
+    {"sun/misc/Unsafe", "park", "(ZJ)V", park},
+    {"jdk/internal/misc/Unsafe", "park", "(ZJ)V", park},
+    {NULL, NULL, NULL, NULL}
+};
+
+Intrinsic Intrinsic_Find(uint8_t *className, uint8_t *name, uint8_t *descriptor){
+    for(const IntrinsicEntry *entry=intrinsics;NULL!=entry->className;entry++){
+        if(0==strcmp(entry->className, (char*)className) && 0==strcmp(entry->name, (char*)name)
+            && 0==strcmp(entry->descriptor, (char*)descriptor)){
+            return entry->fn;
+        }
+    }
+    return NULL;
+}
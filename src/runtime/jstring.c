@@ -0,0 +1,252 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <pthread.h>
+#include "gc.h"
+
+#define INCLUDE_RUNTIME_JSTRING_SELF 1
+#include "runtime/jstring.h"
+#include "runtime/object.h"
+#include "runtime/class.h"
+#include "runtime/heap.h"
+#include "runtime/intrinsic.h"
+#include "classfile/classfile.h"
+#include "utf8.h"
+#include "utils.h"
+
+// the table is split in independently locked segments, each grows on its own
+#define STRING_TABLE_SEGMENTS  16
+#define STRING_TABLE_INITIAL_BUCKETS  256
+#define STRING_TABLE_LOAD_FACTOR  2
+// chars of a key transcoded on the C stack rather than on the heap
+#define STRING_KEY_BUFFER_SIZE  256
+
+typedef struct _InternEntry InternEntry;
+struct _InternEntry{
+    // a disappearing link: hidden from the collector and cleared once the string dies
+    GC_hidden_pointer string;
+    int32_t hash;
+    InternEntry *next;
+};
+
+typedef struct{
+    pthread_mutex_t lock;
+    uint32_t bucketsCount;
+    uint32_t count;
+    InternEntry **buckets;
+} InternSegment;
+
+// chars of a string being looked up
+typedef struct{
+    uint8_t *bytes;
+    uint32_t size; // in bytes
+    uint8_t coder;
+    int32_t hash;
+} StringKey;
+
+static InternSegment segments[STRING_TABLE_SEGMENTS];
+static Class *stringClass = NULL;
+static pthread_once_t stringOnce = PTHREAD_ONCE_INIT;
+
+static void initStrings(void){
+    uint32_t refOffsets[] = {offsetof(StringObject, value)};
+    stringClass = Class_NewBuiltin((uint8_t*)"java/lang/String", sizeof(StringObject), 1, refOffsets);
+    for(int i=0;i<STRING_TABLE_SEGMENTS;i++){
+        pthread_mutex_init(&segments[i].lock, NULL);
+        segments[i].bucketsCount = STRING_TABLE_INITIAL_BUCKETS;
+        segments[i].buckets = (InternEntry**)Heap_AllocPermanentAtomic(sizeof(InternEntry*)*STRING_TABLE_INITIAL_BUCKETS);
+    }
+}
+
+Class* String_Class(void){
+    pthread_once(&stringOnce, initStrings);
+    return stringClass;
+}
+
+// String.hashCode over the UTF-16 chars, whatever the coder
+static int32_t hashChars(const uint8_t *bytes, uint32_t size, uint8_t coder){
+    return Intrinsic_StringHash(bytes, size, coder);
+}
+
+int32_t String_HashCode(StringObject *string){
+    if(0==string->hash){
+        ArrayObject *value = String_Value(string);
+        string->hash = hashChars((uint8_t*)value->data, value->length, string->coder);
+    }
+    return string->hash;
+}
+
+static StringObject* newString(const uint8_t *bytes, uint32_t size, uint8_t coder, int old){
+    Class *class = String_Class();
+    ArrayObject *value = old ? ArrayObject_NewOld(CONST_ARRAY_TYPE_BYTE, size) : ArrayObject_New(CONST_ARRAY_TYPE_BYTE, size);
+    if(NULL==value){
+        return NULL;
+    }
+    memcpy(value->data, bytes, size);
+    StringObject *string = (StringObject*)(old ? Object_NewOld(class) : Object_New(class));
+    if(NULL==string){
+        return NULL;
+    }
+    string->coder = coder;
+    Object_PutRef((Object*)string, offsetof(StringObject, value), value);
+    return string;
+}
+
+// transcode into buffer when it is large enough, on the heap otherwise
+static int keyFromUTF8(StringKey *key, const uint8_t *bytes, uint32_t size, uint32_t length, uint8_t latin1, uint8_t *buffer){
+    key->coder = latin1 ? CONST_STRING_CODER_LATIN1 : CONST_STRING_CODER_UTF16;
+    key->size = length<<key->coder;
+    key->bytes = key->size<=STRING_KEY_BUFFER_SIZE ? buffer : (uint8_t*)Heap_AllocAtomic(key->size);
+    if(NULL==key->bytes){
+        error("OutOfMemoryError");
+        return -1;
+    }
+    if(latin1){
+        UTF8_ToLatin1(bytes, size, key->bytes);
+    }else{
+        UTF8_ToUTF16(bytes, size, (uint16_t*)key->bytes);
+    }
+    key->hash = hashChars(key->bytes, key->size, key->coder);
+    return 0;
+}
+
+static void* revealEntry(void *entry){
+    GC_hidden_pointer hidden = ((InternEntry*)entry)->string;
+    return 0==hidden ? NULL : GC_REVEAL_POINTER(hidden);
+}
+
+static int keyEquals(StringKey *key, StringObject *string){
+    ArrayObject *value = String_Value(string);
+    return key->coder==string->coder && key->size==value->length && 0==memcmp(key->bytes, value->data, key->size);
+}
+
+static void growSegment(InternSegment *segment){
+    uint32_t bucketsCount = segment->bucketsCount*2;
+    InternEntry **buckets = (InternEntry**)Heap_AllocPermanentAtomic(sizeof(InternEntry*)*bucketsCount);
+    if(NULL==buckets){
+        return;
+    }
+    for(uint32_t i=0;i<segment->bucketsCount;i++){
+        InternEntry *entry = segment->buckets[i];
+        while(NULL!=entry){
+            InternEntry *next = entry->next;
+            uint32_t index = ((uint32_t)entry->hash/STRING_TABLE_SEGMENTS)&(bucketsCount-1);
+            entry->next = buckets[index];
+            buckets[index] = entry;
+            entry = next;
+        }
+    }
+    Heap_Free(segment->buckets);
+    segment->buckets = buckets;
+    segment->bucketsCount = bucketsCount;
+}
+
+static StringObject* internKey(StringKey *key){
+    InternSegment *segment = &segments[(uint32_t)key->hash%STRING_TABLE_SEGMENTS];
+    StringObject *string = NULL;
+    pthread_mutex_lock(&segment->lock);
+    uint32_t index = ((uint32_t)key->hash/STRING_TABLE_SEGMENTS)&(segment->bucketsCount-1);
+    InternEntry **link = &segment->buckets[index];
+    while(NULL!=*link){
+        InternEntry *entry = *link;
+        if(key->hash!=entry->hash){
+            link = &entry->next;
+            continue;
+        }
+        // the collector clears the link under its own lock
+        string = (StringObject*)GC_call_with_alloc_lock(revealEntry, entry);
+        if(NULL==string){
+            // collected, drop the entry while we are here
+            *link = entry->next;
+            segment->count--;
+            Heap_Free(entry);
+            continue;
+        }
+        if(keyEquals(key, string)){
+            pthread_mutex_unlock(&segment->lock);
+            return string;
+        }
+        link = &entry->next;
+    }
+    // canonical strings go straight to the old space, the link must not move
+    string = newString(key->bytes, key->size, key->coder, 1);
+    InternEntry *entry = NULL==string ? NULL : (InternEntry*)Heap_AllocPermanent(sizeof(InternEntry));
+    if(NULL==entry){
+        pthread_mutex_unlock(&segment->lock);
+        error("OutOfMemoryError");
+        return NULL;
+    }
+    string->hash = key->hash;
+    entry->string = GC_HIDE_POINTER(string);
+    entry->hash = key->hash;
+    GC_general_register_disappearing_link((void**)&entry->string, string);
+    entry->next = segment->buckets[index];
+    segment->buckets[index] = entry;
+    if(++segment->count>segment->bucketsCount*STRING_TABLE_LOAD_FACTOR){
+        growSegment(segment);
+    }
+    pthread_mutex_unlock(&segment->lock);
+    return string;
+}
+
+static StringObject* internUTF8(const uint8_t *bytes, uint32_t size, uint32_t length, uint8_t latin1){
+    uint8_t buffer[STRING_KEY_BUFFER_SIZE];
+    StringKey key;
+    String_Class();
+    if(0!=keyFromUTF8(&key, bytes, size, length, latin1, buffer)){
+        return NULL;
+    }
+    return internKey(&key);
+}
+
+StringObject* String_NewUTF8(const uint8_t *bytes, uint32_t size){
+    uint8_t buffer[STRING_KEY_BUFFER_SIZE];
+    uint32_t length;
+    uint8_t latin1;
+    StringKey key;
+    if(0>UTF8_Validate(bytes, size, &length, &latin1)){
+        error("Malformed modified UTF-8 string.");
+        return NULL;
+    }
+    if(0!=keyFromUTF8(&key, bytes, size, length, latin1, buffer)){
+        return NULL;
+    }
+    return newString(key.bytes, key.size, key.coder, 0);
+}
+
+StringObject* String_InternUTF8(const uint8_t *bytes, uint32_t size){
+    uint32_t length;
+    uint8_t latin1;
+    if(0>UTF8_Validate(bytes, size, &length, &latin1)){
+        error("Malformed modified UTF-8 string.");
+        return NULL;
+    }
+    return internUTF8(bytes, size, length, latin1);
+}
+
+StringObject* String_Intern(StringObject *string){
+    ArrayObject *value = String_Value(string);
+    StringKey key;
+    key.bytes = (uint8_t*)value->data;
+    key.size = value->length;
+    key.coder = string->coder;
+    key.hash = String_HashCode(string);
+    return internKey(&key);
+}
+
+StringObject* String_ResolveConstant(Class *class, uint16_t index){
+    StringObject *string = (StringObject*)__atomic_load_n(&class->resolved[index], __ATOMIC_ACQUIRE);
+    if(NULL!=string){
+        return string;
+    }
+    void **constant_pool = class->classfile->constant_pool;
+    Constant_StringInfo *info = (Constant_StringInfo*)constant_pool[index];
+    Constant_UTF8Info *utf8 = (Constant_UTF8Info*)constant_pool[info->string_index];
+    // validated by the class file parser already
+    string = internUTF8(utf8->bytes, utf8->length, utf8->charLength, utf8->latin1);
+    if(NULL!=string){
+        // racing resolvers store the same canonical string
+        __atomic_store_n(&class->resolved[index], string, __ATOMIC_RELEASE);
+    }
+    return string;
+}
@@ -0,0 +1,118 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INCLUDE_RUNTIME_LINETABLE_SELF 1
+#include "runtime/linetable.h"
+#include "runtime/heap.h"
+#include "utils.h"
+
+typedef struct{
+    uint16_t pc;
+    uint16_t line;
+    uint32_t order; // keeps duplicated pcs in table order
+} SortedEntry;
+
+static int compareEntries(const void *a, const void *b){
+    const SortedEntry *x = (const SortedEntry*)a;
+    const SortedEntry *y = (const SortedEntry*)b;
+    if(x->pc!=y->pc){
+        return x->pc<y->pc ? -1 : 1;
+    }
+    return x->order<y->order ? -1 : x->order>y->order;
+}
+
+static uint32_t writeVarint(uint8_t *out, uint32_t value){
+    uint32_t size = 0;
+    while(value>=0x80){
+        out[size++] = (uint8_t)(value|0x80);
+        value >>= 7;
+    }
+    out[size++] = (uint8_t)value;
+    return size;
+}
+
+static uint32_t readVarint(uint8_t **cur){
+    uint32_t value = 0;
+    int shift = 0;
+    uint8_t byte;
+    do{
+        byte = *(*cur)++;
+        value |= (uint32_t)(byte&0x7F)<<shift;
+        shift += 7;
+    }while(byte & 0x80);
+    return value;
+}
+
+LineTable* LineTable_New(LineNumberTableEntry *entries, uint32_t count){
+    if(0==count){
+        return NULL;
+    }
+    SortedEntry *sorted = (SortedEntry*)Heap_AllocAtomic(sizeof(SortedEntry)*count);
+    for(uint32_t i=0;i<count;i++){
+        sorted[i].pc = entries[i].start_pc;
+        sorted[i].line = entries[i].line_number;
+        sorted[i].order = i;
+    }
+    qsort(sorted, count, sizeof(SortedEntry), compareEntries);
+
+    LineTable *table = (LineTable*)Heap_AllocPermanent(sizeof(LineTable));
+    table->count = count;
+    table->checkpointsCount = (count+CONST_LINETABLE_BLOCK-1)/CONST_LINETABLE_BLOCK;
+    table->checkpoints = (LineCheckpoint*)Heap_AllocPermanentAtomic(sizeof(LineCheckpoint)*table->checkpointsCount);
+    // 3 bytes hold any 16-bit delta
+    uint8_t *deltas = (uint8_t*)Heap_AllocAtomic(6*count);
+    uint32_t size = 0;
+    for(uint32_t i=0;i<count;i++){
+        if(0==i%CONST_LINETABLE_BLOCK){
+            LineCheckpoint *checkpoint = &table->checkpoints[i/CONST_LINETABLE_BLOCK];
+            checkpoint->pc = sorted[i].pc;
+            checkpoint->line = sorted[i].line;
+            checkpoint->offset = size;
+            continue;
+        }
+        int32_t lineDelta = (int32_t)sorted[i].line-sorted[i-1].line;
+        size += writeVarint(deltas+size, (uint32_t)(sorted[i].pc-sorted[i-1].pc));
+        size += writeVarint(deltas+size, ((uint32_t)lineDelta<<1)^(uint32_t)(lineDelta>>31));
+    }
+    table->deltas = (uint8_t*)Heap_AllocPermanentAtomic(0==size ? 1 : size);
+    memcpy(table->deltas, deltas, size);
+    Heap_Free(deltas);
+    Heap_Free(sorted);
+    return table;
+}
+
+int32_t LineTable_Lookup(LineTable *table, uint32_t pc){
+    if(NULL==table || pc<table->checkpoints[0].pc){
+        return -1;
+    }
+    // last checkpoint at or before pc
+    uint32_t low = 0;
+    uint32_t high = table->checkpointsCount;
+    while(high-low>1){
+        uint32_t mid = (low+high)/2;
+        if(table->checkpoints[mid].pc<=pc){
+            low = mid;
+        }else{
+            high = mid;
+        }
+    }
+    LineCheckpoint *checkpoint = &table->checkpoints[low];
+    uint32_t entryPc = checkpoint->pc;
+    int32_t line = checkpoint->line;
+    uint8_t *cur = table->deltas + checkpoint->offset;
+    uint32_t remaining = table->count-low*CONST_LINETABLE_BLOCK;
+    if(remaining>CONST_LINETABLE_BLOCK){
+        remaining = CONST_LINETABLE_BLOCK;
+    }
+    for(uint32_t i=1;i<remaining;i++){
+        uint32_t pcDelta = readVarint(&cur);
+        uint32_t zigzag = readVarint(&cur);
+        if(entryPc+pcDelta>pc){
+            break;
+        }
+        entryPc += pcDelta;
+        line += (int32_t)(zigzag>>1)^-(int32_t)(zigzag&1);
+    }
+    return line;
+}
@@ -0,0 +1,65 @@
+#include <stdint.h>
+#include <string.h>
+
+#define INCLUDE_RUNTIME_MEMBERINDEX_SELF 1
+#include "runtime/memberindex.h"
+#include "runtime/heap.h"
+
+MemberIndex* MemberIndex_New(uint16_t capacity){
+    if(0==capacity){
+        return NULL;
+    }
+    // at most half full
+    uint32_t size = 4;
+    while(size<2*(uint32_t)capacity){
+        size *= 2;
+    }
+    MemberIndex *index = (MemberIndex*)Heap_AllocPermanent(sizeof(MemberIndex));
+    index->mask = size-1;
+    index->slots = (uint16_t*)Heap_AllocPermanentAtomic(sizeof(uint16_t)*size);
+    index->count = 0;
+    index->entries = (MemberEntry*)Heap_AllocPermanent(sizeof(MemberEntry)*capacity);
+    return index;
+}
+
+// FNV-1a over both strings, the NUL between them included
+uint32_t MemberIndex_Hash(uint8_t *name, uint8_t *descriptor){
+    uint32_t hash = 2166136261u;
+    for(uint8_t *cur=name;;cur++){
+        hash = (hash^*cur)*16777619u;
+        if(0==*cur){
+            break;
+        }
+    }
+    for(uint8_t *cur=descriptor;0!=*cur;cur++){
+        hash = (hash^*cur)*16777619u;
+    }
+    return hash;
+}
+
+void MemberIndex_Add(MemberIndex *index, uint8_t *name, uint8_t *descriptor, uint16_t member){
+    MemberEntry *entry = &index->entries[index->count++];
+    entry->hash = MemberIndex_Hash(name, descriptor);
+    entry->member = member;
+    entry->name = name;
+    entry->descriptor = descriptor;
+    uint32_t slot = entry->hash & index->mask;
+    while(0!=index->slots[slot]){
+        slot = (slot+1) & index->mask;
+    }
+    index->slots[slot] = index->count;
+}
+
+uint16_t MemberIndex_Find(MemberIndex *index, uint32_t hash, uint8_t *name, uint8_t *descriptor){
+    if(NULL==index){
+        return CONST_MEMBER_NONE;
+    }
+    for(uint32_t slot=hash&index->mask;0!=index->slots[slot];slot=(slot+1)&index->mask){
+        MemberEntry *entry = &index->entries[index->slots[slot]-1];
+        if(hash==entry->hash && 0==strcmp((char*)entry->name, (char*)name)
+            && 0==strcmp((char*)entry->descriptor, (char*)descriptor)){
+            return entry->member;
+        }
+    }
+    return CONST_MEMBER_NONE;
+}
@@ -0,0 +1,204 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define INCLUDE_RUNTIME_METHOD_SELF 1
+#include "runtime/method.h"
+#include "runtime/class.h"
+#include "runtime/refmap.h"
+#include "runtime/escape.h"
+#include "runtime/exception.h"
+#include "runtime/linetable.h"
+#include "runtime/descriptor.h"
+#include "runtime/intrinsic.h"
+#include "runtime/boundscheck.h"
+#include "runtime/switchtable.h"
+#include "runtime/peephole.h"
+#include "runtime/heap.h"
+#include "runtime/opcode.h"
+#include "classfile/classfile.h"
+#include "classfile/op.h"
+#include "utils.h"
+
+// marks a method whose code could not be mapped, so it is analyzed once
+static RefMap unmappable;
+// marks a method whose objects all go to the heap
+static EscapeMap escaping;
+
+static Attribute_Code* findCode(ClassFile *classfile, MethodInfo *info){
+    void **attributes = (void**)info->attributes;
+    for(int i=0;i<info->attributes_count;i++){
+        Attribute_Code *attribute = (Attribute_Code*)attributes[i];
+        if(utf8ascii_equals(CLZFILE_cp_getUTF8(classfile->constant_pool, attribute->attribute_name_index), "Code")){
+            return attribute;
+        }
+    }
+    return NULL;
+}
+
+// All LineNumberTable attributes of the code merged into one compact table,
+// the expanded ones are released.
+static LineTable* compressLines(ClassFile *classfile, Attribute_Code *code){
+    void **attributes = (void**)code->attributes;
+    uint32_t count = 0;
+    for(int i=0;i<code->attributes_count;i++){
+        Attribute_LineNumberTable *attribute = (Attribute_LineNumberTable*)attributes[i];
+        if(utf8ascii_equals(CLZFILE_cp_getUTF8(classfile->constant_pool, attribute->attribute_name_index), "LineNumberTable")){
+            count += attribute->line_number_entries_count;
+        }
+    }
+    if(0==count){
+        return NULL;
+    }
+    LineNumberTableEntry *entries = (LineNumberTableEntry*)Heap_AllocAtomic(sizeof(LineNumberTableEntry)*count);
+    count = 0;
+    for(int i=0;i<code->attributes_count;i++){
+        Attribute_LineNumberTable *attribute = (Attribute_LineNumberTable*)attributes[i];
+        if(!utf8ascii_equals(CLZFILE_cp_getUTF8(classfile->constant_pool, attribute->attribute_name_index), "LineNumberTable")){
+            continue;
+        }
+        memcpy(entries+count, attribute->table, sizeof(LineNumberTableEntry)*attribute->line_number_entries_count);
+        count += attribute->line_number_entries_count;
+        Heap_Free(attribute->table);
+        attribute->table = NULL;
+        attribute->line_number_entries_count = 0;
+    }
+    LineTable *lines = LineTable_New(entries, count);
+    Heap_Free(entries);
+    return lines;
+}
+
+static int isLoadOne(uint8_t opcode){
+    switch(opcode){
+        case CONST_OPCODE_ILOAD_1:
+        case CONST_OPCODE_LLOAD_1:
+        case CONST_OPCODE_FLOAD_1:
+        case CONST_OPCODE_DLOAD_1:
+        case CONST_OPCODE_ALOAD_1:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// matched on the class file code, synchronized methods need a frame to hold their monitor
+static void classifyShape(Method *method){
+    uint8_t *code = method->codeAttribute->code;
+    uint32_t length = method->codeLength;
+    method->shape = CONST_METHOD_SHAPE_NONE;
+    if(method->accessFlags & CONST_METHOD_ACCESS_SYNCHRONIZED){
+        return;
+    }
+    if(1==length && CONST_OPCODE_RETURN==code[0]){
+        method->shape = CONST_METHOD_SHAPE_EMPTY;
+        return;
+    }
+    if((method->accessFlags & CONST_METHOD_ACCESS_STATIC) || length<5 || CONST_OPCODE_ALOAD_0!=code[0]){
+        return;
+    }
+    if(5==length && CONST_OPCODE_GETFIELD==code[1] && CONST_OPCODE_IRETURN<=code[4] && CONST_OPCODE_ARETURN>=code[4]
+        && 1==method->argSlots){
+        method->shape = CONST_METHOD_SHAPE_GETTER;
+        method->shapeIndex = (uint16_t)(code[2]<<8 | code[3]);
+    }else if(6==length && isLoadOne(code[1]) && CONST_OPCODE_PUTFIELD==code[2] && CONST_OPCODE_RETURN==code[5]
+        && 1==method->parsedDescriptor->argsCount){
+        method->shape = CONST_METHOD_SHAPE_SETTER;
+        method->shapeIndex = (uint16_t)(code[3]<<8 | code[4]);
+    }else if(5==length && CONST_OPCODE_INVOKESPECIAL==code[1] && CONST_OPCODE_RETURN==code[4]
+        && 1==method->argSlots && utf8ascii_equals(method->name, "<init>")){
+        method->shape = CONST_METHOD_SHAPE_EMPTY_INIT;
+        method->shapeIndex = (uint16_t)(code[2]<<8 | code[3]);
+    }
+}
+
+int Method_Init(Method *method, Class *class, MethodInfo *info){
+    ClassFile *classfile = class->classfile;
+    method->class = class;
+    method->info = info;
+    method->name = CLZFILE_cp_getUTF8(classfile->constant_pool, info->name_index);
+    method->descriptor = CLZFILE_cp_getUTF8(classfile->constant_pool, info->descriptor_index);
+    method->accessFlags = info->access_flags;
+    method->parsedDescriptor = Descriptor_Get(method->descriptor);
+    if(NULL==method->parsedDescriptor){
+        error("ClassFormatError. Invalid descriptor %s of method %s.", method->descriptor, method->name);
+        return -1;
+    }
+    method->argSlots = method->parsedDescriptor->argSlots;
+    if(!(info->access_flags & CONST_METHOD_ACCESS_STATIC)){
+        method->argSlots++;
+    }
+    method->refMap = NULL;
+    method->escapeMap = NULL;
+    method->thisEscape = CONST_ESCAPE_UNKNOWN;
+    method->escapeTries = 0;
+    method->loopGuardsCount = 0;
+    method->loopGuards = NULL;
+    method->intrinsic = Intrinsic_Find(class->name, method->name, method->descriptor);
+    method->shape = CONST_METHOD_SHAPE_NONE;
+    method->shapeIndex = 0;
+    method->handlers = NULL;
+    method->switches = NULL;
+    method->lines = NULL;
+    method->codeAttribute = findCode(classfile, info);
+    if(NULL==method->codeAttribute){
+        if(!(info->access_flags & (CONST_METHOD_ACCESS_ABSTRACT|CONST_METHOD_ACCESS_NATIVE))){
+            error("ClassFormatError. Method %s%s has no Code attribute.", method->name, method->descriptor);
+            return -1;
+        }
+        method->maxStack = 0;
+        method->maxLocals = 0;
+        method->codeLength = 0;
+        method->code = NULL;
+        return 0;
+    }
+#ifdef JVM_PEEPHOLE
+    Peephole_Optimize(classfile, method->codeAttribute);
+#endif
+    method->maxStack = method->codeAttribute->max_stack;
+    method->maxLocals = method->codeAttribute->max_locals;
+    method->codeLength = method->codeAttribute->code_length;
+    method->code = BoundsCheck_Eliminate(method);
+    if(NULL==method->code || 0!=SwitchTable_Init(method)){
+        return -1;
+    }
+    method->handlers = Exception_NewHandlerTable(method->codeAttribute);
+    method->lines = compressLines(classfile, method->codeAttribute);
+    classifyShape(method);
+    return 0;
+}
+
+// racing threads may both compute it, one of the equal maps wins
+RefMap* Method_RefMap(Method *method){
+    RefMap *map = __atomic_load_n(&method->refMap, __ATOMIC_ACQUIRE);
+    if(NULL==map){
+        map = RefMap_Compute(method);
+        if(NULL==map){
+            map = &unmappable;
+        }
+        RefMap *expected = NULL;
+        if(!__atomic_compare_exchange_n(&method->refMap, &expected, map, 0, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)){
+            map = expected;
+        }
+    }
+    return map==&unmappable ? NULL : map;
+}
+
+EscapeMap* Method_EscapeMap(Method *method){
+    EscapeMap *map = __atomic_load_n(&method->escapeMap, __ATOMIC_ACQUIRE);
+    if(NULL==map){
+        int settled;
+        map = Escape_Compute(method, &settled);
+        if(NULL==map){
+            // its later runs may have resolved what this one took as escaping
+            if(!settled && __atomic_add_fetch(&method->escapeTries, 1, __ATOMIC_RELAXED)<CONST_ESCAPE_MAX_TRIES){
+                return NULL;
+            }
+            map = &escaping;
+        }
+        EscapeMap *expected = NULL;
+        if(!__atomic_compare_exchange_n(&method->escapeMap, &expected, map, 0, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)){
+            map = expected;
+        }
+    }
+    return map==&escaping ? NULL : map;
+}
@@ -0,0 +1,351 @@
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#define INCLUDE_RUNTIME_MONITOR_SELF 1
+#include "runtime/monitor.h"
+#include "runtime/object.h"
+#include "runtime/futex.h"
+#include "runtime/thread.h"
+#include "runtime/safepoint.h"
+#include "runtime/heap.h"
+#include "utils.h"
+
+// Monitors are found by index through a two level table, so that readers
+// need no lock while it grows.
+#define MONITOR_CHUNK_BITS  10
+#define MONITOR_CHUNK_SIZE  (1<<MONITOR_CHUNK_BITS)
+#define MONITOR_CHUNKS  4096
+// rounds of spinning on a thin lock before inflating it
+#define MONITOR_SPIN_COUNT  64
+#define MONITOR_SPARES  64
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_RELAX() __builtin_ia32_pause()
+#else
+#define CPU_RELAX() __asm__ __volatile__("" ::: "memory")
+#endif
+
+static Monitor *monitorChunks[MONITOR_CHUNKS];
+static uint32_t monitorsCount = 1; // index 0 is never handed out
+static pthread_mutex_t monitorsLock = PTHREAD_MUTEX_INITIALIZER;
+
+static inline Monitor* monitorAt(uint32_t index){
+    Monitor *chunk = __atomic_load_n(&monitorChunks[index>>MONITOR_CHUNK_BITS], __ATOMIC_ACQUIRE);
+    return &chunk[index&(MONITOR_CHUNK_SIZE-1)];
+}
+
+static uint32_t newMonitor(void){
+    pthread_mutex_lock(&monitorsLock);
+    uint32_t index = monitorsCount;
+    uint32_t chunk = index>>MONITOR_CHUNK_BITS;
+    if(chunk>=MONITOR_CHUNKS || index>CONST_LOCK_MAX_OWNER){
+        pthread_mutex_unlock(&monitorsLock);
+        error("[FIXME] out of monitors.");
+        return 0;
+    }
+    if(NULL==monitorChunks[chunk]){
+        Monitor *monitors = (Monitor*)Heap_AllocPermanentAtomic(sizeof(Monitor)*MONITOR_CHUNK_SIZE);
+        if(NULL==monitors){
+            pthread_mutex_unlock(&monitorsLock);
+            error("OutOfMemoryError");
+            return 0;
+        }
+        __atomic_store_n(&monitorChunks[chunk], monitors, __ATOMIC_RELEASE);
+    }
+    monitorsCount++;
+    pthread_mutex_unlock(&monitorsLock);
+    return index;
+}
+
+// unused monitors left by a lost inflation race, guarded by monitorsLock
+static uint32_t spareMonitors[MONITOR_SPARES];
+static uint32_t spareMonitorsCount = 0;
+
+static uint32_t takeMonitor(void){
+    uint32_t index = 0;
+    pthread_mutex_lock(&monitorsLock);
+    if(0<spareMonitorsCount){
+        index = spareMonitors[--spareMonitorsCount];
+    }
+    pthread_mutex_unlock(&monitorsLock);
+    return 0==index ? newMonitor() : index;
+}
+
+static void spareMonitor(uint32_t index){
+    pthread_mutex_lock(&monitorsLock);
+    if(spareMonitorsCount<MONITOR_SPARES){
+        spareMonitors[spareMonitorsCount++] = index;
+    }
+    pthread_mutex_unlock(&monitorsLock);
+}
+
+// Drepper, "Futexes Are Tricky", mutex 2
+static void lockMonitor(Monitor *monitor){
+    int32_t c = 0;
+    if(__atomic_compare_exchange_n(&monitor->state, &c, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)){
+        return;
+    }
+    if(2!=c){
+        c = __atomic_exchange_n(&monitor->state, 2, __ATOMIC_ACQUIRE);
+    }
+    if(0==c){
+        return;
+    }
+    // the owner may be the one waiting for a safepoint
+    Thread *thread = Thread_Current();
+    int32_t state;
+    SAFEPOINT_ENTER_NATIVE(thread, state);
+    while(0!=c){
+        Futex_Wait(&monitor->state, 2, NULL);
+        c = __atomic_exchange_n(&monitor->state, 2, __ATOMIC_ACQUIRE);
+    }
+    Safepoint_LeaveNative(thread, state);
+}
+
+static void unlockMonitor(Monitor *monitor){
+    if(1!=__atomic_fetch_sub(&monitor->state, 1, __ATOMIC_RELEASE)){
+        __atomic_store_n(&monitor->state, 0, __ATOMIC_RELEASE);
+        Futex_Wake(&monitor->state, 1);
+    }
+}
+
+static void queueAppend(WaitQueue *queue, WaitNode *node){
+    node->next = NULL;
+    node->prev = queue->tail;
+    if(NULL==queue->tail){
+        queue->head = node;
+    }else{
+        queue->tail->next = node;
+    }
+    queue->tail = node;
+}
+
+static void queueRemove(WaitQueue *queue, WaitNode *node){
+    if(NULL==node->prev){
+        queue->head = node->next;
+    }else{
+        node->prev->next = node->next;
+    }
+    if(NULL==node->next){
+        queue->tail = node->prev;
+    }else{
+        node->next->prev = node->prev;
+    }
+    node->prev = node->next = NULL;
+}
+
+// give up ownership, waking the first notified waiter if any
+static void releaseMonitor(Monitor *monitor){
+    Thread *next = NULL;
+    WaitNode *node = monitor->handoff.head;
+    if(NULL!=node){
+        queueRemove(&monitor->handoff, node);
+        // the node goes away as soon as its thread runs again
+        next = node->thread;
+        __atomic_store_n(&node->state, CONST_WAIT_WOKEN, __ATOMIC_RELEASE);
+    }
+    monitor->owner = 0;
+    unlockMonitor(monitor);
+    if(NULL!=next){
+        Thread_Unpark(next);
+    }
+}
+
+// The current thin lock state moves into the monitor. Its owner may keep
+// running meanwhile, but every update it makes to the mark word is a CAS:
+// once inflated they fail and it switches to the monitor.
+Monitor* Monitor_Inflate(Object *object){
+    uint32_t index = 0;
+    uintptr_t mark = __atomic_load_n(&object->header.mark, __ATOMIC_ACQUIRE);
+    while(1){
+        if(mark&CONST_HEADER_INFLATED){
+            if(0!=index){
+                spareMonitor(index);
+            }
+            return monitorAt(LOCK_OWNER(mark));
+        }
+        if(0==index && 0==(index=takeMonitor())){
+            return NULL;
+        }
+        Monitor *monitor = monitorAt(index);
+        monitor->owner = LOCK_OWNER(mark);
+        monitor->recursions = LOCK_RECURSIONS(mark);
+        monitor->state = 0==monitor->owner ? 0 : 1;
+        uintptr_t inflated = (mark&~CONST_LOCK_MASK)|LOCK_THIN(index)|CONST_HEADER_INFLATED;
+        if(__atomic_compare_exchange_n(&object->header.mark, &mark, inflated, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+            return monitor;
+        }
+    }
+}
+
+int Monitor_EnterSlow(Object *object, uint32_t owner){
+    uintptr_t mark = __atomic_load_n(&object->header.mark, __ATOMIC_RELAXED);
+    for(int spin=0;spin<MONITOR_SPIN_COUNT && !(mark&CONST_HEADER_INFLATED);spin++){
+        if(0==(mark&CONST_LOCK_MASK)){
+            if(__atomic_compare_exchange_n(&object->header.mark, &mark, mark|LOCK_THIN(owner), 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)){
+                return 0;
+            }
+            continue;
+        }
+        if(owner==LOCK_OWNER(mark)){
+            if(CONST_LOCK_MAX_RECURSION==LOCK_RECURSIONS(mark)){
+                break;
+            }
+            if(__atomic_compare_exchange_n(&object->header.mark, &mark, mark+((uintptr_t)1<<CONST_LOCK_RECURSION_SHIFT), 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+                return 0;
+            }
+            continue;
+        }
+        CPU_RELAX();
+        mark = __atomic_load_n(&object->header.mark, __ATOMIC_RELAXED);
+    }
+    Monitor *monitor = Monitor_Inflate(object);
+    if(NULL==monitor){
+        return -1;
+    }
+    if(owner==__atomic_load_n(&monitor->owner, __ATOMIC_RELAXED)){
+        monitor->recursions++;
+        return 0;
+    }
+    lockMonitor(monitor);
+    monitor->owner = owner;
+    monitor->recursions = 0;
+    return 0;
+}
+
+int Monitor_ExitSlow(Object *object, uint32_t owner){
+    uintptr_t mark = __atomic_load_n(&object->header.mark, __ATOMIC_RELAXED);
+    while(!(mark&CONST_HEADER_INFLATED)){
+        if(owner!=LOCK_OWNER(mark)){
+            error("[FIXME] java.lang.IllegalMonitorStateException");
+            return -1;
+        }
+        uintptr_t unlocked = 0==LOCK_RECURSIONS(mark) ? mark&~CONST_LOCK_MASK : mark-((uintptr_t)1<<CONST_LOCK_RECURSION_SHIFT);
+        if(__atomic_compare_exchange_n(&object->header.mark, &mark, unlocked, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED)){
+            return 0;
+        }
+    }
+    Monitor *monitor = monitorAt(LOCK_OWNER(mark));
+    if(owner!=monitor->owner){
+        error("[FIXME] java.lang.IllegalMonitorStateException");
+        return -1;
+    }
+    if(0<monitor->recursions){
+        monitor->recursions--;
+        return 0;
+    }
+    releaseMonitor(monitor);
+    return 0;
+}
+
+int Monitor_HoldsLock(Object *object, uint32_t owner){
+    uintptr_t mark = __atomic_load_n(&object->header.mark, __ATOMIC_ACQUIRE);
+    if(mark&CONST_HEADER_INFLATED){
+        return owner==__atomic_load_n(&monitorAt(LOCK_OWNER(mark))->owner, __ATOMIC_RELAXED);
+    }
+    return owner==LOCK_OWNER(mark);
+}
+
+static int64_t monotonicNanos(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec*1000000000+now.tv_nsec;
+}
+
+int Monitor_Wait(Object *object, Thread *thread, int64_t nanos){
+    if(!Monitor_HoldsLock(object, thread->id)){
+        error("[FIXME] java.lang.IllegalMonitorStateException");
+        return -2;
+    }
+    if(Thread_Interrupted(thread)){
+        return -1;
+    }
+    Monitor *monitor = Monitor_Inflate(object);
+    if(NULL==monitor){
+        return -2;
+    }
+    WaitNode node = {thread, CONST_WAIT_WAITING, NULL, NULL};
+    queueAppend(&monitor->waitSet, &node);
+    uint32_t recursions = monitor->recursions;
+    monitor->recursions = 0;
+    releaseMonitor(monitor);
+
+    int64_t deadline = 0<nanos ? monotonicNanos()+nanos : 0;
+    int interrupted = 0;
+    while(CONST_WAIT_WOKEN!=__atomic_load_n(&node.state, __ATOMIC_ACQUIRE)){
+        int64_t remaining = 0;
+        if(0<deadline && 0>=(remaining=deadline-monotonicNanos())){
+            break;
+        }
+        if(__atomic_load_n(&thread->interrupted, __ATOMIC_ACQUIRE)){
+            interrupted = Thread_Interrupted(thread);
+            break;
+        }
+        Thread_Park(thread, remaining);
+    }
+
+    lockMonitor(monitor);
+    monitor->owner = thread->id;
+    monitor->recursions = recursions;
+    // timed out or interrupted before its turn came
+    int32_t state = node.state;
+    if(CONST_WAIT_WAITING==state){
+        queueRemove(&monitor->waitSet, &node);
+    }else if(CONST_WAIT_NOTIFIED==state){
+        queueRemove(&monitor->handoff, &node);
+    }
+    // a notification already taken is not lost to the interrupt, the wait
+    // returns normally with the interrupt pending again (JLS 17.2.4)
+    if(interrupted && CONST_WAIT_WAITING!=state){
+        Thread_Interrupt(thread);
+        return 0;
+    }
+    return interrupted ? -1 : 0;
+}
+
+static int notify(Object *object, uint32_t owner, int all){
+    if(!Monitor_HoldsLock(object, owner)){
+        error("[FIXME] java.lang.IllegalMonitorStateException");
+        return -1;
+    }
+    uintptr_t mark = __atomic_load_n(&object->header.mark, __ATOMIC_ACQUIRE);
+    if(!(mark&CONST_HEADER_INFLATED)){
+        // wait() inflates, a thin lock has nobody waiting
+        return 0;
+    }
+    Monitor *monitor = monitorAt(LOCK_OWNER(mark));
+    do{
+        WaitNode *node = monitor->waitSet.head;
+        if(NULL==node){
+            break;
+        }
+        queueRemove(&monitor->waitSet, node);
+        node->state = CONST_WAIT_NOTIFIED;
+        queueAppend(&monitor->handoff, node);
+    }while(all);
+    return 0;
+}
+
+int Monitor_Notify(Object *object, uint32_t owner){
+    return notify(object, owner, 0);
+}
+
+int Monitor_NotifyAll(Object *object, uint32_t owner){
+    return notify(object, owner, 1);
+}
+
+int Monitor_EnterFrame(Frame *frame){
+    Method *method = frame->method;
+    if(method->accessFlags & CONST_METHOD_ACCESS_STATIC){
+        frame->lock = REF_ENCODE(&method->class->lock);
+    }else{
+        frame->lock = frame->localVars[0].ref;
+    }
+    // the object may move while the thread blocks, the frame has it updated
+    if(0!=Monitor_Enter((Object*)REF_DECODE(frame->lock), frame->thread->id)){
+        frame->lock = REF_ENCODE(NULL);
+        return -1;
+    }
+    return 0;
+}
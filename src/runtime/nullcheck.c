@@ -0,0 +1,76 @@
+#define _GNU_SOURCE 1
+#include <stdint.h>
+#include <stdio.h>
+#include <setjmp.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+
+#define INCLUDE_RUNTIME_NULLCHECK_SELF 1
+#include "runtime/nullcheck.h"
+#include "runtime/thread.h"
+#include "utils.h"
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+int NullCheck_Init(void){
+    unsigned long minAddr = 0;
+    FILE *file = fopen("/proc/sys/vm/mmap_min_addr", "r");
+    if(NULL!=file){
+        if(1!=fscanf(file, "%lu", &minAddr)){
+            minAddr = 0;
+        }
+        fclose(file);
+    }
+    if(minAddr>=CONST_NULLCHECK_GUARD_SIZE){
+        return 0;
+    }
+    // the kernel lets the pages from minAddr up be mapped, reserve them first
+    void *start = (void*)(uintptr_t)minAddr;
+    size_t size = CONST_NULLCHECK_GUARD_SIZE-minAddr;
+    void *guard = mmap(start, size, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_FIXED_NOREPLACE, -1, 0);
+    if(MAP_FAILED==guard || start!=guard){
+        if(MAP_FAILED!=guard){
+            munmap(guard, size);
+        }
+        error("Unable to reserve the null check guard pages, mmap_min_addr is %lu.", minAddr);
+        return -1;
+    }
+    return 0;
+}
+
+// bounds of the INSTRUCTION_TEXT section, set by the linker
+extern const uint8_t __start_jvm_instructions[];
+extern const uint8_t __stop_jvm_instructions[];
+
+static uintptr_t faultPc(void *context){
+    ucontext_t *uc = (ucontext_t*)context;
+#if defined(__x86_64__)
+    return (uintptr_t)uc->uc_mcontext.gregs[REG_RIP];
+#elif defined(__i386__)
+    return (uintptr_t)uc->uc_mcontext.gregs[REG_EIP];
+#elif defined(__aarch64__)
+    return (uintptr_t)uc->uc_mcontext.pc;
+#else
+    // [FIXME] no pc to tell, every fault crashes
+    return 0;
+#endif
+}
+
+// Only faults of an instruction handler of a thread running bytecode: a
+// null dereference in the VM itself, which may hold locks or be half way
+// through an update, still crashes.
+void NullCheck_Trap(Thread *thread, void *addr, void *context){
+    if(NULL==thread || NULL==thread->nullTrap || (uintptr_t)addr>=CONST_NULLCHECK_GUARD_SIZE){
+        return;
+    }
+    if(CONST_THREAD_STATE_JAVA!=__atomic_load_n(&thread->state, __ATOMIC_RELAXED)){
+        return;
+    }
+    uintptr_t pc = faultPc(context);
+    if(pc<(uintptr_t)__start_jvm_instructions || pc>=(uintptr_t)__stop_jvm_instructions){
+        return;
+    }
+    siglongjmp(*thread->nullTrap, 1);
+}
@@ -0,0 +1,433 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "gc.h"
+
+#include "runtime/heap.h"
+#include "runtime/ref.h"
+#include "runtime/object.h"
+#include "runtime/class.h"
+#include "runtime/thread.h"
+#include "runtime/frame.h"
+#include "runtime/safepoint.h"
+#include "utils.h"
+
+// Generational heap: threads bump-allocate from private chunks (TLABs) of a
+// nursery, a minor collection copies the survivors into the bdwgc old space.
+// Frame slots covered by a reference map are precise roots, updated when
+// their object moves. The C stacks of all threads and any unmapped slot are
+// ambiguous roots: objects they point to are pinned in place (mostly-copying)
+// and their chunk is kept out of allocation until a later collection finds
+// it unpinned.
+// Minor collections run inside a safepoint, see safepoint.h.
+
+#define NURSERY_CHUNK_SIZE (64*1024)
+#define NURSERY_LARGE_OBJECT (NURSERY_CHUNK_SIZE/4)
+#define NURSERY_FORWARD_SIZE_SHIFT 8
+#define NURSERY_LIST_INITIAL_SIZE 256
+
+typedef struct{
+    uint8_t *top;
+    uint8_t *end;
+    uint32_t epoch;
+} Tlab;
+
+typedef struct{
+    void **items;
+    uint32_t size;
+    uint32_t capacity;
+} PtrList;
+
+typedef struct _RememberedSet RememberedSet;
+struct _RememberedSet{
+    PtrList slots;
+    RememberedSet *next;
+};
+
+typedef struct{
+    uint8_t *start;
+    uint8_t *end;
+    uint32_t chunksCount;
+    uint32_t nextChunk;
+    uint8_t *pinnedChunks;
+    uint32_t epoch;
+    pthread_mutex_t lock;
+    pthread_mutex_t remsetsLock;
+    RememberedSet *remsets;
+    PtrList pinned;
+    PtrList grey;
+    PtrList survivors;
+    uint64_t minorCollections;
+    uint64_t promotedBytes;
+} Nursery;
+
+static Nursery nursery;
+static __thread Tlab tlab;
+static __thread RememberedSet *remset;
+
+static int inNursery(void *ptr){
+    return (uint8_t*)ptr>=nursery.start && (uint8_t*)ptr<nursery.end;
+}
+
+static void ptrList_add(PtrList *list, void *item){
+    if(list->size>=list->capacity){
+        uint32_t capacity = 0==list->capacity ? NURSERY_LIST_INITIAL_SIZE : list->capacity*2;
+        void **items = (void**)realloc(list->items, sizeof(void*)*capacity);
+        if(NULL==items){
+            error("[FIXME] nursery bookkeeping out of memory.");
+            return;
+        }
+        list->items = items;
+        list->capacity = capacity;
+    }
+    list->items[list->size++] = item;
+}
+
+static void remember(Ref *slot){
+    if(NULL==remset){
+        remset = (RememberedSet*)calloc(1, sizeof(RememberedSet));
+        pthread_mutex_lock(&nursery.remsetsLock);
+        remset->next = nursery.remsets;
+        nursery.remsets = remset;
+        pthread_mutex_unlock(&nursery.remsetsLock);
+    }
+    ptrList_add(&remset->slots, slot);
+}
+
+static uint32_t chunkObjectSize(Object *object){
+    if(object->header.mark & CONST_HEADER_FORWARDED){
+        return (uint32_t)(object->header.mark >> NURSERY_FORWARD_SIZE_SHIFT);
+    }
+    return Object_Size(object);
+}
+
+// objects are allocated back to back, the zeroed tail ends the walk
+static Object* findObject(uint8_t *ptr){
+    uint32_t chunk = (ptr-nursery.start)/NURSERY_CHUNK_SIZE;
+    uint8_t *cur = nursery.start + (size_t)chunk*NURSERY_CHUNK_SIZE;
+    uint8_t *end = cur + NURSERY_CHUNK_SIZE;
+    while(cur<end){
+        Object *object = (Object*)cur;
+        if(0==object->header.mark){
+            return NULL;
+        }
+        uint32_t size = chunkObjectSize(object);
+        if(ptr<cur+size){
+            return object;
+        }
+        cur += size;
+    }
+    return NULL;
+}
+
+static void pin(Object *object){
+    object->header.mark |= CONST_HEADER_PINNED;
+    nursery.pinnedChunks[((uint8_t*)object-nursery.start)/NURSERY_CHUNK_SIZE] = 1;
+    ptrList_add(&nursery.pinned, object);
+}
+
+static void pinAmbiguous(void *ptr){
+    if(!inNursery(ptr)){
+        return;
+    }
+    Object *object = findObject((uint8_t*)ptr);
+    if(NULL==object || (object->header.mark & (CONST_HEADER_PINNED|CONST_HEADER_FORWARDED))){
+        return;
+    }
+    pin(object);
+}
+
+static void pinRange(void **cur, void **end){
+    for(;cur<end;cur++){
+        pinAmbiguous(*cur);
+    }
+}
+
+static void pinSlot(Ref *slot, void *data){
+    pinAmbiguous(REF_DECODE(*slot));
+}
+
+static void ignoreSlot(Ref *slot, void *data){
+}
+
+// precise slots are evacuated once every ambiguous root has pinned its object
+static void pinFrames(Thread *thread, void *data){
+    // a stopped thread saved its registers and stack top when it stopped
+    if(thread!=Thread_Current() && NULL!=thread->stackBase && NULL!=thread->stackTop){
+        pinRange((void**)&thread->registers, (void**)(&thread->registers+1));
+        pinRange((void**)thread->stackTop, (void**)thread->stackBase);
+    }
+    for(Frame *frame=thread->stack->_top;NULL!=frame;frame=frame->lower){
+        Frame_ScanRoots(frame, ignoreSlot, pinSlot, NULL);
+    }
+    // the pending exception is held by the permanent thread only, kept in place
+    pinAmbiguous(thread->exception);
+}
+
+static void pinCStack(void){
+    jmp_buf registers; // spills callee-saved registers onto the scanned range
+    struct GC_stack_base base;
+    setjmp(registers);
+    if(GC_SUCCESS!=GC_get_stack_base(&base)){
+        error("[FIXME] unable to find the stack base, C locals are not pinned.");
+        return;
+    }
+    void **cur = (void**)&base;
+    if((void*)registers<(void*)cur){
+        cur = (void**)registers;
+    }
+    for(;(void*)cur<base.mem_base;cur++){
+        pinAmbiguous(*cur);
+    }
+}
+
+static void evacuate(Ref *slot){
+    Object *object = (Object*)REF_DECODE(*slot);
+    if(!inNursery(object)){
+        return;
+    }
+    uintptr_t mark = object->header.mark;
+    if(mark & CONST_HEADER_FORWARDED){
+        *slot = REF_ENCODE(object->header.class);
+        return;
+    }
+    if(mark & CONST_HEADER_PINNED){
+        return;
+    }
+    uint32_t size = Object_Size(object);
+    GC_descr descr = (mark & CONST_HEADER_ARRAY) ? 0 : object->header.class->descr;
+    Object *copy = (Object*)Heap_AllocOld(size, Object_HeapKind(object), descr);
+    if(NULL==copy){
+        // keep it where it is rather than losing it
+        pin(object);
+        return;
+    }
+    memcpy(copy, object, size);
+    object->header.class = (Class*)copy;
+    object->header.mark = ((uintptr_t)size<<NURSERY_FORWARD_SIZE_SHIFT)|CONST_HEADER_OBJECT|CONST_HEADER_FORWARDED;
+    nursery.promotedBytes += size;
+    ptrList_add(&nursery.grey, copy);
+    *slot = REF_ENCODE(copy);
+}
+
+static void evacuateSlot(Ref *slot, void *data){
+    evacuate(slot);
+}
+
+static void evacuateFrames(Thread *thread, void *data){
+    for(Frame *frame=thread->stack->_top;NULL!=frame;frame=frame->lower){
+        Frame_ScanRoots(frame, evacuateSlot, ignoreSlot, NULL);
+    }
+}
+
+static void scanObject(Object *object, int isOld){
+    Ref *slot;
+    if(object->header.mark & CONST_HEADER_ARRAY){
+        ArrayObject *array = (ArrayObject*)object;
+        if(CONST_ARRAY_TYPE_REFERENCE!=array->elementType){
+            return;
+        }
+        for(uint32_t i=0;i<array->length;i++){
+            slot = (Ref*)array->data + i;
+            evacuate(slot);
+            if(isOld && inNursery(REF_DECODE(*slot))){
+                ptrList_add(&nursery.survivors, slot);
+            }
+        }
+        return;
+    }
+    Class *class = object->header.class;
+    for(int i=0;i<class->refFieldsCount;i++){
+        slot = (Ref*)((uint8_t*)object + class->refOffsets[i]);
+        evacuate(slot);
+        if(isOld && inNursery(REF_DECODE(*slot))){
+            ptrList_add(&nursery.survivors, slot);
+        }
+    }
+}
+
+static void unpinChunk(uint32_t chunk){
+    uint8_t *cur = nursery.start + (size_t)chunk*NURSERY_CHUNK_SIZE;
+    uint8_t *end = cur + NURSERY_CHUNK_SIZE;
+    while(cur<end && 0!=((Object*)cur)->header.mark){
+        Object *object = (Object*)cur;
+        object->header.mark &= ~(uintptr_t)CONST_HEADER_PINNED;
+        cur += chunkObjectSize(object);
+    }
+}
+
+static void minorCollect(void){
+    for(uint32_t i=0;i<nursery.chunksCount;i++){
+        if(nursery.pinnedChunks[i]){
+            unpinChunk(i);
+            nursery.pinnedChunks[i] = 0;
+        }
+    }
+    nursery.pinned.size = 0;
+    nursery.grey.size = 0;
+    nursery.survivors.size = 0;
+
+    Thread_ForEach(pinFrames, NULL);
+    pinCStack();
+
+    for(uint32_t i=0;i<nursery.pinned.size;i++){
+        scanObject((Object*)nursery.pinned.items[i], 0);
+    }
+    Thread_ForEach(evacuateFrames, NULL);
+    for(RememberedSet *set=nursery.remsets;NULL!=set;set=set->next){
+        for(uint32_t i=0;i<set->slots.size;i++){
+            Ref *slot = (Ref*)set->slots.items[i];
+            evacuate(slot);
+            if(inNursery(REF_DECODE(*slot))){
+                ptrList_add(&nursery.survivors, slot);
+            }
+        }
+        set->slots.size = 0;
+    }
+    while(0<nursery.grey.size){
+        scanObject((Object*)nursery.grey.items[--nursery.grey.size], 1);
+    }
+    // old slots still pointing at pinned objects stay remembered
+    for(uint32_t i=0;i<nursery.survivors.size;i++){
+        remember((Ref*)nursery.survivors.items[i]);
+    }
+
+    for(uint32_t i=0;i<nursery.chunksCount;i++){
+        if(!nursery.pinnedChunks[i]){
+            memset(nursery.start + (size_t)i*NURSERY_CHUNK_SIZE, 0, NURSERY_CHUNK_SIZE);
+        }
+    }
+    nursery.nextChunk = 0;
+    nursery.epoch++;
+    nursery.minorCollections++;
+}
+
+static int refillTlab(void){
+    pthread_mutex_lock(&nursery.lock);
+    while(nursery.nextChunk<nursery.chunksCount && nursery.pinnedChunks[nursery.nextChunk]){
+        nursery.nextChunk++;
+    }
+    if(nursery.nextChunk>=nursery.chunksCount){
+        pthread_mutex_unlock(&nursery.lock);
+        return -1;
+    }
+    tlab.top = nursery.start + (size_t)nursery.nextChunk*NURSERY_CHUNK_SIZE;
+    tlab.end = tlab.top + NURSERY_CHUNK_SIZE;
+    tlab.epoch = nursery.epoch;
+    nursery.nextChunk++;
+    pthread_mutex_unlock(&nursery.lock);
+    return 0;
+}
+
+static void* nursery_allocObject(uint32_t size, uint8_t kind, GC_descr descr){
+    if(size>NURSERY_LARGE_OBJECT){
+        return Heap_AllocOld(size, kind, descr);
+    }
+    if(tlab.epoch!=nursery.epoch || tlab.top+size>tlab.end){
+        if(0!=refillTlab()){
+            Safepoint_Begin();
+            pthread_mutex_lock(&nursery.lock);
+            // unless another thread collected while this one waited
+            if(nursery.nextChunk>=nursery.chunksCount){
+                minorCollect();
+            }
+            pthread_mutex_unlock(&nursery.lock);
+            Safepoint_End();
+            if(0!=refillTlab()){
+                return Heap_AllocOld(size, kind, descr);
+            }
+        }
+    }
+    void *ptr = tlab.top;
+    tlab.top += size;
+    return ptr;
+}
+
+static void nursery_writeRef(void *holder, Ref *slot, void *value){
+    *slot = REF_ENCODE(value);
+    if(inNursery(value) && !inNursery(holder)){
+        remember(slot);
+    }
+}
+
+static void markChunkRoots(uint32_t chunk, void (*mark)(void *ptr)){
+    uint8_t *cur = nursery.start + (size_t)chunk*NURSERY_CHUNK_SIZE;
+    uint8_t *end = cur + NURSERY_CHUNK_SIZE;
+    while(cur<end && 0!=((Object*)cur)->header.mark){
+        Object *object = (Object*)cur;
+        cur += chunkObjectSize(object);
+        if(object->header.mark & CONST_HEADER_FORWARDED){
+            continue;
+        }
+        if(object->header.mark & CONST_HEADER_ARRAY){
+            ArrayObject *array = (ArrayObject*)object;
+            if(CONST_ARRAY_TYPE_REFERENCE==array->elementType){
+                for(uint32_t i=0;i<array->length;i++){
+                    mark(ArrayObject_GetRef(array, i));
+                }
+            }
+            continue;
+        }
+        Class *class = object->header.class;
+        for(int i=0;i<class->refFieldsCount;i++){
+            mark(Object_GetRef(object, class->refOffsets[i]));
+        }
+    }
+}
+
+static void nursery_markRoots(void (*mark)(void *ptr)){
+    for(uint32_t i=0;i<nursery.chunksCount;i++){
+        markChunkRoots(i, mark);
+    }
+}
+
+static void nursery_collect(void){
+    Safepoint_Begin();
+    pthread_mutex_lock(&nursery.lock);
+    minorCollect();
+    pthread_mutex_unlock(&nursery.lock);
+    Safepoint_End();
+    GC_gcollect();
+}
+
+static HeapOp nurseryHeapOp = {
+    "generational",
+    nursery_allocObject,
+    nursery_writeRef,
+    nursery_collect,
+    nursery_markRoots
+};
+
+HeapOp* Nursery_New(size_t size){
+    size = (size+NURSERY_CHUNK_SIZE-1)/NURSERY_CHUNK_SIZE*NURSERY_CHUNK_SIZE;
+    void *hint = NULL;
+#ifdef JVM_COMPRESSED_REFS
+    // top of the compressed range, the sbrk-based old space grows from the bottom
+    hint = (void*)(CONST_REF_HEAP_LIMIT - size);
+#endif
+    void *start = mmap(hint, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+    if(MAP_FAILED==start){
+        return NULL;
+    }
+    if(!REF_ENCODABLE(start, size)){
+        munmap(start, size);
+        return NULL;
+    }
+    nursery.start = (uint8_t*)start;
+    nursery.end = nursery.start + size;
+    nursery.chunksCount = size/NURSERY_CHUNK_SIZE;
+    nursery.nextChunk = 0;
+    nursery.pinnedChunks = (uint8_t*)Heap_AllocPermanentAtomic(nursery.chunksCount);
+    nursery.epoch = 1;
+    pthread_mutex_init(&nursery.lock, NULL);
+    pthread_mutex_init(&nursery.remsetsLock, NULL);
+#ifndef JVM_COMPRESSED_REFS
+    // old objects referenced only from young ones must survive a major collection,
+    // compressed references are reported through nursery_markRoots instead
+    GC_add_roots(nursery.start, nursery.end);
+#endif
+    return &nurseryHeapOp;
+}
@@ -0,0 +1,134 @@
+#include <stdint.h>
+#include <string.h>
+
+#define INCLUDE_RUNTIME_OBJECT_SELF 1
+#include "runtime/object.h"
+#include "runtime/class.h"
+#include "runtime/heap.h"
+#include "utils.h"
+
+#define ARRAY_MAX_SIZE 0x7FFFFFFF
+
+uint8_t ArrayObject_ElementSize(uint8_t elementType){
+    switch(elementType){
+        case CONST_ARRAY_TYPE_BOOLEAN:
+        case CONST_ARRAY_TYPE_BYTE:
+            return 1;
+        case CONST_ARRAY_TYPE_CHAR:
+        case CONST_ARRAY_TYPE_SHORT:
+            return 2;
+        case CONST_ARRAY_TYPE_INT:
+        case CONST_ARRAY_TYPE_FLOAT:
+            return 4;
+        case CONST_ARRAY_TYPE_LONG:
+        case CONST_ARRAY_TYPE_DOUBLE:
+            return 8;
+        case CONST_ARRAY_TYPE_REFERENCE:
+            return sizeof(Ref);
+        default:
+            return 0;
+    }
+}
+
+static uint32_t arraySize(uint8_t elementSize, uint32_t length){
+    uint64_t size = sizeof(ArrayObject) + (uint64_t)elementSize*length;
+    return (uint32_t)((size+7)&~(uint64_t)7);
+}
+
+uint32_t Object_Size(Object *object){
+    if(object->header.mark & CONST_HEADER_ARRAY){
+        ArrayObject *array = (ArrayObject*)object;
+        return arraySize(array->elementSize, array->length);
+    }
+    return object->header.class->instanceSize;
+}
+
+uint8_t Object_HeapKind(Object *object){
+    if(object->header.mark & CONST_HEADER_ARRAY){
+        if(CONST_ARRAY_TYPE_REFERENCE==((ArrayObject*)object)->elementType){
+            return CONST_HEAP_KIND_CONSERVATIVE;
+        }
+        // primitive payloads are never scanned by the collector
+        return CONST_HEAP_KIND_ATOMIC;
+    }
+    if(0==object->header.class->refFieldsCount){
+        return CONST_HEAP_KIND_ATOMIC;
+    }
+    return CONST_HEAP_KIND_TYPED;
+}
+
+// old objects skip the nursery, for data known to live long (interned strings)
+static void* allocObject(uint32_t size, uint8_t kind, GC_descr descr, int old){
+    if(old){
+        return Heap_AllocOld(size, kind, descr);
+    }
+    return Heap_AllocObject(size, kind, descr);
+}
+
+static Object* newObject(Class *class, int old){
+    uint8_t kind = 0==class->refFieldsCount ? CONST_HEAP_KIND_ATOMIC : CONST_HEAP_KIND_TYPED;
+    Object *object = (Object*)allocObject(class->instanceSize, kind, class->descr, old);
+    if(NULL==object){
+        error("OutOfMemoryError");
+        return NULL;
+    }
+    object->header.class = class;
+    object->header.mark = CONST_HEADER_OBJECT;
+    return object;
+}
+
+static ArrayObject* newArray(uint8_t elementType, uint32_t length, int old){
+    uint8_t elementSize = ArrayObject_ElementSize(elementType);
+    if(0==elementSize || CONST_ARRAY_TYPE_REFERENCE==elementType){
+        error("Invalid primitive array type: %d.", elementType);
+        return NULL;
+    }
+    if(length>ARRAY_MAX_SIZE){
+        error("OutOfMemoryError");
+        return NULL;
+    }
+    ArrayObject *array = (ArrayObject*)allocObject(arraySize(elementSize, length), CONST_HEAP_KIND_ATOMIC, 0, old);
+    if(NULL==array){
+        error("OutOfMemoryError");
+        return NULL;
+    }
+    array->header.mark = CONST_HEADER_OBJECT|CONST_HEADER_ARRAY;
+    array->elementType = elementType;
+    array->elementSize = elementSize;
+    array->length = length;
+    return array;
+}
+
+Object* Object_New(Class *class){
+    return newObject(class, 0);
+}
+
+Object* Object_NewOld(Class *class){
+    return newObject(class, 1);
+}
+
+ArrayObject* ArrayObject_New(uint8_t elementType, uint32_t length){
+    return newArray(elementType, length, 0);
+}
+
+ArrayObject* ArrayObject_NewOld(uint8_t elementType, uint32_t length){
+    return newArray(elementType, length, 1);
+}
+
+ArrayObject* ArrayObject_NewRef(Class *componentClass, uint32_t length){
+    if(length>ARRAY_MAX_SIZE){
+        error("OutOfMemoryError");
+        return NULL;
+    }
+    ArrayObject *array = (ArrayObject*)Heap_AllocObject(arraySize(sizeof(Ref), length), CONST_HEAP_KIND_CONSERVATIVE, 0);
+    if(NULL==array){
+        error("OutOfMemoryError");
+        return NULL;
+    }
+    array->header.mark = CONST_HEADER_OBJECT|CONST_HEADER_ARRAY;
+    array->componentClass = componentClass;
+    array->elementType = CONST_ARRAY_TYPE_REFERENCE;
+    array->elementSize = sizeof(Ref);
+    array->length = length;
+    return array;
+}
@@ -0,0 +1,49 @@
+#include <stdint.h>
+
+#define INCLUDE_RUNTIME_OPCODE_SELF 1
+#include "runtime/opcode.h"
+
+// fixed instruction lengths, 0 for switches, wide and undefined opcodes
+// (the internal ones included, a class file must not contain them)
+static const uint8_t lengths[256] = {
+    [0x00 ... 0x0f] = 1, [0x10] = 2, [0x11] = 3, [0x12] = 2, [0x13 ... 0x14] = 3,
+    [0x15 ... 0x19] = 2, [0x1a ... 0x35] = 1, [0x36 ... 0x3a] = 2, [0x3b ... 0x83] = 1,
+    [0x84] = 3, [0x85 ... 0x98] = 1, [0x99 ... 0xa8] = 3, [0xa9] = 2,
+    [0xac ... 0xb1] = 1, [0xb2 ... 0xb8] = 3, [0xb9 ... 0xba] = 5, [0xbb] = 3,
+    [0xbc] = 2, [0xbd] = 3, [0xbe ... 0xbf] = 1, [0xc0 ... 0xc1] = 3,
+    [0xc2 ... 0xc3] = 1, [0xc5] = 4, [0xc6 ... 0xc7] = 3, [0xc8 ... 0xc9] = 5
+};
+
+static int32_t readS32(const uint8_t *p){
+    return (int32_t)((uint32_t)p[0]<<24 | (uint32_t)p[1]<<16 | (uint32_t)p[2]<<8 | p[3]);
+}
+
+int64_t Opcode_Length(const uint8_t *code, uint32_t codeLength, uint32_t pc){
+    uint8_t opcode = code[pc];
+    uint32_t base = (pc+4)&~(uint32_t)3;
+    int64_t length;
+    switch(opcode){
+        case CONST_OPCODE_TABLESWITCH:
+            if(base+12>codeLength){
+                return -1;
+            }
+            length = base+12+4*((int64_t)readS32(code+base+8)-readS32(code+base+4)+1)-pc;
+            break;
+        case CONST_OPCODE_LOOKUPSWITCH:
+            if(base+8>codeLength){
+                return -1;
+            }
+            length = base+8+8*(int64_t)readS32(code+base+4)-pc;
+            break;
+        case CONST_OPCODE_WIDE:
+            if(pc+1>=codeLength){
+                return -1;
+            }
+            length = CONST_OPCODE_IINC==code[pc+1] ? 6 : 4;
+            break;
+        default:
+            length = 0==lengths[opcode] ? -1 : lengths[opcode];
+            break;
+    }
+    return pc+length>codeLength ? -1 : length;
+}
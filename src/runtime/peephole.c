@@ -0,0 +1,542 @@
+#include <stdint.h>
+#include <string.h>
+
+#define INCLUDE_RUNTIME_PEEPHOLE_SELF 1
+#include "runtime/peephole.h"
+#include "runtime/opcode.h"
+#include "runtime/heap.h"
+#include "classfile/classfile.h"
+#include "classfile/op.h"
+#include "utils.h"
+
+#define PEEPHOLE_NONE  0xFFFFFFFF
+// goto chains followed by jump threading, a cycle of gotos is left alone
+#define PEEPHOLE_MAX_HOPS  8
+
+#define KIND_OTHER  0
+#define KIND_CONST  1 // int constant, encoded anew in its shortest form
+#define KIND_BRANCH  2 // 16-bit offset
+#define KIND_WIDE_BRANCH  3 // goto_w
+#define KIND_SWITCH  4
+
+typedef struct{
+    uint32_t pc; // in the class file code
+    uint32_t length; // there
+    uint32_t target; // class file pc of a branch target
+    int32_t value; // of a constant
+    uint16_t poolIndex; // of a constant too wide for sipush, 0 otherwise
+    uint8_t opcode;
+    uint8_t kind;
+    uint8_t entry; // entered by a branch or a handler
+    uint8_t deleted;
+} Insn;
+
+typedef struct{
+    ClassFile *classfile;
+    uint8_t *code;
+    uint32_t codeLength;
+    Insn *insns;
+    uint32_t count;
+    uint32_t *at; // instruction starting at a class file pc, PEEPHOLE_NONE inside one
+    uint32_t *newPc; // indexed like insns
+    uint32_t newLength;
+} Peephole;
+
+static int32_t readS32(const uint8_t *p){
+    return (int32_t)((uint32_t)p[0]<<24 | (uint32_t)p[1]<<16 | (uint32_t)p[2]<<8 | p[3]);
+}
+
+static void writeS32(uint8_t *p, int32_t value){
+    p[0] = (uint8_t)((uint32_t)value>>24);
+    p[1] = (uint8_t)((uint32_t)value>>16);
+    p[2] = (uint8_t)((uint32_t)value>>8);
+    p[3] = (uint8_t)value;
+}
+
+static int isBranch(uint8_t opcode){
+    return (CONST_OPCODE_IFEQ<=opcode && CONST_OPCODE_GOTO>=opcode)
+        || CONST_OPCODE_IFNULL==opcode || CONST_OPCODE_IFNONNULL==opcode;
+}
+
+static int isGoto(uint8_t opcode){
+    return CONST_OPCODE_GOTO==opcode || CONST_OPCODE_GOTO_W==opcode;
+}
+
+// a CONSTANT_Integer of the pool holding value, 0 if there is none
+static uint16_t findInteger(ClassFile *classfile, int32_t value){
+    for(uint16_t i=1;i<classfile->constant_pool_count;i++){
+        Constant_IntegerInfo *info = (Constant_IntegerInfo*)classfile->constant_pool[i];
+        if(NULL!=info && CONST_CONSTANTPOOLINFO_TAG_INTEGER==info->tag && (uint32_t)value==info->value){
+            return i;
+        }
+    }
+    return 0;
+}
+
+// 0 when it cannot be pushed without a new pool entry
+static uint32_t constLength(Insn *insn){
+    if(-1<=insn->value && 5>=insn->value){
+        return 1;
+    }
+    if(-128<=insn->value && 127>=insn->value){
+        return 2;
+    }
+    if(-32768<=insn->value && 32767>=insn->value){
+        return 3;
+    }
+    return 0==insn->poolIndex ? 0 : 256>insn->poolIndex ? 2 : 3;
+}
+
+static int setConst(Peephole *p, Insn *insn, int32_t value){
+    Insn folded = *insn;
+    folded.value = value;
+    folded.poolIndex = 0;
+    if(value<-32768 || value>32767){
+        folded.poolIndex = findInteger(p->classfile, value);
+        if(0==folded.poolIndex){
+            return 0;
+        }
+    }
+    *insn = folded;
+    return 1;
+}
+
+static int decodeConst(Peephole *p, Insn *insn){
+    uint8_t *code = p->code + insn->pc;
+    uint8_t opcode = code[0];
+    if(CONST_OPCODE_ICONST_M1<=opcode && CONST_OPCODE_ICONST_5>=opcode){
+        insn->value = opcode-CONST_OPCODE_ICONST_0;
+        return 1;
+    }
+    switch(opcode){
+        case CONST_OPCODE_BIPUSH:
+            insn->value = (int8_t)code[1];
+            return 1;
+        case CONST_OPCODE_SIPUSH:
+            insn->value = (int16_t)(code[1]<<8 | code[2]);
+            return 1;
+        case CONST_OPCODE_LDC:
+        case CONST_OPCODE_LDC_W:{
+            uint16_t index = CONST_OPCODE_LDC==opcode ? code[1] : (uint16_t)(code[1]<<8 | code[2]);
+            if(0==index || index>=p->classfile->constant_pool_count){
+                return 0;
+            }
+            Constant_IntegerInfo *info = (Constant_IntegerInfo*)p->classfile->constant_pool[index];
+            if(NULL==info || CONST_CONSTANTPOOLINFO_TAG_INTEGER!=info->tag){
+                return 0;
+            }
+            insn->value = (int32_t)info->value;
+            insn->poolIndex = index;
+            return 1;
+        }
+        default:
+            return 0;
+    }
+}
+
+static int markEntry(Peephole *p, uint32_t pc){
+    if(pc>=p->codeLength || PEEPHOLE_NONE==p->at[pc]){
+        return -1;
+    }
+    p->insns[p->at[pc]].entry = 1;
+    return 0;
+}
+
+// every switch target entered, with the class file pc of the switch
+static int markSwitch(Peephole *p, Insn *insn){
+    uint8_t *base = p->code + ((insn->pc+4)&~(uint32_t)3);
+    if(0!=markEntry(p, insn->pc+readS32(base))){
+        return -1;
+    }
+    if(CONST_OPCODE_TABLESWITCH==insn->opcode){
+        int64_t count = (int64_t)readS32(base+8)-readS32(base+4)+1;
+        for(int64_t i=0;i<count;i++){
+            if(0!=markEntry(p, insn->pc+readS32(base+12+4*i))){
+                return -1;
+            }
+        }
+    }else{
+        int32_t count = readS32(base+4);
+        for(int32_t i=0;i<count;i++){
+            if(0!=markEntry(p, insn->pc+readS32(base+12+8*i))){
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int decode(Peephole *p, Attribute_Code *code){
+    for(uint32_t pc=0;pc<p->codeLength;pc++){
+        p->at[pc] = PEEPHOLE_NONE;
+    }
+    for(uint32_t pc=0;pc<p->codeLength;){
+        int64_t length = Opcode_Length(p->code, p->codeLength, pc);
+        uint8_t opcode = p->code[pc];
+        // subroutines push return addresses, which are class file pcs
+        if(0>=length || CONST_OPCODE_JSR==opcode || CONST_OPCODE_JSR_W==opcode || CONST_OPCODE_RET==opcode
+            || (CONST_OPCODE_WIDE==opcode && CONST_OPCODE_RET==p->code[pc+1])){
+            return -1;
+        }
+        Insn *insn = &p->insns[p->count];
+        memset(insn, 0, sizeof(Insn));
+        insn->pc = pc;
+        insn->length = (uint32_t)length;
+        insn->opcode = opcode;
+        if(decodeConst(p, insn)){
+            insn->kind = KIND_CONST;
+        }else if(isBranch(opcode)){
+            insn->kind = KIND_BRANCH;
+            insn->target = pc + (int16_t)(p->code[pc+1]<<8 | p->code[pc+2]);
+        }else if(CONST_OPCODE_GOTO_W==opcode){
+            insn->kind = KIND_WIDE_BRANCH;
+            insn->target = pc + readS32(p->code+pc+1);
+        }else if(CONST_OPCODE_TABLESWITCH==opcode || CONST_OPCODE_LOOKUPSWITCH==opcode){
+            insn->kind = KIND_SWITCH;
+        }
+        p->at[pc] = p->count++;
+        pc += (uint32_t)length;
+    }
+    for(uint32_t i=0;i<p->count;i++){
+        Insn *insn = &p->insns[i];
+        if((KIND_BRANCH==insn->kind || KIND_WIDE_BRANCH==insn->kind) && 0!=markEntry(p, insn->target)){
+            return -1;
+        }
+        if(KIND_SWITCH==insn->kind && 0!=markSwitch(p, insn)){
+            return -1;
+        }
+    }
+    for(int i=0;i<code->exception_table_length;i++){
+        ExceptionInfo *handler = &code->exception_table[i];
+        if(0!=markEntry(p, handler->hanfler_pc)){
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// the first instruction kept from i on, count past the end
+static uint32_t kept(Peephole *p, uint32_t i){
+    while(i<p->count && p->insns[i].deleted){
+        i++;
+    }
+    return i;
+}
+
+static uint32_t keptAt(Peephole *p, uint32_t pc){
+    return kept(p, p->at[pc]);
+}
+
+// a branch into a removed instruction lands on the next one kept
+static void removeInsn(Peephole *p, uint32_t i){
+    p->insns[i].deleted = 1;
+    uint32_t next = kept(p, i);
+    if(p->insns[i].entry && next<p->count){
+        p->insns[next].entry = 1;
+    }
+}
+
+// 0 when java semantics keep the value from being folded, division by zero throws
+static int foldBinary(uint8_t opcode, int32_t a, int32_t b, int32_t *result){
+    uint32_t ua = (uint32_t)a;
+    uint32_t ub = (uint32_t)b;
+    switch(opcode){
+        case CONST_OPCODE_IADD: *result = (int32_t)(ua+ub); return 1;
+        case CONST_OPCODE_ISUB: *result = (int32_t)(ua-ub); return 1;
+        case CONST_OPCODE_IMUL: *result = (int32_t)(ua*ub); return 1;
+        case CONST_OPCODE_IAND: *result = a&b; return 1;
+        case CONST_OPCODE_IOR: *result = a|b; return 1;
+        case CONST_OPCODE_IXOR: *result = a^b; return 1;
+        case CONST_OPCODE_ISHL: *result = (int32_t)(ua<<(b&31)); return 1;
+        case CONST_OPCODE_ISHR: *result = a>>(b&31); return 1;
+        case CONST_OPCODE_IUSHR: *result = (int32_t)(ua>>(b&31)); return 1;
+        case CONST_OPCODE_IDIV:
+            if(0==b){
+                return 0;
+            }
+            *result = -1==b ? (int32_t)(0u-ua) : a/b;
+            return 1;
+        case CONST_OPCODE_IREM:
+            if(0==b){
+                return 0;
+            }
+            *result = -1==b ? 0 : a%b;
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static int foldUnary(uint8_t opcode, int32_t a, int32_t *result){
+    switch(opcode){
+        case CONST_OPCODE_INEG: *result = (int32_t)(0u-(uint32_t)a); return 1;
+        case CONST_OPCODE_I2B: *result = (int8_t)a; return 1;
+        case CONST_OPCODE_I2C: *result = (uint16_t)a; return 1;
+        case CONST_OPCODE_I2S: *result = (int16_t)a; return 1;
+        default:
+            return 0;
+    }
+}
+
+// constant at i followed by an operator, or by a constant and an operator
+static int fold(Peephole *p, uint32_t i){
+    Insn *insn = &p->insns[i];
+    uint32_t j = kept(p, i+1);
+    if(KIND_CONST!=insn->kind || j>=p->count || p->insns[j].entry){
+        return 0;
+    }
+    int32_t result;
+    if(foldUnary(p->insns[j].opcode, insn->value, &result)){
+        if(!setConst(p, insn, result)){
+            return 0;
+        }
+        removeInsn(p, j);
+        return 1;
+    }
+    uint32_t k = kept(p, j+1);
+    if(KIND_CONST!=p->insns[j].kind || k>=p->count || p->insns[k].entry
+        || !foldBinary(p->insns[k].opcode, insn->value, p->insns[j].value, &result) || !setConst(p, insn, result)){
+        return 0;
+    }
+    removeInsn(p, k);
+    removeInsn(p, j);
+    return 1;
+}
+
+static void emitConst(Insn *insn, uint8_t *out){
+    int32_t value = insn->value;
+    switch(constLength(insn)){
+        case 1:
+            out[0] = (uint8_t)(CONST_OPCODE_ICONST_0+value);
+            break;
+        case 2:
+            if(-128<=value && 127>=value){
+                out[0] = CONST_OPCODE_BIPUSH;
+                out[1] = (uint8_t)(int8_t)value;
+            }else{
+                out[0] = CONST_OPCODE_LDC;
+                out[1] = (uint8_t)insn->poolIndex;
+            }
+            break;
+        default:
+            if(-32768<=value && 32767>=value){
+                out[0] = CONST_OPCODE_SIPUSH;
+                out[1] = (uint8_t)((uint16_t)value>>8);
+                out[2] = (uint8_t)value;
+            }else{
+                out[0] = CONST_OPCODE_LDC_W;
+                out[1] = (uint8_t)(insn->poolIndex>>8);
+                out[2] = (uint8_t)insn->poolIndex;
+            }
+            break;
+    }
+}
+
+static int threadJump(Peephole *p, Insn *insn){
+    uint32_t target = insn->target;
+    for(int hops=0;hops<PEEPHOLE_MAX_HOPS;hops++){
+        uint32_t t = keptAt(p, target);
+        if(t>=p->count || !isGoto(p->insns[t].opcode) || p->insns[t].target==target){
+            break;
+        }
+        target = p->insns[t].target;
+    }
+    if(target==insn->target){
+        return 0;
+    }
+    insn->target = target;
+    uint32_t t = keptAt(p, target);
+    if(t<p->count){
+        p->insns[t].entry = 1;
+    }
+    return 1;
+}
+
+static int rewrite(Peephole *p){
+    int rewritten = 0;
+    int changed;
+    do{
+        changed = 0;
+        for(uint32_t i=kept(p, 0);i<p->count;i=kept(p, i+1)){
+            Insn *insn = &p->insns[i];
+            while(fold(p, i)){
+                changed = 1;
+            }
+            uint32_t j = kept(p, i+1);
+            if(CONST_OPCODE_DUP==insn->opcode && j<p->count && CONST_OPCODE_POP==p->insns[j].opcode && !p->insns[j].entry){
+                removeInsn(p, j);
+                removeInsn(p, i);
+                changed = 1;
+                continue;
+            }
+            if(KIND_BRANCH==insn->kind || KIND_WIDE_BRANCH==insn->kind){
+                changed |= threadJump(p, insn);
+                if(isGoto(insn->opcode) && keptAt(p, insn->target)==j){
+                    removeInsn(p, i);
+                    changed = 1;
+                }
+            }
+        }
+        rewritten |= changed;
+    }while(changed);
+    // a constant kept as it was may still have a shorter form, or one without a pool load
+    for(uint32_t i=0;i<p->count && !rewritten;i++){
+        Insn *insn = &p->insns[i];
+        uint8_t form[3];
+        if(KIND_CONST==insn->kind){
+            emitConst(insn, form);
+            rewritten = form[0]!=insn->opcode || constLength(insn)!=insn->length;
+        }
+    }
+    return rewritten;
+}
+
+static uint32_t newLength(Insn *insn, uint32_t pc){
+    switch(insn->kind){
+        case KIND_CONST:
+            return constLength(insn);
+        case KIND_SWITCH:{
+            uint32_t oldPad = 3-(insn->pc&3);
+            uint32_t pad = 3-(pc&3);
+            return insn->length-oldPad+pad;
+        }
+        default:
+            return insn->length;
+    }
+}
+
+static uint32_t mapPc(Peephole *p, uint32_t pc){
+    if(pc>=p->codeLength){
+        return p->newLength;
+    }
+    uint32_t i = keptAt(p, pc);
+    return i<p->count ? p->newPc[i] : p->newLength;
+}
+
+static void emitSwitch(Peephole *p, Insn *insn, uint32_t pc, uint8_t *out){
+    uint8_t *in = p->code + ((insn->pc+4)&~(uint32_t)3);
+    uint32_t pad = 3-(pc&3);
+    out[0] = insn->opcode;
+    memset(out+1, 0, pad);
+    out += 1+pad;
+    writeS32(out, (int32_t)(mapPc(p, insn->pc+readS32(in))-pc));
+    if(CONST_OPCODE_TABLESWITCH==insn->opcode){
+        memcpy(out+4, in+4, 8);
+        int64_t count = (int64_t)readS32(in+8)-readS32(in+4)+1;
+        for(int64_t i=0;i<count;i++){
+            writeS32(out+12+4*i, (int32_t)(mapPc(p, insn->pc+readS32(in+12+4*i))-pc));
+        }
+    }else{
+        memcpy(out+4, in+4, 4);
+        int32_t count = readS32(in+4);
+        for(int32_t i=0;i<count;i++){
+            memcpy(out+8+8*i, in+8+8*i, 4);
+            writeS32(out+12+8*i, (int32_t)(mapPc(p, insn->pc+readS32(in+12+8*i))-pc));
+        }
+    }
+}
+
+// NULL when a short branch no longer reaches its target
+static uint8_t* emit(Peephole *p){
+    uint32_t pc = 0;
+    for(uint32_t i=0;i<p->count;i++){
+        p->newPc[i] = pc;
+        if(!p->insns[i].deleted){
+            pc += newLength(&p->insns[i], pc);
+        }
+    }
+    p->newLength = pc;
+    uint8_t *out = (uint8_t*)Heap_AllocAtomic(0==pc ? 1 : pc);
+    for(uint32_t i=kept(p, 0);i<p->count;i=kept(p, i+1)){
+        Insn *insn = &p->insns[i];
+        uint32_t at = p->newPc[i];
+        int64_t offset = (int64_t)mapPc(p, insn->target)-at;
+        switch(insn->kind){
+            case KIND_CONST:
+                emitConst(insn, out+at);
+                break;
+            case KIND_BRANCH:
+                if(offset<INT16_MIN || offset>INT16_MAX){
+                    Heap_Free(out);
+                    return NULL;
+                }
+                out[at] = insn->opcode;
+                out[at+1] = (uint8_t)((uint16_t)offset>>8);
+                out[at+2] = (uint8_t)offset;
+                break;
+            case KIND_WIDE_BRANCH:
+                out[at] = insn->opcode;
+                writeS32(out+at+1, (int32_t)offset);
+                break;
+            case KIND_SWITCH:
+                emitSwitch(p, insn, at, out+at);
+                break;
+            default:
+                memcpy(out+at, p->code+insn->pc, insn->length);
+                break;
+        }
+    }
+    return out;
+}
+
+static void mapRange(Peephole *p, uint16_t *start, uint16_t *length){
+    uint32_t end = mapPc(p, (uint32_t)*start+*length);
+    *start = (uint16_t)mapPc(p, *start);
+    *length = (uint16_t)(end-*start);
+}
+
+static void mapDebugInfo(Peephole *p, Attribute_Code *code){
+    void **attributes = (void**)code->attributes;
+    for(int i=0;i<code->attributes_count;i++){
+        Attribute_LineNumberTable *attribute = (Attribute_LineNumberTable*)attributes[i];
+        uint8_t *name = CLZFILE_cp_getUTF8(p->classfile->constant_pool, attribute->attribute_name_index);
+        if(utf8ascii_equals(name, "LineNumberTable")){
+            for(int j=0;j<attribute->line_number_entries_count;j++){
+                attribute->table[j].start_pc = (uint16_t)mapPc(p, attribute->table[j].start_pc);
+            }
+        }else if(utf8ascii_equals(name, "LocalVariableTable")){
+            Attribute_LocalVariableTable *locals = (Attribute_LocalVariableTable*)attributes[i];
+            for(int j=0;j<locals->local_variable_entries_count;j++){
+                mapRange(p, &locals->table[j].start_pc, &locals->table[j].length);
+            }
+        }else if(utf8ascii_equals(name, "LocalVariableTypeTable")){
+            Attribute_LocalVariableTypeTable *locals = (Attribute_LocalVariableTypeTable*)attributes[i];
+            for(int j=0;j<locals->local_variable_type_entries_count;j++){
+                mapRange(p, &locals->table[j].start_pc, &locals->table[j].length);
+            }
+        }
+    }
+}
+
+void Peephole_Optimize(ClassFile *classfile, Attribute_Code *code){
+    if(0==code->code_length){
+        return;
+    }
+    Peephole p;
+    p.classfile = classfile;
+    p.code = code->code;
+    p.codeLength = code->code_length;
+    p.count = 0;
+    p.insns = (Insn*)Heap_AllocAtomic(sizeof(Insn)*p.codeLength);
+    p.at = (uint32_t*)Heap_AllocAtomic(sizeof(uint32_t)*p.codeLength);
+    p.newPc = (uint32_t*)Heap_AllocAtomic(sizeof(uint32_t)*p.codeLength);
+    uint8_t *out = NULL;
+    if(0==decode(&p, code) && rewrite(&p)){
+        out = emit(&p);
+    }
+    if(NULL!=out){
+        for(int i=0;i<code->exception_table_length;i++){
+            ExceptionInfo *handler = &code->exception_table[i];
+            handler->start_pc = (uint16_t)mapPc(&p, handler->start_pc);
+            handler->end_pc = (uint16_t)mapPc(&p, handler->end_pc);
+            handler->hanfler_pc = (uint16_t)mapPc(&p, handler->hanfler_pc);
+        }
+        mapDebugInfo(&p, code);
+        Heap_Free(code->code);
+        code->code = out;
+        code->code_length = p.newLength;
+    }
+    Heap_Free(p.newPc);
+    Heap_Free(p.at);
+    Heap_Free(p.insns);
+}
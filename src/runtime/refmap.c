@@ -0,0 +1,774 @@
+#include <stdint.h>
+#include <string.h>
+
+#define INCLUDE_RUNTIME_REFMAP_SELF 1
+#include "runtime/refmap.h"
+#include "runtime/method.h"
+#include "runtime/class.h"
+#include "runtime/heap.h"
+#include "runtime/opcode.h"
+#include "runtime/descriptor.h"
+#include "classfile/classfile.h"
+#include "classfile/op.h"
+#include "utils.h"
+
+// Forward pass: which slots hold a reference on every path into an
+// instruction. Backward pass: which reference locals are read again.
+// Stack slots are always live, the code consumes whatever it pushed.
+
+#define SLOT_VALUE 0
+#define SLOT_REF 1
+
+
+typedef struct{
+    Method *method;
+    void **constantPool;
+    uint16_t constantPoolCount;
+    uint8_t *code;
+    uint32_t codeLength;
+    uint16_t maxLocals;
+    uint16_t maxStack;
+    uint16_t slotsCount;
+    uint16_t localWords;
+    uint32_t *index; // by pc: instruction number, CONST_REFMAP_NONE elsewhere
+    uint32_t *pcs; // by instruction number
+    uint32_t count;
+    uint8_t *states; // slotsCount per instruction, locals then stack
+    int32_t *depths; // -1 until reached
+    uint32_t *worklist;
+    uint32_t worklistSize;
+    uint8_t *queued;
+    uint32_t *live; // localWords per instruction
+} Analysis;
+
+// abstract state of the instruction being interpreted
+typedef struct{
+    uint8_t *slots;
+    int32_t sp;
+} State;
+
+static uint16_t readU16(uint8_t *p){
+    return (uint16_t)(p[0]<<8 | p[1]);
+}
+
+static int32_t readS32(uint8_t *p){
+    return (int32_t)((uint32_t)p[0]<<24 | (uint32_t)p[1]<<16 | (uint32_t)p[2]<<8 | p[3]);
+}
+
+static uint32_t switchBase(uint32_t pc){
+    return (pc+4)&~(uint32_t)3;
+}
+
+
+static void enqueue(Analysis *a, uint32_t insn){
+    if(!a->queued[insn]){
+        a->queued[insn] = 1;
+        a->worklist[a->worklistSize++] = insn;
+    }
+}
+
+static int merge(Analysis *a, uint32_t target, State *state){
+    if(target>=a->codeLength || CONST_REFMAP_NONE==a->index[target]){
+        error("VerifyError. Branch into the middle of an instruction at %u in %s.", target, a->method->name);
+        return -1;
+    }
+    uint32_t insn = a->index[target];
+    uint8_t *slots = a->states + (size_t)insn*a->slotsCount;
+    if(-1==a->depths[insn]){
+        memcpy(slots, state->slots, a->slotsCount);
+        a->depths[insn] = state->sp;
+        enqueue(a, insn);
+        return 0;
+    }
+    if(a->depths[insn]!=state->sp){
+        error("VerifyError. Inconsistent stack height at %u in %s.", target, a->method->name);
+        return -1;
+    }
+    int changed = 0;
+    for(int i=0;i<a->maxLocals+state->sp;i++){
+        if(SLOT_REF==slots[i] && SLOT_REF!=state->slots[i]){
+            slots[i] = SLOT_VALUE;
+            changed = 1;
+        }
+    }
+    if(changed){
+        enqueue(a, insn);
+    }
+    return 0;
+}
+
+typedef int (*SuccessorFn)(Analysis *a, uint32_t target, void *data);
+
+// branch and fall through targets, exception handlers are handled apart
+static int forEachSuccessor(Analysis *a, uint32_t pc, SuccessorFn fn, void *data){
+    uint8_t *code = a->code;
+    uint8_t opcode = code[pc];
+    uint32_t next = pc+(uint32_t)Opcode_Length(code, a->codeLength, pc);
+    uint32_t base;
+    switch(opcode){
+        case CONST_OPCODE_IFEQ ... CONST_OPCODE_IF_ACMPNE:
+        case CONST_OPCODE_IFNULL:
+        case CONST_OPCODE_IFNONNULL:
+            if(0!=fn(a, pc+(int16_t)readU16(code+pc+1), data)){
+                return -1;
+            }
+            return fn(a, next, data);
+        case CONST_OPCODE_GOTO:
+            return fn(a, pc+(int16_t)readU16(code+pc+1), data);
+        case CONST_OPCODE_GOTO_W:
+            return fn(a, pc+readS32(code+pc+1), data);
+        case CONST_OPCODE_TABLESWITCH:
+            base = switchBase(pc);
+            if(0!=fn(a, pc+readS32(code+base), data)){
+                return -1;
+            }
+            for(int64_t i=0;i<=(int64_t)readS32(code+base+8)-readS32(code+base+4);i++){
+                if(0!=fn(a, pc+readS32(code+base+12+4*i), data)){
+                    return -1;
+                }
+            }
+            return 0;
+        case CONST_OPCODE_LOOKUPSWITCH:
+            base = switchBase(pc);
+            if(0!=fn(a, pc+readS32(code+base), data)){
+                return -1;
+            }
+            for(int32_t i=0;i<readS32(code+base+4);i++){
+                if(0!=fn(a, pc+readS32(code+base+12+8*i), data)){
+                    return -1;
+                }
+            }
+            return 0;
+        case CONST_OPCODE_IRETURN ... CONST_OPCODE_RETURN:
+        case CONST_OPCODE_ATHROW:
+            return 0;
+        default:
+            return fn(a, next, data);
+    }
+}
+
+static uint8_t* constantDescriptor(Analysis *a, uint16_t index){
+    if(0==index || index>=a->constantPoolCount || NULL==a->constantPool[index]){
+        return NULL;
+    }
+    uint16_t nameAndType;
+    switch(*(uint8_t*)a->constantPool[index]){
+        case CONST_CONSTANTPOOLINFO_TAG_FIELD_REF:
+        case CONST_CONSTANTPOOLINFO_TAG_METHOD_REF:
+        case CONST_CONSTANTPOOLINFO_TAG_INTERFACE_METHOD_REF:
+            nameAndType = ((Constant_FieldRefInfo*)a->constantPool[index])->name_and_type_index;
+            break;
+        case CONST_CONSTANTPOOLINFO_TAG_INVOKE_DYNAMIC:
+            nameAndType = ((Constant_InvokeDynamicInfo*)a->constantPool[index])->name_and_type_index;
+            break;
+        default:
+            return NULL;
+    }
+    Constant_NameAndTypeInfo *info = (Constant_NameAndTypeInfo*)a->constantPool[nameAndType];
+    return CLZFILE_cp_getUTF8(a->constantPool, info->descriptor_index);
+}
+
+static int pop(Analysis *a, State *state, int count){
+    if(state->sp<count){
+        error("VerifyError. Operand stack underflow in %s.", a->method->name);
+        return -1;
+    }
+    state->sp -= count;
+    return 0;
+}
+
+static int push(Analysis *a, State *state, uint8_t kind, int count){
+    if(state->sp+count>a->maxStack){
+        error("VerifyError. Operand stack overflow in %s.", a->method->name);
+        return -1;
+    }
+    for(int i=0;i<count;i++){
+        state->slots[a->maxLocals+state->sp++] = kind;
+    }
+    return 0;
+}
+
+static int pushType(Analysis *a, State *state, uint8_t type){
+    switch(type){
+        case 'V':
+            return 0;
+        case 'L':
+        case '[':
+            return push(a, state, SLOT_REF, 1);
+        case 'J':
+        case 'D':
+            return push(a, state, SLOT_VALUE, 2);
+        default:
+            return push(a, state, SLOT_VALUE, 1);
+    }
+}
+
+static int typeSlots(uint8_t type){
+    return 'J'==type || 'D'==type ? 2 : 1;
+}
+
+static int checkLocal(Analysis *a, uint32_t local, int count){
+    if(local+count>a->maxLocals){
+        error("VerifyError. Local variable %u out of range in %s.", local, a->method->name);
+        return -1;
+    }
+    return 0;
+}
+
+static int load(Analysis *a, State *state, uint32_t local, int count, int isRef){
+    if(0!=checkLocal(a, local, count)){
+        return -1;
+    }
+    return push(a, state, isRef ? state->slots[local] : SLOT_VALUE, count);
+}
+
+// astore also stores returnAddresses, the slot keeps what was on the stack
+static int store(Analysis *a, State *state, uint32_t local, int count, int isRef){
+    if(0!=checkLocal(a, local, count) || 0!=pop(a, state, count)){
+        return -1;
+    }
+    for(int i=0;i<count;i++){
+        state->slots[local+i] = isRef ? state->slots[a->maxLocals+state->sp] : SLOT_VALUE;
+    }
+    return 0;
+}
+
+// dup family, patterns list the popped slots to push again, 0 being the top
+static int shuffle(Analysis *a, State *state, int pops, const int8_t *pattern, int count){
+    uint8_t popped[4];
+    if(0!=pop(a, state, pops)){
+        return -1;
+    }
+    for(int i=0;i<pops;i++){
+        popped[i] = state->slots[a->maxLocals+state->sp+pops-1-i];
+    }
+    for(int i=0;i<count;i++){
+        if(0!=push(a, state, popped[pattern[i]], 1)){
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int interpret(Analysis *a, uint32_t pc, State *state){
+    uint8_t *code = a->code;
+    uint8_t opcode = code[pc];
+    uint8_t *descriptor;
+    Descriptor *parsed;
+    uint8_t tag;
+    uint16_t index;
+    switch(opcode){
+        case CONST_OPCODE_NOP:
+            return 0;
+        case CONST_OPCODE_ACONST_NULL:
+            return push(a, state, SLOT_REF, 1);
+        case CONST_OPCODE_ICONST_M1 ... CONST_OPCODE_ICONST_5:
+        case CONST_OPCODE_FCONST_0 ... CONST_OPCODE_FCONST_2:
+        case CONST_OPCODE_BIPUSH:
+        case CONST_OPCODE_SIPUSH:
+            return push(a, state, SLOT_VALUE, 1);
+        case CONST_OPCODE_LCONST_0 ... CONST_OPCODE_LCONST_1:
+        case CONST_OPCODE_DCONST_0 ... CONST_OPCODE_DCONST_1:
+        case CONST_OPCODE_LDC2_W:
+            return push(a, state, SLOT_VALUE, 2);
+        case CONST_OPCODE_LDC:
+        case CONST_OPCODE_LDC_W:
+            index = CONST_OPCODE_LDC==opcode ? code[pc+1] : readU16(code+pc+1);
+            if(0==index || index>=a->constantPoolCount || NULL==a->constantPool[index]){
+                error("VerifyError. Invalid constant %u in %s.", index, a->method->name);
+                return -1;
+            }
+            tag = *(uint8_t*)a->constantPool[index];
+            if(CONST_CONSTANTPOOLINFO_TAG_INTEGER==tag || CONST_CONSTANTPOOLINFO_TAG_FLOAT==tag){
+                return push(a, state, SLOT_VALUE, 1);
+            }
+            return push(a, state, SLOT_REF, 1);
+        case CONST_OPCODE_ILOAD:
+        case CONST_OPCODE_FLOAD:
+            return load(a, state, code[pc+1], 1, 0);
+        case CONST_OPCODE_LLOAD:
+        case CONST_OPCODE_DLOAD:
+            return load(a, state, code[pc+1], 2, 0);
+        case CONST_OPCODE_ALOAD:
+            return load(a, state, code[pc+1], 1, 1);
+        case CONST_OPCODE_ILOAD_0 ... CONST_OPCODE_ILOAD_3:
+            return load(a, state, opcode-CONST_OPCODE_ILOAD_0, 1, 0);
+        case CONST_OPCODE_LLOAD_0 ... CONST_OPCODE_LLOAD_3:
+            return load(a, state, opcode-CONST_OPCODE_LLOAD_0, 2, 0);
+        case CONST_OPCODE_FLOAD_0 ... CONST_OPCODE_FLOAD_3:
+            return load(a, state, opcode-CONST_OPCODE_FLOAD_0, 1, 0);
+        case CONST_OPCODE_DLOAD_0 ... CONST_OPCODE_DLOAD_3:
+            return load(a, state, opcode-CONST_OPCODE_DLOAD_0, 2, 0);
+        case CONST_OPCODE_ALOAD_0 ... CONST_OPCODE_ALOAD_3:
+            return load(a, state, opcode-CONST_OPCODE_ALOAD_0, 1, 1);
+        case CONST_OPCODE_IALOAD ... CONST_OPCODE_SALOAD:
+            if(0!=pop(a, state, 2)){
+                return -1;
+            }
+            if(CONST_OPCODE_AALOAD==opcode){
+                return push(a, state, SLOT_REF, 1);
+            }
+            return push(a, state, SLOT_VALUE, CONST_OPCODE_LALOAD==opcode || CONST_OPCODE_DALOAD==opcode ? 2 : 1);
+        case CONST_OPCODE_ISTORE:
+        case CONST_OPCODE_FSTORE:
+            return store(a, state, code[pc+1], 1, 0);
+        case CONST_OPCODE_LSTORE:
+        case CONST_OPCODE_DSTORE:
+            return store(a, state, code[pc+1], 2, 0);
+        case CONST_OPCODE_ASTORE:
+            return store(a, state, code[pc+1], 1, 1);
+        case CONST_OPCODE_ISTORE_0 ... CONST_OPCODE_ISTORE_3:
+            return store(a, state, opcode-CONST_OPCODE_ISTORE_0, 1, 0);
+        case CONST_OPCODE_LSTORE_0 ... CONST_OPCODE_LSTORE_3:
+            return store(a, state, opcode-CONST_OPCODE_LSTORE_0, 2, 0);
+        case CONST_OPCODE_FSTORE_0 ... CONST_OPCODE_FSTORE_3:
+            return store(a, state, opcode-CONST_OPCODE_FSTORE_0, 1, 0);
+        case CONST_OPCODE_DSTORE_0 ... CONST_OPCODE_DSTORE_3:
+            return store(a, state, opcode-CONST_OPCODE_DSTORE_0, 2, 0);
+        case CONST_OPCODE_ASTORE_0 ... CONST_OPCODE_ASTORE_3:
+            return store(a, state, opcode-CONST_OPCODE_ASTORE_0, 1, 1);
+        case CONST_OPCODE_IASTORE ... CONST_OPCODE_SASTORE:
+            return pop(a, state, CONST_OPCODE_LASTORE==opcode || CONST_OPCODE_DASTORE==opcode ? 4 : 3);
+        case CONST_OPCODE_POP:
+            return pop(a, state, 1);
+        case CONST_OPCODE_POP2:
+            return pop(a, state, 2);
+        case CONST_OPCODE_DUP:
+            return shuffle(a, state, 1, (const int8_t[]){0, 0}, 2);
+        case CONST_OPCODE_DUP_X1:
+            return shuffle(a, state, 2, (const int8_t[]){0, 1, 0}, 3);
+        case CONST_OPCODE_DUP_X2:
+            return shuffle(a, state, 3, (const int8_t[]){0, 2, 1, 0}, 4);
+        case CONST_OPCODE_DUP2:
+            return shuffle(a, state, 2, (const int8_t[]){1, 0, 1, 0}, 4);
+        case CONST_OPCODE_DUP2_X1:
+            return shuffle(a, state, 3, (const int8_t[]){1, 0, 2, 1, 0}, 5);
+        case CONST_OPCODE_DUP2_X2:
+            return shuffle(a, state, 4, (const int8_t[]){1, 0, 3, 2, 1, 0}, 6);
+        case CONST_OPCODE_SWAP:
+            return shuffle(a, state, 2, (const int8_t[]){0, 1}, 2);
+        // arithmetic, odd opcodes work on longs and doubles up to lxor
+        case CONST_OPCODE_IADD ... CONST_OPCODE_DREM:
+        case CONST_OPCODE_IAND ... CONST_OPCODE_LXOR:
+            if(0!=pop(a, state, (opcode&1) ? 4 : 2)){
+                return -1;
+            }
+            return push(a, state, SLOT_VALUE, (opcode&1) ? 2 : 1);
+        case CONST_OPCODE_INEG ... CONST_OPCODE_DNEG:
+            return 0;
+        case CONST_OPCODE_ISHL ... CONST_OPCODE_LUSHR:
+            if(0!=pop(a, state, (opcode&1) ? 3 : 2)){
+                return -1;
+            }
+            return push(a, state, SLOT_VALUE, (opcode&1) ? 2 : 1);
+        case CONST_OPCODE_IINC:
+            return checkLocal(a, code[pc+1], 1);
+        case CONST_OPCODE_I2L:
+        case CONST_OPCODE_I2D:
+        case CONST_OPCODE_F2L:
+        case CONST_OPCODE_F2D:
+            return push(a, state, SLOT_VALUE, 1);
+        case CONST_OPCODE_L2I:
+        case CONST_OPCODE_L2F:
+        case CONST_OPCODE_D2I:
+        case CONST_OPCODE_D2F:
+            return pop(a, state, 1);
+        case CONST_OPCODE_I2F:
+        case CONST_OPCODE_L2D:
+        case CONST_OPCODE_F2I:
+        case CONST_OPCODE_D2L:
+        case CONST_OPCODE_I2B ... CONST_OPCODE_I2S:
+            return 0;
+        case CONST_OPCODE_LCMP:
+        case CONST_OPCODE_DCMPL:
+        case CONST_OPCODE_DCMPG:
+            if(0!=pop(a, state, 4)){
+                return -1;
+            }
+            return push(a, state, SLOT_VALUE, 1);
+        case CONST_OPCODE_FCMPL:
+        case CONST_OPCODE_FCMPG:
+            if(0!=pop(a, state, 2)){
+                return -1;
+            }
+            return push(a, state, SLOT_VALUE, 1);
+        case CONST_OPCODE_IFEQ ... CONST_OPCODE_IFLE:
+        case CONST_OPCODE_IFNULL:
+        case CONST_OPCODE_IFNONNULL:
+        case CONST_OPCODE_TABLESWITCH:
+        case CONST_OPCODE_LOOKUPSWITCH:
+        case CONST_OPCODE_MONITORENTER:
+        case CONST_OPCODE_MONITOREXIT:
+            return pop(a, state, 1);
+        case CONST_OPCODE_IF_ICMPEQ ... CONST_OPCODE_IF_ACMPNE:
+            return pop(a, state, 2);
+        case CONST_OPCODE_GOTO:
+        case CONST_OPCODE_GOTO_W:
+        case CONST_OPCODE_IRETURN ... CONST_OPCODE_RETURN:
+        case CONST_OPCODE_ATHROW:
+            return 0;
+        case CONST_OPCODE_GETSTATIC:
+        case CONST_OPCODE_PUTSTATIC:
+        case CONST_OPCODE_GETFIELD:
+        case CONST_OPCODE_PUTFIELD:
+            descriptor = constantDescriptor(a, readU16(code+pc+1));
+            if(NULL==descriptor){
+                error("VerifyError. Invalid field reference in %s.", a->method->name);
+                return -1;
+            }
+            if(CONST_OPCODE_GETFIELD==opcode && 0!=pop(a, state, 1)){
+                return -1;
+            }
+            if(CONST_OPCODE_GETSTATIC==opcode || CONST_OPCODE_GETFIELD==opcode){
+                return pushType(a, state, descriptor[0]);
+            }
+            return pop(a, state, typeSlots(descriptor[0])+(CONST_OPCODE_PUTFIELD==opcode));
+        case CONST_OPCODE_INVOKEVIRTUAL ... CONST_OPCODE_INVOKEDYNAMIC:
+            descriptor = constantDescriptor(a, readU16(code+pc+1));
+            parsed = NULL==descriptor ? NULL : Descriptor_Get(descriptor);
+            if(NULL==parsed){
+                error("VerifyError. Invalid method reference in %s.", a->method->name);
+                return -1;
+            }
+            if(0!=pop(a, state, parsed->argSlots+(CONST_OPCODE_INVOKESTATIC!=opcode && CONST_OPCODE_INVOKEDYNAMIC!=opcode))){
+                return -1;
+            }
+            return pushType(a, state, parsed->returnType);
+        case CONST_OPCODE_NEW:
+            return push(a, state, SLOT_REF, 1);
+        case CONST_OPCODE_NEWARRAY:
+        case CONST_OPCODE_ANEWARRAY:
+        case CONST_OPCODE_CHECKCAST:
+            if(0!=pop(a, state, 1)){
+                return -1;
+            }
+            return push(a, state, SLOT_REF, 1);
+        case CONST_OPCODE_ARRAYLENGTH:
+        case CONST_OPCODE_INSTANCEOF:
+            if(0!=pop(a, state, 1)){
+                return -1;
+            }
+            return push(a, state, SLOT_VALUE, 1);
+        case CONST_OPCODE_MULTIANEWARRAY:
+            if(0!=pop(a, state, code[pc+3])){
+                return -1;
+            }
+            return push(a, state, SLOT_REF, 1);
+        case CONST_OPCODE_WIDE:
+            index = readU16(code+pc+2);
+            switch(code[pc+1]){
+                case CONST_OPCODE_ILOAD:
+                case CONST_OPCODE_FLOAD:
+                    return load(a, state, index, 1, 0);
+                case CONST_OPCODE_LLOAD:
+                case CONST_OPCODE_DLOAD:
+                    return load(a, state, index, 2, 0);
+                case CONST_OPCODE_ALOAD:
+                    return load(a, state, index, 1, 1);
+                case CONST_OPCODE_ISTORE:
+                case CONST_OPCODE_FSTORE:
+                    return store(a, state, index, 1, 0);
+                case CONST_OPCODE_LSTORE:
+                case CONST_OPCODE_DSTORE:
+                    return store(a, state, index, 2, 0);
+                case CONST_OPCODE_ASTORE:
+                    return store(a, state, index, 1, 1);
+                case CONST_OPCODE_IINC:
+                    return checkLocal(a, index, 1);
+                default:
+                    break;
+            }
+            // fall through, wide ret
+        default:
+            // jsr and ret make the slots depend on the caller of the subroutine
+            return -1;
+    }
+}
+
+// reference locals read by an instruction, and the ones it overwrites
+static void localsEffect(uint8_t *code, uint32_t pc, int32_t *use, int32_t *def, int *defCount){
+    uint8_t opcode = code[pc];
+    *use = -1;
+    *def = -1;
+    *defCount = 1;
+    switch(opcode){
+        case CONST_OPCODE_ALOAD:
+            *use = code[pc+1];
+            return;
+        case CONST_OPCODE_ALOAD_0 ... CONST_OPCODE_ALOAD_3:
+            *use = opcode-CONST_OPCODE_ALOAD_0;
+            return;
+        case CONST_OPCODE_ISTORE ... CONST_OPCODE_ASTORE:
+            *def = code[pc+1];
+            *defCount = CONST_OPCODE_LSTORE==opcode || CONST_OPCODE_DSTORE==opcode ? 2 : 1;
+            return;
+        case CONST_OPCODE_ISTORE_0 ... CONST_OPCODE_ASTORE_3:
+            *def = (opcode-CONST_OPCODE_ISTORE_0)&3;
+            *defCount = opcode>=CONST_OPCODE_LSTORE_0 && opcode<=CONST_OPCODE_LSTORE_3 ? 2 : opcode>=CONST_OPCODE_DSTORE_0 && opcode<=CONST_OPCODE_DSTORE_3 ? 2 : 1;
+            return;
+        case CONST_OPCODE_WIDE:
+            opcode = code[pc+1];
+            if(CONST_OPCODE_ALOAD==opcode){
+                *use = readU16(code+pc+2);
+            }else if(opcode>=CONST_OPCODE_ISTORE && opcode<=CONST_OPCODE_ASTORE){
+                *def = readU16(code+pc+2);
+                *defCount = CONST_OPCODE_LSTORE==opcode || CONST_OPCODE_DSTORE==opcode ? 2 : 1;
+            }
+            return;
+        default:
+            return;
+    }
+}
+
+static int orLiveIn(Analysis *a, uint32_t target, void *data){
+    uint32_t *out = (uint32_t*)data;
+    uint32_t *in = a->live + (size_t)a->index[target]*a->localWords;
+    for(int i=0;i<a->localWords;i++){
+        out[i] |= in[i];
+    }
+    return 0;
+}
+
+static int mergeTarget(Analysis *a, uint32_t target, void *data){
+    return merge(a, target, (State*)data);
+}
+
+static int findInstructions(Analysis *a){
+    uint32_t pc = 0;
+    for(uint32_t i=0;i<a->codeLength;i++){
+        a->index[i] = CONST_REFMAP_NONE;
+    }
+    a->count = 0;
+    while(pc<a->codeLength){
+        int64_t length = Opcode_Length(a->code, a->codeLength, pc);
+        if(0>=length || pc+length>a->codeLength){
+            error("VerifyError. Invalid instruction 0x%02x at %u in %s.", a->code[pc], pc, a->method->name);
+            return -1;
+        }
+        a->index[pc] = a->count;
+        a->pcs[a->count++] = pc;
+        pc += (uint32_t)length;
+    }
+    return 0;
+}
+
+static int initialState(Analysis *a, State *state){
+    Method *method = a->method;
+    uint32_t local = 0;
+    memset(state->slots, SLOT_VALUE, a->slotsCount);
+    state->sp = 0;
+    if(method->argSlots>a->maxLocals){
+        error("VerifyError. Arguments of %s%s exceed max_locals.", method->name, method->descriptor);
+        return -1;
+    }
+    if(!(method->accessFlags & CONST_METHOD_ACCESS_STATIC)){
+        state->slots[local++] = SLOT_REF;
+    }
+    for(uint8_t *cur=method->descriptor+1;')'!=*cur;cur++){
+        if('['==*cur || 'L'==*cur){
+            while('['==*cur){
+                cur++;
+            }
+            if('L'==*cur){
+                while(';'!=*cur){
+                    cur++;
+                }
+            }
+            state->slots[local++] = SLOT_REF;
+        }else{
+            local += typeSlots(*cur);
+        }
+    }
+    return 0;
+}
+
+// a handler starts with the thrown exception alone on the stack
+static int mergeHandlers(Analysis *a, uint32_t pc, State *state, uint8_t *scratch){
+    Attribute_Code *attribute = a->method->codeAttribute;
+    for(int i=0;i<attribute->exception_table_length;i++){
+        ExceptionInfo *handler = &attribute->exception_table[i];
+        if(pc<handler->start_pc || pc>=handler->end_pc){
+            continue;
+        }
+        if(0==a->maxStack){
+            error("VerifyError. Exception handler without stack in %s.", a->method->name);
+            return -1;
+        }
+        State thrown = {scratch, 1};
+        memcpy(scratch, state->slots, a->maxLocals);
+        scratch[a->maxLocals] = SLOT_REF;
+        if(0!=merge(a, handler->hanfler_pc, &thrown)){
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int forward(Analysis *a){
+    State state;
+    uint8_t *scratch = (uint8_t*)Heap_AllocAtomic(a->slotsCount);
+    int status = -1;
+    state.slots = (uint8_t*)Heap_AllocAtomic(a->slotsCount);
+    memset(scratch, SLOT_VALUE, a->slotsCount);
+    if(0!=initialState(a, &state) || 0!=merge(a, 0, &state)){
+        goto done;
+    }
+    while(0<a->worklistSize){
+        uint32_t insn = a->worklist[--a->worklistSize];
+        uint32_t pc = a->pcs[insn];
+        a->queued[insn] = 0;
+        memcpy(state.slots, a->states + (size_t)insn*a->slotsCount, a->slotsCount);
+        state.sp = a->depths[insn];
+        // a handler may see the locals from before or after the instruction
+        if(0!=mergeHandlers(a, pc, &state, scratch)){
+            goto done;
+        }
+        if(0!=interpret(a, pc, &state)){
+            error("[FIXME] unable to map the references of %s%s at %u.", a->method->name, a->method->descriptor, pc);
+            goto done;
+        }
+        if(0!=mergeHandlers(a, pc, &state, scratch) || 0!=forEachSuccessor(a, pc, mergeTarget, &state)){
+            goto done;
+        }
+    }
+    status = 0;
+done:
+    Heap_Free(scratch);
+    Heap_Free(state.slots);
+    return status;
+}
+
+static void backward(Analysis *a){
+    Attribute_Code *attribute = a->method->codeAttribute;
+    uint32_t *live = (uint32_t*)Heap_AllocAtomic(sizeof(uint32_t)*a->localWords);
+    int changed = 1;
+    while(changed){
+        changed = 0;
+        for(int64_t insn=(int64_t)a->count-1;insn>=0;insn--){
+            if(-1==a->depths[insn]){
+                continue;
+            }
+            uint32_t pc = a->pcs[insn];
+            int32_t use, def;
+            int defCount;
+            memset(live, 0, sizeof(uint32_t)*a->localWords);
+            forEachSuccessor(a, pc, orLiveIn, live);
+            localsEffect(a->code, pc, &use, &def, &defCount);
+            for(int i=0;-1!=def && i<defCount;i++){
+                live[(def+i)>>5] &= ~((uint32_t)1<<((def+i)&31));
+            }
+            if(-1!=use){
+                live[use>>5] |= (uint32_t)1<<(use&31);
+            }
+            for(int i=0;i<attribute->exception_table_length;i++){
+                ExceptionInfo *handler = &attribute->exception_table[i];
+                if(pc>=handler->start_pc && pc<handler->end_pc){
+                    orLiveIn(a, handler->hanfler_pc, live);
+                }
+            }
+            uint32_t *in = a->live + (size_t)insn*a->localWords;
+            if(0!=memcmp(in, live, sizeof(uint32_t)*a->localWords)){
+                memcpy(in, live, sizeof(uint32_t)*a->localWords);
+                changed = 1;
+            }
+        }
+    }
+    Heap_Free(live);
+}
+
+static RefMap* build(Analysis *a){
+    RefMap *map = (RefMap*)Heap_AllocPermanent(sizeof(RefMap));
+    uint32_t words = (a->slotsCount+31)/32;
+    uint32_t *bits = (uint32_t*)Heap_AllocAtomic(sizeof(uint32_t)*words*(a->count+1));
+    uint16_t *depths = (uint16_t*)Heap_AllocAtomic(sizeof(uint16_t)*(a->count+1));
+    uint32_t entries = 0;
+    map->maxLocals = a->maxLocals;
+    map->maxStack = a->maxStack;
+    map->words = (uint16_t)words;
+    map->entries = (uint32_t*)Heap_AllocPermanentAtomic(sizeof(uint32_t)*a->codeLength);
+    for(uint32_t pc=0;pc<a->codeLength;pc++){
+        map->entries[pc] = CONST_REFMAP_NONE;
+    }
+    for(uint32_t insn=0;insn<a->count;insn++){
+        if(-1==a->depths[insn]){
+            continue;
+        }
+        uint8_t *slots = a->states + (size_t)insn*a->slotsCount;
+        uint32_t *in = a->live + (size_t)insn*a->localWords;
+        uint32_t *entry = bits + (size_t)entries*words;
+        memset(entry, 0, sizeof(uint32_t)*words);
+        for(int i=0;i<a->maxLocals;i++){
+            if(SLOT_REF==slots[i] && REFMAP_TEST(in, i)){
+                entry[i>>5] |= (uint32_t)1<<(i&31);
+            }
+        }
+        for(int i=a->maxLocals;i<a->maxLocals+a->depths[insn];i++){
+            if(SLOT_REF==slots[i]){
+                entry[i>>5] |= (uint32_t)1<<(i&31);
+            }
+        }
+        depths[entries] = (uint16_t)a->depths[insn];
+        if(0<entries && depths[entries-1]==depths[entries] && 0==memcmp(entry-words, entry, sizeof(uint32_t)*words)){
+            map->entries[a->pcs[insn]] = entries-1;
+            continue;
+        }
+        map->entries[a->pcs[insn]] = entries++;
+    }
+    map->depths = (uint16_t*)Heap_AllocPermanentAtomic(sizeof(uint16_t)*entries);
+    memcpy(map->depths, depths, sizeof(uint16_t)*entries);
+    map->bits = (uint32_t*)Heap_AllocPermanentAtomic(sizeof(uint32_t)*words*entries);
+    memcpy(map->bits, bits, sizeof(uint32_t)*words*entries);
+    Heap_Free(bits);
+    Heap_Free(depths);
+    return map;
+}
+
+RefMap* RefMap_Compute(Method *method){
+    Analysis a;
+    RefMap *map = NULL;
+    if(NULL==method->code || 0==method->codeLength){
+        return NULL;
+    }
+    a.method = method;
+    a.constantPool = method->class->classfile->constant_pool;
+    a.constantPoolCount = method->class->classfile->constant_pool_count;
+    // the class file code, the VM may execute a rewritten copy of it
+    a.code = method->codeAttribute->code;
+    a.codeLength = method->codeLength;
+    a.maxLocals = method->maxLocals;
+    a.maxStack = method->maxStack;
+    a.slotsCount = method->maxLocals+method->maxStack;
+    a.localWords = (method->maxLocals+31)/32;
+    if(0==a.localWords){
+        a.localWords = 1;
+    }
+    a.index = (uint32_t*)Heap_AllocAtomic(sizeof(uint32_t)*a.codeLength);
+    a.pcs = (uint32_t*)Heap_AllocAtomic(sizeof(uint32_t)*a.codeLength);
+    if(0!=findInstructions(&a)){
+        goto done;
+    }
+    a.states = (uint8_t*)Heap_AllocAtomic((size_t)a.count*a.slotsCount+1);
+    a.depths = (int32_t*)Heap_AllocAtomic(sizeof(int32_t)*a.count);
+    a.worklist = (uint32_t*)Heap_AllocAtomic(sizeof(uint32_t)*a.count);
+    a.queued = (uint8_t*)Heap_AllocAtomic(a.count);
+    a.live = (uint32_t*)Heap_AllocAtomic(sizeof(uint32_t)*a.localWords*a.count);
+    a.worklistSize = 0;
+    memset(a.queued, 0, a.count);
+    memset(a.live, 0, sizeof(uint32_t)*a.localWords*a.count);
+    for(uint32_t i=0;i<a.count;i++){
+        a.depths[i] = -1;
+    }
+    if(0==forward(&a)){
+        backward(&a);
+        map = build(&a);
+    }
+    Heap_Free(a.states);
+    Heap_Free(a.depths);
+    Heap_Free(a.worklist);
+    Heap_Free(a.queued);
+    Heap_Free(a.live);
+done:
+    Heap_Free(a.index);
+    Heap_Free(a.pcs);
+    return map;
+}
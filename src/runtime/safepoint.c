@@ -0,0 +1,151 @@
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <sched.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "slog.h"
+
+#define INCLUDE_RUNTIME_SAFEPOINT_SELF 1
+#include "runtime/safepoint.h"
+#include "runtime/thread.h"
+#include "runtime/futex.h"
+#include "runtime/nullcheck.h"
+#include "utils.h"
+
+volatile uint8_t *Safepoint_PollPage = NULL;
+int32_t Safepoint_Active = 0;
+int32_t Safepoint_Reached = 0;
+
+static size_t pollPageSize;
+// bumped when an operation ends, blocked threads sleep on it
+static int32_t safepointEpoch = 0;
+static pthread_mutex_t safepointLock = PTHREAD_MUTEX_INITIALIZER;
+static int32_t ownerState; // of the thread running the operation, guarded by safepointLock
+static SafepointStats stats;
+static struct sigaction previousAction;
+
+static uint64_t monotonicNanos(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec*1000000000+now.tv_nsec;
+}
+
+void Safepoint_Block(Thread *thread){
+    SAFEPOINT_SAVE_CONTEXT(thread);
+    do{
+        int32_t epoch = __atomic_load_n(&safepointEpoch, __ATOMIC_ACQUIRE);
+        __atomic_store_n(&thread->state, CONST_THREAD_STATE_BLOCKED, __ATOMIC_SEQ_CST);
+        while(__atomic_load_n(&Safepoint_Active, __ATOMIC_SEQ_CST) && epoch==__atomic_load_n(&safepointEpoch, __ATOMIC_ACQUIRE)){
+            Futex_Wait(&safepointEpoch, epoch, NULL);
+        }
+        __atomic_store_n(&thread->state, CONST_THREAD_STATE_JAVA, __ATOMIC_SEQ_CST);
+        // another operation may have started right after this one
+    }while(__atomic_load_n(&Safepoint_Active, __ATOMIC_SEQ_CST));
+}
+
+// the poll faults while the page is armed, the load is retried on return;
+// null dereferences of bytecode unwind to the interpreter
+static void onSegv(int sig, siginfo_t *info, void *context){
+    uint8_t *addr = (uint8_t*)info->si_addr;
+    Thread *thread = Thread_Current();
+    if(NULL!=thread && addr>=Safepoint_PollPage && addr<Safepoint_PollPage+pollPageSize){
+        Safepoint_Block(thread);
+        return;
+    }
+    NullCheck_Trap(thread, addr, context);
+    if(previousAction.sa_flags & SA_SIGINFO){
+        previousAction.sa_sigaction(sig, info, context);
+        return;
+    }
+    if(SIG_IGN==previousAction.sa_handler){
+        return;
+    }
+    if(SIG_DFL==previousAction.sa_handler){
+        // fault again, this time fatally
+        signal(sig, SIG_DFL);
+        return;
+    }
+    previousAction.sa_handler(sig);
+}
+
+int Safepoint_Init(void){
+    struct sigaction action;
+    pollPageSize = (size_t)sysconf(_SC_PAGESIZE);
+    void *page = mmap(NULL, pollPageSize, PROT_READ, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if(MAP_FAILED==page){
+        error("Unable to map the safepoint polling page.");
+        return -1;
+    }
+    Safepoint_PollPage = (volatile uint8_t*)page;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = onSegv;
+    action.sa_flags = SA_SIGINFO|SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if(0!=sigaction(SIGSEGV, &action, &previousAction)){
+        error("Unable to install the safepoint signal handler.");
+        return -1;
+    }
+    return 0;
+}
+
+typedef struct{
+    Thread *self;
+    int pending;
+} StopContext;
+
+static void checkStopped(Thread *thread, void *data){
+    StopContext *context = (StopContext*)data;
+    if(thread!=context->self && CONST_THREAD_STATE_JAVA==__atomic_load_n(&thread->state, __ATOMIC_SEQ_CST)){
+        context->pending = 1;
+    }
+}
+
+void Safepoint_Begin(void){
+    Thread *self = Thread_Current();
+    int32_t state;
+    // safe while queued behind another operation
+    SAFEPOINT_ENTER_NATIVE(self, state);
+    pthread_mutex_lock(&safepointLock);
+    ownerState = state;
+    uint64_t start = monotonicNanos();
+    __atomic_store_n(&Safepoint_Active, 1, __ATOMIC_SEQ_CST);
+    mprotect((void*)Safepoint_PollPage, pollPageSize, PROT_NONE);
+    StopContext context = {self, 1};
+    while(context.pending){
+        context.pending = 0;
+        Thread_ForEach(checkStopped, &context);
+        if(context.pending){
+            sched_yield();
+        }
+    }
+    __atomic_store_n(&Safepoint_Reached, 1, __ATOMIC_RELEASE);
+    uint64_t elapsed = monotonicNanos()-start;
+    stats.count++;
+    stats.totalNanos += elapsed;
+    stats.lastNanos = elapsed;
+    if(elapsed>stats.maxNanos){
+        stats.maxNanos = elapsed;
+    }
+    slog(0, SLOG_DEBUG, "Safepoint #%lu reached in %lu ns.", (unsigned long)stats.count, (unsigned long)elapsed);
+}
+
+void Safepoint_End(void){
+    Thread *self = Thread_Current();
+    __atomic_store_n(&Safepoint_Reached, 0, __ATOMIC_RELEASE);
+    mprotect((void*)Safepoint_PollPage, pollPageSize, PROT_READ);
+    __atomic_store_n(&Safepoint_Active, 0, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&safepointEpoch, 1, __ATOMIC_RELEASE);
+    Futex_Wake(&safepointEpoch, INT32_MAX);
+    int32_t state = ownerState;
+    pthread_mutex_unlock(&safepointLock);
+    Safepoint_LeaveNative(self, state);
+}
+
+void Safepoint_GetStats(SafepointStats *out){
+    pthread_mutex_lock(&safepointLock);
+    *out = stats;
+    pthread_mutex_unlock(&safepointLock);
+}
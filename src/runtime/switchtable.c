@@ -0,0 +1,259 @@
+#include <stdint.h>
+#include <string.h>
+
+#define INCLUDE_RUNTIME_SWITCHTABLE_SELF 1
+#include "runtime/switchtable.h"
+#include "runtime/method.h"
+#include "runtime/heap.h"
+#include "runtime/opcode.h"
+#include "classfile/op.h"
+#include "utils.h"
+
+// multiplier pairs tried before the binary search stays
+#define HASH_ATTEMPTS  8
+
+static int32_t readS32(uint8_t *p){
+    return (int32_t)((uint32_t)p[0]<<24 | (uint32_t)p[1]<<16 | (uint32_t)p[2]<<8 | p[3]);
+}
+
+static void decodeTable(Switch *s, uint8_t *operands){
+    int32_t high = readS32(operands+8);
+    s->kind = CONST_SWITCH_DENSE;
+    s->low = readS32(operands+4);
+    s->count = (uint32_t)((int64_t)high-s->low+1);
+    s->offsets = (int32_t*)Heap_AllocPermanentAtomic(sizeof(int32_t)*s->count);
+    for(uint32_t i=0;i<s->count;i++){
+        s->offsets[i] = readS32(operands+12+4*i);
+    }
+}
+
+static uint32_t nextMultiplier(uint32_t *seed){
+    // xorshift, odd multipliers only
+    *seed ^= *seed<<13;
+    *seed ^= *seed>>17;
+    *seed ^= *seed<<5;
+    return *seed|1;
+}
+
+// Hash and displace: the keys are split in buckets, and buckets are placed
+// biggest first, each with the first displacement moving all of its keys to
+// free slots. Fails when two keys of a bucket share their slot hash.
+static int displace(Switch *s, uint32_t *order, uint32_t *bucketStarts, uint8_t *used){
+    uint32_t size = (uint32_t)1<<(32-s->shift);
+    uint32_t buckets = (uint32_t)1<<(32-s->bucketShift);
+    memset(bucketStarts, 0, sizeof(uint32_t)*(buckets+1));
+    for(uint32_t i=0;i<s->count;i++){
+        bucketStarts[((uint32_t)s->keys[i]*s->bucketMultiplier)>>s->bucketShift]++;
+    }
+    // counting sort of the keys by bucket, buckets visited by decreasing size
+    uint32_t largest = 0;
+    for(uint32_t b=0,total=0;b<=buckets;b++){
+        uint32_t keys = bucketStarts[b];
+        bucketStarts[b] = total;
+        total += keys;
+        largest = keys>largest ? keys : largest;
+    }
+    uint32_t *cursor = order+s->count;
+    memcpy(cursor, bucketStarts, sizeof(uint32_t)*buckets);
+    for(uint32_t i=0;i<s->count;i++){
+        order[cursor[((uint32_t)s->keys[i]*s->bucketMultiplier)>>s->bucketShift]++] = i;
+    }
+    memset(used, 0, size);
+    for(uint32_t bucketSize=largest;0<bucketSize;bucketSize--){
+        for(uint32_t b=0;b<buckets;b++){
+            if(bucketSize!=bucketStarts[b+1]-bucketStarts[b]){
+                continue;
+            }
+            uint32_t d;
+            for(d=0;d<size;d++){
+                uint32_t i;
+                for(i=bucketStarts[b];i<bucketStarts[b+1];i++){
+                    uint32_t slot = ((((uint32_t)s->keys[order[i]]*s->multiplier)>>s->shift)+d)&(size-1);
+                    if(used[slot]){
+                        break;
+                    }
+                    used[slot] = 1;
+                }
+                if(i==bucketStarts[b+1]){
+                    break;
+                }
+                // releases the slots taken by the failed displacement
+                for(uint32_t j=bucketStarts[b];j<i;j++){
+                    used[((((uint32_t)s->keys[order[j]]*s->multiplier)>>s->shift)+d)&(size-1)] = 0;
+                }
+            }
+            if(d==size){
+                return -1;
+            }
+            s->displacements[b] = d;
+        }
+    }
+    return 0;
+}
+
+static void hashKeys(Switch *s){
+    uint8_t bits = 1;
+    while(((uint32_t)1<<bits)<2*s->count){
+        bits++;
+    }
+    uint8_t bucketBits = bits-2;
+    uint32_t size = (uint32_t)1<<bits;
+    uint32_t buckets = (uint32_t)1<<bucketBits;
+    uint32_t *order = (uint32_t*)Heap_AllocAtomic(sizeof(uint32_t)*(s->count+buckets));
+    uint32_t *bucketStarts = (uint32_t*)Heap_AllocAtomic(sizeof(uint32_t)*(buckets+1));
+    uint8_t *used = (uint8_t*)Heap_AllocAtomic(size);
+    s->displacements = (uint32_t*)Heap_AllocPermanentAtomic(sizeof(uint32_t)*buckets);
+    s->shift = (uint8_t)(32-bits);
+    s->bucketShift = (uint8_t)(32-bucketBits);
+    uint32_t seed = 0x9E3779B9;
+    int found = 0;
+    for(int attempt=0;attempt<HASH_ATTEMPTS && !found;attempt++){
+        s->multiplier = nextMultiplier(&seed);
+        s->bucketMultiplier = nextMultiplier(&seed);
+        found = 0==displace(s, order, bucketStarts, used);
+    }
+    Heap_Free(order);
+    Heap_Free(bucketStarts);
+    Heap_Free(used);
+    if(!found){
+        Heap_Free(s->displacements);
+        s->displacements = NULL;
+        return;
+    }
+    int32_t *keys = (int32_t*)Heap_AllocPermanentAtomic(sizeof(int32_t)*size);
+    int32_t *offsets = (int32_t*)Heap_AllocPermanentAtomic(sizeof(int32_t)*size);
+    for(uint32_t i=0;i<size;i++){
+        offsets[i] = s->defaultOffset;
+    }
+    for(uint32_t i=0;i<s->count;i++){
+        uint32_t slot = SWITCH_HASH_SLOT(s, s->keys[i]);
+        keys[slot] = s->keys[i];
+        offsets[slot] = s->offsets[i];
+    }
+    Heap_Free(s->keys);
+    Heap_Free(s->offsets);
+    s->kind = CONST_SWITCH_HASHED;
+    s->count = size;
+    s->keys = keys;
+    s->offsets = offsets;
+}
+
+static int decodeLookup(Switch *s, uint8_t *operands){
+    int32_t count = readS32(operands+4);
+    uint8_t *pairs = operands+8;
+    for(int32_t i=1;i<count;i++){
+        if(readS32(pairs+8*i)<=readS32(pairs+8*(i-1))){
+            return -1;
+        }
+    }
+    s->count = (uint32_t)count;
+    // keys spread over less than twice their count cost less as a table
+    if(0<count && (int64_t)readS32(pairs+8*(count-1))-readS32(pairs)<2*(int64_t)count){
+        s->kind = CONST_SWITCH_DENSE;
+        s->low = readS32(pairs);
+        s->count = (uint32_t)((int64_t)readS32(pairs+8*(count-1))-s->low+1);
+        s->offsets = (int32_t*)Heap_AllocPermanentAtomic(sizeof(int32_t)*s->count);
+        for(uint32_t i=0;i<s->count;i++){
+            s->offsets[i] = s->defaultOffset;
+        }
+        for(int32_t i=0;i<count;i++){
+            s->offsets[readS32(pairs+8*i)-s->low] = readS32(pairs+8*i+4);
+        }
+        return 0;
+    }
+    s->kind = CONST_SWITCH_SORTED;
+    s->keys = (int32_t*)Heap_AllocPermanentAtomic(sizeof(int32_t)*(0==count ? 1 : count));
+    s->offsets = (int32_t*)Heap_AllocPermanentAtomic(sizeof(int32_t)*(0==count ? 1 : count));
+    for(int32_t i=0;i<count;i++){
+        s->keys[i] = readS32(pairs+8*i);
+        s->offsets[i] = readS32(pairs+8*i+4);
+    }
+    if(s->count>CONST_SWITCH_HASH_THRESHOLD){
+        hashKeys(s);
+    }
+    return 0;
+}
+
+int SwitchTable_Init(Method *method){
+    uint8_t *code = method->codeAttribute->code;
+    uint32_t codeLength = method->codeLength;
+    uint16_t count = 0;
+    method->switches = NULL;
+    for(uint32_t pc=0;pc<codeLength;pc+=(uint32_t)Opcode_Length(code, codeLength, pc)){
+        count += CONST_OPCODE_TABLESWITCH==code[pc] || CONST_OPCODE_LOOKUPSWITCH==code[pc];
+    }
+    if(0==count){
+        return 0;
+    }
+    SwitchTable *table = (SwitchTable*)Heap_AllocPermanent(sizeof(SwitchTable));
+    table->count = count;
+    table->switches = (Switch*)Heap_AllocPermanent(sizeof(Switch)*count);
+    memset(table->switches, 0, sizeof(Switch)*count);
+    Switch *s = table->switches;
+    for(uint32_t pc=0;pc<codeLength;pc+=(uint32_t)Opcode_Length(code, codeLength, pc)){
+        if(CONST_OPCODE_TABLESWITCH!=code[pc] && CONST_OPCODE_LOOKUPSWITCH!=code[pc]){
+            continue;
+        }
+        // operands start after the padding, aligned on the start of the code
+        uint8_t *operands = code+((pc+4)&~(uint32_t)3);
+        s->pc = pc;
+        s->defaultOffset = readS32(operands);
+        if(CONST_OPCODE_TABLESWITCH==code[pc]){
+            if(readS32(operands+8)<readS32(operands+4)){
+                error("VerifyError. tableswitch at %u in %s has high below low.", pc, method->name);
+                return -1;
+            }
+            decodeTable(s, operands);
+        }else if(0>readS32(operands+4)){
+            error("VerifyError. lookupswitch at %u in %s has a negative npairs.", pc, method->name);
+            return -1;
+        }else if(0!=decodeLookup(s, operands)){
+            error("VerifyError. lookupswitch at %u in %s has unsorted keys.", pc, method->name);
+            return -1;
+        }
+        s++;
+    }
+    method->switches = table;
+    return 0;
+}
+
+static Switch* findSwitch(SwitchTable *table, uint32_t pc){
+    uint32_t low = 0;
+    uint32_t high = table->count;
+    while(low<high){
+        uint32_t middle = (low+high)/2;
+        if(table->switches[middle].pc<pc){
+            low = middle+1;
+        }else{
+            high = middle;
+        }
+    }
+    return &table->switches[low];
+}
+
+int32_t SwitchTable_Offset(SwitchTable *table, uint32_t pc, int32_t key){
+    Switch *s = 1==table->count ? table->switches : findSwitch(table, pc);
+    switch(s->kind){
+        case CONST_SWITCH_DENSE:{
+            uint32_t index = (uint32_t)key-(uint32_t)s->low;
+            return index<s->count ? s->offsets[index] : s->defaultOffset;
+        }
+        case CONST_SWITCH_HASHED:{
+            uint32_t slot = SWITCH_HASH_SLOT(s, key);
+            return key==s->keys[slot] ? s->offsets[slot] : s->defaultOffset;
+        }
+        default:{
+            uint32_t low = 0;
+            uint32_t high = s->count;
+            while(low<high){
+                uint32_t middle = (low+high)/2;
+                if(s->keys[middle]<key){
+                    low = middle+1;
+                }else{
+                    high = middle;
+                }
+            }
+            return low<s->count && key==s->keys[low] ? s->offsets[low] : s->defaultOffset;
+        }
+    }
+}
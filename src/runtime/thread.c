@@ -1,21 +1,103 @@
-#include "gc.h"
+#include <stdint.h>
+#include <time.h>
 
 #define INCLUDE_RUNTIME_THREAD_SELF 1
 
 #include "runtime/thread.h"
 #include "runtime/frame.h"
+#include "runtime/heap.h"
+#include "runtime/monitor.h"
+#include "runtime/futex.h"
+#include "runtime/safepoint.h"
+#include "gc.h"
 #include "utils.h"
 
 #define DEFAULT_MAX_STACK_SIZE 1024
 
+// push-only and lock-free, collectors walk it while the world is stopped
+static Thread *threads = NULL;
+static uint32_t lastThreadId = 0;
+static __thread Thread *currentThread = NULL;
+
 Thread* Thread_New(unsigned int stackSize){
-    Thread * thread = (Thread*)GC_malloc(sizeof(Thread));
+    // threads are roots for the collectors, keep them out of collectable memory
+    Thread * thread = (Thread*)Heap_AllocPermanent(sizeof(Thread));
+    thread->id = __atomic_add_fetch(&lastThreadId, 1, __ATOMIC_RELAXED);
+    if(thread->id>CONST_LOCK_MAX_OWNER){
+        error("[FIXME] too many threads for thin locks.");
+        return NULL;
+    }
     thread->stack = Stack_New(stackSize);
     thread->pc = NULL;
+    thread->javaBase = NULL;
+    thread->exception = NULL;
+    thread->aborted = 0;
+    thread->nullTrap = NULL;
+    thread->next = __atomic_load_n(&threads, __ATOMIC_ACQUIRE);
+    while(!__atomic_compare_exchange_n(&threads, &thread->next, thread, 1, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE));
     return thread;    
 }
 
+Thread* Thread_Current(void){
+    return currentThread;
+}
+
+void Thread_SetCurrent(Thread *thread){
+    struct GC_stack_base base;
+    currentThread = thread;
+    if(NULL!=thread && GC_SUCCESS==GC_get_stack_base(&base)){
+        thread->stackBase = base.mem_base;
+    }
+}
+
+void Thread_Park(Thread *thread, int64_t nanos){
+    int32_t permit = 1;
+    if(__atomic_compare_exchange_n(&thread->parkWord, &permit, 0, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)){
+        return;
+    }
+    int32_t none = 0;
+    if(!__atomic_compare_exchange_n(&thread->parkWord, &none, -1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)){
+        // unparked in between
+        __atomic_store_n(&thread->parkWord, 0, __ATOMIC_RELAXED);
+        return;
+    }
+    int32_t state;
+    // asleep is as good as stopped for a safepoint
+    SAFEPOINT_ENTER_NATIVE(thread, state);
+    if(0<nanos){
+        struct timespec timeout = {nanos/1000000000, nanos%1000000000};
+        Futex_Wait(&thread->parkWord, -1, &timeout);
+    }else{
+        Futex_Wait(&thread->parkWord, -1, NULL);
+    }
+    Safepoint_LeaveNative(thread, state);
+    // consume the permit, or step down after a timeout
+    __atomic_exchange_n(&thread->parkWord, 0, __ATOMIC_ACQUIRE);
+}
+
+void Thread_Unpark(Thread *thread){
+    if(-1==__atomic_exchange_n(&thread->parkWord, 1, __ATOMIC_RELEASE)){
+        Futex_Wake(&thread->parkWord, 1);
+    }
+}
+
+void Thread_Interrupt(Thread *thread){
+    __atomic_store_n(&thread->interrupted, 1, __ATOMIC_RELEASE);
+    Thread_Unpark(thread);
+}
+
+int Thread_Interrupted(Thread *thread){
+    return __atomic_exchange_n(&thread->interrupted, 0, __ATOMIC_ACQ_REL);
+}
+
+void Thread_ForEach(void (*fn)(Thread *thread, void *data), void *data){
+    for(Thread *thread=__atomic_load_n(&threads, __ATOMIC_ACQUIRE);NULL!=thread;thread=thread->next){
+        fn(thread, data);
+    }
+}
+
 int Thread_PushFrame(Thread *thread, Frame *frame){
+    frame->thread = thread;
     return Stack_Push(thread->stack, frame);    
 }
 
@@ -28,8 +110,8 @@ Frame* Thread_CurrentFrame(Thread *thread){
 }
 
 Stack* Stack_New(unsigned int stackSize){
-    Stack* stack = (Stack*)GC_malloc(sizeof(Stack));
-    stack->maxsize = stackSize;
+    Stack* stack = (Stack*)Heap_Alloc(sizeof(Stack));
+    stack->maxSize = stackSize;
     stack->size = 0;
     stack->_top = NULL;
    return stack; 
@@ -43,8 +125,9 @@ int Stack_Push(Stack *stack, Frame *frame){
     if(NULL!=stack->_top){
         frame->lower = stack->_top;
     }
-    stack._top = frame;
+    stack->_top = frame;
     stack->size++;
+    return 0;
 }
 
 Frame* Stack_Pop(Stack *stack){
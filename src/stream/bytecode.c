@@ -1,7 +1,8 @@
 #include "stream.h"
 #include <stdio.h>
+#include <string.h>
 #include "slog.h"
-#include "gc.h"
+#include "runtime/heap.h"
 
 
 typedef struct{
@@ -13,7 +14,10 @@ typedef struct{
 
 static int bytecode_readUint8(Stream *stream, uint8_t *ptr){
     BytecodeReader *bytecodeReader = ((BytecodeReader*)stream->data);
-    *ptr=bytecodeReader->code[bytecodeReader->code_len++];
+    if(bytecodeReader->pc>=bytecodeReader->code_len){
+        return EOF;
+    }
+    *ptr=bytecodeReader->code[bytecodeReader->pc++];
     return 1;
 }
 
@@ -39,8 +43,14 @@ static int bytecode_readUint64(Stream *stream, uint64_t *ptr){
     return EOF;
 }
 
-static int bytecode_readBytes(Stream *stream,uint32_t size, uint8_t *ptr){
-    return EOF;
+static int bytecode_readBytes(Stream *stream,unsigned int size, uint8_t *ptr){
+    BytecodeReader *bytecodeReader = ((BytecodeReader*)stream->data);
+    if(bytecodeReader->pc+size>bytecodeReader->code_len){
+        return EOF;
+    }
+    memcpy(ptr, bytecodeReader->code+bytecodeReader->pc, size);
+    bytecodeReader->pc += size;
+    return size;
 }
 
 static long int bytecode_position(Stream *stream){
@@ -48,8 +58,10 @@ static long int bytecode_position(Stream *stream){
     return bytecodeReader->pc;
 }
 
-static int bytecode_skip(Stream *stream,long offset){
-    return 0;
+static long int bytecode_skip(Stream *stream,long offset){
+    BytecodeReader *bytecodeReader = ((BytecodeReader*)stream->data);
+    bytecodeReader->pc += offset;
+    return bytecodeReader->pc;
 }
 
 static int bytecode_reset(Stream *stream){
@@ -59,10 +71,10 @@ static int bytecode_reset(Stream *stream){
 }
 
 static StreamReaderOp* newBytecodeReaderOp(){
-    StreamReaderOp* op = (StreamReaderOp*)GC_malloc(sizeof(StreamReaderOp));
+    StreamReaderOp* op = (StreamReaderOp*)Heap_Alloc(sizeof(StreamReaderOp));
     op->ReadUint8 = bytecode_readUint8;
     op->ReadUint16 = bytecode_readUint16;
-    op->ReadUint32 = bytecode_readUint16;
+    op->ReadUint32 = bytecode_readUint32;
     op->ReadUint64 = bytecode_readUint64;
     op->ReadBytes = bytecode_readBytes;
     op->Position = bytecode_position;    
@@ -72,14 +84,20 @@ static StreamReaderOp* newBytecodeReaderOp(){
 }
 
 Stream* BytecodeReader_New(uint8_t *code, uint64_t code_len, uint64_t pc){
-    Stream *stream = (Stream *)GC_malloc(sizeof(Stream));
+    Stream *stream = (Stream *)Heap_Alloc(sizeof(Stream));
     stream->reader = newBytecodeReaderOp();
     stream->writer = NULL;
-    BytecodeReader* bytecodeReader = (BytecodeReader *)GC_malloc(sizeof(BytecodeReader));
+    BytecodeReader* bytecodeReader = (BytecodeReader *)Heap_Alloc(sizeof(BytecodeReader));
     stream->data = bytecodeReader;
     ((BytecodeReader*)stream->data)->code = code;   
     ((BytecodeReader*)stream->data)->code_len = code_len;
     ((BytecodeReader*)stream->data)->pc = pc;
+    return stream;
 }
 
-
+void BytecodeReader_Rebind(Stream *stream, uint8_t *code, uint64_t code_len, uint64_t pc){
+    BytecodeReader *bytecodeReader = ((BytecodeReader*)stream->data);
+    bytecodeReader->code = code;
+    bytecodeReader->code_len = code_len;
+    bytecodeReader->pc = pc;
+}
@@ -1,7 +1,7 @@
 #include "stream.h"
 #include <stdio.h>
 #include "slog.h"
-#include "gc.h"
+#include "runtime/heap.h"
 
 
 typedef struct{
@@ -99,7 +99,7 @@ static int filestream_reset(Stream *stream){
 }
 
 static StreamReaderOp* newFileStreamReaderOp(){
-    StreamReaderOp* op = (StreamReaderOp*)GC_malloc(sizeof(StreamReaderOp));
+    StreamReaderOp* op = (StreamReaderOp*)Heap_Alloc(sizeof(StreamReaderOp));
     op->ReadUint8 = filestream_readUint8;
     op->ReadUint16 = filestream_readUint16;
     op->ReadUint32 = filestream_readUint16;
@@ -116,10 +116,10 @@ Stream* FileReader_New(char* filepath){
         slog(0, SLOG_ERROR, "Unable to open file for reading");
         return NULL;
     }
-    Stream *stream = (Stream *)GC_malloc(sizeof(Stream));
+    Stream *stream = (Stream *)Heap_Alloc(sizeof(Stream));
     stream->reader = newFileStreamReaderOp();
     stream->writer = NULL;
-    FileStream* filestream = (FileStream *)GC_malloc(sizeof(FileStream));
+    FileStream* filestream = (FileStream *)Heap_Alloc(sizeof(FileStream));
     stream->data = filestream;
     ((FileStream*)stream->data)->filepath = filepath;   
     ((FileStream*)stream->data)->fp = fp;   
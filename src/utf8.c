@@ -0,0 +1,220 @@
+#include <stdint.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define UTF8_X86 1
+#endif
+
+#define INCLUDE_UTF8_H_SELF 1
+#include "utf8.h"
+
+typedef struct{
+    char *name;
+    // length of the leading run of ASCII bytes, a 0x00 byte ends it too
+    uint32_t (*AsciiSpan) (const uint8_t *bytes, uint32_t size);
+    // zero extend size ASCII bytes to UTF-16
+    void (*WidenAscii) (const uint8_t *bytes, uint32_t size, uint16_t *out);
+} UTF8Op;
+
+static uint32_t scalar_asciiSpan(const uint8_t *bytes, uint32_t size){
+    uint32_t i = 0;
+    while(i<size && 0<bytes[i] && bytes[i]<0x80){
+        i++;
+    }
+    return i;
+}
+
+static void scalar_widenAscii(const uint8_t *bytes, uint32_t size, uint16_t *out){
+    for(uint32_t i=0;i<size;i++){
+        out[i] = bytes[i];
+    }
+}
+
+static UTF8Op scalarUTF8Op = {
+    "scalar",
+    scalar_asciiSpan,
+    scalar_widenAscii
+};
+
+#ifdef UTF8_X86
+
+__attribute__((target("sse2")))
+static uint32_t sse2_asciiSpan(const uint8_t *bytes, uint32_t size){
+    const __m128i zero = _mm_setzero_si128();
+    uint32_t i = 0;
+    for(;i+16<=size;i+=16){
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(bytes+i));
+        int mask = _mm_movemask_epi8(chunk) | _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, zero));
+        if(0!=mask){
+            return i+__builtin_ctz(mask);
+        }
+    }
+    return i+scalar_asciiSpan(bytes+i, size-i);
+}
+
+__attribute__((target("sse2")))
+static void sse2_widenAscii(const uint8_t *bytes, uint32_t size, uint16_t *out){
+    const __m128i zero = _mm_setzero_si128();
+    uint32_t i = 0;
+    for(;i+16<=size;i+=16){
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(bytes+i));
+        _mm_storeu_si128((__m128i*)(out+i), _mm_unpacklo_epi8(chunk, zero));
+        _mm_storeu_si128((__m128i*)(out+i+8), _mm_unpackhi_epi8(chunk, zero));
+    }
+    scalar_widenAscii(bytes+i, size-i, out+i);
+}
+
+__attribute__((target("avx2")))
+static uint32_t avx2_asciiSpan(const uint8_t *bytes, uint32_t size){
+    const __m256i zero = _mm256_setzero_si256();
+    uint32_t i = 0;
+    for(;i+32<=size;i+=32){
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)(bytes+i));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(chunk) | (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, zero));
+        if(0!=mask){
+            return i+__builtin_ctz(mask);
+        }
+    }
+    return i+sse2_asciiSpan(bytes+i, size-i);
+}
+
+__attribute__((target("avx2")))
+static void avx2_widenAscii(const uint8_t *bytes, uint32_t size, uint16_t *out){
+    uint32_t i = 0;
+    for(;i+32<=size;i+=32){
+        __m128i low = _mm_loadu_si128((const __m128i*)(bytes+i));
+        __m128i high = _mm_loadu_si128((const __m128i*)(bytes+i+16));
+        _mm256_storeu_si256((__m256i*)(out+i), _mm256_cvtepu8_epi16(low));
+        _mm256_storeu_si256((__m256i*)(out+i+16), _mm256_cvtepu8_epi16(high));
+    }
+    sse2_widenAscii(bytes+i, size-i, out+i);
+}
+
+static UTF8Op sse2UTF8Op = {
+    "sse2",
+    sse2_asciiSpan,
+    sse2_widenAscii
+};
+
+static UTF8Op avx2UTF8Op = {
+    "avx2",
+    avx2_asciiSpan,
+    avx2_widenAscii
+};
+
+#endif
+
+static UTF8Op *utf8Op = NULL;
+
+// racing threads all pick the same kernel
+static UTF8Op* currentOp(void){
+    if(NULL!=utf8Op){
+        return utf8Op;
+    }
+    UTF8Op *op = &scalarUTF8Op;
+#ifdef UTF8_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")){
+        op = &avx2UTF8Op;
+    }else if(__builtin_cpu_supports("sse2")){
+        op = &sse2UTF8Op;
+    }
+#endif
+    utf8Op = op;
+    return op;
+}
+
+// decode the multi-byte sequence at bytes[*pos], -1 if malformed
+static int32_t decodeSequence(const uint8_t *bytes, uint32_t size, uint32_t *pos){
+    uint32_t i = *pos;
+    uint8_t byte1 = bytes[i];
+    if(0xC0==(byte1&0xE0)){
+        if(i+1>=size || 0x80!=(bytes[i+1]&0xC0)){
+            return -1;
+        }
+        *pos = i+2;
+        return (byte1&0x1F)<<6 | (bytes[i+1]&0x3F);
+    }
+    if(0xE0==(byte1&0xF0)){
+        if(i+2>=size || 0x80!=(bytes[i+1]&0xC0) || 0x80!=(bytes[i+2]&0xC0)){
+            return -1;
+        }
+        *pos = i+3;
+        return (byte1&0x0F)<<12 | (bytes[i+1]&0x3F)<<6 | (bytes[i+2]&0x3F);
+    }
+    // 0x00, a stray continuation byte or a 4 byte form
+    return -1;
+}
+
+int UTF8_Validate(const uint8_t *bytes, uint32_t size, uint32_t *length, uint8_t *latin1){
+    UTF8Op *op = currentOp();
+    uint32_t count = 0;
+    uint8_t fits = 1;
+    uint32_t i = 0;
+    while(i<size){
+        uint32_t span = op->AsciiSpan(bytes+i, size-i);
+        i += span;
+        count += span;
+        if(i>=size){
+            break;
+        }
+        int32_t c = decodeSequence(bytes, size, &i);
+        if(0>c){
+            return -1;
+        }
+        if(0xFF<c){
+            fits = 0;
+        }
+        count++;
+    }
+    if(NULL!=length){
+        *length = count;
+    }
+    if(NULL!=latin1){
+        *latin1 = fits;
+    }
+    return 0;
+}
+
+uint32_t UTF8_ToLatin1(const uint8_t *bytes, uint32_t size, uint8_t *out){
+    UTF8Op *op = currentOp();
+    uint32_t count = 0;
+    uint32_t i = 0;
+    while(i<size){
+        uint32_t span = op->AsciiSpan(bytes+i, size-i);
+        memcpy(out+count, bytes+i, span);
+        i += span;
+        count += span;
+        if(i>=size){
+            break;
+        }
+        out[count++] = (uint8_t)decodeSequence(bytes, size, &i);
+    }
+    return count;
+}
+
+uint32_t UTF8_ToUTF16(const uint8_t *bytes, uint32_t size, uint16_t *out){
+    UTF8Op *op = currentOp();
+    uint32_t count = 0;
+    uint32_t i = 0;
+    while(i<size){
+        uint32_t span = op->AsciiSpan(bytes+i, size-i);
+        op->WidenAscii(bytes+i, span, out+count);
+        i += span;
+        count += span;
+        if(i>=size){
+            break;
+        }
+        out[count++] = (uint16_t)decodeSequence(bytes, size, &i);
+    }
+    return count;
+}
+
+// modified UTF-8 never contains 0x00, so ascii ends exactly where bytes do
+int UTF8_EqualsASCII(const uint8_t *bytes, uint32_t size, const char *ascii){
+    return 0==strncmp((const char*)bytes, ascii, size) && 0==ascii[size];
+}
+
+char* UTF8_KernelName(void){
+    return currentOp()->name;
+}
@@ -1,9 +1,12 @@
 #include <stdint.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "slog.h"
 
 #define INCLUDE_UTILS_H_SELF 1
 #include "utils.h"
-
-#define IS_BIG_ENDIAN (*(uint16_t *)"\0\xff" < 0x100)
+#include "utf8.h"
 
 float ieee754_bin2float(uint32_t value){
     union{
@@ -41,31 +44,26 @@ uint64_t ieee754_double2bin(double value){
     return un.ivalue;
 }
 
-int utf8ascii_equals(uint8_t[] utf8, uint8_t[] ascii){
-    if(strlen(ascii)!=uft8_length(utf8)){
-        return 0;
-    }
-    if(!strcmp(ascii, utf8)){
-        return 1;
-    }
-    return 0;
+// constant pool strings are NUL terminated and modified UTF-8 has no 0x00
+// byte inside, a plain compare is exact
+uint32_t utf8ascii_equals(uint8_t utf8[], const char ascii[]){
+    return 0==strcmp((const char*)utf8, ascii);
 }
 
-int uft8_length(uint8_t[] utf8){
-    int i=0;
-    int count=0;
-    while(utf8[i]){
-        if((utf8[i]&0xc0)!= 0x80){
-            count++;
-        }
-        i++;
+// the java length in UTF-16 chars, 0 if malformed
+uint32_t utf8_length(uint8_t utf8[], uint32_t size){
+    uint32_t length = 0;
+    if(0>UTF8_Validate(utf8, size, &length, NULL)){
+        return 0;
     }
-    return count;
+    return length;
 }
 
 void error(char formatStr[], ...){
+    char message[1024];
     va_list args;
     va_start(args,formatStr);
-    slog(0, SLOG_ERROR, formatStr, args);
+    vsnprintf(message, sizeof(message), formatStr, args);
     va_end(args);
+    slog(0, SLOG_ERROR, "%s", message);
 }
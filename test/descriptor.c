@@ -0,0 +1,50 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "test.h"
+#include "runtime/descriptor.h"
+#include "runtime/heap.h"
+
+int main(void){
+    Heap_Init(CONST_HEAP_BACKEND_BDWGC, 0);
+
+    Descriptor *parsed = Descriptor_Get((uint8_t*)"(I[JLjava/lang/String;D[[Ljava/lang/Object;Z)J");
+    CHECK(NULL!=parsed);
+    CHECK_EQ(7, parsed->argSlots);
+    CHECK_EQ(6, parsed->argsCount);
+    CHECK(0==memcmp(parsed->argTypes, "ILLDLZ", 6));
+    CHECK_EQ('J', parsed->returnType);
+    CHECK_EQ(2, parsed->returnSlots);
+
+    Descriptor *none = Descriptor_Get((uint8_t*)"()V");
+    CHECK(NULL!=none);
+    CHECK_EQ(0, none->argSlots);
+    CHECK_EQ(0, none->argsCount);
+    CHECK_EQ('V', none->returnType);
+    CHECK_EQ(0, none->returnSlots);
+    CHECK_EQ('L', Descriptor_Get((uint8_t*)"()[I")->returnType);
+
+    // equal strings from different constant pools share one entry
+    char copy[] = "(I[JLjava/lang/String;D[[Ljava/lang/Object;Z)J";
+    CHECK(parsed==Descriptor_Get((uint8_t*)copy));
+    CHECK(parsed!=Descriptor_Get((uint8_t*)"(I[JLjava/lang/String;D[[Ljava/lang/Object;Z)I"));
+
+    CHECK(NULL==Descriptor_Get((uint8_t*)"I)V"));
+    CHECK(NULL==Descriptor_Get((uint8_t*)"(V)V"));
+    CHECK(NULL==Descriptor_Get((uint8_t*)"(L;)V"));
+    CHECK(NULL==Descriptor_Get((uint8_t*)"(Ljava/lang/String)V"));
+    CHECK(NULL==Descriptor_Get((uint8_t*)"([)V"));
+    CHECK(NULL==Descriptor_Get((uint8_t*)"(I)"));
+    CHECK(NULL==Descriptor_Get((uint8_t*)"(I)VV"));
+
+    // the JVMS limit of 255 parameter slots
+    char wide[300];
+    wide[0] = '(';
+    memset(wide+1, 'J', 128);
+    strcpy(wide+129, ")V");
+    CHECK(NULL==Descriptor_Get((uint8_t*)wide));
+    strcpy(wide+128, ")V");
+    CHECK(NULL!=Descriptor_Get((uint8_t*)wide));
+    CHECK_EQ(254, Descriptor_Get((uint8_t*)wide)->argSlots);
+    return Test_Result("descriptor");
+}
@@ -0,0 +1,67 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "test.h"
+#include "runtime/exception.h"
+#include "runtime/class.h"
+#include "runtime/method.h"
+#include "runtime/heap.h"
+
+#define NO_HANDLER  CONST_EXCEPTION_NO_HANDLER
+
+int main(void){
+    Heap_Init(CONST_HEAP_BACKEND_BDWGC, 0);
+    Class *base = Class_NewBuiltin((uint8_t*)"test/Base", 16, 0, NULL);
+    Class *derived = Class_NewProxy((uint8_t*)"test/Derived", base, NULL, 0, 16, 0, NULL, NULL, 0);
+    Class *other = Class_NewBuiltin((uint8_t*)"test/Other", 16, 0, NULL);
+
+    Attribute_Code attribute;
+    memset(&attribute, 0, sizeof(attribute));
+    CHECK(NULL==Exception_NewHandlerTable(&attribute));
+
+    // nested and overlapping ranges, inner handlers first as javac lays them out
+    ExceptionInfo infos[] = {
+        {10, 20, 100, 1}, // catches Derived
+        {10, 30, 110, 2}, // catches Base
+        {5, 40, 120, 0}, // finally
+        {50, 60, 130, 1},
+        {55, 70, 140, 2},
+    };
+    attribute.exception_table_length = sizeof(infos)/sizeof(infos[0]);
+    attribute.exception_table = infos;
+    HandlerTable *table = Exception_NewHandlerTable(&attribute);
+    CHECK(NULL!=table);
+    CHECK_EQ(5, table->handlersCount);
+    // 5 10 20 30 40 50 55 60 70
+    CHECK_EQ(8, table->intervalsCount);
+    // the catch types are resolved already, the method needs no constant pool
+    table->handlers[0].catchClass = derived;
+    table->handlers[1].catchClass = base;
+    table->handlers[3].catchClass = derived;
+    table->handlers[4].catchClass = base;
+
+    Method method;
+    memset(&method, 0, sizeof(method));
+    method.handlers = table;
+    CHECK_EQ(NO_HANDLER, Exception_FindHandler(&method, 4, derived));
+    CHECK_EQ(120, Exception_FindHandler(&method, 5, derived));
+    CHECK_EQ(100, Exception_FindHandler(&method, 10, derived));
+    CHECK_EQ(110, Exception_FindHandler(&method, 19, base));
+    CHECK_EQ(120, Exception_FindHandler(&method, 19, other));
+    CHECK_EQ(110, Exception_FindHandler(&method, 20, derived));
+    CHECK_EQ(120, Exception_FindHandler(&method, 30, derived));
+    CHECK_EQ(120, Exception_FindHandler(&method, 39, other));
+    CHECK_EQ(NO_HANDLER, Exception_FindHandler(&method, 40, derived));
+    CHECK_EQ(NO_HANDLER, Exception_FindHandler(&method, 49, derived));
+    CHECK_EQ(130, Exception_FindHandler(&method, 50, derived));
+    CHECK_EQ(NO_HANDLER, Exception_FindHandler(&method, 54, base));
+    CHECK_EQ(130, Exception_FindHandler(&method, 55, derived));
+    CHECK_EQ(140, Exception_FindHandler(&method, 55, base));
+    CHECK_EQ(140, Exception_FindHandler(&method, 69, derived));
+    CHECK_EQ(NO_HANDLER, Exception_FindHandler(&method, 69, other));
+    CHECK_EQ(NO_HANDLER, Exception_FindHandler(&method, 70, derived));
+
+    method.handlers = NULL;
+    CHECK_EQ(NO_HANDLER, Exception_FindHandler(&method, 10, derived));
+    return Test_Result("handlertable");
+}
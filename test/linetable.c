@@ -0,0 +1,52 @@
+#include <stdint.h>
+
+#include "test.h"
+#include "runtime/linetable.h"
+#include "runtime/heap.h"
+
+#define ENTRIES  100
+
+// the line of the last entry, in pc then table order, at or before pc
+static int32_t expectedLine(LineNumberTableEntry *entries, uint32_t count, uint32_t pc){
+    int32_t line = -1;
+    uint32_t best = 0;
+    for(uint32_t i=0;i<count;i++){
+        if(entries[i].start_pc<=pc && (-1==line || entries[i].start_pc>=best)){
+            best = entries[i].start_pc;
+            line = entries[i].line_number;
+        }
+    }
+    return line;
+}
+
+int main(void){
+    Heap_Init(CONST_HEAP_BACKEND_BDWGC, 0);
+
+    CHECK(NULL==LineTable_New(NULL, 0));
+    CHECK_EQ(-1, LineTable_Lookup(NULL, 0));
+
+    LineNumberTableEntry one[] = {{10, 7}};
+    LineTable *single = LineTable_New(one, 1);
+    CHECK_EQ(-1, LineTable_Lookup(single, 9));
+    CHECK_EQ(7, LineTable_Lookup(single, 10));
+    CHECK_EQ(7, LineTable_Lookup(single, 60000));
+
+    // unsorted, with duplicated pcs, pc gaps over one varint byte and
+    // decreasing lines, across several checkpoints
+    LineNumberTableEntry entries[ENTRIES];
+    uint32_t seed = 12345;
+    for(uint32_t i=0;i<ENTRIES;i++){
+        seed = seed*1103515245+12345;
+        entries[i].start_pc = (uint16_t)(5+(seed>>8)%20000);
+        entries[i].line_number = (uint16_t)(1+(seed>>4)%60000);
+    }
+    entries[17].start_pc = entries[3].start_pc;
+    entries[40].start_pc = entries[39].start_pc;
+    LineTable *table = LineTable_New(entries, ENTRIES);
+    CHECK_EQ(ENTRIES, table->count);
+    CHECK_EQ((ENTRIES+CONST_LINETABLE_BLOCK-1)/CONST_LINETABLE_BLOCK, table->checkpointsCount);
+    for(uint32_t pc=0;pc<20010;pc++){
+        CHECK_EQ(expectedLine(entries, ENTRIES, pc), LineTable_Lookup(table, pc));
+    }
+    return Test_Result("linetable");
+}
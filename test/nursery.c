@@ -0,0 +1,118 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "test.h"
+#include "runtime/heap.h"
+#include "runtime/object.h"
+#include "runtime/class.h"
+#include "runtime/thread.h"
+#include "runtime/frame.h"
+#include "runtime/safepoint.h"
+
+// Objects are only held hidden by the test, the C stack is scanned as an
+// ambiguous root and would pin whatever it still points to.
+#define HIDE(object)  (~(uintptr_t)(object))
+#define REVEAL(hidden)  ((Object*)~(hidden))
+
+#define NURSERY_SIZE  (1024*1024)
+
+typedef struct{
+    ObjectHeader header;
+    Ref next;
+} Node;
+
+static Class *nodeClass;
+
+typedef struct{
+    uintptr_t exception; // pending on the thread
+    uintptr_t local; // in an unmapped frame slot
+    uintptr_t reached; // from the pending exception only
+    uintptr_t remembered; // from an old object only
+    uintptr_t garbage;
+} Objects;
+
+static __attribute__((noinline)) void allocate(Thread *thread, Frame *frame, Object *old, Objects *objects){
+    Object *exception = Object_New(nodeClass);
+    Object *reached = Object_New(nodeClass);
+    Object *local = Object_New(nodeClass);
+    Object *remembered = Object_New(nodeClass);
+    Object *garbage = Object_New(nodeClass);
+    Object_PutRef(exception, offsetof(Node, next), reached);
+    Object_PutRef(old, offsetof(Node, next), remembered);
+    thread->exception = exception;
+    frame->localVars[0].ref = REF_ENCODE(local);
+    objects->exception = HIDE(exception);
+    objects->local = HIDE(local);
+    objects->reached = HIDE(reached);
+    objects->remembered = HIDE(remembered);
+    objects->garbage = HIDE(garbage);
+}
+
+// overwrites what allocate left below the stack pointer
+static __attribute__((noinline)) void scrubStack(void){
+    volatile uint8_t scratch[16*1024];
+    memset((void*)scratch, 0, sizeof(scratch));
+}
+
+static int isPinned(Object *object){
+    return 0!=(object->header.mark & CONST_HEADER_PINNED);
+}
+
+// the objects revealed here are held in a frame that is gone by the next collection
+static __attribute__((noinline)) void checkFirst(Thread *thread, Frame *frame, Object *old, Objects *objects){
+    // the pending exception is pinned in place, and what it holds survives
+    Object *exception = REVEAL(objects->exception);
+    CHECK(exception==thread->exception);
+    CHECK(nodeClass==exception->header.class);
+    CHECK(isPinned(exception));
+    Object *reached = (Object*)Object_GetRef(exception, offsetof(Node, next));
+    CHECK(NULL!=reached);
+    CHECK(REVEAL(objects->reached)!=reached);
+    CHECK(nodeClass==reached->header.class);
+    CHECK(REVEAL(objects->reached)->header.mark & CONST_HEADER_FORWARDED);
+
+    Object *local = REVEAL(objects->local);
+    CHECK(local==REF_DECODE(frame->localVars[0].ref));
+    CHECK(nodeClass==local->header.class);
+    CHECK(isPinned(local));
+
+    // promoted through the remembered set
+    Object *remembered = (Object*)Object_GetRef(old, offsetof(Node, next));
+    CHECK(NULL!=remembered);
+    CHECK(REVEAL(objects->remembered)!=remembered);
+    CHECK(nodeClass==remembered->header.class);
+
+    // shares the chunk of the pinned ones, left in place but not pinned
+    CHECK(!isPinned(REVEAL(objects->garbage)));
+    CHECK(!(REVEAL(objects->garbage)->header.mark & CONST_HEADER_FORWARDED));
+}
+
+int main(void){
+    CHECK_EQ(0, Heap_Init(CONST_HEAP_BACKEND_GENERATIONAL, NURSERY_SIZE));
+    CHECK_EQ(0, Safepoint_Init());
+    uint32_t refOffsets[] = {offsetof(Node, next)};
+    nodeClass = Class_NewBuiltin((uint8_t*)"test/Node", sizeof(Node), 1, refOffsets);
+    Thread *thread = Thread_New(16);
+    Thread_SetCurrent(thread);
+    // no reference map, its slots are ambiguous roots
+    Frame *frame = Frame_New(1, 1);
+    frame->thread = thread;
+    Thread_PushFrame(thread, frame);
+    Object *old = Object_NewOld(nodeClass);
+
+    Objects objects;
+    allocate(thread, frame, old, &objects);
+    scrubStack();
+    Heap_Collect();
+
+    checkFirst(thread, frame, old, &objects);
+
+    // a cleared exception no longer pins it
+    thread->exception = NULL;
+    frame->localVars[0].ref = REF_ENCODE(NULL);
+    scrubStack();
+    Heap_Collect();
+    CHECK(!isPinned(REVEAL(objects.exception)));
+    CHECK(!isPinned(REVEAL(objects.local)));
+    return Test_Result("nursery");
+}
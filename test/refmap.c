@@ -0,0 +1,102 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "test.h"
+#include "runtime/refmap.h"
+#include "runtime/method.h"
+#include "runtime/class.h"
+#include "runtime/heap.h"
+#include "runtime/opcode.h"
+
+static ClassFile classfile;
+static Class class;
+static Attribute_Code attribute;
+
+static RefMap* compute(Method *method, uint8_t *code, uint32_t length, char *descriptor, uint16_t maxLocals, uint16_t maxStack){
+    memset(method, 0, sizeof(Method));
+    memset(&attribute, 0, sizeof(attribute));
+    attribute.code = code;
+    attribute.code_length = length;
+    attribute.max_locals = maxLocals;
+    attribute.max_stack = maxStack;
+    class.classfile = &classfile;
+    method->class = &class;
+    method->name = (uint8_t*)"test";
+    method->descriptor = (uint8_t*)descriptor;
+    method->accessFlags = CONST_METHOD_ACCESS_STATIC;
+    method->codeAttribute = &attribute;
+    method->code = code;
+    method->codeLength = length;
+    method->maxLocals = maxLocals;
+    method->maxStack = maxStack;
+    method->argSlots = 2;
+    return RefMap_Compute(method);
+}
+
+static uint32_t* entryBits(RefMap *map, uint32_t pc){
+    return map->bits + (size_t)map->entries[pc]*map->words;
+}
+
+int main(void){
+    Heap_Init(CONST_HEAP_BACKEND_BDWGC, 0);
+    Method method;
+
+    // static void test(Object o, int i): p = o, then p loaded and dropped unless i is 0
+    uint8_t code[] = {
+        CONST_OPCODE_ALOAD_0, // 0
+        CONST_OPCODE_ASTORE_2, // 1
+        CONST_OPCODE_ILOAD_1, // 2
+        CONST_OPCODE_IFEQ, 0, 5, // 3, to 8
+        CONST_OPCODE_ALOAD_2, // 6
+        CONST_OPCODE_POP, // 7
+        CONST_OPCODE_RETURN, // 8
+    };
+    RefMap *map = compute(&method, code, sizeof(code), "(Ljava/lang/Object;I)V", 3, 1);
+    CHECK(NULL!=map);
+    CHECK_EQ(3, map->maxLocals);
+    CHECK_EQ(1, map->maxStack);
+    CHECK_EQ(CONST_REFMAP_NONE, map->entries[4]);
+    CHECK_EQ(CONST_REFMAP_NONE, map->entries[5]);
+    for(uint32_t pc=0;pc<sizeof(code);pc++){
+        if(4==pc || 5==pc){
+            continue;
+        }
+        CHECK(CONST_REFMAP_NONE!=map->entries[pc]);
+    }
+    // the argument is live until it is copied
+    uint32_t *bits = entryBits(map, 0);
+    CHECK(REFMAP_TEST(bits, 0));
+    CHECK(!REFMAP_TEST(bits, 1));
+    CHECK(!REFMAP_TEST(bits, 2));
+    CHECK_EQ(0, map->depths[map->entries[0]]);
+    // then dead, its copy on the stack
+    bits = entryBits(map, 1);
+    CHECK(!REFMAP_TEST(bits, 0));
+    CHECK(REFMAP_TEST(bits, 3));
+    CHECK_EQ(1, map->depths[map->entries[1]]);
+    // the copy is live on the path that loads it
+    CHECK(REFMAP_TEST(entryBits(map, 2), 2));
+    CHECK(REFMAP_TEST(entryBits(map, 3), 2));
+    CHECK(!REFMAP_TEST(entryBits(map, 3), 3));
+    CHECK(REFMAP_TEST(entryBits(map, 6), 2));
+    bits = entryBits(map, 7);
+    CHECK(!REFMAP_TEST(bits, 2));
+    CHECK(REFMAP_TEST(bits, 3));
+    bits = entryBits(map, 8);
+    CHECK(!REFMAP_TEST(bits, 0));
+    CHECK(!REFMAP_TEST(bits, 2));
+    CHECK_EQ(0, map->depths[map->entries[8]]);
+    // the int argument never is a reference
+    for(uint32_t pc=0;pc<sizeof(code);pc++){
+        if(CONST_REFMAP_NONE!=map->entries[pc]){
+            CHECK(!REFMAP_TEST(entryBits(map, pc), 1));
+        }
+    }
+
+    // code that does not verify has no map
+    uint8_t underflow[] = {CONST_OPCODE_POP, CONST_OPCODE_RETURN};
+    CHECK(NULL==compute(&method, underflow, sizeof(underflow), "(Ljava/lang/Object;I)V", 3, 1));
+    uint8_t subroutine[] = {CONST_OPCODE_JSR, 0, 3, CONST_OPCODE_RETURN};
+    CHECK(NULL==compute(&method, subroutine, sizeof(subroutine), "(Ljava/lang/Object;I)V", 3, 1));
+    return Test_Result("refmap");
+}
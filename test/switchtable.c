@@ -0,0 +1,135 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "test.h"
+#include "runtime/switchtable.h"
+#include "runtime/method.h"
+#include "runtime/heap.h"
+#include "runtime/opcode.h"
+
+#define HASHED_KEYS  40
+
+static uint8_t code[1024];
+static uint32_t length;
+
+static void emitS32(int32_t value){
+    code[length++] = (uint8_t)((uint32_t)value>>24);
+    code[length++] = (uint8_t)((uint32_t)value>>16);
+    code[length++] = (uint8_t)((uint32_t)value>>8);
+    code[length++] = (uint8_t)value;
+}
+
+static void emitSwitch(uint8_t opcode, int32_t defaultOffset){
+    code[length++] = opcode;
+    while(0!=length%4){
+        code[length++] = 0;
+    }
+    emitS32(defaultOffset);
+}
+
+static void emitLookup(int32_t defaultOffset, int32_t *keys, int32_t *offsets, int32_t count){
+    emitSwitch(CONST_OPCODE_LOOKUPSWITCH, defaultOffset);
+    emitS32(count);
+    for(int32_t i=0;i<count;i++){
+        emitS32(keys[i]);
+        emitS32(offsets[i]);
+    }
+}
+
+static int initMethod(Method *method, Attribute_Code *attribute){
+    memset(method, 0, sizeof(Method));
+    memset(attribute, 0, sizeof(Attribute_Code));
+    attribute->code = code;
+    attribute->code_length = length;
+    method->name = (uint8_t*)"test";
+    method->codeAttribute = attribute;
+    method->code = code;
+    method->codeLength = length;
+    return SwitchTable_Init(method);
+}
+
+int main(void){
+    Heap_Init(CONST_HEAP_BACKEND_BDWGC, 0);
+    Method method;
+    Attribute_Code attribute;
+
+    length = 0;
+    code[length++] = CONST_OPCODE_RETURN;
+    CHECK_EQ(0, initMethod(&method, &attribute));
+    CHECK(NULL==method.switches);
+
+    length = 0;
+    uint32_t tablePc = length;
+    emitSwitch(CONST_OPCODE_TABLESWITCH, 100);
+    emitS32(-2);
+    emitS32(2);
+    for(int32_t i=0;i<5;i++){
+        emitS32(10+i);
+    }
+    uint32_t sortedPc = length;
+    int32_t sortedKeys[] = {-1000, 5, 70000};
+    int32_t sortedOffsets[] = {1, 2, 3};
+    emitLookup(200, sortedKeys, sortedOffsets, 3);
+    uint32_t densePc = length;
+    int32_t denseKeys[] = {10, 11, 13, 14};
+    int32_t denseOffsets[] = {21, 22, 23, 24};
+    emitLookup(300, denseKeys, denseOffsets, 4);
+    uint32_t hashedPc = length;
+    int32_t hashedKeys[HASHED_KEYS];
+    int32_t hashedOffsets[HASHED_KEYS];
+    for(int32_t i=0;i<HASHED_KEYS;i++){
+        hashedKeys[i] = (i-HASHED_KEYS/2)*7919+i*i*31;
+        hashedOffsets[i] = 1000+i;
+    }
+    emitLookup(400, hashedKeys, hashedOffsets, HASHED_KEYS);
+    code[length++] = CONST_OPCODE_RETURN;
+    CHECK_EQ(0, initMethod(&method, &attribute));
+    SwitchTable *table = method.switches;
+    CHECK(NULL!=table);
+    CHECK_EQ(4, table->count);
+    CHECK_EQ(CONST_SWITCH_DENSE, table->switches[0].kind);
+    CHECK_EQ(CONST_SWITCH_SORTED, table->switches[1].kind);
+    CHECK_EQ(CONST_SWITCH_DENSE, table->switches[2].kind);
+    CHECK_EQ(CONST_SWITCH_HASHED, table->switches[3].kind);
+
+    CHECK_EQ(100, SwitchTable_Offset(table, tablePc, -3));
+    for(int32_t key=-2;key<=2;key++){
+        CHECK_EQ(12+key, SwitchTable_Offset(table, tablePc, key));
+    }
+    CHECK_EQ(100, SwitchTable_Offset(table, tablePc, 3));
+    CHECK_EQ(100, SwitchTable_Offset(table, tablePc, INT32_MIN));
+    CHECK_EQ(100, SwitchTable_Offset(table, tablePc, INT32_MAX));
+
+    for(int32_t i=0;i<3;i++){
+        CHECK_EQ(sortedOffsets[i], SwitchTable_Offset(table, sortedPc, sortedKeys[i]));
+        CHECK_EQ(200, SwitchTable_Offset(table, sortedPc, sortedKeys[i]+1));
+    }
+    CHECK_EQ(200, SwitchTable_Offset(table, sortedPc, INT32_MIN));
+
+    for(int32_t i=0;i<4;i++){
+        CHECK_EQ(denseOffsets[i], SwitchTable_Offset(table, densePc, denseKeys[i]));
+    }
+    CHECK_EQ(300, SwitchTable_Offset(table, densePc, 9));
+    CHECK_EQ(300, SwitchTable_Offset(table, densePc, 12));
+    CHECK_EQ(300, SwitchTable_Offset(table, densePc, 15));
+
+    for(int32_t i=0;i<HASHED_KEYS;i++){
+        CHECK_EQ(hashedOffsets[i], SwitchTable_Offset(table, hashedPc, hashedKeys[i]));
+        CHECK_EQ(400, SwitchTable_Offset(table, hashedPc, hashedKeys[i]+1));
+    }
+    CHECK_EQ(400, SwitchTable_Offset(table, hashedPc, INT32_MAX));
+
+    // malformed switches fail the method
+    length = 0;
+    emitSwitch(CONST_OPCODE_TABLESWITCH, 100);
+    emitS32(2);
+    emitS32(1);
+    code[length++] = CONST_OPCODE_RETURN;
+    CHECK_EQ(-1, initMethod(&method, &attribute));
+    length = 0;
+    int32_t unsortedKeys[] = {5, 5};
+    emitLookup(200, unsortedKeys, sortedOffsets, 2);
+    code[length++] = CONST_OPCODE_RETURN;
+    CHECK_EQ(-1, initMethod(&method, &attribute));
+    return Test_Result("switchtable");
+}
@@ -0,0 +1,36 @@
+#ifndef H_TEST
+#define H_TEST 1
+
+#include <stdio.h>
+
+// Each test program checks one module and exits non-zero when any check
+// failed, see the test target of the Makefile.
+
+static int testFailures = 0;
+
+#define CHECK(cond) do{ \
+    if(!(cond)){ \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        testFailures++; \
+    } \
+}while(0)
+
+#define CHECK_EQ(expected, actual) do{ \
+    long long _e = (long long)(expected); \
+    long long _a = (long long)(actual); \
+    if(_e!=_a){ \
+        fprintf(stderr, "%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual, _a, _e); \
+        testFailures++; \
+    } \
+}while(0)
+
+static inline int Test_Result(const char *name){
+    if(0!=testFailures){
+        fprintf(stderr, "%s: %d checks failed\n", name, testFailures);
+        return 1;
+    }
+    printf("%s: ok\n", name);
+    return 0;
+}
+
+#endif